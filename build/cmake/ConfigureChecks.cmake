@@ -47,6 +47,7 @@ check_include_file(sys/resource.h HAVE_SYS_RESOURCE_H)
 check_include_file(sys/socket.h HAVE_SYS_SOCKET_H)
 check_include_file(sys/stat.h HAVE_SYS_STAT_H)
 check_include_file(sys/time.h HAVE_SYS_TIME_H)
+check_include_file(sys/uio.h HAVE_SYS_UIO_H)
 check_include_file(sys/un.h HAVE_SYS_UN_H)
 check_include_file(poll.h HAVE_POLL_H)
 check_include_file(sys/poll.h HAVE_SYS_POLL_H)
@@ -72,6 +73,7 @@ check_function_exists(gethostbyname_r HAVE_GETHOSTBYNAME_R)
 check_function_exists(strerror_r HAVE_STRERROR_R)
 check_function_exists(sched_get_priority_max HAVE_SCHED_GET_PRIORITY_MAX)
 check_function_exists(sched_get_priority_min HAVE_SCHED_GET_PRIORITY_MIN)
+check_function_exists(pthread_setaffinity_np HAVE_PTHREAD_SETAFFINITY_NP)
 
 
 check_cxx_source_compiles(
@@ -81,6 +83,33 @@ check_cxx_source_compiles(
   "
   STRERROR_R_CHAR_P)
 
+# io_uring with provided buffer rings and multishot receive (Linux 6.0 headers)
+check_cxx_source_compiles(
+  "
+  #include <linux/io_uring.h>
+  int main(){struct io_uring_buf_ring r; (void)r; return IORING_REGISTER_PBUF_RING + IORING_RECV_MULTISHOT + IORING_ACCEPT_MULTISHOT;}
+  "
+  HAVE_LINUX_IO_URING_H)
+
+# memfd_create() and eventfd() for the shared memory transport (Linux)
+check_cxx_source_compiles(
+  "
+  #include <sys/eventfd.h>
+  #include <sys/mman.h>
+  int main(){return memfd_create(\"x\", MFD_CLOEXEC) + eventfd(0, EFD_CLOEXEC);}
+  "
+  HAVE_MEMFD_CREATE)
+
+# Optional compression libraries for the THeaderTransport zstd and LZ4 transforms
+find_library(ZSTD_LIBRARY zstd)
+if(ZSTD_LIBRARY)
+  check_include_file(zstd.h HAVE_ZSTD_H)
+endif()
+find_library(LZ4_LIBRARY lz4)
+if(LZ4_LIBRARY)
+  check_include_file(lz4.h HAVE_LZ4_H)
+endif()
+
 
 set(PACKAGE ${PACKAGE_NAME})
 set(PACKAGE_STRING "${PACKAGE_NAME} ${PACKAGE_VERSION}")
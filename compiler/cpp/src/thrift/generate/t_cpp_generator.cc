@@ -27,6 +27,8 @@
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <map>
+#include <set>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -71,6 +73,14 @@ public:
     gen_no_skeleton_ = false;
     gen_no_constructors_ = false;
     gen_private_optional_ = false;
+    gen_string_views_ = false;
+    gen_pmr_ = false;
+    gen_variant_unions_ = false;
+    gen_flat_containers_ = false;
+    gen_serialized_size_ = false;
+    gen_read_partial_ = false;
+    sizing_ = false;
+    partial_ = false;
     has_members_ = false;
 
     for( iter = parsed_options.begin(); iter != parsed_options.end(); ++iter) {
@@ -105,11 +115,30 @@ public:
         gen_no_constructors_ = true;
       } else if ( iter->first.compare("private_optional") == 0) {
         gen_private_optional_ = true;
+      } else if ( iter->first.compare("string_views") == 0) {
+        gen_string_views_ = true;
+      } else if ( iter->first.compare("pmr") == 0) {
+        gen_pmr_ = true;
+      } else if ( iter->first.compare("variant_unions") == 0) {
+        gen_variant_unions_ = true;
+      } else if ( iter->first.compare("flat_containers") == 0) {
+        gen_flat_containers_ = true;
+      } else if ( iter->first.compare("serialized_size") == 0) {
+        gen_serialized_size_ = true;
+      } else if ( iter->first.compare("read_partial") == 0) {
+        gen_read_partial_ = true;
       } else {
         throw "unknown option cpp:" + iter->first;
       }
     }
 
+    if (gen_pmr_ && gen_string_views_) {
+      throw "cpp:pmr and cpp:string_views cannot be combined";
+    }
+    if (gen_pmr_ && gen_flat_containers_) {
+      throw "cpp:pmr and cpp:flat_containers cannot be combined";
+    }
+
     out_dir_base_ = "gen-cpp";
   }
 
@@ -177,10 +206,20 @@ public:
   void generate_struct_reader(std::ostream& out, t_struct* tstruct, bool pointers = false);
   void generate_struct_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
   void generate_struct_result_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
+  void generate_struct_serialized_size(t_struct* tstruct);
+  void generate_serialized_size_decl(std::ostream& out);
+  void generate_read_partial_decl(std::ostream& out);
   void generate_struct_swap(std::ostream& out, t_struct* tstruct);
   void generate_struct_swap_decl(std::ostream& out, t_struct* tstruct);
   void generate_struct_print_method(std::ostream& out, t_struct* tstruct);
   void generate_exception_what_method(std::ostream& out, t_struct* tstruct);
+  void generate_variant_union(t_struct* tunion);
+  void generate_variant_union_declaration(std::ostream& out, t_struct* tunion);
+  void generate_variant_union_definition(std::ostream& out, t_struct* tunion);
+  void generate_variant_union_reader(std::ostream& out, t_struct* tunion);
+  void generate_variant_union_writer(std::ostream& out, t_struct* tunion);
+  void generate_variant_union_swap(std::ostream& out, t_struct* tunion);
+  void generate_variant_union_print_method(std::ostream& out, t_struct* tunion);
 
   /**
    * Service-level generation functions
@@ -259,6 +298,22 @@ public:
   std::string namespace_close(std::string ns);
   std::string type_name(t_type* ttype, bool in_typedef = false, bool arg = false);
   std::string base_type_name(t_base_type::t_base tbase);
+  bool is_string_view(t_type* ttype);
+  bool is_pmr_string(t_type* ttype);
+  bool is_pmr_member(t_field* tfield);
+  bool is_variant_union(t_type* ttype);
+  bool is_flat_container(t_type* ttype);
+  bool has_flat_container(t_type* ttype);
+  bool uses_flat_containers();
+  bool uses_lazy_fields();
+  void validate_lazy_fields(t_struct* tstruct);
+  std::string lazy_codec_name(t_field* tfield);
+  void generate_lazy_codec_declarations(std::ostream& out, t_struct* tstruct);
+  void generate_lazy_codecs(std::ostream& out, t_struct* tstruct);
+  void generate_lazy_codec_sizes(std::ostream& out, t_struct* tstruct);
+  std::string variant_alternative(t_field* tfield);
+  std::string array_elem_name(t_type* ttype);
+  std::string declare_local(t_field* tfield);
   std::string declare_field(t_field* tfield,
                             bool init = false,
                             bool pointer = false,
@@ -289,6 +344,16 @@ public:
 
   bool is_reference(t_field* tfield) { return tfield->get_reference(); }
 
+  /**
+   * Whether a field is annotated with cpp.lazy, i.e. is kept as a
+   * ::apache::thrift::TLazy that is decoded on first access.
+   */
+  bool is_lazy(t_field* tfield) const {
+    std::map<std::string, std::vector<std::string>>::const_iterator it
+        = tfield->annotations_.find("cpp.lazy");
+    return it != tfield->annotations_.end() && !(!it->second.empty() && it->second.back() == "false");
+  }
+
   bool is_complex_type(t_type* ttype) {
     ttype = get_true_type(ttype);
 
@@ -422,6 +487,51 @@ private:
    */
   bool gen_private_optional_;
 
+  /**
+   * True if we should generate string and binary values as TStringView.
+   */
+  bool gen_string_views_;
+
+  /**
+   * True if we should generate std::pmr strings and containers that are
+   * allocated from the current TArena.
+   */
+  bool gen_pmr_;
+
+  /**
+   * True if we should generate unions that keep their value in a
+   * std::variant rather than a member and an isset flag for every field.
+   */
+  bool gen_variant_unions_;
+
+  /**
+   * True if we should generate maps and sets as sorted vectors
+   * (TFlatMap and TFlatSet) unless their cpp.flat annotation says otherwise.
+   */
+  bool gen_flat_containers_;
+
+  /**
+   * True if we should generate serializedSize<Protocol>() methods for structs.
+   */
+  bool gen_serialized_size_;
+
+  /**
+   * True if we should generate readPartial() methods for structs, which only
+   * decode the fields in a TFieldMask.
+   */
+  bool gen_read_partial_;
+
+  /**
+   * True while a writer is generated as the serializedSize() of a struct,
+   * which calls the serializedSize() of the structs in it.
+   */
+  bool sizing_;
+
+  /**
+   * True while a reader is generated as the readPartial() of a struct.
+   */
+  bool partial_;
+
   /**
    * True if thrift has member(s)
    */
@@ -443,6 +553,12 @@ private:
   ofstream_with_content_based_conditional_update f_types_impl_;
   ofstream_with_content_based_conditional_update f_types_tcc_;
   ofstream_with_content_based_conditional_update f_header_;
+
+  /**
+   * The serializedSize() templates of the structs, which go at the end of
+   * the types header, where every struct they refer to is complete.
+   */
+  std::ostringstream f_types_sizes_;
   ofstream_with_content_based_conditional_update f_service_;
   ofstream_with_content_based_conditional_update f_service_tcc_;
 
@@ -497,8 +613,26 @@ void t_cpp_generator::init_generator() {
            << "#include <thrift/TApplicationException.h>" << '\n'
            << "#include <thrift/TBase.h>" << '\n'
            << "#include <thrift/protocol/TProtocol.h>" << '\n'
-           << "#include <thrift/transport/TTransport.h>" << '\n'
-           << '\n';
+           << "#include <thrift/transport/TTransport.h>" << '\n';
+  if (gen_pmr_) {
+    f_types_ << "#include <thrift/TArena.h>" << '\n';
+  }
+  if (gen_serialized_size_) {
+    f_types_ << "#include <thrift/protocol/TSerializedSize.h>" << '\n';
+  }
+  if (gen_read_partial_) {
+    f_types_ << "#include <thrift/protocol/TFieldMask.h>" << '\n';
+  }
+  f_types_ << '\n';
+  if (gen_variant_unions_) {
+    f_types_ << "#include <variant>" << '\n';
+  }
+  if (uses_flat_containers()) {
+    f_types_ << "#include <thrift/TFlatContainers.h>" << '\n';
+  }
+  if (uses_lazy_fields()) {
+    f_types_ << "#include <thrift/TLazy.h>" << '\n';
+  }
   // Include C++xx compatibility header
   f_types_ << "#include <functional>" << '\n';
   f_types_ << "#include <memory>" << '\n';
@@ -560,6 +694,8 @@ void t_cpp_generator::init_generator() {
  * Closes the output files.
  */
 void t_cpp_generator::close_generator() {
+  f_types_ << f_types_sizes_.str();
+
   // Close namespace
   f_types_ << ns_close_ << '\n' << '\n';
   f_types_impl_ << ns_close_ << '\n';
@@ -940,6 +1076,11 @@ void t_cpp_generator::print_const_value(ostream& out,
         throw "type error: " + type->get_name() + " has no field " + v_iter->first->get_string();
       }
       string item_val = render_const_value(&out, name, field_type, v_iter->second);
+      if (is_variant_union(type)) {
+        indent(out) << name << ".__set_" << v_iter->first->get_string() << "(" << item_val
+                    << ");" << '\n';
+        continue;
+      }
       indent(out) << name << "." << v_iter->first->get_string() << " = " << item_val << ";" << '\n';
       if (is_nonrequired_field) {
         indent(out) << name << ".__isset." << v_iter->first->get_string() << " = true;" << '\n';
@@ -1043,12 +1184,27 @@ void t_cpp_generator::generate_forward_declaration(t_struct* tstruct) {
  * @param tstruct The struct definition
  */
 void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception) {
+  validate_lazy_fields(tstruct);
+  if (is_variant_union(tstruct)) {
+    generate_variant_union(tstruct);
+    return;
+  }
+
   generate_struct_declaration(f_types_, tstruct, is_exception, false, true, true, true, true);
   generate_struct_definition(f_types_impl_, f_types_impl_, tstruct, true, true, false);
+  generate_lazy_codecs(f_types_impl_, tstruct);
 
   std::ostream& out = (gen_templates_ ? f_types_tcc_ : f_types_impl_);
   generate_struct_reader(out, tstruct);
+  if (gen_read_partial_) {
+    partial_ = true;
+    generate_struct_reader(out, tstruct);
+    partial_ = false;
+  }
   generate_struct_writer(out, tstruct);
+  if (gen_serialized_size_) {
+    generate_struct_serialized_size(tstruct);
+  }
   
   // Generate forward setter template implementations in .tcc file
   if (gen_forward_setter_) {
@@ -1161,16 +1317,21 @@ void t_cpp_generator::generate_default_constructor(ostream& out,
   // the initializer block
   for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
     t_type* t = get_true_type((*m_iter)->get_type());
-    if (t->is_base_type() || t->is_enum() || is_reference(*m_iter)) {
+    if (t->is_base_type() || t->is_enum() || is_reference(*m_iter) || is_pmr_member(*m_iter)) {
       string dval;
       t_const_value* cv = (*m_iter)->get_value();
-      if (cv != nullptr) {
+      if (t->is_container() && !is_reference(*m_iter)) {
+        // Contents, if any, are added below
+      } else if (cv != nullptr) {
         dval += render_const_value(&out, (*m_iter)->get_name(), t, cv);
       } else if (t->is_enum()) {
         dval += "static_cast<" + type_name(t) + ">(0)";
       } else {
         dval += (t->is_string() || is_reference(*m_iter) || t->is_uuid()) ? "" : "0";
       }
+      if (is_pmr_member(*m_iter)) {
+        dval += (dval.empty() ? "" : ", ") + string("::apache::thrift::TArena::current()");
+      }
       if (!init_ctor) {
         init_ctor = true;
         if(has_default_value) {
@@ -1200,7 +1361,8 @@ void t_cpp_generator::generate_default_constructor(ostream& out,
     if (!t->is_base_type() && !t->is_enum() && !is_reference(*m_iter)) {
       t_const_value* cv = (*m_iter)->get_value();
       if (cv != nullptr) {
-        print_const_value(out, (*m_iter)->get_name(), t, cv);
+        string name = (*m_iter)->get_name();
+        print_const_value(out, is_lazy(*m_iter) ? name + ".mutable_get()" : name, t, cv);
       }
     }
   }
@@ -1246,13 +1408,29 @@ void t_cpp_generator::generate_constructor_helper(ostream& out,
   out << tmp_name << ") ";
   if(is_move || is_struct_storage_not_throwing(tstruct))
     out << "noexcept ";
-  if (is_exception)
-    out << ": TException() ";
-  out << "{" << '\n';
-  indent_up();
 
   const vector<t_field*>& members = tstruct->get_members();
 
+  // Members are assigned below; pmr ones first need the current arena
+  vector<string> pmr_inits;
+  for (auto member : members) {
+    if (is_pmr_member(member)) {
+      pmr_inits.push_back(member->get_name() + "(::apache::thrift::TArena::current())");
+    }
+  }
+  if (pmr_inits.empty()) {
+    if (is_exception)
+      out << ": TException() ";
+  } else {
+    out << '\n' << indent() << "   : " << (is_exception ? "TException(),\n" + indent() + "     " : "");
+    for (size_t i = 0; i < pmr_inits.size(); ++i) {
+      out << (i == 0 ? "" : ",\n" + indent() + "     ") << pmr_inits[i];
+    }
+    out << " ";
+  }
+  out << "{" << '\n';
+  indent_up();
+
   // eliminate compiler unused warning
   if (members.empty())
     indent(out) << "(void) " << tmp_name << ";" << '\n';
@@ -1440,6 +1618,10 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
     out << "~" << tstruct->get_name() << "() noexcept;\n";
   }
 
+  if (!pointers) {
+    generate_lazy_codec_declarations(out, tstruct);
+  }
+
   // Declare all fields
   if (gen_private_optional_ && !pointers) {
     bool fields_are_public = true;
@@ -1512,7 +1694,8 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
       }
       // Const getter only
       out << '\n' << indent() << "const " << field_type << "& __get_" << (*m_iter)->get_name() 
-          << "() const { return " << (*m_iter)->get_name() << "; }" << '\n';
+          << "() const { return " << (*m_iter)->get_name()
+          << (is_lazy(*m_iter) ? ".get()" : "") << "; }" << '\n';
     }
   }
   out << '\n';
@@ -1547,6 +1730,9 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
         out << " override";
       out << ';' << '\n';
     }
+    if (is_user_struct && gen_read_partial_) {
+      generate_read_partial_decl(out);
+    }
   }
   if (write) {
     if (gen_templates_) {
@@ -1559,6 +1745,9 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
         out << " override";
       out << ';' << '\n';
     }
+    if (is_user_struct && gen_serialized_size_) {
+      generate_serialized_size_decl(out);
+    }
   }
   out << '\n';
 
@@ -1724,12 +1913,14 @@ void t_cpp_generator::generate_struct_forward_setter_impls(ostream& out, t_struc
  * @param tstruct The struct
  */
 void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bool pointers) {
+  string method = partial_ ? "readPartial" : "read";
+  string mask = partial_ ? ", const ::apache::thrift::protocol::TFieldMask& mask" : "";
   if (gen_templates_) {
     out << indent() << "template <class Protocol_>" << '\n' << indent() << "uint32_t "
-        << tstruct->get_name() << "::read(Protocol_* iprot) {" << '\n';
+        << tstruct->get_name() << "::" << method << "(Protocol_* iprot" << mask << ") {" << '\n';
   } else {
-    indent(out) << "uint32_t " << tstruct->get_name()
-                << "::read(::apache::thrift::protocol::TProtocol* iprot) {" << '\n';
+    indent(out) << "uint32_t " << tstruct->get_name() << "::" << method
+                << "(::apache::thrift::protocol::TProtocol* iprot" << mask << ") {" << '\n';
   }
   indent_up();
 
@@ -1767,6 +1958,13 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
   out << indent() << "if (ftype == ::apache::thrift::protocol::T_STOP) {" << '\n' << indent()
       << "  break;" << '\n' << indent() << "}" << '\n';
 
+  if (partial_) {
+    out << indent() << "if (!mask.contains(fid)) {" << '\n' << indent()
+        << "  xfer += iprot->skip(ftype);" << '\n' << indent()
+        << "  xfer += iprot->readFieldEnd();" << '\n' << indent() << "  continue;" << '\n'
+        << indent() << "}" << '\n';
+  }
+
   if (fields.empty()) {
     out << indent() << "xfer += iprot->skip(ftype);" << '\n';
   } else {
@@ -1830,7 +2028,9 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
   out << '\n';
   for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
     if ((*f_iter)->get_req() == t_field::T_REQUIRED)
-      out << indent() << "if (!isset_" << (*f_iter)->get_name() << ')' << '\n' << indent()
+      out << indent() << "if (!isset_" << (*f_iter)->get_name()
+          << (partial_ ? " && mask.contains(" + std::to_string((*f_iter)->get_key()) + ")" : "")
+          << ')' << '\n' << indent()
           << "  throw TProtocolException(TProtocolException::INVALID_DATA);" << '\n';
   }
 
@@ -1851,7 +2051,10 @@ void t_cpp_generator::generate_struct_writer(ostream& out, t_struct* tstruct, bo
   const vector<t_field*>& fields = tstruct->get_sorted_members();
   vector<t_field*>::const_iterator f_iter;
 
-  if (gen_templates_) {
+  if (sizing_) {
+    out << indent() << "template <class Sizer_>" << '\n' << indent() << "uint32_t "
+        << tstruct->get_name() << "::serializedSize(Sizer_* oprot) const {" << '\n';
+  } else if (gen_templates_) {
     out << indent() << "template <class Protocol_>" << '\n' << indent() << "uint32_t "
         << tstruct->get_name() << "::write(Protocol_* oprot) const {" << '\n';
   } else {
@@ -1862,7 +2065,9 @@ void t_cpp_generator::generate_struct_writer(ostream& out, t_struct* tstruct, bo
 
   out << indent() << "uint32_t xfer = 0;" << '\n';
 
-  indent(out) << "::apache::thrift::protocol::TOutputRecursionTracker tracker(*oprot);" << '\n';
+  if (!sizing_) {
+    indent(out) << "::apache::thrift::protocol::TOutputRecursionTracker tracker(*oprot);" << '\n';
+  }
   indent(out) << "xfer += oprot->writeStructBegin(\"" << name << "\");" << '\n';
 
   for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
@@ -1904,6 +2109,63 @@ void t_cpp_generator::generate_struct_writer(ostream& out, t_struct* tstruct, bo
   indent(out) << "}" << '\n' << '\n';
 }
 
+/**
+ * Generates the serializedSize() template of a struct into the end of the
+ * types header.  It is its writer, calling a sizer rather than a protocol.
+ *
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_struct_serialized_size(t_struct* tstruct) {
+  sizing_ = true;
+  if (is_variant_union(tstruct)) {
+    generate_variant_union_writer(f_types_sizes_, tstruct);
+  } else {
+    generate_struct_writer(f_types_sizes_, tstruct);
+    generate_lazy_codec_sizes(f_types_sizes_, tstruct);
+  }
+  sizing_ = false;
+}
+
+/**
+ * Declares the readPartial() method of a struct.
+ *
+ * @param out Stream to write to
+ */
+void t_cpp_generator::generate_read_partial_decl(ostream& out) {
+  out << '\n' << indent() << "/**" << '\n' << indent()
+      << " * Reads the struct like read(), but only decodes the fields whose ids are" << '\n'
+      << indent() << " * in the mask and skips all others, which keep their defaults and" << '\n'
+      << indent() << " * are not set. Only the required fields in the mask have to be there." << '\n'
+      << indent() << " */" << '\n';
+  if (gen_templates_) {
+    out << indent() << "template <class Protocol_>" << '\n' << indent()
+        << "uint32_t readPartial(Protocol_* iprot, const ::apache::thrift::protocol::TFieldMask& mask);"
+        << '\n';
+  } else {
+    out << indent() << "uint32_t readPartial(::apache::thrift::protocol::TProtocol* iprot, "
+        << "const ::apache::thrift::protocol::TFieldMask& mask);" << '\n';
+  }
+}
+
+/**
+ * Declares the serializedSize() methods of a struct.
+ *
+ * @param out Stream to write to
+ */
+void t_cpp_generator::generate_serialized_size_decl(ostream& out) {
+  out << '\n' << indent() << "/**" << '\n' << indent()
+      << " * The number of bytes write() writes with the given protocol, computed" << '\n'
+      << indent() << " * without encoding anything." << '\n' << indent() << " */" << '\n'
+      << indent() << "template <class Protocol_>" << '\n' << indent()
+      << "uint32_t serializedSize() const {" << '\n' << indent()
+      << "  typename ::apache::thrift::protocol::TProtocolSizer<Protocol_>::type sizer;" << '\n'
+      << indent()
+      << "  sizer.setRawFormat(::apache::thrift::protocol::TProtocolSizer<Protocol_>::rawFormat());"
+      << '\n' << indent() << "  return serializedSize(&sizer);" << '\n' << indent() << "}" << '\n'
+      << indent() << "template <class Sizer_>" << '\n' << indent()
+      << "uint32_t serializedSize(Sizer_* oprot) const;" << '\n';
+}
+
 /**
  * Struct writer for result of a function, which can have only one of its
  * fields set and does a conditional if else look up into the __isset field
@@ -2234,152 +2496,586 @@ void t_cpp_generator::generate_exception_what_method(std::ostream& out, t_struct
 }
 
 /**
- * Generates a thrift service. In C++, this comprises an entirely separate
- * header and source file. The header file defines the methods and includes
- * the data types defined in the main header file, and the implementation
- * file contains implementations of the basic printer and default interfaces.
+ * Generates a union that keeps its value in a std::variant. The variant has
+ * an empty alternative, then one for each field in the order they are
+ * declared, so that it is no larger than the largest field, and the index
+ * of the field that is set is the Type of the union.
  *
- * @param tservice The service definition
+ * @param tunion The union definition
  */
-void t_cpp_generator::generate_service(t_service* tservice) {
-  string svcname = tservice->get_name();
-
-  // Make output files
-  string f_header_name = get_out_dir() + svcname + ".h";
-  f_header_.open(f_header_name.c_str());
+void t_cpp_generator::generate_variant_union(t_struct* tunion) {
+  generate_variant_union_declaration(f_types_, tunion);
+  generate_variant_union_definition(f_types_impl_, tunion);
 
-  // Print header file includes
-  f_header_ << autogen_comment();
-  f_header_ << "#ifndef " << svcname << "_H" << '\n' << "#define " << svcname << "_H" << '\n'
-            << '\n';
-  if (gen_cob_style_) {
-    f_header_ << "#include <thrift/transport/TBufferTransports.h>" << '\n' // TMemoryBuffer
-              << "#include <functional>" << '\n'
-              << "namespace apache { namespace thrift { namespace async {" << '\n'
-              << "class TAsyncChannel;" << '\n' << "}}}" << '\n';
-  }
-  f_header_ << "#include <thrift/TDispatchProcessor.h>" << '\n';
-  if (gen_cob_style_) {
-    f_header_ << "#include <thrift/async/TAsyncDispatchProcessor.h>" << '\n';
+  std::ostream& out = (gen_templates_ ? f_types_tcc_ : f_types_impl_);
+  generate_variant_union_reader(out, tunion);
+  generate_variant_union_writer(out, tunion);
+  if (gen_serialized_size_) {
+    generate_struct_serialized_size(tunion);
   }
-  f_header_ << "#include <thrift/async/TConcurrentClientSyncInfo.h>" << '\n';
-  f_header_ << "#include <memory>" << '\n';
-  f_header_ << "#include \"" << get_include_prefix(*get_program()) << program_name_ << "_types.h\""
-            << '\n';
+  generate_variant_union_swap(f_types_impl_, tunion);
 
-  t_service* extends_service = tservice->get_extends();
-  if (extends_service != nullptr) {
-    f_header_ << "#include \"" << get_include_prefix(*(extends_service->get_program()))
-              << extends_service->get_name() << ".h\"" << '\n';
+  if (!has_custom_ostream(tunion)) {
+    std::ostream& print_method_out = (gen_template_streamop_ ? f_types_tcc_ : f_types_impl_);
+    generate_variant_union_print_method(print_method_out, tunion);
   }
 
-  f_header_ << '\n' << ns_open_ << '\n' << '\n';
-
-  f_header_ << "#ifdef _MSC_VER\n"
-               "  #pragma warning( push )\n"
-               "  #pragma warning (disable : 4250 ) //inheriting methods via dominance \n"
-               "#endif\n\n";
+  has_members_ = true;
+}
 
-  // Service implementation file includes
-  string f_service_name = get_out_dir() + svcname + ".cpp";
-  f_service_.open(f_service_name.c_str());
-  f_service_ << autogen_comment();
-  f_service_ << "#include \"" << get_include_prefix(*get_program()) << svcname << ".h\"" << '\n';
-  if (gen_cob_style_) {
-    f_service_ << "#include \"thrift/async/TAsyncChannel.h\"" << '\n';
-  }
-  if (gen_templates_) {
-    f_service_ << "#include \"" << get_include_prefix(*get_program()) << svcname << ".tcc\""
-               << '\n';
+/**
+ * Writes the declaration of a variant union into the header file
+ *
+ * @param out Output stream
+ * @param tunion The union
+ */
+void t_cpp_generator::generate_variant_union_declaration(ostream& out, t_struct* tunion) {
+  const string& name = tunion->get_name();
+  const vector<t_field*>& members = tunion->get_members();
+  bool is_final = tunion->annotations_.find("final") != tunion->annotations_.end();
+  string extends = gen_templates_ ? "" : " : public virtual ::apache::thrift::TBase";
 
-    string f_service_tcc_name = get_out_dir() + svcname + ".tcc";
-    f_service_tcc_.open(f_service_tcc_name.c_str());
-    f_service_tcc_ << autogen_comment();
-    f_service_tcc_ << "#include \"" << get_include_prefix(*get_program()) << svcname << ".h\""
-                   << '\n';
+  out << '\n';
+  generate_java_doc(out, tunion);
+  out << indent() << "class " << name << extends << " {" << '\n' << indent() << " public:"
+      << '\n' << '\n';
+  indent_up();
 
-    f_service_tcc_ << "#ifndef " << svcname << "_TCC" << '\n' << "#define " << svcname << "_TCC"
-                   << '\n' << '\n';
+  indent(out) << "enum class Type {" << '\n';
+  indent_up();
+  indent(out) << "__EMPTY__ = 0";
+  for (size_t i = 0; i < members.size(); ++i) {
+    out << "," << '\n' << indent() << members[i]->get_name() << " = " << (i + 1);
+  }
+  out << '\n';
+  indent_down();
+  indent(out) << "};" << '\n' << '\n';
 
-    if (gen_cob_style_) {
-      f_service_tcc_ << "#include \"thrift/async/TAsyncChannel.h\"" << '\n';
+  if (!gen_no_constructors_) {
+    indent(out) << name << "(const " << name << "&) = default;" << '\n';
+    indent(out) << name << "(" << name << "&&) = default;" << '\n';
+    indent(out) << name << "& operator=(const " << name << "&) = default;" << '\n';
+    indent(out) << name << "& operator=(" << name << "&&) = default;" << '\n';
+    indent(out) << name << "()" << (has_field_with_default_value(tunion) ? "" : " noexcept")
+                << ";" << '\n';
+    if (!is_final) {
+      out << '\n' << indent();
+      if (!gen_templates_) out << "virtual ";
+      out << "~" << name << "() noexcept;" << '\n';
     }
   }
 
-  f_service_ << '\n' << ns_open_ << '\n' << '\n';
-  f_service_tcc_ << '\n' << ns_open_ << '\n' << '\n';
-
-  // Generate all the components
-  generate_service_interface(tservice, "");
-  generate_service_interface_factory(tservice, "");
-  generate_service_null(tservice, "");
-  generate_service_helpers(tservice);
-  generate_service_client(tservice, "");
-  generate_service_processor(tservice, "");
-  generate_service_multiface(tservice);
-  generate_service_client(tservice, "Concurrent");
+  out << '\n' << indent() << "Type getType() const noexcept {" << '\n' << indent()
+      << "  return static_cast<Type>(value_.index());" << '\n' << indent() << "}" << '\n';
 
-  // Generate skeleton
-  if (!gen_no_skeleton_) {
-      generate_service_skeleton(tservice);
+  // The getters throw std::bad_variant_access unless the field is the one
+  // that is set, the mutable ones set the field when it is not
+  for (size_t i = 0; i < members.size(); ++i) {
+    t_field* field = members[i];
+    string alternative = variant_alternative(field);
+    out << '\n';
+    generate_java_doc(out, field);
+    indent(out) << "const " << alternative << "& get_" << field->get_name() << "() const {"
+                << '\n' << indent() << "  return std::get<" << (i + 1) << ">(value_);" << '\n'
+                << indent() << "}" << '\n';
+    indent(out) << alternative << "& mutable_" << field->get_name() << "() {" << '\n';
+    indent_up();
+    indent(out) << "if (value_.index() != " << (i + 1) << ") {" << '\n';
+    indent(out) << "  value_.emplace<" << (i + 1) << ">("
+                << (is_pmr_member(field) ? "::apache::thrift::TArena::current()" : "") << ");"
+                << '\n';
+    indent(out) << "}" << '\n';
+    indent(out) << "return std::get<" << (i + 1) << ">(value_);" << '\n';
+    indent_down();
+    indent(out) << "}" << '\n';
+    if (is_reference(field)) {
+      indent(out) << "void __set_" << field->get_name() << "(" << alternative << " val);" << '\n';
+    } else {
+      indent(out) << "void __set_" << field->get_name() << "("
+                  << type_name(field->get_type(), false, true) << " val);" << '\n';
+    }
   }
 
-  // Generate all the cob components
-  if (gen_cob_style_) {
-    generate_service_interface(tservice, "CobCl");
-    generate_service_interface(tservice, "CobSv");
-    generate_service_interface_factory(tservice, "CobSv");
-    generate_service_null(tservice, "CobSv");
-    generate_service_client(tservice, "Cob");
-    generate_service_processor(tservice, "Cob");
+  out << '\n' << indent() << "void __clear() noexcept {" << '\n' << indent()
+      << "  value_.emplace<0>();" << '\n' << indent() << "}" << '\n' << '\n';
 
-    if (!gen_no_skeleton_) {
-      generate_service_async_skeleton(tservice);
-    }
+  if (!gen_no_default_operators_) {
+    out << indent() << "bool operator == (const " << name << " & rhs) const;" << '\n';
+    out << indent() << "bool operator != (const " << name << " &rhs) const {" << '\n'
+        << indent() << "  return !(*this == rhs);" << '\n' << indent() << "}" << '\n' << '\n';
+    out << indent() << "bool operator < (const " << name << " & ) const;" << '\n' << '\n';
+  }
 
+  if (gen_templates_) {
+    out << indent() << "template <class Protocol_>" << '\n' << indent()
+        << "uint32_t read(Protocol_* iprot);" << '\n';
+    out << indent() << "template <class Protocol_>" << '\n' << indent()
+        << "uint32_t write(Protocol_* oprot) const;" << '\n';
+  } else {
+    out << indent() << "uint32_t read(::apache::thrift::protocol::TProtocol* iprot) override;"
+        << '\n';
+    out << indent()
+        << "uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const override;" << '\n';
+  }
+  if (gen_serialized_size_) {
+    generate_serialized_size_decl(out);
   }
+  out << '\n';
 
-  f_header_ << "#ifdef _MSC_VER\n"
-               "  #pragma warning( pop )\n"
-               "#endif\n\n";
+  if (!has_custom_ostream(tunion)) {
+    out << indent();
+    if (!gen_templates_ && !gen_template_streamop_) out << "virtual ";
+    generate_struct_print_method_decl(out, nullptr);
+    out << ";" << '\n' << '\n';
+  }
 
-  // Close the namespace
-  f_service_ << ns_close_ << '\n' << '\n';
-  f_service_tcc_ << ns_close_ << '\n' << '\n';
-  f_header_ << ns_close_ << '\n' << '\n';
+  indent(out) << "friend ";
+  generate_struct_swap_decl(out, tunion);
 
-  // TODO(simpkins): Make this a separate option
-  if (gen_templates_) {
-    f_header_ << "#include \"" << get_include_prefix(*get_program()) << svcname << ".tcc\"" << '\n'
-              << "#include \"" << get_include_prefix(*get_program()) << program_name_
-              << "_types.tcc\"" << '\n' << '\n';
+  indent_down();
+  out << indent() << " private:" << '\n';
+  indent_up();
+  indent(out) << "std::variant<std::monostate";
+  for (auto member : members) {
+    out << ", " << variant_alternative(member);
   }
+  out << "> value_;" << '\n';
 
-  f_header_ << "#endif" << '\n';
-  f_service_tcc_ << "#endif" << '\n';
+  indent_down();
+  indent(out) << "};" << '\n' << '\n';
 
-  // Close the files
-  f_service_tcc_.close();
-  f_service_.close();
-  f_header_.close();
+  out << indent();
+  generate_struct_swap_decl(out, tunion);
+  generate_struct_ostream_operator_decl(out, tunion);
 }
 
 /**
- * Generates helper functions for a service. Basically, this generates types
- * for all the arguments and results to functions.
+ * Writes the constructors, setters and operators of a variant union
  *
- * @param tservice The service to generate a header definition for
+ * @param out Output stream
+ * @param tunion The union
  */
-void t_cpp_generator::generate_service_helpers(t_service* tservice) {
-  vector<t_function*> functions = tservice->get_functions();
-  vector<t_function*>::iterator f_iter;
-  std::ostream& out = (gen_templates_ ? f_service_tcc_ : f_service_);
+void t_cpp_generator::generate_variant_union_definition(ostream& out, t_struct* tunion) {
+  const string& name = tunion->get_name();
+  const vector<t_field*>& members = tunion->get_members();
 
-  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
-    t_struct* ts = (*f_iter)->get_arglist();
-    string name_orig = ts->get_name();
+  if (!gen_no_constructors_) {
+    if (tunion->annotations_.find("final") == tunion->annotations_.end()) {
+      out << '\n' << indent() << name << "::~" << name << "() noexcept {" << '\n' << indent()
+          << "}" << '\n' << '\n';
+    }
 
-    // TODO(dreiss): Why is this stuff not in generate_function_helpers?
+    // A union starts out empty, unless a field has a default value
+    bool has_default_value = has_field_with_default_value(tunion);
+    indent(out) << name << "::" << name << "()" << (has_default_value ? "" : " noexcept") << " {"
+                << '\n';
+    indent_up();
+    for (size_t i = 0; i < members.size(); ++i) {
+      t_const_value* cv = members[i]->get_value();
+      if (cv == nullptr) {
+        continue;
+      }
+      t_type* t = get_true_type(members[i]->get_type());
+      if (t->is_base_type() || t->is_enum() || is_reference(members[i])) {
+        indent(out) << "value_.emplace<" << (i + 1) << ">("
+                    << render_const_value(&out, members[i]->get_name(), t, cv) << ");" << '\n';
+      } else {
+        indent(out) << "auto& " << members[i]->get_name() << " = value_.emplace<" << (i + 1)
+                    << ">("
+                    << (is_pmr_member(members[i]) ? "::apache::thrift::TArena::current()" : "")
+                    << ");" << '\n';
+        print_const_value(out, members[i]->get_name(), t, cv);
+      }
+    }
+    scope_down(out);
+  }
+
+  for (size_t i = 0; i < members.size(); ++i) {
+    t_field* field = members[i];
+    out << '\n' << indent() << "void " << name << "::__set_" << field->get_name() << "(";
+    if (is_reference(field)) {
+      out << variant_alternative(field);
+    } else {
+      out << type_name(field->get_type(), false, true);
+    }
+    out << " val) {" << '\n';
+    indent(out) << "  value_.emplace<" << (i + 1) << ">(val"
+                << (is_pmr_member(field) ? ", ::apache::thrift::TArena::current()" : "") << ");"
+                << '\n';
+    indent(out) << "}" << '\n';
+  }
+
+  if (!gen_no_default_operators_) {
+    out << '\n' << indent() << "bool " << name << "::operator==(const " << name
+        << " & rhs) const" << '\n';
+    scope_up(out);
+    indent(out) << "return value_ == rhs.value_;" << '\n';
+    scope_down(out);
+    out << '\n';
+  }
+
+  std::ostream& ostream_op_out = (gen_template_streamop_ ? f_types_tcc_ : out);
+  generate_struct_ostream_operator(ostream_op_out, tunion);
+  out << '\n';
+}
+
+/**
+ * Generates the reader of a variant union, which reads a field straight
+ * into the alternative it is kept in.
+ *
+ * @param out Stream to write to
+ * @param tunion The union
+ */
+void t_cpp_generator::generate_variant_union_reader(ostream& out, t_struct* tunion) {
+  const vector<t_field*>& fields = tunion->get_members();
+
+  if (gen_templates_) {
+    out << indent() << "template <class Protocol_>" << '\n' << indent() << "uint32_t "
+        << tunion->get_name() << "::read(Protocol_* iprot) {" << '\n';
+  } else {
+    indent(out) << "uint32_t " << tunion->get_name()
+                << "::read(::apache::thrift::protocol::TProtocol* iprot) {" << '\n';
+  }
+  indent_up();
+
+  out << '\n'
+      << indent() << "::apache::thrift::protocol::TInputRecursionTracker tracker(*iprot);" << '\n'
+      << indent() << "uint32_t xfer = 0;" << '\n'
+      << indent() << "std::string fname;" << '\n'
+      << indent() << "::apache::thrift::protocol::TType ftype;" << '\n'
+      << indent() << "int16_t fid;" << '\n'
+      << '\n'
+      << indent() << "xfer += iprot->readStructBegin(fname);" << '\n'
+      << '\n';
+
+  indent(out) << "while (true)" << '\n';
+  scope_up(out);
+
+  indent(out) << "xfer += iprot->readFieldBegin(fname, ftype, fid);" << '\n';
+  out << indent() << "if (ftype == ::apache::thrift::protocol::T_STOP) {" << '\n' << indent()
+      << "  break;" << '\n' << indent() << "}" << '\n';
+
+  if (fields.empty()) {
+    out << indent() << "xfer += iprot->skip(ftype);" << '\n';
+  } else {
+    indent(out) << "switch (fid)" << '\n';
+    scope_up(out);
+
+    for (size_t i = 0; i < fields.size(); ++i) {
+      t_field* field = fields[i];
+      indent(out) << "case " << field->get_key() << ":" << '\n';
+      indent_up();
+      indent(out) << "if (ftype == " << type_to_enum(field->get_type()) << ") {" << '\n';
+      indent_up();
+      indent(out) << "auto& " << field->get_name() << "_ = this->value_.emplace<" << (i + 1)
+                  << ">("
+                  << (is_pmr_member(field) ? "::apache::thrift::TArena::current()" : "")
+                  << ");" << '\n';
+      generate_deserialize_field(out, field, "", "_");
+      indent_down();
+      out << indent() << "} else {" << '\n' << indent() << "  xfer += iprot->skip(ftype);" << '\n'
+          << indent() << "}" << '\n' << indent() << "break;" << '\n';
+      indent_down();
+    }
+
+    out << indent() << "default:" << '\n' << indent() << "  xfer += iprot->skip(ftype);" << '\n'
+        << indent() << "  break;" << '\n';
+
+    scope_down(out);
+  }
+  indent(out) << "xfer += iprot->readFieldEnd();" << '\n';
+
+  scope_down(out);
+
+  out << '\n' << indent() << "xfer += iprot->readStructEnd();" << '\n';
+  indent(out) << "return xfer;" << '\n';
+
+  indent_down();
+  indent(out) << "}" << '\n' << '\n';
+}
+
+/**
+ * Generates the writer of a variant union, which writes only the field that
+ * is set.
+ *
+ * @param out Stream to write to
+ * @param tunion The union
+ */
+void t_cpp_generator::generate_variant_union_writer(ostream& out, t_struct* tunion) {
+  const string& name = tunion->get_name();
+  const vector<t_field*>& members = tunion->get_members();
+  const vector<t_field*>& fields = tunion->get_sorted_members();
+
+  if (sizing_) {
+    out << indent() << "template <class Sizer_>" << '\n' << indent() << "uint32_t " << name
+        << "::serializedSize(Sizer_* oprot) const {" << '\n';
+  } else if (gen_templates_) {
+    out << indent() << "template <class Protocol_>" << '\n' << indent() << "uint32_t " << name
+        << "::write(Protocol_* oprot) const {" << '\n';
+  } else {
+    indent(out) << "uint32_t " << name
+                << "::write(::apache::thrift::protocol::TProtocol* oprot) const {" << '\n';
+  }
+  indent_up();
+
+  out << indent() << "uint32_t xfer = 0;" << '\n';
+  if (!sizing_) {
+    indent(out) << "::apache::thrift::protocol::TOutputRecursionTracker tracker(*oprot);" << '\n';
+  }
+  indent(out) << "xfer += oprot->writeStructBegin(\"" << name << "\");" << '\n' << '\n';
+
+  indent(out) << "switch (getType())" << '\n';
+  scope_up(out);
+  for (auto field : fields) {
+    size_t index = std::find(members.begin(), members.end(), field) - members.begin() + 1;
+    indent(out) << "case Type::" << field->get_name() << ":" << '\n';
+    scope_up(out);
+    indent(out) << "const auto& " << field->get_name() << "_ = std::get<" << index
+                << ">(this->value_);" << '\n';
+    indent(out) << "xfer += oprot->writeFieldBegin(\"" << field->get_name() << "\", "
+                << type_to_enum(field->get_type()) << ", " << field->get_key() << ");" << '\n';
+    generate_serialize_field(out, field, "", "_");
+    indent(out) << "xfer += oprot->writeFieldEnd();" << '\n';
+    indent(out) << "break;" << '\n';
+    scope_down(out);
+  }
+  indent(out) << "case Type::__EMPTY__:" << '\n';
+  indent(out) << "  break;" << '\n';
+  scope_down(out);
+
+  out << '\n' << indent() << "xfer += oprot->writeFieldStop();" << '\n' << indent()
+      << "xfer += oprot->writeStructEnd();" << '\n' << indent() << "return xfer;" << '\n';
+
+  indent_down();
+  indent(out) << "}" << '\n' << '\n';
+}
+
+/**
+ * Generates the swap function of a variant union.
+ *
+ * @param out Stream to write to
+ * @param tunion The union
+ */
+void t_cpp_generator::generate_variant_union_swap(ostream& out, t_struct* tunion) {
+  string a = "a";
+  string b = "b";
+  if (tunion->get_name() == "a" || tunion->get_name() == "b") {
+    a = "a1";
+    b = "a2";
+  }
+  out << indent() << "void swap(" << tunion->get_name() << " &" << a << ", "
+      << tunion->get_name() << " &" << b << ") noexcept {" << '\n';
+  indent_up();
+  out << indent() << "using ::std::swap;" << '\n';
+  out << indent() << "swap(" << a << ".value_, " << b << ".value_);" << '\n';
+  scope_down(out);
+  out << '\n';
+}
+
+/**
+ * Generates printTo for a variant union, which prints only the field that
+ * is set.
+ */
+void t_cpp_generator::generate_variant_union_print_method(std::ostream& out, t_struct* tunion) {
+  const vector<t_field*>& members = tunion->get_members();
+
+  out << indent();
+  generate_struct_print_method_decl(out, tunion);
+  out << " {" << '\n';
+  indent_up();
+
+  bool use_printto = gen_template_streamop_;
+  if (use_printto) {
+    out << indent() << "using ::apache::thrift::printTo;" << '\n';
+  }
+  out << indent() << "using ::apache::thrift::to_string;" << '\n';
+  out << indent() << "out << \"" << tunion->get_name() << "(\";" << '\n';
+
+  indent(out) << "switch (getType())" << '\n';
+  scope_up(out);
+  for (size_t i = 0; i < members.size(); ++i) {
+    string value = "std::get<" + std::to_string(i + 1) + ">(value_)";
+    indent(out) << "case Type::" << members[i]->get_name() << ":" << '\n';
+    indent_up();
+    if (use_printto) {
+      indent(out) << "out << \"" << members[i]->get_name() << "=\", printTo(out, " << value
+                  << ");" << '\n';
+    } else {
+      indent(out) << "out << \"" << members[i]->get_name() << "=\" << to_string(" << value
+                  << ");" << '\n';
+    }
+    indent(out) << "break;" << '\n';
+    indent_down();
+  }
+  indent(out) << "case Type::__EMPTY__:" << '\n';
+  indent(out) << "  break;" << '\n';
+  scope_down(out);
+
+  out << indent() << "out << \")\";" << '\n';
+
+  indent_down();
+  out << "}" << '\n' << '\n';
+}
+
+/**
+ * Generates a thrift service. In C++, this comprises an entirely separate
+ * header and source file. The header file defines the methods and includes
+ * the data types defined in the main header file, and the implementation
+ * file contains implementations of the basic printer and default interfaces.
+ *
+ * @param tservice The service definition
+ */
+void t_cpp_generator::generate_service(t_service* tservice) {
+  string svcname = tservice->get_name();
+
+  for (auto tfunction : tservice->get_functions()) {
+    vector<t_field*> fields = tfunction->get_arglist()->get_members();
+    const vector<t_field*>& xceptions = tfunction->get_xceptions()->get_members();
+    fields.insert(fields.end(), xceptions.begin(), xceptions.end());
+    for (auto tfield : fields) {
+      if (is_lazy(tfield)) {
+        throw "cpp.lazy on " + tfield->get_name() + " of " + svcname + "." + tfunction->get_name()
+            + ": only struct fields can be lazy";
+      }
+    }
+  }
+
+  // Make output files
+  string f_header_name = get_out_dir() + svcname + ".h";
+  f_header_.open(f_header_name.c_str());
+
+  // Print header file includes
+  f_header_ << autogen_comment();
+  f_header_ << "#ifndef " << svcname << "_H" << '\n' << "#define " << svcname << "_H" << '\n'
+            << '\n';
+  if (gen_cob_style_) {
+    f_header_ << "#include <thrift/transport/TBufferTransports.h>" << '\n' // TMemoryBuffer
+              << "#include <functional>" << '\n'
+              << "namespace apache { namespace thrift { namespace async {" << '\n'
+              << "class TAsyncChannel;" << '\n' << "}}}" << '\n';
+  }
+  f_header_ << "#include <thrift/TDispatchProcessor.h>" << '\n';
+  if (gen_cob_style_) {
+    f_header_ << "#include <thrift/async/TAsyncDispatchProcessor.h>" << '\n';
+  }
+  f_header_ << "#include <thrift/async/TConcurrentClientSyncInfo.h>" << '\n';
+  f_header_ << "#include <memory>" << '\n';
+  f_header_ << "#include \"" << get_include_prefix(*get_program()) << program_name_ << "_types.h\""
+            << '\n';
+
+  t_service* extends_service = tservice->get_extends();
+  if (extends_service != nullptr) {
+    f_header_ << "#include \"" << get_include_prefix(*(extends_service->get_program()))
+              << extends_service->get_name() << ".h\"" << '\n';
+  }
+
+  f_header_ << '\n' << ns_open_ << '\n' << '\n';
+
+  f_header_ << "#ifdef _MSC_VER\n"
+               "  #pragma warning( push )\n"
+               "  #pragma warning (disable : 4250 ) //inheriting methods via dominance \n"
+               "#endif\n\n";
+
+  // Service implementation file includes
+  string f_service_name = get_out_dir() + svcname + ".cpp";
+  f_service_.open(f_service_name.c_str());
+  f_service_ << autogen_comment();
+  f_service_ << "#include \"" << get_include_prefix(*get_program()) << svcname << ".h\"" << '\n';
+  if (gen_cob_style_) {
+    f_service_ << "#include \"thrift/async/TAsyncChannel.h\"" << '\n';
+  }
+  if (gen_templates_) {
+    f_service_ << "#include \"" << get_include_prefix(*get_program()) << svcname << ".tcc\""
+               << '\n';
+
+    string f_service_tcc_name = get_out_dir() + svcname + ".tcc";
+    f_service_tcc_.open(f_service_tcc_name.c_str());
+    f_service_tcc_ << autogen_comment();
+    f_service_tcc_ << "#include \"" << get_include_prefix(*get_program()) << svcname << ".h\""
+                   << '\n';
+
+    f_service_tcc_ << "#ifndef " << svcname << "_TCC" << '\n' << "#define " << svcname << "_TCC"
+                   << '\n' << '\n';
+
+    if (gen_cob_style_) {
+      f_service_tcc_ << "#include \"thrift/async/TAsyncChannel.h\"" << '\n';
+    }
+  }
+
+  f_service_ << '\n' << ns_open_ << '\n' << '\n';
+  f_service_tcc_ << '\n' << ns_open_ << '\n' << '\n';
+
+  // Generate all the components
+  generate_service_interface(tservice, "");
+  generate_service_interface_factory(tservice, "");
+  generate_service_null(tservice, "");
+  generate_service_helpers(tservice);
+  generate_service_client(tservice, "");
+  generate_service_processor(tservice, "");
+  generate_service_multiface(tservice);
+  generate_service_client(tservice, "Concurrent");
+
+  // Generate skeleton
+  if (!gen_no_skeleton_) {
+      generate_service_skeleton(tservice);
+  }
+
+  // Generate all the cob components
+  if (gen_cob_style_) {
+    generate_service_interface(tservice, "CobCl");
+    generate_service_interface(tservice, "CobSv");
+    generate_service_interface_factory(tservice, "CobSv");
+    generate_service_null(tservice, "CobSv");
+    generate_service_client(tservice, "Cob");
+    generate_service_processor(tservice, "Cob");
+
+    if (!gen_no_skeleton_) {
+      generate_service_async_skeleton(tservice);
+    }
+
+  }
+
+  f_header_ << "#ifdef _MSC_VER\n"
+               "  #pragma warning( pop )\n"
+               "#endif\n\n";
+
+  // Close the namespace
+  f_service_ << ns_close_ << '\n' << '\n';
+  f_service_tcc_ << ns_close_ << '\n' << '\n';
+  f_header_ << ns_close_ << '\n' << '\n';
+
+  // TODO(simpkins): Make this a separate option
+  if (gen_templates_) {
+    f_header_ << "#include \"" << get_include_prefix(*get_program()) << svcname << ".tcc\"" << '\n'
+              << "#include \"" << get_include_prefix(*get_program()) << program_name_
+              << "_types.tcc\"" << '\n' << '\n';
+  }
+
+  f_header_ << "#endif" << '\n';
+  f_service_tcc_ << "#endif" << '\n';
+
+  // Close the files
+  f_service_tcc_.close();
+  f_service_.close();
+  f_header_.close();
+}
+
+/**
+ * Generates helper functions for a service. Basically, this generates types
+ * for all the arguments and results to functions.
+ *
+ * @param tservice The service to generate a header definition for
+ */
+void t_cpp_generator::generate_service_helpers(t_service* tservice) {
+  vector<t_function*> functions = tservice->get_functions();
+  vector<t_function*>::iterator f_iter;
+  std::ostream& out = (gen_templates_ ? f_service_tcc_ : f_service_);
+
+  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
+    t_struct* ts = (*f_iter)->get_arglist();
+    string name_orig = ts->get_name();
+
+    // TODO(dreiss): Why is this stuff not in generate_function_helpers?
     ts->set_name(tservice->get_name() + "_" + (*f_iter)->get_name() + "_args");
     generate_struct_declaration(f_header_, ts, false);
     generate_struct_definition(out, f_service_, ts, false);
@@ -3408,6 +4104,9 @@ public:
   void run() {
     generate_class_definition();
 
+    // Generate the getMethodId() function
+    generate_method_lookup();
+
     // Generate the dispatchCall() function
     generate_dispatch_call(false);
     if (generator_->gen_templates_) {
@@ -3421,6 +4120,9 @@ public:
   }
 
   void generate_class_definition();
+  void generate_method_lookup();
+  void generate_method_lookup_switch(const vector<std::pair<string, int> >& methods,
+                                     vector<bool>& used);
   void generate_dispatch_call(bool template_protocol);
   void generate_process_functions();
   void generate_factory();
@@ -3553,30 +4255,6 @@ void ProcessorGenerator::generate_class_definition() {
   f_header_ << " private:" << '\n';
   indent_up();
 
-  // Declare processMap_
-  f_header_ << indent() << "typedef  void (" << class_name_ << "::*"
-            << "ProcessFunction)(" << finish_cob_decl_ << "int32_t, "
-            << "::apache::thrift::protocol::TProtocol*, "
-            << "::apache::thrift::protocol::TProtocol*" << call_context_decl_ << ");" << '\n';
-  if (generator_->gen_templates_) {
-    f_header_ << indent() << "typedef void (" << class_name_ << "::*"
-              << "SpecializedProcessFunction)(" << finish_cob_decl_ << "int32_t, "
-              << "Protocol_*, Protocol_*" << call_context_decl_ << ");" << '\n' << indent()
-              << "struct ProcessFunctions {" << '\n' << indent() << "  ProcessFunction generic;"
-              << '\n' << indent() << "  SpecializedProcessFunction specialized;" << '\n' << indent()
-              << "  ProcessFunctions(ProcessFunction g, "
-              << "SpecializedProcessFunction s) :" << '\n' << indent() << "    generic(g)," << '\n'
-              << indent() << "    specialized(s) {}" << '\n' << indent()
-              << "  ProcessFunctions() : generic(nullptr), specialized(nullptr) "
-              << "{}" << '\n' << indent() << "};" << '\n' << indent()
-              << "typedef std::map<std::string, ProcessFunctions> "
-              << "ProcessMap;" << '\n';
-  } else {
-    f_header_ << indent() << "typedef std::map<std::string, ProcessFunction> "
-              << "ProcessMap;" << '\n';
-  }
-  f_header_ << indent() << "ProcessMap processMap_;" << '\n';
-
   for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
     indent(f_header_) << "void process_" << (*f_iter)->get_name() << "(" << finish_cob_
                       << "int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, "
@@ -3620,45 +4298,117 @@ void ProcessorGenerator::generate_class_definition() {
   if (!extends_.empty()) {
     f_header_ << indent() << "  " << extends_ << "(iface)," << '\n';
   }
-  f_header_ << indent() << "  iface_(iface) {" << '\n';
-  indent_up();
+  f_header_ << indent() << "  iface_(iface) {" << '\n';
+  f_header_ << indent() << "}" << '\n' << '\n' << indent() << "virtual ~" << class_name_ << "() {}"
+            << '\n' << '\n';
+
+  f_header_ << indent() << "/**" << '\n' << indent()
+            << " * Returns the position of fname among the functions declared by this" << '\n'
+            << indent() << " * service (not counting inherited ones), or -1 if it declares none by"
+            << '\n' << indent() << " * that name. Allocation free and independent of the number of"
+            << '\n' << indent() << " * functions." << '\n' << indent() << " */" << '\n';
+  f_header_ << indent() << "static int32_t getMethodId(const std::string& fname);" << '\n';
+  indent_down();
+  f_header_ << "};" << '\n' << '\n';
+
+  if (generator_->gen_templates_) {
+    // Generate a backwards compatible typedef, for callers who don't know
+    // about the new template-style code.
+    //
+    // We can't use TProtocol as the template parameter, since ProcessorT
+    // provides overloaded versions of most methods, one of which accepts
+    // TProtocol pointers, and one which accepts Protocol_ pointers.  This
+    // results in a compile error if instantiated with Protocol_ == TProtocol.
+    // Therefore, we define TDummyProtocol solely so we can use it as the
+    // template parameter here.
+    f_header_ << "typedef " << class_name_ << "< ::apache::thrift::protocol::TDummyProtocol > "
+              << service_name_ << pstyle_ << "Processor;" << '\n' << '\n';
+  }
+}
+
+void ProcessorGenerator::generate_method_lookup() {
+  vector<t_function*> functions = service_->get_functions();
+
+  f_out_ << template_header_ << "int32_t " << class_name_ << template_suffix_
+         << "::getMethodId(const std::string& fname) {" << '\n';
+  indent_up();
+
+  if (functions.empty()) {
+    f_out_ << indent() << "(void)fname;" << '\n' << indent() << "return -1;" << '\n';
+    indent_down();
+    f_out_ << "}" << '\n' << '\n';
+    return;
+  }
+
+  // Bucket the names by length, then tell them apart one character at a time
+  std::map<size_t, vector<std::pair<string, int> > > by_length;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    const string& name = functions[i]->get_name();
+    by_length[name.size()].push_back(std::make_pair(name, static_cast<int>(i)));
+  }
+
+  f_out_ << indent() << "switch (fname.size()) {" << '\n';
+  std::map<size_t, vector<std::pair<string, int> > >::const_iterator l_iter;
+  for (l_iter = by_length.begin(); l_iter != by_length.end(); ++l_iter) {
+    f_out_ << indent() << "case " << l_iter->first << ":" << '\n';
+    indent_up();
+    vector<bool> used(l_iter->first, false);
+    generate_method_lookup_switch(l_iter->second, used);
+    indent_down();
+  }
+  f_out_ << indent() << "default:" << '\n' << indent() << "  break;" << '\n' << indent() << "}"
+         << '\n' << indent() << "return -1;" << '\n';
+
+  indent_down();
+  f_out_ << "}" << '\n' << '\n';
+}
+
+/**
+ * Emits the body of one case of the lookup switch. All of methods have the
+ * same length; used marks the character positions already switched on.
+ */
+void ProcessorGenerator::generate_method_lookup_switch(const vector<std::pair<string, int> >& methods,
+                                                       vector<bool>& used) {
+  if (methods.size() == 1) {
+    f_out_ << indent() << "return fname == \"" << methods[0].first << "\" ? " << methods[0].second
+           << " : -1;" << '\n';
+    return;
+  }
 
-  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
-    f_header_ << indent() << "processMap_[\"" << (*f_iter)->get_name() << "\"] = ";
-    if (generator_->gen_templates_) {
-      f_header_ << "ProcessFunctions(" << '\n';
-      if (generator_->gen_templates_only_) {
-        indent(f_header_) << "  nullptr," << '\n';
-      } else {
-        indent(f_header_) << "  &" << class_name_ << "::process_" << (*f_iter)->get_name() << ","
-                          << '\n';
-      }
-      indent(f_header_) << "  &" << class_name_ << "::process_" << (*f_iter)->get_name() << ")";
-    } else {
-      f_header_ << "&" << class_name_ << "::process_" << (*f_iter)->get_name();
+  // Switch on the position that splits the remaining names the most
+  size_t pos = 0;
+  size_t best = 0;
+  for (size_t p = 0; p < used.size(); ++p) {
+    if (used[p]) {
+      continue;
+    }
+    std::set<char> chars;
+    for (size_t i = 0; i < methods.size(); ++i) {
+      chars.insert(methods[i].first[p]);
+    }
+    if (chars.size() > best) {
+      best = chars.size();
+      pos = p;
     }
-    f_header_ << ";" << '\n';
   }
 
-  indent_down();
-  f_header_ << indent() << "}" << '\n' << '\n' << indent() << "virtual ~" << class_name_ << "() {}"
-            << '\n';
-  indent_down();
-  f_header_ << "};" << '\n' << '\n';
+  std::map<char, vector<std::pair<string, int> > > by_char;
+  for (size_t i = 0; i < methods.size(); ++i) {
+    by_char[methods[i].first[pos]].push_back(methods[i]);
+  }
 
-  if (generator_->gen_templates_) {
-    // Generate a backwards compatible typedef, for callers who don't know
-    // about the new template-style code.
-    //
-    // We can't use TProtocol as the template parameter, since ProcessorT
-    // provides overloaded versions of most methods, one of which accepts
-    // TProtocol pointers, and one which accepts Protocol_ pointers.  This
-    // results in a compile error if instantiated with Protocol_ == TProtocol.
-    // Therefore, we define TDummyProtocol solely so we can use it as the
-    // template parameter here.
-    f_header_ << "typedef " << class_name_ << "< ::apache::thrift::protocol::TDummyProtocol > "
-              << service_name_ << pstyle_ << "Processor;" << '\n' << '\n';
+  used[pos] = true;
+  f_out_ << indent() << "switch (fname[" << pos << "]) {" << '\n';
+  std::map<char, vector<std::pair<string, int> > >::const_iterator c_iter;
+  for (c_iter = by_char.begin(); c_iter != by_char.end(); ++c_iter) {
+    f_out_ << indent() << "case '" << c_iter->first << "':" << '\n';
+    indent_up();
+    generate_method_lookup_switch(c_iter->second, used);
+    indent_down();
   }
+  f_out_ << indent() << "default:" << '\n' << indent() << "  break;" << '\n' << indent() << "}"
+         << '\n' << indent() << "break;" << '\n';
+  used[pos] = false;
 }
 
 void ProcessorGenerator::generate_dispatch_call(bool template_protocol) {
@@ -3682,50 +4432,43 @@ void ProcessorGenerator::generate_dispatch_call(bool template_protocol) {
          << "const std::string& fname, int32_t seqid" << call_context_ << ") {" << '\n';
   indent_up();
 
-  // HOT: member function pointer map
-  f_out_ << indent() << typename_str_ << "ProcessMap::iterator pfn;" << '\n' << indent()
-         << "pfn = processMap_.find(fname);" << '\n' << indent()
-         << "if (pfn == processMap_.end()) {" << '\n';
+  // HOT: switch over the ids from getMethodId()
+  vector<t_function*> functions = service_->get_functions();
+  f_out_ << indent() << "switch (getMethodId(fname)) {" << '\n';
+  for (size_t i = 0; i < functions.size(); ++i) {
+    f_out_ << indent() << "case " << i << ":" << '\n';
+    if (!template_protocol && generator_->gen_templates_only_) {
+      // Only the specialized process functions are meant to be used
+      f_out_ << indent() << "  throw ::apache::thrift::TApplicationException("
+             << "::apache::thrift::TApplicationException::UNKNOWN, "
+             << "\"" << class_name_ << " only supports its template protocol\");" << '\n';
+    } else {
+      f_out_ << indent() << "  process_" << functions[i]->get_name() << "(" << cob_arg_
+             << "seqid, iprot, oprot" << call_context_arg_ << ");" << '\n' << indent()
+             << (style_ == "Cob" ? "  return;" : "  return true;") << '\n';
+    }
+  }
+  f_out_ << indent() << "default:" << '\n' << indent() << "  break;" << '\n' << indent() << "}"
+         << '\n' << '\n';
+
   if (extends_.empty()) {
-    f_out_ << indent() << "  iprot->skip(::apache::thrift::protocol::T_STRUCT);" << '\n' << indent()
-           << "  iprot->readMessageEnd();" << '\n' << indent()
-           << "  iprot->getTransport()->readEnd();" << '\n' << indent()
-           << "  ::apache::thrift::TApplicationException "
+    f_out_ << indent() << "iprot->skip(::apache::thrift::protocol::T_STRUCT);" << '\n' << indent()
+           << "iprot->readMessageEnd();" << '\n' << indent()
+           << "iprot->getTransport()->readEnd();" << '\n' << indent()
+           << "::apache::thrift::TApplicationException "
               "x(::apache::thrift::TApplicationException::UNKNOWN_METHOD, \"Invalid method name: "
               "'\"+fname+\"'\");" << '\n' << indent()
-           << "  oprot->writeMessageBegin(fname, ::apache::thrift::protocol::T_EXCEPTION, seqid);"
-           << '\n' << indent() << "  x.write(oprot);" << '\n' << indent()
-           << "  oprot->writeMessageEnd();" << '\n' << indent()
-           << "  oprot->getTransport()->writeEnd();" << '\n' << indent()
-           << "  oprot->getTransport()->flush();" << '\n' << indent()
-           << (style_ == "Cob" ? "  return cob(true);" : "  return true;") << '\n';
+           << "oprot->writeMessageBegin(fname, ::apache::thrift::protocol::T_EXCEPTION, seqid);"
+           << '\n' << indent() << "x.write(oprot);" << '\n' << indent()
+           << "oprot->writeMessageEnd();" << '\n' << indent()
+           << "oprot->getTransport()->writeEnd();" << '\n' << indent()
+           << "oprot->getTransport()->flush();" << '\n' << indent()
+           << (style_ == "Cob" ? "return cob(true);" : "return true;") << '\n';
   } else {
-    f_out_ << indent() << "  return " << extends_ << "::dispatchCall("
+    f_out_ << indent() << "return " << extends_ << "::dispatchCall("
            << (style_ == "Cob" ? "cob, " : "") << "iprot, oprot, fname, seqid" << call_context_arg_
            << ");" << '\n';
   }
-  f_out_ << indent() << "}" << '\n';
-  if (template_protocol) {
-    f_out_ << indent() << "(this->*(pfn->second.specialized))";
-  } else {
-    if (generator_->gen_templates_only_) {
-      // TODO: This is a null pointer, so nothing good will come from calling
-      // it.  Throw an exception instead.
-      f_out_ << indent() << "(this->*(pfn->second.generic))";
-    } else if (generator_->gen_templates_) {
-      f_out_ << indent() << "(this->*(pfn->second.generic))";
-    } else {
-      f_out_ << indent() << "(this->*(pfn->second))";
-    }
-  }
-  f_out_ << "(" << cob_arg_ << "seqid, iprot, oprot" << call_context_arg_ << ");" << '\n';
-
-  // TODO(dreiss): return pfn ret?
-  if (style_ == "Cob") {
-    f_out_ << indent() << "return;" << '\n';
-  } else {
-    f_out_ << indent() << "return true;" << '\n';
-  }
 
   indent_down();
   f_out_ << "}" << '\n' << '\n';
@@ -3899,7 +4642,15 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
         << "this->eventHandler_.get(), ctx, " << service_func_name << ");" << '\n' << '\n'
         << indent() << "if (this->eventHandler_.get() != nullptr) {" << '\n' << indent()
         << "  this->eventHandler_->preRead(ctx, " << service_func_name << ");" << '\n' << indent()
-        << "}" << '\n' << '\n' << indent() << argsname << " args;" << '\n' << indent()
+        << "}" << '\n' << '\n';
+
+    // Arguments and result live in an arena freed after the reply is written
+    if (gen_pmr_) {
+      out << indent() << "::apache::thrift::TArena arena;" << '\n' << indent()
+          << "::apache::thrift::TArena::Scope arenaScope(arena);" << '\n';
+    }
+
+    out << indent() << argsname << " args;" << '\n' << indent()
         << "args.read(iprot);" << '\n' << indent() << "iprot->readMessageEnd();" << '\n' << indent()
         << "uint32_t bytes = iprot->getTransport()->readEnd();" << '\n' << '\n' << indent()
         << "if (this->eventHandler_.get() != nullptr) {" << '\n' << indent()
@@ -3910,6 +4661,9 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
     if (!tfunction->is_oneway()) {
       out << indent() << resultname << " result;" << '\n';
     }
+    if (gen_pmr_) {
+      out << indent() << "arenaScope.leave();" << '\n';
+    }
 
     // Try block for functions with exceptions
     out << indent() << "try {" << '\n';
@@ -4351,10 +5105,17 @@ void t_cpp_generator::generate_deserialize_field(ostream& out,
 
   string name = prefix + tfield->get_name() + suffix;
 
-  if (type->is_struct() || type->is_xception()) {
+  if (is_lazy(tfield)) {
+    indent(out) << "xfer += " << name << ".read(iprot, " << type_to_enum(type) << ");" << '\n';
+  } else if (type->is_struct() || type->is_xception()) {
     generate_deserialize_struct(out, (t_struct*)type, name, is_reference(tfield));
   } else if (type->is_container()) {
     generate_deserialize_container(out, type, name);
+  } else if (is_pmr_string(type)) {
+    // The protocols only read into a std::string
+    indent(out) << "xfer += ::apache::thrift::"
+                << (type->is_binary() ? "readPmrBinary" : "readPmrString") << "(iprot, " << name
+                << ");" << '\n';
   } else if (type->is_base_type()) {
     indent(out) << "xfer += iprot->";
     t_base_type::t_base tbase = ((t_base_type*)type)->get_base();
@@ -4367,9 +5128,9 @@ void t_cpp_generator::generate_deserialize_field(ostream& out,
       break;
     case t_base_type::TYPE_STRING:
       if (type->is_binary()) {
-        out << "readBinary(" << name << ");";
+        out << (is_string_view(type) ? "readBinaryView(" : "readBinary(") << name << ");";
       } else {
-        out << "readString(" << name << ");";
+        out << (is_string_view(type) ? "readStringView(" : "readString(") << name << ");";
       }
       break;
     case t_base_type::TYPE_BOOL:
@@ -4422,6 +5183,11 @@ void t_cpp_generator::generate_deserialize_struct(ostream& out,
                 << type_name(tstruct) << ");" << '\n';
     indent(out) << "}" << '\n';
     indent(out) << "xfer += " << prefix << "->read(iprot);" << '\n';
+    if (is_variant_union(tstruct)) {
+      indent(out) << "if (" << prefix << "->getType() == " << type_name(tstruct)
+                  << "::Type::__EMPTY__) { " << prefix << ".reset(); }" << '\n';
+      return;
+    }
     indent(out) << "bool wasSet = false;" << '\n';
     const vector<t_field*>& members = tstruct->get_members();
     vector<t_field*>::const_iterator f_iter;
@@ -4446,8 +5212,14 @@ void t_cpp_generator::generate_deserialize_container(ostream& out, t_type* ttype
 
   t_container* tcontainer = (t_container*)ttype;
   bool use_push = tcontainer->has_cpp_name();
+  string array = array_elem_name(ttype);
 
-  indent(out) << prefix << ".clear();" << '\n' << indent() << "uint32_t " << size << ";" << '\n';
+  // Numbers read in bulk overwrite the whole list, so it is only resized,
+  // which leaves the elements that are already there alone
+  if (array.empty() || !ttype->is_list()) {
+    indent(out) << prefix << ".clear();" << '\n';
+  }
+  indent(out) << "uint32_t " << size << ";" << '\n';
 
   // Declare variables, read header
   if (ttype->is_map()) {
@@ -4464,23 +5236,50 @@ void t_cpp_generator::generate_deserialize_container(ostream& out, t_type* ttype
       indent(out) << prefix << ".resize(" << size << ");" << '\n';
     }
   }
+  if (is_flat_container(ttype)) {
+    // Make room for all the elements at once
+    indent(out) << prefix << ".reserve(" << size << ");" << '\n';
+  }
+
+  if (!array.empty() && ttype->is_list()) {
+    // Integer lists are read straight into the vector
+    indent(out) << "xfer += iprot->read" << array << "Array(" << prefix << ".data(), " << size
+                << ");" << '\n';
+  } else if (!array.empty()) {
+    string elems = tmp("_elems");
+    string elem_type = type_name(((t_set*)ttype)->get_elem_type());
+    if (gen_pmr_) {
+      indent(out) << "std::pmr::vector<" << elem_type << "> " << elems << "(" << size
+                  << ", ::apache::thrift::TArena::current());" << '\n';
+    } else {
+      indent(out) << "std::vector<" << elem_type << "> " << elems << "(" << size << ");" << '\n';
+    }
+    indent(out) << "xfer += iprot->read" << array << "Array(" << elems << ".data(), " << size
+                << ");" << '\n';
+    indent(out) << prefix << ".insert(" << elems << ".begin(), " << elems << ".end());" << '\n';
+  } else {
+    // For loop iterates over elements
+    string i = tmp("_i");
+    out << indent() << "uint32_t " << i << ";" << '\n' << indent() << "for (" << i << " = 0; "
+        << i << " < " << size << "; ++" << i << ")" << '\n';
 
-  // For loop iterates over elements
-  string i = tmp("_i");
-  out << indent() << "uint32_t " << i << ";" << '\n' << indent() << "for (" << i << " = 0; " << i
-      << " < " << size << "; ++" << i << ")" << '\n';
+    scope_up(out);
 
-  scope_up(out);
+    if (ttype->is_map()) {
+      generate_deserialize_map_element(out, (t_map*)ttype, prefix);
+    } else if (ttype->is_set()) {
+      generate_deserialize_set_element(out, (t_set*)ttype, prefix);
+    } else if (ttype->is_list()) {
+      generate_deserialize_list_element(out, (t_list*)ttype, prefix, use_push, i);
+    }
 
-  if (ttype->is_map()) {
-    generate_deserialize_map_element(out, (t_map*)ttype, prefix);
-  } else if (ttype->is_set()) {
-    generate_deserialize_set_element(out, (t_set*)ttype, prefix);
-  } else if (ttype->is_list()) {
-    generate_deserialize_list_element(out, (t_list*)ttype, prefix, use_push, i);
-  }
+    scope_down(out);
 
-  scope_down(out);
+    if (is_flat_container(ttype) && !ttype->is_list()) {
+      // The elements were appended as they came; one sort puts them in order
+      indent(out) << prefix << ".sortAppended();" << '\n';
+    }
+  }
 
   // Read container end
   if (ttype->is_map()) {
@@ -4503,11 +5302,17 @@ void t_cpp_generator::generate_deserialize_map_element(ostream& out, t_map* tmap
   t_field fkey(tmap->get_key_type(), key);
   t_field fval(tmap->get_val_type(), val);
 
-  out << indent() << declare_field(&fkey) << '\n';
+  out << indent() << declare_local(&fkey) << '\n';
 
   generate_deserialize_field(out, &fkey);
-  indent(out) << declare_field(&fval, false, false, false, true) << " = " << prefix << "[" << key
-              << "];" << '\n';
+  if (is_flat_container(tmap)) {
+    // Inserting each element in order would be quadratic on unsorted input
+    indent(out) << declare_field(&fval, false, false, false, true) << " = " << prefix
+                << ".appendUnsorted(std::move(" << key << "));" << '\n';
+  } else {
+    indent(out) << declare_field(&fval, false, false, false, true) << " = " << prefix << "["
+                << (gen_pmr_ ? "std::move(" + key + ")" : key) << "];" << '\n';
+  }
 
   generate_deserialize_field(out, &fval);
 }
@@ -4516,11 +5321,16 @@ void t_cpp_generator::generate_deserialize_set_element(ostream& out, t_set* tset
   string elem = tmp("_elem");
   t_field felem(tset->get_elem_type(), elem);
 
-  indent(out) << declare_field(&felem) << '\n';
+  indent(out) << declare_local(&felem) << '\n';
 
   generate_deserialize_field(out, &felem);
 
-  indent(out) << prefix << ".insert(" << elem << ");" << '\n';
+  if (is_flat_container(tset)) {
+    indent(out) << prefix << ".appendUnsorted(std::move(" << elem << "));" << '\n';
+  } else {
+    indent(out) << prefix << ".insert(" << (gen_pmr_ ? "std::move(" + elem + ")" : elem) << ");"
+                << '\n';
+  }
 }
 
 void t_cpp_generator::generate_deserialize_list_element(ostream& out,
@@ -4531,9 +5341,10 @@ void t_cpp_generator::generate_deserialize_list_element(ostream& out,
   if (use_push) {
     string elem = tmp("_elem");
     t_field felem(tlist->get_elem_type(), elem);
-    indent(out) << declare_field(&felem) << '\n';
+    indent(out) << declare_local(&felem) << '\n';
     generate_deserialize_field(out, &felem);
-    indent(out) << prefix << ".push_back(" << elem << ");" << '\n';
+    indent(out) << prefix << ".push_back(" << (gen_pmr_ ? "std::move(" + elem + ")" : elem)
+                << ");" << '\n';
   } else {
     t_field felem(tlist->get_elem_type(), prefix + "[" + index + "]");
     generate_deserialize_field(out, &felem);
@@ -4559,10 +5370,17 @@ void t_cpp_generator::generate_serialize_field(ostream& out,
     throw "CANNOT GENERATE SERIALIZE CODE FOR void TYPE: " + name;
   }
 
-  if (type->is_struct() || type->is_xception()) {
+  if (is_lazy(tfield)) {
+    indent(out) << "xfer += " << name << (sizing_ ? ".serializedSize(oprot);" : ".write(oprot);")
+                << '\n';
+  } else if (type->is_struct() || type->is_xception()) {
     generate_serialize_struct(out, (t_struct*)type, name, is_reference(tfield));
   } else if (type->is_container()) {
     generate_serialize_container(out, type, name);
+  } else if (is_pmr_string(type)) {
+    indent(out) << "xfer += ::apache::thrift::"
+                << (type->is_binary() ? "writePmrBinary" : "writePmrString") << "(oprot, " << name
+                << ");" << '\n';
   } else if (type->is_base_type() || type->is_enum()) {
 
     indent(out) << "xfer += oprot->";
@@ -4578,9 +5396,9 @@ void t_cpp_generator::generate_serialize_field(ostream& out,
         break;
       case t_base_type::TYPE_STRING:
         if (type->is_binary()) {
-          out << "writeBinary(" << name << ");";
+          out << (is_string_view(type) ? "writeBinaryView(" : "writeBinary(") << name << ");";
         } else {
-          out << "writeString(" << name << ");";
+          out << (is_string_view(type) ? "writeStringView(" : "writeString(") << name << ");";
         }
         break;
       case t_base_type::TYPE_BOOL:
@@ -4626,7 +5444,20 @@ void t_cpp_generator::generate_serialize_struct(ostream& out,
                                                 t_struct* tstruct,
                                                 string prefix,
                                                 bool pointer) {
-  if (pointer) {
+  if (sizing_) {
+    // An unset reference is written as an empty struct
+    if (pointer) {
+      indent(out) << "if (" << prefix << ") {" << '\n';
+      indent(out) << "  xfer += " << prefix << "->serializedSize(oprot);" << '\n';
+      indent(out) << "} else {" << '\n';
+      indent(out) << "  xfer += oprot->writeStructBegin(\"" << tstruct->get_name() << "\");" << '\n';
+      indent(out) << "  xfer += oprot->writeStructEnd();" << '\n';
+      indent(out) << "  xfer += oprot->writeFieldStop();" << '\n';
+      indent(out) << "}" << '\n';
+    } else {
+      indent(out) << "xfer += " << prefix << ".serializedSize(oprot);" << '\n';
+    }
+  } else if (pointer) {
     indent(out) << "if (" << prefix << ") {" << '\n';
     indent(out) << "  xfer += " << prefix << "->write(oprot); " << '\n';
     indent(out) << "} else {"
@@ -4656,19 +5487,25 @@ void t_cpp_generator::generate_serialize_container(ostream& out, t_type* ttype,
                 << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
   }
 
-  string iter = tmp("_iter");
-  out << indent() << type_name(ttype) << "::const_iterator " << iter << ";" << '\n' << indent()
-      << "for (" << iter << " = " << prefix << ".begin(); " << iter << " != " << prefix
-      << ".end(); ++" << iter << ")" << '\n';
-  scope_up(out);
-  if (ttype->is_map()) {
-    generate_serialize_map_element(out, (t_map*)ttype, iter);
-  } else if (ttype->is_set()) {
-    generate_serialize_set_element(out, (t_set*)ttype, iter);
-  } else if (ttype->is_list()) {
-    generate_serialize_list_element(out, (t_list*)ttype, iter);
+  string array = ttype->is_list() ? array_elem_name(ttype) : "";
+  if (!array.empty()) {
+    indent(out) << "xfer += oprot->write" << array << "Array(" << prefix << ".data(), "
+                << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+  } else {
+    string iter = tmp("_iter");
+    out << indent() << type_name(ttype) << "::const_iterator " << iter << ";" << '\n' << indent()
+        << "for (" << iter << " = " << prefix << ".begin(); " << iter << " != " << prefix
+        << ".end(); ++" << iter << ")" << '\n';
+    scope_up(out);
+    if (ttype->is_map()) {
+      generate_serialize_map_element(out, (t_map*)ttype, iter);
+    } else if (ttype->is_set()) {
+      generate_serialize_set_element(out, (t_set*)ttype, iter);
+    } else if (ttype->is_list()) {
+      generate_serialize_list_element(out, (t_list*)ttype, iter);
+    }
+    scope_down(out);
   }
-  scope_down(out);
 
   if (ttype->is_map()) {
     indent(out) << "xfer += oprot->writeMapEnd();" << '\n';
@@ -4818,16 +5655,26 @@ string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
     t_container* tcontainer = (t_container*)ttype;
     if (tcontainer->has_cpp_name()) {
       cname = tcontainer->get_cpp_name();
+    } else if (is_flat_container(ttype) && ttype->is_map()) {
+      t_map* tmap = (t_map*)ttype;
+      cname = "::apache::thrift::TFlatMap<" + type_name(tmap->get_key_type(), in_typedef) + ", "
+              + type_name(tmap->get_val_type(), in_typedef) + "> ";
+    } else if (is_flat_container(ttype)) {
+      t_set* tset = (t_set*)ttype;
+      cname = "::apache::thrift::TFlatSet<" + type_name(tset->get_elem_type(), in_typedef) + "> ";
     } else if (ttype->is_map()) {
       t_map* tmap = (t_map*)ttype;
-      cname = "std::map<" + type_name(tmap->get_key_type(), in_typedef) + ", "
+      cname = string(gen_pmr_ ? "std::pmr::map<" : "std::map<")
+              + type_name(tmap->get_key_type(), in_typedef) + ", "
               + type_name(tmap->get_val_type(), in_typedef) + "> ";
     } else if (ttype->is_set()) {
       t_set* tset = (t_set*)ttype;
-      cname = "std::set<" + type_name(tset->get_elem_type(), in_typedef) + "> ";
+      cname = string(gen_pmr_ ? "std::pmr::set<" : "std::set<")
+              + type_name(tset->get_elem_type(), in_typedef) + "> ";
     } else if (ttype->is_list()) {
       t_list* tlist = (t_list*)ttype;
-      cname = "std::vector<" + type_name(tlist->get_elem_type(), in_typedef) + "> ";
+      cname = string(gen_pmr_ ? "std::pmr::vector<" : "std::vector<")
+              + type_name(tlist->get_elem_type(), in_typedef) + "> ";
     }
 
     if (arg) {
@@ -4866,6 +5713,326 @@ string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
   }
 }
 
+/**
+ * Returns true if the (true) type is a string or binary that the generated
+ * code holds in a TStringView, i.e. the string_views option is on and no
+ * cpp.type annotation replaces it.
+ */
+bool t_cpp_generator::is_string_view(t_type* ttype) {
+  if (!gen_string_views_ || !ttype->is_string()) {
+    return false;
+  }
+  return ttype->annotations_.find("cpp.type") == ttype->annotations_.end();
+}
+
+/**
+ * Returns true if the (true) type is a string or binary that the generated
+ * code holds in a std::pmr::string.
+ */
+bool t_cpp_generator::is_pmr_string(t_type* ttype) {
+  if (!gen_pmr_ || !ttype->is_string()) {
+    return false;
+  }
+  return ttype->annotations_.find("cpp.type") == ttype->annotations_.end();
+}
+
+/**
+ * Returns "I16", "I32", "I64" or "Double" if the container is a list or set
+ * of that type, whose elements the protocol reads and writes in bulk
+ * (readI32Array() etc.), or an empty string.
+ */
+string t_cpp_generator::array_elem_name(t_type* ttype) {
+  t_type* elem_type;
+  if (ttype->is_list()) {
+    elem_type = ((t_list*)ttype)->get_elem_type();
+  } else if (ttype->is_set()) {
+    elem_type = ((t_set*)ttype)->get_elem_type();
+  } else {
+    return "";
+  }
+  if (((t_container*)ttype)->has_cpp_name()) {
+    return "";
+  }
+  elem_type = get_true_type(elem_type);
+  if (!elem_type->is_base_type()
+      || elem_type->annotations_.find("cpp.type") != elem_type->annotations_.end()) {
+    return "";
+  }
+  switch (((t_base_type*)elem_type)->get_base()) {
+  case t_base_type::TYPE_I16:
+    return "I16";
+  case t_base_type::TYPE_I32:
+    return "I32";
+  case t_base_type::TYPE_I64:
+    return "I64";
+  case t_base_type::TYPE_DOUBLE:
+    return "Double";
+  default:
+    return "";
+  }
+}
+
+/**
+ * Returns true if the member is a std::pmr string or container, which the
+ * constructors bind to the current TArena.
+ */
+bool t_cpp_generator::is_pmr_member(t_field* tfield) {
+  if (!gen_pmr_ || is_reference(tfield)) {
+    return false;
+  }
+  t_type* type = get_true_type(tfield->get_type());
+  if (type->is_container()) {
+    return !((t_container*)type)->has_cpp_name();
+  }
+  return is_pmr_string(type);
+}
+
+/**
+ * Returns true if the type is a union that is generated with its value in a
+ * std::variant.
+ */
+bool t_cpp_generator::is_variant_union(t_type* ttype) {
+  ttype = get_true_type(ttype);
+  return gen_variant_unions_ && ttype->is_struct() && ((t_struct*)ttype)->is_union();
+}
+
+/**
+ * Returns the type a field of a variant union is kept as.
+ */
+string t_cpp_generator::variant_alternative(t_field* tfield) {
+  string result = type_name(tfield->get_type());
+  if (is_reference(tfield)) {
+    result = "::std::shared_ptr<" + result + ">";
+  }
+  return result;
+}
+
+/**
+ * Returns true if the type is a map or set that is generated as a TFlatMap
+ * or TFlatSet, either because of the flat_containers option or its cpp.flat
+ * annotation.
+ */
+bool t_cpp_generator::is_flat_container(t_type* ttype) {
+  if (gen_pmr_ || !(ttype->is_map() || ttype->is_set())
+      || ((t_container*)ttype)->has_cpp_name()) {
+    return false;
+  }
+  std::map<std::string, std::vector<std::string>>::const_iterator it
+      = ttype->annotations_.find("cpp.flat");
+  if (it != ttype->annotations_.end() && !it->second.empty()) {
+    return it->second.back() != "false";
+  }
+  return gen_flat_containers_;
+}
+
+/**
+ * Returns true if the type is or contains a flat container.
+ */
+bool t_cpp_generator::has_flat_container(t_type* ttype) {
+  ttype = get_true_type(ttype);
+  if (is_flat_container(ttype)) {
+    return true;
+  }
+  if (ttype->is_map()) {
+    return has_flat_container(((t_map*)ttype)->get_key_type())
+           || has_flat_container(((t_map*)ttype)->get_val_type());
+  } else if (ttype->is_set()) {
+    return has_flat_container(((t_set*)ttype)->get_elem_type());
+  } else if (ttype->is_list()) {
+    return has_flat_container(((t_list*)ttype)->get_elem_type());
+  }
+  return false;
+}
+
+/**
+ * Returns true if any type of the program is generated as a flat
+ * container, so the types header has to include thrift/TFlatContainers.h.
+ */
+bool t_cpp_generator::uses_flat_containers() {
+  if (gen_flat_containers_) {
+    return true;
+  }
+  if (gen_pmr_) {
+    return false;
+  }
+  for (auto tdef : program_->get_typedefs()) {
+    if (has_flat_container(tdef->get_type())) {
+      return true;
+    }
+  }
+  for (auto tconst : program_->get_consts()) {
+    if (has_flat_container(tconst->get_type())) {
+      return true;
+    }
+  }
+  for (auto tstruct : program_->get_objects()) {
+    for (auto member : tstruct->get_members()) {
+      if (has_flat_container(member->get_type())) {
+        return true;
+      }
+    }
+  }
+  for (auto tservice : program_->get_services()) {
+    for (auto tfunction : tservice->get_functions()) {
+      if (has_flat_container(tfunction->get_returntype())) {
+        return true;
+      }
+      for (auto arg : tfunction->get_arglist()->get_members()) {
+        if (has_flat_container(arg->get_type())) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * Returns true if any struct of the program has a cpp.lazy field, so the
+ * types header has to include thrift/TLazy.h.
+ */
+bool t_cpp_generator::uses_lazy_fields() {
+  for (auto tstruct : program_->get_objects()) {
+    for (auto member : tstruct->get_members()) {
+      if (is_lazy(member)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * Checks that the cpp.lazy fields of a struct can be kept as a TLazy.
+ */
+void t_cpp_generator::validate_lazy_fields(t_struct* tstruct) {
+  for (auto member : tstruct->get_members()) {
+    if (!is_lazy(member)) {
+      continue;
+    }
+    string where = tstruct->get_name() + "." + member->get_name();
+    t_type* type = get_true_type(member->get_type());
+    if (!(type->is_struct() || type->is_xception() || type->is_container())) {
+      throw "cpp.lazy on " + where + ": only structs and containers can be lazy";
+    }
+    if (is_reference(member)) {
+      throw "cpp.lazy on " + where + " cannot be combined with cpp.ref";
+    }
+    if (is_variant_union(tstruct)) {
+      throw "cpp.lazy on " + where + " is not supported with cpp:variant_unions";
+    }
+    if (gen_pmr_) {
+      throw "cpp.lazy on " + where + " is not supported with cpp:pmr";
+    }
+  }
+}
+
+/**
+ * Returns the name of the nested class that reads and writes a lazy
+ * container field for its TLazy.
+ */
+string t_cpp_generator::lazy_codec_name(t_field* tfield) {
+  return "__lazy_" + tfield->get_name() + "_codec";
+}
+
+/**
+ * Declares the codecs of the lazy container fields of a struct.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_lazy_codec_declarations(ostream& out, t_struct* tstruct) {
+  for (auto member : tstruct->get_members()) {
+    if (!is_lazy(member) || !get_true_type(member->get_type())->is_container()) {
+      continue;
+    }
+    string type = type_name(member->get_type());
+    out << '\n' << indent() << "struct " << lazy_codec_name(member) << " {" << '\n' << indent()
+        << "  static uint32_t read(::apache::thrift::protocol::TProtocol* iprot, " << type << "& "
+        << member->get_name() << ");" << '\n' << indent()
+        << "  static uint32_t write(::apache::thrift::protocol::TProtocol* oprot, const " << type
+        << "& " << member->get_name() << ");" << '\n';
+    if (gen_serialized_size_) {
+      out << indent() << "  template <class Sizer_>" << '\n' << indent()
+          << "  static uint32_t serializedSize(Sizer_* oprot, const " << type << "& "
+          << member->get_name() << ");" << '\n';
+    }
+    out << indent() << "};" << '\n' << '\n';
+  }
+}
+
+/**
+ * Defines the codecs of the lazy container fields of a struct, which read
+ * and write the container the way the struct would.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_lazy_codecs(ostream& out, t_struct* tstruct) {
+  for (auto member : tstruct->get_members()) {
+    if (!is_lazy(member) || !get_true_type(member->get_type())->is_container()) {
+      continue;
+    }
+    t_type* type = get_true_type(member->get_type());
+    string codec = tstruct->get_name() + "::" + lazy_codec_name(member);
+
+    indent(out) << "uint32_t " << codec << "::read(::apache::thrift::protocol::TProtocol* iprot, "
+                << type_name(member->get_type()) << "& " << member->get_name() << ") {" << '\n';
+    indent_up();
+    indent(out) << "uint32_t xfer = 0;" << '\n';
+    generate_deserialize_container(out, type, member->get_name());
+    indent(out) << "return xfer;" << '\n';
+    indent_down();
+    indent(out) << "}" << '\n' << '\n';
+
+    indent(out) << "uint32_t " << codec << "::write(::apache::thrift::protocol::TProtocol* oprot, const "
+                << type_name(member->get_type()) << "& " << member->get_name() << ") {" << '\n';
+    indent_up();
+    indent(out) << "uint32_t xfer = 0;" << '\n';
+    generate_serialize_container(out, type, member->get_name());
+    indent(out) << "return xfer;" << '\n';
+    indent_down();
+    indent(out) << "}" << '\n' << '\n';
+  }
+}
+
+/**
+ * Defines the serializedSize() of the codecs of the lazy container fields of
+ * a struct, which TLazy calls when it cannot use the size of its raw bytes.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_lazy_codec_sizes(ostream& out, t_struct* tstruct) {
+  for (auto member : tstruct->get_members()) {
+    if (!is_lazy(member) || !get_true_type(member->get_type())->is_container()) {
+      continue;
+    }
+    indent(out) << "template <class Sizer_>" << '\n' << indent() << "uint32_t "
+                << tstruct->get_name() << "::" << lazy_codec_name(member)
+                << "::serializedSize(Sizer_* oprot, const " << type_name(member->get_type())
+                << "& " << member->get_name() << ") {" << '\n';
+    indent_up();
+    indent(out) << "uint32_t xfer = 0;" << '\n';
+    generate_serialize_container(out, get_true_type(member->get_type()), member->get_name());
+    indent(out) << "return xfer;" << '\n';
+    indent_down();
+    indent(out) << "}" << '\n' << '\n';
+  }
+}
+
+/**
+ * Declares a local that a container element is read into. With pmr, it
+ * already uses the current TArena, so that it can be moved into place.
+ */
+string t_cpp_generator::declare_local(t_field* tfield) {
+  if (!is_pmr_member(tfield)) {
+    return declare_field(tfield);
+  }
+  return type_name(tfield->get_type()) + " " + tfield->get_name()
+         + "(::apache::thrift::TArena::current());";
+}
+
 /**
  * Returns the C++ type that corresponds to the thrift type.
  *
@@ -4877,7 +6044,10 @@ string t_cpp_generator::base_type_name(t_base_type::t_base tbase) {
   case t_base_type::TYPE_VOID:
     return "void";
   case t_base_type::TYPE_STRING:
-    return "std::string";
+    if (gen_string_views_) {
+      return "::apache::thrift::TStringView";
+    }
+    return gen_pmr_ ? "std::pmr::string" : "std::string";
   case t_base_type::TYPE_BOOL:
     return "bool";
   case t_base_type::TYPE_I8:
@@ -4916,6 +6086,14 @@ string t_cpp_generator::declare_field(t_field* tfield,
   result += type_name(tfield->get_type());
   if (is_reference(tfield)) {
     result = "::std::shared_ptr<" + result + ">";
+  } else if (is_lazy(tfield)) {
+    if (result[result.size() - 1] == ' ') {
+      result.erase(result.size() - 1);
+    }
+    if (get_true_type(tfield->get_type())->is_container()) {
+      result += ", " + lazy_codec_name(tfield);
+    }
+    result = "::apache::thrift::TLazy<" + result + ">";
   }
   if (pointer) {
     result += "*";
@@ -5093,6 +6271,9 @@ bool t_cpp_generator::is_struct_storage_not_throwing(t_struct* tstruct) const {
   for(size_t i=0; i < members.size(); ++i)  {
     t_type* type = get_true_type(members[i]->get_type());
 
+    if(is_lazy(members[i]))
+      return false;
+
     if(type->is_enum())
       continue;
     if(type->is_xception())
@@ -5180,4 +6361,27 @@ THRIFT_REGISTER_GENERATOR(
     "                     with perfect forwarding for non-primitive types.\n"
     "    no_ostream_operators:\n"
     "                     Omit generation of ostream definitions.\n"
-    "    no_skeleton:     Omits generation of skeleton.\n")
+    "    no_skeleton:     Omits generation of skeleton.\n"
+    "    string_views:    Hold string and binary values in ::apache::thrift::TStringView,\n"
+    "                     which refers into the transport's read buffer where possible\n"
+    "                     instead of copying. Such values stay valid only until that\n"
+    "                     buffer is reused (e.g. once a server handler returns).\n"
+    "    pmr:             Generate std::pmr strings and containers (requires C++17). Structs\n"
+    "                     allocate from the current ::apache::thrift::TArena, and processors\n"
+    "                     read each call's arguments into a per-call arena.\n"
+    "    variant_unions:  Keep the value of a union in a std::variant (requires C++17),\n"
+    "                     with getType(), get_<field>() and mutable_<field>() accessors\n"
+    "                     in place of a public member and an isset flag for each field.\n"
+    "    flat_containers: Generate maps and sets as ::apache::thrift::TFlatMap and TFlatSet,\n"
+    "                     which keep their elements in a sorted vector. The annotation\n"
+    "                     (cpp.flat = \"true\") or (cpp.flat = \"false\") on a map or set\n"
+    "                     type overrides this for that type.\n"
+    "    serialized_size: Generate serializedSize<Protocol>() methods on structs, which\n"
+    "                     compute what write() would write with TBinaryProtocol or\n"
+    "                     TCompactProtocol without encoding anything.\n"
+    "    read_partial:    Generate readPartial(iprot, mask) methods on structs, which only\n"
+    "                     decode the fields in a ::apache::thrift::protocol::TFieldMask\n"
+    "                     and skip all others.\n"
+    "  The annotation (cpp.lazy = \"true\") on a struct or container field keeps it as an\n"
+    "  ::apache::thrift::TLazy, which read() leaves undecoded where the transport allows\n"
+    "  and write() copies verbatim until it is changed.\n")
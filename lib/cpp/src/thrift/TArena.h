@@ -0,0 +1,172 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TARENA_H_
+#define _THRIFT_TARENA_H_ 1
+
+#if !defined(_MSVC_LANG) && __cplusplus < 201703L || defined(_MSVC_LANG) && _MSVC_LANG < 201703L
+#error "thrift/TArena.h and code generated with cpp:pmr require C++17"
+#endif
+
+#include <thrift/Thrift.h>
+#include <thrift/TStringView.h>
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+
+namespace apache {
+namespace thrift {
+
+/**
+ * Memory arena for the std::pmr strings and containers of structs generated
+ * with the <tt>pmr</tt> option.
+ *
+ * The arena hands out memory from a few large blocks and frees them all at
+ * once when it is destroyed, so a whole deserialized message costs a handful
+ * of mallocs instead of one per string, list, set and map. Generated structs
+ * take their memory resource from current() when they are constructed;
+ * a Scope makes an arena current for the calling thread:
+ *
+ * <pre>
+ *   TArena arena;
+ *   TArena::Scope scope(arena);
+ *   Request request;    // everything request.read() allocates is in arena
+ * </pre>
+ *
+ * Generated processors do this for the args and result of each call, so the
+ * handler's arguments are only valid until it returns. Nothing built while a
+ * scope is active may outlive the arena.
+ */
+class TArena {
+public:
+  /**
+   * Construct an arena that starts with a block of the specified size and
+   * takes further blocks from the default memory resource.
+   */
+  explicit TArena(std::size_t initialSize = 4096) : resource_(initialSize) {}
+
+  TArena(const TArena&) = delete;
+  TArena& operator=(const TArena&) = delete;
+
+  std::pmr::memory_resource* resource() noexcept { return &resource_; }
+
+  /**
+   * Return the memory resource new generated structs use on this thread:
+   * the arena of the innermost Scope, or std::pmr::get_default_resource().
+   */
+  static std::pmr::memory_resource* current() noexcept {
+    std::pmr::memory_resource* resource = currentSlot();
+    return resource != nullptr ? resource : std::pmr::get_default_resource();
+  }
+
+  /**
+   * Makes an arena current for the calling thread until the scope is left,
+   * either explicitly or by destroying it.
+   */
+  class Scope {
+  public:
+    explicit Scope(TArena& arena) noexcept : previous_(currentSlot()), active_(true) {
+      currentSlot() = arena.resource();
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    ~Scope() { leave(); }
+
+    void leave() noexcept {
+      if (active_) {
+        currentSlot() = previous_;
+        active_ = false;
+      }
+    }
+
+  private:
+    std::pmr::memory_resource* previous_;
+    bool active_;
+  };
+
+private:
+  static std::pmr::memory_resource*& currentSlot() noexcept {
+    static thread_local std::pmr::memory_resource* current = nullptr;
+    return current;
+  }
+
+  std::pmr::monotonic_buffer_resource resource_;
+};
+
+namespace detail {
+
+/**
+ * Per-thread buffer that protocols read strings into before they are copied
+ * into the arena. Kept between reads, unless a large string grew it.
+ */
+inline std::string& pmrReadBuffer() {
+  static thread_local std::string buffer;
+  return buffer;
+}
+
+template <typename Read_>
+uint32_t readPmr(std::pmr::string& str, Read_ read) {
+  std::string& buffer = pmrReadBuffer();
+  uint32_t result = read(buffer);
+  str.assign(buffer.data(), buffer.size());
+  if (buffer.capacity() > 65536) {
+    std::string().swap(buffer);
+  }
+  return result;
+}
+
+inline TStringView pmrView(const std::pmr::string& str) noexcept {
+  return TStringView::borrow(reinterpret_cast<const uint8_t*>(str.data()),
+                             static_cast<uint32_t>(str.size()));
+}
+
+} // namespace detail
+
+/*
+ * The protocol interface only deals in std::string, so generated code reads
+ * and writes its std::pmr::string fields through these.
+ */
+
+template <class Protocol_>
+uint32_t readPmrString(Protocol_* iprot, std::pmr::string& str) {
+  return detail::readPmr(str, [iprot](std::string& buffer) { return iprot->readString(buffer); });
+}
+
+template <class Protocol_>
+uint32_t readPmrBinary(Protocol_* iprot, std::pmr::string& str) {
+  return detail::readPmr(str, [iprot](std::string& buffer) { return iprot->readBinary(buffer); });
+}
+
+template <class Protocol_>
+uint32_t writePmrString(Protocol_* oprot, const std::pmr::string& str) {
+  return oprot->writeStringView(detail::pmrView(str));
+}
+
+template <class Protocol_>
+uint32_t writePmrBinary(Protocol_* oprot, const std::pmr::string& str) {
+  return oprot->writeBinaryView(detail::pmrView(str));
+}
+
+} // namespace thrift
+} // namespace apache
+
+#endif // #ifndef _THRIFT_TARENA_H_
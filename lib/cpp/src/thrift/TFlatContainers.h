@@ -0,0 +1,554 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TFLATCONTAINERS_H_
+#define _THRIFT_TFLATCONTAINERS_H_ 1
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+
+namespace detail {
+
+/**
+ * Orders the elements of a flat container by key.
+ */
+template <typename Key, typename Compare>
+struct TFlatKeyCompare {
+  explicit TFlatKeyCompare(const Compare& compare) : compare(compare) {}
+
+  static const Key& key(const Key& key) { return key; }
+  template <typename T>
+  static const Key& key(const std::pair<Key, T>& value) { return value.first; }
+
+  template <typename A, typename B>
+  bool operator()(const A& a, const B& b) const { return compare(key(a), key(b)); }
+
+  Compare compare;
+};
+
+/**
+ * std::lower_bound without a branch on the result of each comparison, which
+ * the CPU cannot predict on random keys: the range halves whatever the
+ * comparison says, so the compiler can select the next range instead.
+ */
+template <typename Iterator, typename Key, typename Compare>
+Iterator lowerBound(Iterator first, Iterator last, const Key& key, const Compare& compare) {
+  typename std::iterator_traits<Iterator>::difference_type length = last - first;
+  if (length == 0) {
+    return first;
+  }
+  while (length > 1) {
+    typename std::iterator_traits<Iterator>::difference_type half = length / 2;
+    first = compare(first[half - 1], key) ? first + half : first;
+    length -= half;
+  }
+  return compare(*first, key) ? first + 1 : first;
+}
+
+} // namespace detail
+
+/**
+ * A map that keeps its elements in a vector sorted by key, for the map
+ * fields of structs generated with the <tt>flat_containers</tt> option or
+ * the <tt>cpp.flat</tt> annotation.
+ *
+ * The elements take a single allocation and are iterated in the same order
+ * as a std::map's, so a struct serializes the same either way. Lookups are
+ * binary searches over contiguous memory. Inserting keeps the vector sorted,
+ * so it is constant time when keys come in order, as they do from a
+ * serialized std::map or TFlatMap, and linear time otherwise; insert() of a
+ * range sorts once instead, as do appendUnsorted() and sortAppended(),
+ * which generated code reads elements with. Like a vector, inserting and erasing invalidate
+ * iterators and references. The key of an element must not be changed
+ * through an iterator.
+ */
+template <typename Key,
+          typename T,
+          typename Compare = std::less<Key>,
+          typename Allocator = std::allocator<std::pair<Key, T> > >
+class TFlatMap {
+public:
+  typedef Key key_type;
+  typedef T mapped_type;
+  typedef std::pair<Key, T> value_type;
+  typedef Compare key_compare;
+  typedef Allocator allocator_type;
+  typedef std::vector<value_type, Allocator> container_type;
+  typedef typename container_type::size_type size_type;
+  typedef typename container_type::difference_type difference_type;
+  typedef value_type& reference;
+  typedef const value_type& const_reference;
+  typedef typename container_type::iterator iterator;
+  typedef typename container_type::const_iterator const_iterator;
+  typedef typename container_type::reverse_iterator reverse_iterator;
+  typedef typename container_type::const_reverse_iterator const_reverse_iterator;
+
+  TFlatMap() : compare_(Compare()) {}
+
+  explicit TFlatMap(const Compare& compare, const Allocator& allocator = Allocator())
+    : values_(allocator), compare_(compare) {}
+
+  template <typename InputIterator>
+  TFlatMap(InputIterator first, InputIterator last, const Compare& compare = Compare())
+    : compare_(compare) {
+    insert(first, last);
+  }
+
+  TFlatMap(std::initializer_list<value_type> values, const Compare& compare = Compare())
+    : compare_(compare) {
+    insert(values.begin(), values.end());
+  }
+
+  TFlatMap& operator=(std::initializer_list<value_type> values) {
+    clear();
+    insert(values.begin(), values.end());
+    return *this;
+  }
+
+  allocator_type get_allocator() const { return values_.get_allocator(); }
+  key_compare key_comp() const { return compare_.compare; }
+
+  iterator begin() noexcept { return values_.begin(); }
+  const_iterator begin() const noexcept { return values_.begin(); }
+  const_iterator cbegin() const noexcept { return values_.cbegin(); }
+  iterator end() noexcept { return values_.end(); }
+  const_iterator end() const noexcept { return values_.end(); }
+  const_iterator cend() const noexcept { return values_.cend(); }
+  reverse_iterator rbegin() noexcept { return values_.rbegin(); }
+  const_reverse_iterator rbegin() const noexcept { return values_.rbegin(); }
+  reverse_iterator rend() noexcept { return values_.rend(); }
+  const_reverse_iterator rend() const noexcept { return values_.rend(); }
+
+  bool empty() const noexcept { return values_.empty(); }
+  size_type size() const noexcept { return values_.size(); }
+  size_type max_size() const noexcept { return values_.max_size(); }
+  size_type capacity() const noexcept { return values_.capacity(); }
+  void reserve(size_type count) { values_.reserve(count); }
+  void shrink_to_fit() { values_.shrink_to_fit(); }
+  void clear() noexcept { values_.clear(); }
+
+  T& operator[](const Key& key) { return emplaceKey(key)->second; }
+  T& operator[](Key&& key) { return emplaceKey(std::move(key))->second; }
+
+  T& at(const Key& key) {
+    iterator it = find(key);
+    if (it == end()) {
+      throw std::out_of_range("TFlatMap::at");
+    }
+    return it->second;
+  }
+
+  const T& at(const Key& key) const {
+    const_iterator it = find(key);
+    if (it == end()) {
+      throw std::out_of_range("TFlatMap::at");
+    }
+    return it->second;
+  }
+
+  std::pair<iterator, bool> insert(const value_type& value) { return insertValue(value); }
+  std::pair<iterator, bool> insert(value_type&& value) { return insertValue(std::move(value)); }
+
+  template <typename P,
+            typename = typename std::enable_if<std::is_constructible<value_type, P&&>::value>::type>
+  std::pair<iterator, bool> insert(P&& value) {
+    return insertValue(value_type(std::forward<P>(value)));
+  }
+
+  /**
+   * Inserts the elements of a range that are not in the map, keeping the
+   * first of any with the same key, like std::map does.
+   */
+  template <typename InputIterator>
+  void insert(InputIterator first, InputIterator last) {
+    size_type size = values_.size();
+    values_.insert(values_.end(), first, last);
+    iterator middle = values_.begin() + size;
+    std::stable_sort(middle, values_.end(), compare_);
+    std::inplace_merge(values_.begin(), middle, values_.end(), compare_);
+    values_.erase(std::unique(values_.begin(), values_.end(), Equivalent(compare_)),
+                  values_.end());
+  }
+
+  void insert(std::initializer_list<value_type> values) { insert(values.begin(), values.end()); }
+
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    return insertValue(value_type(std::forward<Args>(args)...));
+  }
+
+  /**
+   * Adds an element with the key and a default value at the end, wherever
+   * the key belongs, and returns the value. The map must not be used
+   * otherwise until sortAppended() has put it back in order.
+   */
+  template <typename K>
+  T& appendUnsorted(K&& key) {
+    values_.emplace_back(std::piecewise_construct,
+                         std::forward_as_tuple(std::forward<K>(key)),
+                         std::tuple<>());
+    return values_.back().second;
+  }
+
+  /**
+   * Sorts the map after appendUnsorted(), keeping the last element added of
+   * any with the same key, as assigning through operator[] would. Linear
+   * time if the keys were appended in order.
+   */
+  void sortAppended() {
+    if (std::adjacent_find(values_.begin(), values_.end(), NotLess(compare_)) == values_.end()) {
+      return;
+    }
+    std::stable_sort(values_.begin(), values_.end(), compare_);
+    iterator out = values_.begin();
+    for (iterator it = values_.begin(); it != values_.end(); ++it, ++out) {
+      while (it + 1 != values_.end() && !compare_(*it, *(it + 1))) {
+        ++it;
+      }
+      if (out != it) {
+        *out = std::move(*it);
+      }
+    }
+    values_.erase(out, values_.end());
+  }
+
+  iterator erase(const_iterator position) { return values_.erase(position); }
+  iterator erase(iterator position) { return values_.erase(position); }
+  iterator erase(const_iterator first, const_iterator last) { return values_.erase(first, last); }
+
+  size_type erase(const Key& key) {
+    iterator it = find(key);
+    if (it == end()) {
+      return 0;
+    }
+    values_.erase(it);
+    return 1;
+  }
+
+  void swap(TFlatMap& other) noexcept {
+    using std::swap;
+    swap(values_, other.values_);
+    swap(compare_, other.compare_);
+  }
+
+  iterator find(const Key& key) {
+    iterator it = lower_bound(key);
+    return (it != end() && !compare_(key, *it)) ? it : end();
+  }
+
+  const_iterator find(const Key& key) const {
+    const_iterator it = lower_bound(key);
+    return (it != end() && !compare_(key, *it)) ? it : end();
+  }
+
+  size_type count(const Key& key) const { return find(key) != end() ? 1 : 0; }
+
+  iterator lower_bound(const Key& key) {
+    return detail::lowerBound(values_.begin(), values_.end(), key, compare_);
+  }
+
+  const_iterator lower_bound(const Key& key) const {
+    return detail::lowerBound(values_.begin(), values_.end(), key, compare_);
+  }
+
+  iterator upper_bound(const Key& key) {
+    return std::upper_bound(values_.begin(), values_.end(), key, compare_);
+  }
+
+  const_iterator upper_bound(const Key& key) const {
+    return std::upper_bound(values_.begin(), values_.end(), key, compare_);
+  }
+
+  std::pair<iterator, iterator> equal_range(const Key& key) {
+    return std::equal_range(values_.begin(), values_.end(), key, compare_);
+  }
+
+  std::pair<const_iterator, const_iterator> equal_range(const Key& key) const {
+    return std::equal_range(values_.begin(), values_.end(), key, compare_);
+  }
+
+  friend bool operator==(const TFlatMap& a, const TFlatMap& b) { return a.values_ == b.values_; }
+  friend bool operator!=(const TFlatMap& a, const TFlatMap& b) { return a.values_ != b.values_; }
+  friend bool operator<(const TFlatMap& a, const TFlatMap& b) { return a.values_ < b.values_; }
+
+private:
+  typedef detail::TFlatKeyCompare<Key, Compare> ValueCompare;
+
+  struct Equivalent {
+    explicit Equivalent(const ValueCompare& compare) : compare(compare) {}
+    bool operator()(const value_type& a, const value_type& b) const {
+      return !compare(a, b) && !compare(b, a);
+    }
+    const ValueCompare& compare;
+  };
+
+  // True where two neighbours are out of order or have the same key
+  struct NotLess {
+    explicit NotLess(const ValueCompare& compare) : compare(compare) {}
+    bool operator()(const value_type& a, const value_type& b) const { return !compare(a, b); }
+    const ValueCompare& compare;
+  };
+
+  /**
+   * Finds the element with the key, adding one with a default value if
+   * there is none, appending it without a search if its key is the largest.
+   */
+  template <typename K>
+  iterator emplaceKey(K&& key) {
+    if (values_.empty() || compare_(values_.back(), key)) {
+      values_.emplace_back(std::piecewise_construct,
+                           std::forward_as_tuple(std::forward<K>(key)),
+                           std::tuple<>());
+      return values_.end() - 1;
+    }
+    iterator it = lower_bound(key);
+    if (it == end() || compare_(key, *it)) {
+      it = values_.emplace(it, std::piecewise_construct,
+                           std::forward_as_tuple(std::forward<K>(key)),
+                           std::tuple<>());
+    }
+    return it;
+  }
+
+  template <typename V>
+  std::pair<iterator, bool> insertValue(V&& value) {
+    if (values_.empty() || compare_(values_.back(), value)) {
+      values_.push_back(std::forward<V>(value));
+      return std::make_pair(values_.end() - 1, true);
+    }
+    iterator it = lower_bound(value.first);
+    if (it != end() && !compare_(value, *it)) {
+      return std::make_pair(it, false);
+    }
+    return std::make_pair(values_.insert(it, std::forward<V>(value)), true);
+  }
+
+  container_type values_;
+  ValueCompare compare_;
+};
+
+/**
+ * A set that keeps its elements in a sorted vector, for the set fields of
+ * structs generated with the <tt>flat_containers</tt> option or the
+ * <tt>cpp.flat</tt> annotation. It has the same trade-offs as TFlatMap.
+ */
+template <typename Key, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key> >
+class TFlatSet {
+public:
+  typedef Key key_type;
+  typedef Key value_type;
+  typedef Compare key_compare;
+  typedef Compare value_compare;
+  typedef Allocator allocator_type;
+  typedef std::vector<Key, Allocator> container_type;
+  typedef typename container_type::size_type size_type;
+  typedef typename container_type::difference_type difference_type;
+  typedef const Key& reference;
+  typedef const Key& const_reference;
+  typedef typename container_type::const_iterator iterator;
+  typedef typename container_type::const_iterator const_iterator;
+  typedef typename container_type::const_reverse_iterator reverse_iterator;
+  typedef typename container_type::const_reverse_iterator const_reverse_iterator;
+
+  TFlatSet() : compare_(Compare()) {}
+
+  explicit TFlatSet(const Compare& compare, const Allocator& allocator = Allocator())
+    : values_(allocator), compare_(compare) {}
+
+  template <typename InputIterator>
+  TFlatSet(InputIterator first, InputIterator last, const Compare& compare = Compare())
+    : compare_(compare) {
+    insert(first, last);
+  }
+
+  TFlatSet(std::initializer_list<Key> values, const Compare& compare = Compare())
+    : compare_(compare) {
+    insert(values.begin(), values.end());
+  }
+
+  TFlatSet& operator=(std::initializer_list<Key> values) {
+    clear();
+    insert(values.begin(), values.end());
+    return *this;
+  }
+
+  allocator_type get_allocator() const { return values_.get_allocator(); }
+  key_compare key_comp() const { return compare_; }
+  value_compare value_comp() const { return compare_; }
+
+  const_iterator begin() const noexcept { return values_.begin(); }
+  const_iterator cbegin() const noexcept { return values_.cbegin(); }
+  const_iterator end() const noexcept { return values_.end(); }
+  const_iterator cend() const noexcept { return values_.cend(); }
+  const_reverse_iterator rbegin() const noexcept { return values_.rbegin(); }
+  const_reverse_iterator rend() const noexcept { return values_.rend(); }
+
+  bool empty() const noexcept { return values_.empty(); }
+  size_type size() const noexcept { return values_.size(); }
+  size_type max_size() const noexcept { return values_.max_size(); }
+  size_type capacity() const noexcept { return values_.capacity(); }
+  void reserve(size_type count) { values_.reserve(count); }
+  void shrink_to_fit() { values_.shrink_to_fit(); }
+  void clear() noexcept { values_.clear(); }
+
+  std::pair<iterator, bool> insert(const Key& value) { return insertValue(value); }
+  std::pair<iterator, bool> insert(Key&& value) { return insertValue(std::move(value)); }
+
+  /**
+   * Inserts the elements of a range that are not in the set.
+   */
+  template <typename InputIterator>
+  void insert(InputIterator first, InputIterator last) {
+    size_type size = values_.size();
+    values_.insert(values_.end(), first, last);
+    typename container_type::iterator middle = values_.begin() + size;
+    std::stable_sort(middle, values_.end(), compare_);
+    std::inplace_merge(values_.begin(), middle, values_.end(), compare_);
+    values_.erase(std::unique(values_.begin(), values_.end(), Equivalent(compare_)),
+                  values_.end());
+  }
+
+  void insert(std::initializer_list<Key> values) { insert(values.begin(), values.end()); }
+
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    return insertValue(Key(std::forward<Args>(args)...));
+  }
+
+  /**
+   * Adds the element at the end, wherever it belongs. The set must not be
+   * used otherwise until sortAppended() has put it back in order.
+   */
+  template <typename V>
+  void appendUnsorted(V&& value) {
+    values_.emplace_back(std::forward<V>(value));
+  }
+
+  /**
+   * Sorts the set after appendUnsorted(), keeping the first element added of
+   * any that are equivalent, as insert() would. Linear time if the elements
+   * were appended in order.
+   */
+  void sortAppended() {
+    if (std::adjacent_find(values_.begin(), values_.end(), NotLess(compare_)) == values_.end()) {
+      return;
+    }
+    std::stable_sort(values_.begin(), values_.end(), compare_);
+    values_.erase(std::unique(values_.begin(), values_.end(), Equivalent(compare_)),
+                  values_.end());
+  }
+
+  iterator erase(const_iterator position) { return values_.erase(position); }
+  iterator erase(const_iterator first, const_iterator last) { return values_.erase(first, last); }
+
+  size_type erase(const Key& key) {
+    const_iterator it = find(key);
+    if (it == end()) {
+      return 0;
+    }
+    values_.erase(it);
+    return 1;
+  }
+
+  void swap(TFlatSet& other) noexcept {
+    using std::swap;
+    swap(values_, other.values_);
+    swap(compare_, other.compare_);
+  }
+
+  const_iterator find(const Key& key) const {
+    const_iterator it = lower_bound(key);
+    return (it != end() && !compare_(key, *it)) ? it : end();
+  }
+
+  size_type count(const Key& key) const { return find(key) != end() ? 1 : 0; }
+
+  const_iterator lower_bound(const Key& key) const {
+    return detail::lowerBound(values_.begin(), values_.end(), key, compare_);
+  }
+
+  const_iterator upper_bound(const Key& key) const {
+    return std::upper_bound(values_.begin(), values_.end(), key, compare_);
+  }
+
+  std::pair<const_iterator, const_iterator> equal_range(const Key& key) const {
+    return std::equal_range(values_.begin(), values_.end(), key, compare_);
+  }
+
+  friend bool operator==(const TFlatSet& a, const TFlatSet& b) { return a.values_ == b.values_; }
+  friend bool operator!=(const TFlatSet& a, const TFlatSet& b) { return a.values_ != b.values_; }
+  friend bool operator<(const TFlatSet& a, const TFlatSet& b) { return a.values_ < b.values_; }
+
+private:
+  struct Equivalent {
+    explicit Equivalent(const Compare& compare) : compare(compare) {}
+    bool operator()(const Key& a, const Key& b) const { return !compare(a, b) && !compare(b, a); }
+    const Compare& compare;
+  };
+
+  // True where two neighbours are out of order or equivalent
+  struct NotLess {
+    explicit NotLess(const Compare& compare) : compare(compare) {}
+    bool operator()(const Key& a, const Key& b) const { return !compare(a, b); }
+    const Compare& compare;
+  };
+
+  template <typename V>
+  std::pair<iterator, bool> insertValue(V&& value) {
+    if (values_.empty() || compare_(values_.back(), value)) {
+      values_.push_back(std::forward<V>(value));
+      return std::make_pair(const_iterator(values_.end() - 1), true);
+    }
+    typename container_type::iterator it
+        = detail::lowerBound(values_.begin(), values_.end(), value, compare_);
+    if (it != values_.end() && !compare_(value, *it)) {
+      return std::make_pair(const_iterator(it), false);
+    }
+    return std::make_pair(const_iterator(values_.insert(it, std::forward<V>(value))), true);
+  }
+
+  container_type values_;
+  Compare compare_;
+};
+
+template <typename Key, typename T, typename Compare, typename Allocator>
+void swap(TFlatMap<Key, T, Compare, Allocator>& a,
+          TFlatMap<Key, T, Compare, Allocator>& b) noexcept {
+  a.swap(b);
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void swap(TFlatSet<Key, Compare, Allocator>& a, TFlatSet<Key, Compare, Allocator>& b) noexcept {
+  a.swap(b);
+}
+}
+} // apache::thrift
+
+#endif // #ifndef _THRIFT_TFLATCONTAINERS_H_
@@ -0,0 +1,208 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TLAZY_H_
+#define _THRIFT_TLAZY_H_ 1
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <thrift/protocol/TProtocol.h>
+#include <thrift/protocol/TProtocolException.h>
+#include <thrift/transport/TBufferTransports.h>
+
+namespace apache {
+namespace thrift {
+
+/**
+ * Reads and writes a struct or exception for TLazy.
+ */
+template <class T>
+struct TLazyStructCodec {
+  static uint32_t read(protocol::TProtocol* iprot, T& value) { return value.read(iprot); }
+  static uint32_t write(protocol::TProtocol* oprot, const T& value) { return value.write(oprot); }
+  template <class Sizer_>
+  static uint32_t serializedSize(Sizer_* oprot, const T& value) {
+    return value.serializedSize(oprot);
+  }
+};
+
+/**
+ * A field value that is decoded on first access.
+ *
+ * Generated code uses this type for fields annotated with <tt>cpp.lazy</tt>.
+ * When the field is read by a protocol with a raw format (TBinaryProtocol or
+ * TCompactProtocol) from a transport that keeps the whole message around
+ * (see TTransport::isBorrowStable(), e.g. TMemoryBuffer and TFramedTransport),
+ * read() only skips over the value and keeps a copy of its bytes. get()
+ * decodes them the first time it is called. Until the value is changed,
+ * write() copies those bytes to a protocol of the same format instead of
+ * encoding the value again. Any other protocol or transport decodes the
+ * value right away.
+ *
+ * Decoding on first access modifies the object, so the first get() must not
+ * race with any other access, even on a const object.
+ */
+template <class T, class Codec_ = TLazyStructCodec<T> >
+class TLazy {
+public:
+  TLazy() : decoded_(true), format_(nullptr) {}
+  TLazy(const T& value) : value_(value), decoded_(true), format_(nullptr) {}
+  TLazy(T&& value) : value_(std::move(value)), decoded_(true), format_(nullptr) {}
+
+  TLazy& operator=(const T& value) {
+    value_ = value;
+    setDecoded();
+    return *this;
+  }
+
+  TLazy& operator=(T&& value) {
+    value_ = std::move(value);
+    setDecoded();
+    return *this;
+  }
+
+  /**
+   * The value, decoded first if it has not been yet.
+   */
+  const T& get() const {
+    if (!decoded_) {
+      decode();
+    }
+    return value_;
+  }
+
+  /**
+   * The value, for changing it. The raw bytes no longer match it and are
+   * dropped, so write() encodes it again.
+   */
+  T& mutable_get() {
+    get();
+    setDecoded();
+    return value_;
+  }
+
+  /**
+   * Whether the bytes the value was read from are kept, i.e. whether write()
+   * can copy them.
+   */
+  bool hasRaw() const { return format_ != nullptr; }
+
+  /**
+   * The bytes the value was read from, in the format of rawFormat().
+   */
+  const std::string& raw() const { return raw_; }
+
+  const protocol::TRawFormat* rawFormat() const { return format_; }
+
+  uint32_t read(protocol::TProtocol* iprot, protocol::TType type) {
+    const protocol::TRawFormat* format = iprot->getRawFormat();
+    std::shared_ptr<transport::TTransport> trans = iprot->getTransport();
+    if (format == nullptr || !trans->isBorrowStable()) {
+      setDecoded();
+      return Codec_::read(iprot, value_);
+    }
+
+    uint32_t len = 0;
+    const uint8_t* start = trans->borrow(nullptr, &len);
+    uint32_t size = iprot->skip(type);
+    len = 0;
+    const uint8_t* end = trans->borrow(nullptr, &len);
+    if (start == nullptr || end != start + size) {
+      throw protocol::TProtocolException(protocol::TProtocolException::INVALID_DATA,
+                                         "lazy field was not read from one buffer");
+    }
+    raw_.assign(reinterpret_cast<const char*>(start), size);
+    format_ = format;
+    decoded_ = false;
+    return size;
+  }
+
+  uint32_t write(protocol::TProtocol* oprot) const {
+    if (format_ != nullptr && oprot->getRawFormat() == format_) {
+      oprot->getTransport()->write(reinterpret_cast<const uint8_t*>(raw_.data()),
+                                   static_cast<uint32_t>(raw_.size()));
+      return static_cast<uint32_t>(raw_.size());
+    }
+    return Codec_::write(oprot, get());
+  }
+
+  /**
+   * The number of bytes write() writes with the protocol of the sizer (see
+   * TSerializedSize.h). That is the number of raw bytes when write() would
+   * copy them, which may hold fields T does not know about, so the value is
+   * only decoded to size it for another format.
+   */
+  template <class Sizer_>
+  uint32_t serializedSize(Sizer_* oprot) const {
+    if (format_ != nullptr && oprot->getRawFormat() == format_) {
+      return static_cast<uint32_t>(raw_.size());
+    }
+    return Codec_::serializedSize(oprot, get());
+  }
+
+  bool operator==(const TLazy& rhs) const {
+    if (format_ != nullptr && format_ == rhs.format_ && raw_ == rhs.raw_) {
+      return true;
+    }
+    return get() == rhs.get();
+  }
+
+  bool operator!=(const TLazy& rhs) const { return !(*this == rhs); }
+
+  void swap(TLazy& other) noexcept {
+    using std::swap;
+    swap(value_, other.value_);
+    swap(decoded_, other.decoded_);
+    swap(raw_, other.raw_);
+    swap(format_, other.format_);
+  }
+
+private:
+  void decode() const {
+    std::shared_ptr<transport::TMemoryBuffer> buffer(
+        new transport::TMemoryBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(raw_.data())),
+                                     static_cast<uint32_t>(raw_.size())));
+    std::shared_ptr<protocol::TProtocol> iprot = format_->newProtocol(buffer);
+    value_ = T();
+    Codec_::read(iprot.get(), value_);
+    decoded_ = true;
+  }
+
+  void setDecoded() {
+    decoded_ = true;
+    format_ = nullptr;
+    raw_.clear();
+  }
+
+  mutable T value_;
+  mutable bool decoded_;
+  std::string raw_;
+  const protocol::TRawFormat* format_;
+};
+
+template <class T, class Codec_>
+void swap(TLazy<T, Codec_>& a, TLazy<T, Codec_>& b) noexcept {
+  a.swap(b);
+}
+}
+} // apache::thrift
+
+#endif // _THRIFT_TLAZY_H_
@@ -24,9 +24,14 @@
 #include <set>
 #include <vector>
 
+#include <thrift/TFlatContainers.h>
+
 namespace apache {
 namespace thrift {
 
+template <class T, class Codec_>
+class TLazy;
+
 // Generic printTo template - streams value directly to output
 template <typename OStream, typename T>
 void printTo(OStream& out, const T& t) {
@@ -49,6 +54,15 @@ void printTo(OStream& out, const std::set<T>& s);
 template <typename OStream, typename T>
 void printTo(OStream& out, const std::vector<T>& t);
 
+template <typename OStream, typename K, typename V, typename C, typename A>
+void printTo(OStream& out, const TFlatMap<K, V, C, A>& m);
+
+template <typename OStream, typename T, typename C, typename A>
+void printTo(OStream& out, const TFlatSet<T, C, A>& s);
+
+template <typename OStream, typename T, typename Codec_>
+void printTo(OStream& out, const TLazy<T, Codec_>& v);
+
 // Pair support
 template <typename OStream, typename K, typename V>
 void printTo(OStream& out, const std::pair<K, V>& v) {
@@ -91,6 +105,28 @@ void printTo(OStream& out, const std::set<T>& s) {
   out << "}";
 }
 
+// Flat map support
+template <typename OStream, typename K, typename V, typename C, typename A>
+void printTo(OStream& out, const TFlatMap<K, V, C, A>& m) {
+  out << "{";
+  printTo(out, m.begin(), m.end());
+  out << "}";
+}
+
+// Flat set support
+template <typename OStream, typename T, typename C, typename A>
+void printTo(OStream& out, const TFlatSet<T, C, A>& s) {
+  out << "{";
+  printTo(out, s.begin(), s.end());
+  out << "}";
+}
+
+// Lazy field support
+template <typename OStream, typename T, typename Codec_>
+void printTo(OStream& out, const TLazy<T, Codec_>& v) {
+  printTo(out, v.get());
+}
+
 } // namespace thrift
 } // namespace apache
 
@@ -0,0 +1,169 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TSTRINGVIEW_H_
+#define _THRIFT_TSTRINGVIEW_H_ 1
+
+#include <thrift/Thrift.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace apache {
+namespace thrift {
+
+/**
+ * Thrift string or binary value that may refer to bytes it does not own.
+ *
+ * Generated code uses this type for string and binary fields when the C++
+ * generator runs with the <tt>string_views</tt> option. TBinaryProtocol and
+ * TCompactProtocol then point the value into the read buffer of transports
+ * that keep the whole message around (see TTransport::isBorrowStable(), e.g.
+ * TMemoryBuffer and TFramedTransport) instead of copying it.
+ *
+ * A borrowed value is only valid until that read buffer is reused, which
+ * for a server is once the handler returns, and for a client is the next
+ * call. Use str() for anything that has to outlive that. Values built from
+ * a std::string or a C string own a shared copy of it and are always safe;
+ * copying a TStringView never copies the bytes.
+ */
+class TStringView {
+public:
+  typedef char value_type;
+  typedef const char* iterator;
+  typedef const char* const_iterator;
+  typedef std::size_t size_type;
+
+  TStringView() noexcept : data_(nullptr), size_(0) {}
+
+  /**
+   * Construct the object from a copy of the specified string.
+   */
+  TStringView(const std::string& str)
+    : owned_(std::make_shared<std::string>(str)), data_(owned_->data()), size_(owned_->size()) {}
+
+  /**
+   * Construct the object taking over the specified string.
+   */
+  TStringView(std::string&& str)
+    : owned_(std::make_shared<std::string>(std::move(str))),
+      data_(owned_->data()),
+      size_(owned_->size()) {}
+
+  /**
+   * Construct the object from a copy of the specified C string.
+   */
+  TStringView(const char* str) : TStringView(std::string(str)) {}
+
+  /**
+   * Construct an object that refers to, but does not own, the specified bytes.
+   */
+  static TStringView borrow(const uint8_t* data, uint32_t size) noexcept {
+    TStringView view;
+    view.data_ = reinterpret_cast<const char*>(data);
+    view.size_ = size;
+    return view;
+  }
+
+  /**
+   * Check if the bytes are owned by this object (or by a copy of it).
+   */
+  bool owned() const noexcept { return owned_ != nullptr || size_ == 0; }
+
+  /**
+   * Return a std::string copy of the bytes.
+   */
+  std::string str() const { return std::string(data_, size_); }
+
+  const_iterator begin() const noexcept { return data_; }
+  const_iterator end() const noexcept { return data_ + size_; }
+  size_type size() const noexcept { return size_; }
+  size_type length() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  const char* data() const noexcept { return data_; }
+  char operator[](size_type pos) const noexcept { return data_[pos]; }
+
+  void clear() noexcept {
+    owned_.reset();
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  int compare(const TStringView& other) const noexcept {
+    size_type n = (std::min)(size_, other.size_);
+    int rc = n == 0 ? 0 : std::memcmp(data_, other.data_, n);
+    if (rc != 0) {
+      return rc;
+    }
+    return size_ < other.size_ ? -1 : (size_ > other.size_ ? 1 : 0);
+  }
+
+  void swap(TStringView& other) noexcept {
+    owned_.swap(other.owned_);
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+  }
+
+private:
+  std::shared_ptr<const std::string> owned_;
+  const char* data_;
+  size_type size_;
+};
+
+/**
+ * Swap two TStringView objects
+ */
+inline void swap(TStringView& lhs, TStringView& rhs) noexcept {
+  lhs.swap(rhs);
+}
+
+inline bool operator==(const TStringView& lhs, const TStringView& rhs) noexcept {
+  return lhs.size() == rhs.size() && lhs.compare(rhs) == 0;
+}
+
+inline bool operator!=(const TStringView& lhs, const TStringView& rhs) noexcept {
+  return !(lhs == rhs);
+}
+
+inline bool operator<(const TStringView& lhs, const TStringView& rhs) noexcept {
+  return lhs.compare(rhs) < 0;
+}
+
+/**
+ * Get the String representation of a TStringView.
+ */
+inline std::string to_string(const TStringView& view) {
+  return view.str();
+}
+
+/**
+ * TStringView ostream stream operator implementation
+ */
+inline std::ostream& operator<<(std::ostream& out, const TStringView& obj) {
+  out.write(obj.data(), static_cast<std::streamsize>(obj.size()));
+  return out;
+}
+
+} // namespace thrift
+} // namespace apache
+
+#endif // #ifndef _THRIFT_TSTRINGVIEW_H_
@@ -29,6 +29,8 @@
 #include <string>
 #include <vector>
 
+#include <thrift/TFlatContainers.h>
+
 namespace apache {
 namespace thrift {
 
@@ -37,6 +39,9 @@ namespace {
 const auto default_locale = std::locale("C");
 }
 
+template <class T, class Codec_>
+class TLazy;
+
 template <typename T>
 std::string to_string(const T& t) {
   std::ostringstream o;
@@ -79,14 +84,23 @@ inline std::string to_string(const long double& t) {
   return o.str();
 }
 
-template <typename K, typename V>
-std::string to_string(const std::map<K, V>& m);
+template <typename K, typename V, typename C, typename A>
+std::string to_string(const std::map<K, V, C, A>& m);
 
-template <typename T>
-std::string to_string(const std::set<T>& s);
+template <typename T, typename C, typename A>
+std::string to_string(const std::set<T, C, A>& s);
 
-template <typename T>
-std::string to_string(const std::vector<T>& t);
+template <typename T, typename A>
+std::string to_string(const std::vector<T, A>& t);
+
+template <typename K, typename V, typename C, typename A>
+std::string to_string(const TFlatMap<K, V, C, A>& m);
+
+template <typename T, typename C, typename A>
+std::string to_string(const TFlatSet<T, C, A>& s);
+
+template <class T, class Codec_>
+std::string to_string(const TLazy<T, Codec_>& v);
 
 template <typename K, typename V>
 std::string to_string(const typename std::pair<K, V>& v) {
@@ -106,26 +120,45 @@ std::string to_string(const T& beg, const T& end) {
   return o.str();
 }
 
-template <typename T>
-std::string to_string(const std::vector<T>& t) {
+template <typename T, typename A>
+std::string to_string(const std::vector<T, A>& t) {
   std::ostringstream o;
   o << "[" << to_string(t.begin(), t.end()) << "]";
   return o.str();
 }
 
-template <typename K, typename V>
-std::string to_string(const std::map<K, V>& m) {
+template <typename K, typename V, typename C, typename A>
+std::string to_string(const std::map<K, V, C, A>& m) {
   std::ostringstream o;
   o << "{" << to_string(m.begin(), m.end()) << "}";
   return o.str();
 }
 
-template <typename T>
-std::string to_string(const std::set<T>& s) {
+template <typename T, typename C, typename A>
+std::string to_string(const std::set<T, C, A>& s) {
   std::ostringstream o;
   o << "{" << to_string(s.begin(), s.end()) << "}";
   return o.str();
 }
+
+template <typename K, typename V, typename C, typename A>
+std::string to_string(const TFlatMap<K, V, C, A>& m) {
+  std::ostringstream o;
+  o << "{" << to_string(m.begin(), m.end()) << "}";
+  return o.str();
+}
+
+template <typename T, typename C, typename A>
+std::string to_string(const TFlatSet<T, C, A>& s) {
+  std::ostringstream o;
+  o << "{" << to_string(s.begin(), s.end()) << "}";
+  return o.str();
+}
+
+template <class T, class Codec_>
+std::string to_string(const TLazy<T, Codec_>& v) {
+  return to_string(v.get());
+}
 }
 } // apache::thrift
 
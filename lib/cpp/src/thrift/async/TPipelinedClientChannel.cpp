@@ -0,0 +1,456 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <thrift/async/TPipelinedClientChannel.h>
+
+#include <functional>
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#include <thrift/TApplicationException.h>
+#include <thrift/transport/PlatformSocket.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TSocket.h>
+#include <thrift/transport/TTransportException.h>
+#include <thrift/transport/TVirtualTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace async {
+
+using apache::thrift::concurrency::Guard;
+using apache::thrift::concurrency::Synchronized;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::TVirtualTransport;
+
+namespace {
+
+/**
+ * Reads from another transport, keeping a copy of everything read.
+ */
+class TCaptureTransport : public TVirtualTransport<TCaptureTransport> {
+public:
+  TCaptureTransport(std::shared_ptr<TTransport> transport, TMemoryBuffer* capture)
+    : transport_(transport), capture_(capture) {}
+
+  uint32_t read(uint8_t* buf, uint32_t len) {
+    uint32_t got = transport_->read(buf, len);
+    capture_->write(buf, got);
+    return got;
+  }
+
+private:
+  std::shared_ptr<TTransport> transport_;
+  TMemoryBuffer* capture_;
+};
+
+uint32_t roundUpToPowerOfTwo(uint32_t value) {
+  uint32_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+void invoke(const TAsyncChannel::VoidCallback& cob) {
+  try {
+    cob();
+  } catch (const std::exception& e) {
+    TOutput::instance().printf("TPipelinedClientChannel: callback raised an exception: %s",
+                               e.what());
+  } catch (...) {
+    TOutput::instance().printf("TPipelinedClientChannel: callback raised an unknown exception");
+  }
+}
+}
+
+TPipelinedClientChannel::TPipelinedClientChannel(
+    std::shared_ptr<TTransport> transport,
+    std::shared_ptr<apache::thrift::protocol::TProtocolFactory> protocolFactory,
+    bool framed,
+    uint32_t maxPending)
+  : transport_(transport),
+    protocolFactory_(protocolFactory),
+    framed_(framed),
+    slots_(new Slot[roundUpToPowerOfTwo(maxPending)]),
+    slotMask_(roundUpToPowerOfTwo(maxPending) - 1),
+    nextSeqId_(0),
+    inFlight_(0),
+    slotWaiters_(0),
+    failed_(false),
+    writing_(false),
+    readerDestroyed_(nullptr) {
+  if (!transport_->isOpen()) {
+    transport_->open();
+  }
+
+  readTransport_.reset(new TBufferedTransport(transport_));
+  readBuffer_.reset(new TMemoryBuffer());
+  if (framed_) {
+    readProtocol_ = protocolFactory_->getProtocol(readBuffer_);
+  } else {
+    // Unframed replies are parsed off the connection to find where they end
+    captureTransport_.reset(new TCaptureTransport(readTransport_, readBuffer_.get()));
+    captureProtocol_ = protocolFactory_->getProtocol(captureTransport_);
+  }
+  headerBuffer_.reset(new TMemoryBuffer());
+  headerProtocol_ = protocolFactory_->getProtocol(headerBuffer_);
+
+  readerThread_ = std::thread(&TPipelinedClientChannel::readLoop, this);
+}
+
+TPipelinedClientChannel::~TPipelinedClientChannel() {
+  failed_ = true;
+  if (readerThread_.get_id() == std::this_thread::get_id()) {
+    // A callback is destroying the channel: nothing is reading, and the
+    // reader leaves the channel alone once the callback returns
+    *readerDestroyed_ = true;
+    readerThread_.detach();
+  } else {
+    // Shutting the socket down wakes the reader without closing the
+    // descriptor it is reading from
+    auto* socket = dynamic_cast<TSocket*>(transport_.get());
+    if (socket != nullptr && socket->getSocketFD() != THRIFT_INVALID_SOCKET) {
+      shutdown(socket->getSocketFD(), THRIFT_SHUT_RDWR);
+    } else {
+      closeTransport();
+    }
+    readerThread_.join();
+  }
+  closeTransport();
+
+  // Requests the reader did not complete, if a callback destroyed it
+  fail();
+}
+
+void TPipelinedClientChannel::closeTransport() {
+  try {
+    transport_->close();
+  } catch (const TTransportException& e) {
+    TOutput::instance().printf("TPipelinedClientChannel: close failed: %s", e.what());
+  }
+}
+
+void TPipelinedClientChannel::sendMessage(const VoidCallback& cob, TMemoryBuffer* message) {
+  if (failed_) {
+    throwDeadConnection();
+  }
+
+  uint8_t* buf;
+  uint32_t len;
+  message->getBuffer(&buf, &len);
+  try {
+    write(nullptr, 0, buf, len);
+  } catch (...) {
+    fail();
+    throw;
+  }
+  cob();
+}
+
+void TPipelinedClientChannel::recvMessage(const VoidCallback& cob, TMemoryBuffer* message) {
+  (void)cob;
+  (void)message;
+  throw TTransportException(TTransportException::BAD_ARGS,
+                            "TPipelinedClientChannel: replies can only be received with "
+                            "sendAndRecvMessage()");
+}
+
+void TPipelinedClientChannel::sendAndRecvMessage(const VoidCallback& cob,
+                                                 TMemoryBuffer* sendBuf,
+                                                 TMemoryBuffer* recvBuf) {
+  if (failed_) {
+    throwDeadConnection();
+  }
+
+  uint8_t* buf;
+  uint32_t len;
+  sendBuf->getBuffer(&buf, &len);
+
+  // Read the caller's message header, to write it again with our sequence id
+  std::shared_ptr<TMemoryBuffer> request(new TMemoryBuffer(buf, len));
+  std::string fname;
+  TMessageType mtype;
+  int32_t callerSeqid;
+  protocolFactory_->getProtocol(request)->readMessageBegin(fname, mtype, callerSeqid);
+  uint32_t headerLen = len - request->available_read();
+
+  Slot& slot = claimSlot();
+  slot.callerSeqid = callerSeqid;
+  slot.cob = cob;
+  slot.recvBuf = recvBuf;
+
+  std::shared_ptr<TMemoryBuffer> header(new TMemoryBuffer(static_cast<uint32_t>(fname.size()) + 32));
+  protocolFactory_->getProtocol(header)->writeMessageBegin(fname, mtype, slot.seqid);
+  uint8_t* headerBuf;
+  uint32_t headerBufLen;
+  header->getBuffer(&headerBuf, &headerBufLen);
+
+  // The reply may come in as soon as the request is out
+  slot.state = WAITING;
+
+  // If the channel failed in the meantime, the slot may have been missed
+  if (failed_) {
+    int expected = WAITING;
+    if (slot.state.compare_exchange_strong(expected, CLAIMED)) {
+      releaseSlot(slot);
+      throwDeadConnection();
+    }
+    return;
+  }
+
+  try {
+    write(headerBuf, headerBufLen, buf + headerLen, len - headerLen);
+  } catch (...) {
+    // Unless the request was completed already, its caller gets the exception
+    int expected = WAITING;
+    bool ours = slot.state.compare_exchange_strong(expected, CLAIMED);
+    if (ours) {
+      releaseSlot(slot);
+    }
+    fail();
+    if (ours) {
+      throw;
+    }
+  }
+}
+
+TPipelinedClientChannel::Slot& TPipelinedClientChannel::claimSlot() {
+  uint32_t inFlight = inFlight_;
+  for (;;) {
+    if (inFlight <= slotMask_) {
+      if (inFlight_.compare_exchange_weak(inFlight, inFlight + 1)) {
+        break;
+      }
+      continue;
+    }
+
+    Synchronized s(slotMonitor_);
+    ++slotWaiters_;
+    while (inFlight_ > slotMask_ && !failed_) {
+      slotMonitor_.waitForever();
+    }
+    --slotWaiters_;
+    if (failed_) {
+      throwDeadConnection();
+    }
+    inFlight = inFlight_;
+  }
+
+  // There is a free slot, though replies coming back out of order may have
+  // left it elsewhere than the next sequence id's
+  for (;;) {
+    uint32_t seqid = nextSeqId_++;
+    Slot& slot = slots_[seqid & slotMask_];
+    int expected = FREE;
+    if (slot.state.compare_exchange_strong(expected, CLAIMED)) {
+      slot.seqid = static_cast<int32_t>(seqid);
+      return slot;
+    }
+  }
+}
+
+void TPipelinedClientChannel::releaseSlot(Slot& slot) {
+  slot.cob = nullptr;
+  slot.recvBuf = nullptr;
+  slot.state = FREE;
+  --inFlight_;
+  if (slotWaiters_ > 0) {
+    Synchronized s(slotMonitor_);
+    slotMonitor_.notify();
+  }
+}
+
+void TPipelinedClientChannel::write(const uint8_t* header,
+                                    uint32_t headerLen,
+                                    const uint8_t* body,
+                                    uint32_t bodyLen) {
+  {
+    Guard g(writeMutex_);
+    if (framed_) {
+      uint32_t size = headerLen + bodyLen;
+      char frameHeader[4] = {static_cast<char>(size >> 24), static_cast<char>(size >> 16),
+                             static_cast<char>(size >> 8), static_cast<char>(size)};
+      writeQueue_.append(frameHeader, sizeof(frameHeader));
+    }
+    if (headerLen > 0) {
+      writeQueue_.append(reinterpret_cast<const char*>(header), headerLen);
+    }
+    writeQueue_.append(reinterpret_cast<const char*>(body), bodyLen);
+
+    // Whoever is writing will pick this message up along with their own
+    if (writing_) {
+      return;
+    }
+    writing_ = true;
+  }
+
+  for (;;) {
+    {
+      Guard g(writeMutex_);
+      writeBatch_.clear();
+      if (writeQueue_.empty()) {
+        writing_ = false;
+        return;
+      }
+      writeBatch_.swap(writeQueue_);
+    }
+
+    try {
+      transport_->write(reinterpret_cast<const uint8_t*>(writeBatch_.data()),
+                        static_cast<uint32_t>(writeBatch_.size()));
+      transport_->flush();
+    } catch (...) {
+      Guard g(writeMutex_);
+      writeQueue_.clear();
+      writing_ = false;
+      throw;
+    }
+  }
+}
+
+bool TPipelinedClientChannel::readMessage(std::string& fname,
+                                          TMessageType& mtype,
+                                          int32_t& seqid) {
+  // An idle connection may time out between replies, but not within one
+  for (;;) {
+    try {
+      if (!readTransport_->peek()) {
+        return false;
+      }
+      break;
+    } catch (const TTransportException& e) {
+      if (e.getType() != TTransportException::TIMED_OUT) {
+        throw;
+      }
+    }
+  }
+
+  readBuffer_->resetBuffer();
+  if (framed_) {
+    uint8_t frameHeader[4];
+    readTransport_->readAll(frameHeader, sizeof(frameHeader));
+    uint32_t size = (static_cast<uint32_t>(frameHeader[0]) << 24)
+                    | (static_cast<uint32_t>(frameHeader[1]) << 16)
+                    | (static_cast<uint32_t>(frameHeader[2]) << 8)
+                    | static_cast<uint32_t>(frameHeader[3]);
+    if (size > static_cast<uint32_t>(transport_->getConfiguration()->getMaxFrameSize())) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Received an oversized frame");
+    }
+    readTransport_->readAll(readBuffer_->getWritePtr(size), size);
+    readBuffer_->wroteBytes(size);
+    readProtocol_->readMessageBegin(fname, mtype, seqid);
+  } else {
+    captureProtocol_->readMessageBegin(fname, mtype, seqid);
+    readBuffer_->resetBuffer();
+    captureProtocol_->skip(apache::thrift::protocol::T_STRUCT);
+    captureProtocol_->readMessageEnd();
+  }
+  readTransport_->readEnd();
+  return true;
+}
+
+void TPipelinedClientChannel::readLoop() {
+  bool destroyed = false;
+  readerDestroyed_ = &destroyed;
+  try {
+    std::string fname;
+    TMessageType mtype;
+    int32_t seqid;
+    while (readMessage(fname, mtype, seqid)) {
+      Slot& slot = slots_[static_cast<uint32_t>(seqid) & slotMask_];
+      int expected = WAITING;
+      if (!slot.state.compare_exchange_strong(expected, CLAIMED)) {
+        throw TApplicationException(TApplicationException::BAD_SEQUENCE_ID,
+                                    "server sent a bad seqid");
+      }
+      if (slot.seqid != seqid) {
+        slot.state = WAITING;
+        throw TApplicationException(TApplicationException::BAD_SEQUENCE_ID,
+                                    "server sent a bad seqid");
+      }
+
+      // Give the reply back its caller's sequence id
+      headerBuffer_->resetBuffer();
+      headerProtocol_->writeMessageBegin(fname, mtype, slot.callerSeqid);
+      uint8_t* headerBuf;
+      uint32_t headerBufLen;
+      headerBuffer_->getBuffer(&headerBuf, &headerBufLen);
+      uint8_t* body;
+      uint32_t bodyLen;
+      readBuffer_->getBuffer(&body, &bodyLen);
+
+      slot.recvBuf->resetBuffer();
+      slot.recvBuf->write(headerBuf, headerBufLen);
+      slot.recvBuf->write(body, bodyLen);
+
+      // Free the slot first, the callback may well send the next request
+      VoidCallback cob;
+      cob.swap(slot.cob);
+      releaseSlot(slot);
+      invoke(cob);
+      if (destroyed) {
+        return;
+      }
+    }
+  } catch (const TException& e) {
+    if (!failed_) {
+      TOutput::instance().printf("TPipelinedClientChannel: reading replies failed: %s", e.what());
+    }
+  }
+  fail(&destroyed);
+}
+
+void TPipelinedClientChannel::fail(const bool* destroyed) {
+  failed_ = true;
+
+  for (uint32_t ix = 0; ix <= slotMask_; ix++) {
+    Slot& slot = slots_[ix];
+    int expected = WAITING;
+    if (slot.state.compare_exchange_strong(expected, CLAIMED)) {
+      VoidCallback cob;
+      cob.swap(slot.cob);
+      slot.recvBuf->resetBuffer();
+      releaseSlot(slot);
+      invoke(cob);
+      if (destroyed != nullptr && *destroyed) {
+        return;
+      }
+    }
+  }
+
+  Synchronized s(slotMonitor_);
+  slotMonitor_.notifyAll();
+}
+
+void TPipelinedClientChannel::throwDeadConnection() {
+  throw TTransportException(TTransportException::NOT_OPEN,
+                            "TPipelinedClientChannel: the connection has failed");
+}
+}
+}
+} // apache::thrift::async
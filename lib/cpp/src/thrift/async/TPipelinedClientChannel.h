@@ -0,0 +1,204 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_ASYNC_TPIPELINEDCLIENTCHANNEL_H_
+#define _THRIFT_ASYNC_TPIPELINEDCLIENTCHANNEL_H_ 1
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <thrift/async/TAsyncChannel.h>
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/concurrency/Mutex.h>
+#include <thrift/protocol/TProtocol.h>
+#include <thrift/transport/TTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace async {
+
+/**
+ * A channel that keeps many requests in flight on one connection.
+ *
+ * Any number of threads may call sendAndRecvMessage() at the same time,
+ * typically each with a cob style client of its own sharing the channel.
+ * Every request is given a sequence id of the channel's own, so replies may
+ * come back in any order: a dedicated reader thread reads them off the
+ * connection and hands each one to the callback of its request, without a
+ * slow reply holding up the ones behind it.  The callbacks run on the reader
+ * thread.
+ *
+ * Requests waiting for their reply are kept in a fixed table indexed by
+ * sequence id, which senders and the reader update with atomic operations
+ * only.  Requests sent at the same time are written out together.
+ *
+ * The transport must support a read and a write at the same time from two
+ * threads, as TSocket does.  When the channel is framed, which is what
+ * servers like TNonblockingServer expect, the channel adds and strips the
+ * frame headers itself and the transport should not be a TFramedTransport.
+ *
+ * If the connection fails every request waiting for a reply is completed
+ * with an empty reply, which the client fails to read, and further requests
+ * throw.  The channel cannot be used again.
+ */
+class TPipelinedClientChannel : public TAsyncChannel {
+public:
+  using TAsyncChannel::VoidCallback;
+
+  /**
+   * @param transport the connection, opened here if it is not open yet
+   * @param protocolFactory makes the protocol the clients use, to read
+   *        and write the message headers
+   * @param framed whether messages are framed on the wire
+   * @param maxPending the most requests awaiting a reply at a time, rounded
+   *        up to a power of two; more block until replies come in
+   */
+  TPipelinedClientChannel(std::shared_ptr<apache::thrift::transport::TTransport> transport,
+                          std::shared_ptr<apache::thrift::protocol::TProtocolFactory> protocolFactory,
+                          bool framed = true,
+                          uint32_t maxPending = 1024);
+
+  /**
+   * Stops the reader thread and closes the connection.  A TSocket is shut
+   * down to stop the reader, and closed only once it has; any other
+   * transport is closed under it.  The channel may be destroyed by one of
+   * its callbacks, on the reader thread.
+   */
+  ~TPipelinedClientChannel() override;
+
+  bool good() const override { return !failed_; }
+  bool error() const override { return failed_; }
+  bool timedOut() const override { return false; }
+
+  /**
+   * Sends a message that has no reply, such as a oneway call.
+   */
+  void sendMessage(const VoidCallback& cob,
+                   apache::thrift::transport::TMemoryBuffer* message) override;
+
+  /**
+   * Replies are matched to requests by sequence id, so they cannot be
+   * received on their own.  Always throws.
+   */
+  void recvMessage(const VoidCallback& cob,
+                   apache::thrift::transport::TMemoryBuffer* message) override;
+
+  /**
+   * Sends a request and calls cob once its reply is in recvBuf.  The
+   * request's sequence id is replaced on the wire and restored in the reply.
+   */
+  void sendAndRecvMessage(const VoidCallback& cob,
+                          apache::thrift::transport::TMemoryBuffer* sendBuf,
+                          apache::thrift::transport::TMemoryBuffer* recvBuf) override;
+
+  /**
+   * The number of requests awaiting a reply.
+   */
+  uint32_t pendingCount() const { return inFlight_; }
+
+private:
+  enum SlotState { FREE, CLAIMED, WAITING };
+
+  struct Slot {
+    Slot() : state(FREE), seqid(0), callerSeqid(0), recvBuf(nullptr) {}
+
+    std::atomic<int> state;
+    std::atomic<int32_t> seqid;
+    int32_t callerSeqid;
+    VoidCallback cob;
+    apache::thrift::transport::TMemoryBuffer* recvBuf;
+  };
+
+  /**
+   * Waits for a place in the pending table and claims a slot in it,
+   * choosing the sequence id that goes with it.
+   */
+  Slot& claimSlot();
+
+  void releaseSlot(Slot& slot);
+
+  /**
+   * Queues a message to be written, and writes out everything queued unless
+   * another thread is doing so already.
+   */
+  void write(const uint8_t* header,
+             uint32_t headerLen,
+             const uint8_t* body,
+             uint32_t bodyLen);
+
+  /**
+   * Reads the next reply, leaving all of it but the header in readBuffer_.
+   * Returns false at the end of the connection.
+   */
+  bool readMessage(std::string& fname,
+                   apache::thrift::protocol::TMessageType& mtype,
+                   int32_t& seqid);
+
+  void readLoop();
+
+  void closeTransport();
+
+  /**
+   * Marks the channel failed and completes every request awaiting a reply.
+   * Stops as soon as *destroyed is set, by a callback destroying the
+   * channel.
+   */
+  void fail(const bool* destroyed = nullptr);
+
+  void throwDeadConnection();
+
+  std::shared_ptr<apache::thrift::transport::TTransport> transport_;
+  std::shared_ptr<apache::thrift::protocol::TProtocolFactory> protocolFactory_;
+  const bool framed_;
+
+  std::unique_ptr<Slot[]> slots_;
+  const uint32_t slotMask_;
+  std::atomic<uint32_t> nextSeqId_;
+  std::atomic<uint32_t> inFlight_;
+  std::atomic<uint32_t> slotWaiters_;
+  std::atomic<bool> failed_;
+  apache::thrift::concurrency::Monitor slotMonitor_;
+
+  apache::thrift::concurrency::Mutex writeMutex_;
+  // begin writeMutex_ protected members
+  std::string writeQueue_;
+  bool writing_;
+  std::string writeBatch_;
+  // end writeMutex_ protected members
+
+  // Used by the reader thread only
+  std::shared_ptr<apache::thrift::transport::TTransport> readTransport_;
+  std::shared_ptr<apache::thrift::transport::TMemoryBuffer> readBuffer_;
+  std::shared_ptr<apache::thrift::protocol::TProtocol> readProtocol_;
+  std::shared_ptr<apache::thrift::transport::TTransport> captureTransport_;
+  std::shared_ptr<apache::thrift::protocol::TProtocol> captureProtocol_;
+  std::shared_ptr<apache::thrift::transport::TMemoryBuffer> headerBuffer_;
+  std::shared_ptr<apache::thrift::protocol::TProtocol> headerProtocol_;
+
+  std::thread readerThread_;
+  // Set by the reader thread to a flag of its own, which the destructor
+  // sets when a callback destroys the channel
+  bool* readerDestroyed_;
+};
+}
+}
+} // apache::thrift::async
+
+#endif // #ifndef _THRIFT_ASYNC_TPIPELINEDCLIENTCHANNEL_H_
@@ -200,6 +200,15 @@ public:
   static std::shared_ptr<ThreadManager> newSimpleThreadManager(size_t count = 4,
                                                                  size_t pendingTaskCountMax = 0);
 
+  /**
+   * Creates a thread manager like newSimpleThreadManager, except that tasks are
+   * queued on count lock-free queues rather than a single locked one.  Workers
+   * take tasks from a queue of their own and steal from the others when it is
+   * empty, so that adding and running tasks does not contend on one mutex.
+   */
+  static std::shared_ptr<ThreadManager> newWorkStealingThreadManager(size_t count = 4,
+                                                                       size_t pendingTaskCountMax = 0);
+
   class Task;
 
   class Worker;
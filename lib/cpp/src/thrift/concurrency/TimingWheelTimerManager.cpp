@@ -0,0 +1,472 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/concurrency/TimingWheelTimerManager.h>
+#include <thrift/concurrency/Exception.h>
+
+#include <assert.h>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+using std::shared_ptr;
+using std::weak_ptr;
+
+/**
+ * A timer, linked into a slot of the wheel while it is pending.  The wheel
+ * holds the timer alive through self_, so that it can be unlinked without
+ * looking anything up.
+ */
+class TimingWheelTimerManager::Task : public Runnable {
+
+public:
+  enum STATE { WAITING, EXECUTING, CANCELLED, COMPLETE };
+
+  Task(shared_ptr<Runnable> runnable, uint64_t deadline)
+    : runnable_(runnable),
+      state_(WAITING),
+      deadline_(deadline),
+      slot_(nullptr),
+      prev_(nullptr),
+      next_(nullptr) {}
+
+  ~Task() override = default;
+
+  void run() override {
+    if (state_ == EXECUTING) {
+      runnable_->run();
+      state_ = COMPLETE;
+    }
+  }
+
+  bool operator==(const shared_ptr<Runnable>& runnable) const { return runnable_ == runnable; }
+
+private:
+  shared_ptr<Runnable> runnable_;
+  friend class TimingWheelTimerManager;
+  friend class TimingWheelTimerManager::Dispatcher;
+  STATE state_;
+  uint64_t deadline_;
+  Task** slot_;
+  Task* prev_;
+  Task* next_;
+  shared_ptr<Task> self_;
+};
+
+class TimingWheelTimerManager::Dispatcher : public Runnable {
+
+public:
+  Dispatcher(TimingWheelTimerManager* manager) : manager_(manager) {}
+
+  ~Dispatcher() override = default;
+
+  /**
+   * Dispatcher entry point
+   *
+   * As long as dispatcher thread is running, advance the wheel and run the
+   * tasks that fall due.
+   */
+  void run() override {
+    {
+      Synchronized s(manager_->monitor_);
+      if (manager_->state_ == TimingWheelTimerManager::STARTING) {
+        manager_->state_ = TimingWheelTimerManager::STARTED;
+        manager_->monitor_.notifyAll();
+      }
+    }
+
+    do {
+      std::vector<shared_ptr<TimingWheelTimerManager::Task> > expiredTasks;
+      {
+        Synchronized s(manager_->monitor_);
+        while (manager_->state_ == TimingWheelTimerManager::STARTED) {
+          auto now = std::chrono::steady_clock::now();
+          manager_->advance(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                now - manager_->epoch_).count(),
+                            expiredTasks);
+          if (!expiredTasks.empty()) {
+            break;
+          }
+
+          if (manager_->taskCount_ == 0) {
+            manager_->wakeTick_ = std::numeric_limits<uint64_t>::max();
+            manager_->monitor_.waitForever();
+          } else {
+            manager_->wakeTick_ = manager_->nextTick();
+            manager_->monitor_.waitForTime(manager_->epoch_
+                                           + std::chrono::milliseconds(manager_->wakeTick_));
+          }
+        }
+      }
+
+      for (const auto& expiredTask : expiredTasks) {
+        expiredTask->run();
+      }
+
+    } while (manager_->state_ == TimingWheelTimerManager::STARTED);
+
+    {
+      Synchronized s(manager_->monitor_);
+      if (manager_->state_ == TimingWheelTimerManager::STOPPING) {
+        manager_->state_ = TimingWheelTimerManager::STOPPED;
+        manager_->monitor_.notifyAll();
+      }
+    }
+    return;
+  }
+
+private:
+  TimingWheelTimerManager* manager_;
+  friend class TimingWheelTimerManager;
+};
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4355) // 'this' used in base member initializer list
+#endif
+
+TimingWheelTimerManager::TimingWheelTimerManager()
+  : epoch_(std::chrono::steady_clock::now()),
+    currentTick_(0),
+    wakeTick_(std::numeric_limits<uint64_t>::max()),
+    taskCount_(0),
+    state_(TimingWheelTimerManager::UNINITIALIZED),
+    dispatcher_(std::make_shared<Dispatcher>(this)) {
+  for (int level = 0; level < LEVELS; level++) {
+    for (uint64_t ix = 0; ix < SLOTS; ix++) {
+      wheel_[level][ix] = nullptr;
+    }
+  }
+}
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+TimingWheelTimerManager::~TimingWheelTimerManager() {
+
+  // If we haven't been explicitly stopped, do so now.  We don't need to grab
+  // the monitor here, since stop already takes care of reentrancy.
+
+  if (state_ != STOPPED) {
+    try {
+      stop();
+    } catch (...) {
+      // We're really hosed.
+    }
+  }
+}
+
+void TimingWheelTimerManager::start() {
+  bool doStart = false;
+  {
+    Synchronized s(monitor_);
+    if (!threadFactory_) {
+      throw InvalidArgumentException();
+    }
+    if (state_ == TimingWheelTimerManager::UNINITIALIZED) {
+      state_ = TimingWheelTimerManager::STARTING;
+      doStart = true;
+    }
+  }
+
+  if (doStart) {
+    dispatcherThread_ = threadFactory_->newThread(dispatcher_);
+    dispatcherThread_->start();
+  }
+
+  {
+    Synchronized s(monitor_);
+    while (state_ == TimingWheelTimerManager::STARTING) {
+      monitor_.wait();
+    }
+    assert(state_ != TimingWheelTimerManager::STARTING);
+  }
+}
+
+void TimingWheelTimerManager::stop() {
+  bool doStop = false;
+  {
+    Synchronized s(monitor_);
+    if (state_ == TimingWheelTimerManager::UNINITIALIZED) {
+      state_ = TimingWheelTimerManager::STOPPED;
+    } else if (state_ != STOPPING && state_ != STOPPED) {
+      doStop = true;
+      state_ = STOPPING;
+      monitor_.notifyAll();
+    }
+    while (state_ != STOPPED) {
+      monitor_.wait();
+    }
+  }
+
+  if (doStop) {
+    // Clean up any outstanding tasks
+    clear();
+
+    // Remove dispatcher's reference to us.
+    dispatcher_->manager_ = nullptr;
+  }
+}
+
+shared_ptr<const ThreadFactory> TimingWheelTimerManager::threadFactory() const {
+  Synchronized s(monitor_);
+  return threadFactory_;
+}
+
+void TimingWheelTimerManager::threadFactory(shared_ptr<const ThreadFactory> value) {
+  Synchronized s(monitor_);
+  threadFactory_ = value;
+}
+
+size_t TimingWheelTimerManager::taskCount() const {
+  return taskCount_;
+}
+
+TimingWheelTimerManager::Timer TimingWheelTimerManager::add(shared_ptr<Runnable> task,
+                                                            const std::chrono::milliseconds& timeout) {
+  return add(task, std::chrono::steady_clock::now() + timeout);
+}
+
+TimingWheelTimerManager::Timer TimingWheelTimerManager::add(
+    shared_ptr<Runnable> task,
+    const std::chrono::time_point<std::chrono::steady_clock>& abstime) {
+  auto now = std::chrono::steady_clock::now();
+
+  if (abstime < now) {
+    throw InvalidArgumentException();
+  }
+
+  // Allocate outside the lock, the task and its count in one go
+  shared_ptr<Task> timer = std::make_shared<Task>(task, toTick(abstime));
+
+  Synchronized s(monitor_);
+  if (state_ != TimingWheelTimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  timer->self_ = timer;
+  link(timer.get());
+  taskCount_++;
+
+  // Kick the dispatcher if it is asleep until later than this task is due
+  if (timer->deadline_ < wakeTick_) {
+    wakeTick_ = timer->deadline_;
+    monitor_.notify();
+  }
+
+  return timer;
+}
+
+void TimingWheelTimerManager::remove(shared_ptr<Runnable> task) {
+  Synchronized s(monitor_);
+  if (state_ != TimingWheelTimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+  bool found = false;
+  for (int level = 0; level < LEVELS; level++) {
+    for (uint64_t ix = 0; ix < SLOTS; ix++) {
+      Task* next = wheel_[level][ix];
+      while (next != nullptr) {
+        Task* timer = next;
+        next = timer->next_;
+        if (*timer == task) {
+          found = true;
+          unlink(timer);
+          timer->state_ = Task::CANCELLED;
+          taskCount_--;
+          timer->self_.reset();
+        }
+      }
+    }
+  }
+  if (!found) {
+    throw NoSuchTaskException();
+  }
+}
+
+void TimingWheelTimerManager::remove(Timer handle) {
+  Synchronized s(monitor_);
+  if (state_ != TimingWheelTimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  shared_ptr<Task> task = handle.lock();
+  if (!task) {
+    throw NoSuchTaskException();
+  }
+
+  if (task->slot_ == nullptr) {
+    // Task is being executed
+    throw UncancellableTaskException();
+  }
+
+  unlink(task.get());
+  task->state_ = Task::CANCELLED;
+  taskCount_--;
+  task->self_.reset();
+}
+
+TimingWheelTimerManager::STATE TimingWheelTimerManager::state() const {
+  return state_;
+}
+
+uint64_t TimingWheelTimerManager::toTick(
+    const std::chrono::time_point<std::chrono::steady_clock>& time) const {
+  if (time <= epoch_) {
+    return 0;
+  }
+  auto elapsed = time - epoch_;
+  auto ticks = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+  if (ticks < elapsed) {
+    ++ticks;
+  }
+  return ticks.count();
+}
+
+void TimingWheelTimerManager::link(Task* task) {
+  const uint64_t span = static_cast<uint64_t>(1) << (SLOT_BITS * LEVELS);
+  uint64_t deadline = task->deadline_ > currentTick_ ? task->deadline_ : currentTick_;
+  uint64_t delta = deadline - currentTick_;
+
+  // Timers beyond the reach of the wheel go round again
+  if (delta >= span) {
+    deadline = currentTick_ + span - 1;
+    delta = span - 1;
+  }
+
+  int level = 0;
+  while (level < LEVELS - 1 && delta >= static_cast<uint64_t>(1) << (SLOT_BITS * (level + 1))) {
+    level++;
+  }
+
+  Task** slot = &wheel_[level][(deadline >> (SLOT_BITS * level)) & SLOT_MASK];
+  task->slot_ = slot;
+  task->prev_ = nullptr;
+  task->next_ = *slot;
+  if (*slot != nullptr) {
+    (*slot)->prev_ = task;
+  }
+  *slot = task;
+}
+
+void TimingWheelTimerManager::unlink(Task* task) {
+  if (task->prev_ != nullptr) {
+    task->prev_->next_ = task->next_;
+  } else {
+    *task->slot_ = task->next_;
+  }
+  if (task->next_ != nullptr) {
+    task->next_->prev_ = task->prev_;
+  }
+  task->slot_ = nullptr;
+  task->prev_ = nullptr;
+  task->next_ = nullptr;
+}
+
+void TimingWheelTimerManager::advance(uint64_t tick, std::vector<shared_ptr<Task> >& expired) {
+  while (currentTick_ <= tick) {
+    if (taskCount_ == 0) {
+      currentTick_ = tick + 1;
+      return;
+    }
+
+    // Skip the ticks with nothing to do
+    uint64_t next = nextTick();
+    if (next > tick) {
+      currentTick_ = tick + 1;
+      return;
+    }
+    currentTick_ = next;
+
+    // At the start of each round of a level, move its next slot down
+    if ((next & SLOT_MASK) == 0) {
+      int top = 1;
+      while (top < LEVELS - 1 && ((next >> (SLOT_BITS * top)) & SLOT_MASK) == 0) {
+        top++;
+      }
+      for (int level = top; level > 0; level--) {
+        cascade(level, next);
+      }
+    }
+
+    Task* timer = wheel_[0][next & SLOT_MASK];
+    wheel_[0][next & SLOT_MASK] = nullptr;
+    while (timer != nullptr) {
+      Task* following = timer->next_;
+      timer->slot_ = nullptr;
+      timer->prev_ = nullptr;
+      timer->next_ = nullptr;
+      if (timer->deadline_ > next) {
+        link(timer);
+      } else {
+        timer->state_ = Task::EXECUTING;
+        taskCount_--;
+        expired.push_back(std::move(timer->self_));
+      }
+      timer = following;
+    }
+
+    currentTick_ = next + 1;
+  }
+}
+
+void TimingWheelTimerManager::cascade(int level, uint64_t tick) {
+  Task** slot = &wheel_[level][(tick >> (SLOT_BITS * level)) & SLOT_MASK];
+  Task* timer = *slot;
+  *slot = nullptr;
+  while (timer != nullptr) {
+    Task* following = timer->next_;
+    link(timer);
+    timer = following;
+  }
+}
+
+uint64_t TimingWheelTimerManager::nextTick() const {
+  uint64_t tick = currentTick_;
+  while ((tick & SLOT_MASK) != 0 && wheel_[0][tick & SLOT_MASK] == nullptr) {
+    tick++;
+  }
+  return tick;
+}
+
+void TimingWheelTimerManager::clear() {
+  for (int level = 0; level < LEVELS; level++) {
+    for (uint64_t ix = 0; ix < SLOTS; ix++) {
+      Task* timer = wheel_[level][ix];
+      wheel_[level][ix] = nullptr;
+      while (timer != nullptr) {
+        Task* following = timer->next_;
+        timer->slot_ = nullptr;
+        timer->prev_ = nullptr;
+        timer->next_ = nullptr;
+        timer->self_.reset();
+        timer = following;
+      }
+    }
+  }
+  taskCount_ = 0;
+}
+}
+}
+} // apache::thrift::concurrency
@@ -0,0 +1,181 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_CONCURRENCY_TIMINGWHEELTIMERMANAGER_H_
+#define _THRIFT_CONCURRENCY_TIMINGWHEELTIMERMANAGER_H_ 1
+
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/concurrency/ThreadFactory.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+/**
+ * Timing Wheel Timer Manager
+ *
+ * A timer manager with the same interface as TimerManager, for when there
+ * are many timers at once, such as a timeout for every request in flight.
+ *
+ * Timers are kept in a hierarchical timing wheel with a resolution of one
+ * millisecond: four levels of 256 slots, each a list, the first level
+ * holding the timers due in the next 256ms, the next the ones due in the
+ * next 65536ms, and so on.  Adding or removing a timer takes constant time
+ * and a single allocation, where TimerManager keeps an ordered map.  The
+ * dispatcher takes every timer due at once and runs them in a batch.
+ *
+ * Tasks run no earlier than their time, but timers due within the same
+ * millisecond run in no particular order.
+ */
+class TimingWheelTimerManager {
+
+public:
+  class Task;
+  typedef std::weak_ptr<Task> Timer;
+
+  TimingWheelTimerManager();
+
+  virtual ~TimingWheelTimerManager();
+
+  virtual std::shared_ptr<const ThreadFactory> threadFactory() const;
+
+  virtual void threadFactory(std::shared_ptr<const ThreadFactory> value);
+
+  /**
+   * Starts the timer manager service
+   *
+   * @throws IllegalArgumentException Missing thread factory attribute
+   */
+  virtual void start();
+
+  /**
+   * Stops the timer manager service
+   */
+  virtual void stop();
+
+  virtual size_t taskCount() const;
+
+  /**
+   * Adds a task to be executed at some time in the future by a worker thread.
+   *
+   * @param task The task to execute
+   * @param timeout Time in milliseconds to delay before executing task
+   * @return Handle of the timer, which can be used to remove the timer.
+   */
+  virtual Timer add(std::shared_ptr<Runnable> task, const std::chrono::milliseconds& timeout);
+  Timer add(std::shared_ptr<Runnable> task, uint64_t timeout) { return add(task, std::chrono::milliseconds(timeout)); }
+
+  /**
+   * Adds a task to be executed at some time in the future by a worker thread.
+   *
+   * @param task The task to execute
+   * @param abstime Absolute time in the future to execute task.
+   * @return Handle of the timer, which can be used to remove the timer.
+   */
+  virtual Timer add(std::shared_ptr<Runnable> task, const std::chrono::time_point<std::chrono::steady_clock>& abstime);
+
+  /**
+   * Removes a pending task.  This looks through every timer.
+   *
+   * @param task The task to remove. All timers which execute this task will
+   * be removed.
+   * @throws NoSuchTaskException Specified task doesn't exist. It was either
+   *                             processed already or this call was made for a
+   *                             task that was never added to this timer
+   */
+  virtual void remove(std::shared_ptr<Runnable> task);
+
+  /**
+   * Removes a single pending task
+   *
+   * @param timer The timer to remove. The timer is returned when calling the
+   * add() method.
+   * @throws NoSuchTaskException Specified task doesn't exist. It was either
+   *                             processed already or this call was made for a
+   *                             task that was never added to this timer
+   *
+   * @throws UncancellableTaskException Specified task is already being
+   *                                    executed or has completed execution.
+   */
+  virtual void remove(Timer timer);
+
+  enum STATE { UNINITIALIZED, STARTING, STARTED, STOPPING, STOPPED };
+
+  virtual STATE state() const;
+
+private:
+  static const int LEVELS = 4;
+  static const int SLOT_BITS = 8;
+  static const uint64_t SLOTS = 1 << SLOT_BITS;
+  static const uint64_t SLOT_MASK = SLOTS - 1;
+
+  /**
+   * The first tick at or after the given time.
+   */
+  uint64_t toTick(const std::chrono::time_point<std::chrono::steady_clock>& time) const;
+
+  /**
+   * Puts a task in the slot for its deadline, relative to the next tick
+   * to be processed.
+   */
+  void link(Task* task);
+
+  void unlink(Task* task);
+
+  /**
+   * Processes the ticks up to and including the given one, moving the timers
+   * due out of the wheel and into expired.
+   */
+  void advance(uint64_t tick, std::vector<std::shared_ptr<Task> >& expired);
+
+  /**
+   * Moves the timers of a slot of a higher level down the wheel.
+   */
+  void cascade(int level, uint64_t tick);
+
+  /**
+   * The tick the dispatcher next has work at, when there are timers.
+   */
+  uint64_t nextTick() const;
+
+  void clear();
+
+  std::shared_ptr<const ThreadFactory> threadFactory_;
+  friend class Task;
+  std::chrono::time_point<std::chrono::steady_clock> epoch_;
+  Task* wheel_[LEVELS][SLOTS];
+  uint64_t currentTick_;
+  uint64_t wakeTick_;
+  size_t taskCount_;
+  Monitor monitor_;
+  STATE state_;
+  class Dispatcher;
+  friend class Dispatcher;
+  std::shared_ptr<Dispatcher> dispatcher_;
+  std::shared_ptr<Thread> dispatcherThread_;
+};
+}
+}
+} // apache::thrift::concurrency
+
+#endif // #ifndef _THRIFT_CONCURRENCY_TIMINGWHEELTIMERMANAGER_H_
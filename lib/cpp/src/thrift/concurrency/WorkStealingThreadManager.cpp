@@ -0,0 +1,866 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/concurrency/Exception.h>
+#include <thrift/concurrency/Monitor.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+using std::shared_ptr;
+
+/**
+ * Work stealing ThreadManager
+ *
+ * Tasks are spread over a number of bounded lock-free queues, one per worker
+ * the manager was created with.  Each worker takes tasks from its own queue
+ * first and steals from the others when it runs dry, so adding and running
+ * tasks never touches the manager mutex_ while the workers are busy.
+ *
+ * Idle workers sleep on monitor_.  Rather than notifying on every add, at
+ * most one worker at a time is woken up to look for work; when it finds a
+ * task and more are pending it wakes up the next one, so a burst of adds
+ * costs one wakeup per worker actually needed rather than one per task.
+ *
+ * Should every queue fill up, tasks go to an overflow list under its own
+ * lock until the workers catch up.  The rarely used operations that look
+ * at the pending tasks (remove(), removeNextPending() and expiration) take
+ * the tasks out of the queues and put back the ones they keep.
+ */
+class WorkStealingThreadManager : public ThreadManager {
+
+public:
+  WorkStealingThreadManager(size_t workerCount, size_t pendingTaskCountMax);
+
+  ~WorkStealingThreadManager() override;
+
+  void start() override;
+  void stop() override;
+
+  ThreadManager::STATE state() const override { return state_; }
+
+  shared_ptr<ThreadFactory> threadFactory() const override {
+    Guard g(mutex_);
+    return threadFactory_;
+  }
+
+  void threadFactory(shared_ptr<ThreadFactory> value) override {
+    Guard g(mutex_);
+    if (threadFactory_ && threadFactory_->isDetached() != value->isDetached()) {
+      throw InvalidArgumentException();
+    }
+    threadFactory_ = value;
+  }
+
+  void addWorker(size_t value) override;
+
+  void removeWorker(size_t value) override;
+
+  size_t idleWorkerCount() const override { return sleepers_; }
+
+  size_t workerCount() const override {
+    Guard g(mutex_);
+    return workerCount_;
+  }
+
+  size_t pendingTaskCount() const override { return pending_; }
+
+  size_t totalTaskCount() const override {
+    Guard g(mutex_);
+    return pending_ + workerCount_ - sleepers_;
+  }
+
+  size_t pendingTaskCountMax() const override { return pendingTaskCountMax_; }
+
+  size_t expiredTaskCount() const override { return expiredCount_; }
+
+  void add(shared_ptr<Runnable> value, int64_t timeout, int64_t expiration) override;
+
+  void remove(shared_ptr<Runnable> task) override;
+
+  shared_ptr<Runnable> removeNextPending() override;
+
+  void removeExpiredTasks() override {
+    Guard g(mutex_);
+    removeExpired(false);
+  }
+
+  void setExpireCallback(ExpireCallback expireCallback) override;
+
+private:
+  class Task;
+  class TaskQueue;
+  class Worker;
+
+  /**
+   * Reserves a place for one more pending task, blocking or throwing as add()
+   * documents when there are pendingTaskCountMax_ of them already.
+   */
+  void reserve(int64_t timeout);
+
+  /**
+   * Queues a task whose place has been reserved, starting with the queue
+   * after the one this thread last used.
+   */
+  void push(Task* task);
+
+  /**
+   * Takes the next task for the worker whose own queue is home, stealing
+   * from the other queues when that one is empty.  Stealing starts with the
+   * queue victim, which is left at the one stolen from.  The caller accounts
+   * for the task with claimed().
+   */
+  Task* take(size_t home, size_t& victim);
+
+  /**
+   * Releases the place a task taken off the queues held.  The caller wakes
+   * up a thread blocked in add() if there is one.
+   */
+  void claimed(Task* task);
+
+  /**
+   * Takes every queued task off the queues, oldest first per queue.  Tasks
+   * taken off are still pending, and go back with requeue().
+   */
+  void drain(std::deque<Task*>& tasks);
+
+  void requeue(const std::deque<Task*>& tasks);
+
+  /**
+   * Wakes up one sleeping worker unless one is already looking for work.
+   */
+  void wakeWorker();
+
+  /**
+   * Remove one or more expired tasks.  The caller holds mutex_.
+   * \param[in]  justOne  if true, try to remove just one task and return
+   */
+  void removeExpired(bool justOne);
+
+  /**
+   * \returns whether it is acceptable to block, depending on the current thread id
+   */
+  bool canSleep() const;
+
+  /**
+   * Lowers the maximum worker count and blocks until enough worker threads complete
+   * to get to the new maximum worker limit.  The caller is responsible for acquiring
+   * a lock on the class mutex_.
+   */
+  void removeWorkersUnderLock(size_t value);
+
+  const size_t initialWorkerCount_;
+  const size_t pendingTaskCountMax_;
+
+  // Lock-free state, touched on every add and every task run
+  std::vector<std::unique_ptr<TaskQueue> > queues_;
+  std::atomic<size_t> pending_;         // queued tasks, plus places reserved for ones being queued
+  std::atomic<size_t> queued_;          // tasks workers can take off the queues
+  std::atomic<size_t> expiring_;        // queued tasks that have an expiration
+  std::atomic<size_t> overflowCount_;
+  std::atomic<size_t> searching_;       // workers looking for a task, including one being woken up
+  std::atomic<size_t> sleepers_;        // workers waiting on monitor_, only changed under mutex_
+  std::atomic<size_t> blockedAdders_;   // threads in add() waiting on maxMonitor_
+  std::atomic<size_t> expiredCount_;
+  std::atomic<bool> shrink_;            // workerCount_ > workerMaxCount_, workers must check in
+  std::atomic<ThreadManager::STATE> state_;
+
+  // Everything below is guarded by mutex_
+  size_t workerCount_;
+  size_t workerMaxCount_;
+  size_t signalled_;                    // sleepers notified that have not woken up yet
+  size_t nextHome_;
+  ExpireCallback expireCallback_;
+  shared_ptr<ThreadFactory> threadFactory_;
+
+  Mutex mutex_;
+  Monitor monitor_;
+  Monitor maxMonitor_;
+  Monitor workerMonitor_;       // used to synchronize changes in worker count
+
+  Mutex overflowMutex_;
+  std::deque<Task*> overflow_;
+
+  std::set<shared_ptr<Thread> > workers_;
+  std::set<shared_ptr<Thread> > deadWorkers_;
+  std::map<const Thread::id_t, shared_ptr<Thread> > idMap_;
+};
+
+class WorkStealingThreadManager::Task {
+
+public:
+  Task(shared_ptr<Runnable> runnable, int64_t expiration) : runnable_(runnable) {
+    if (expiration != 0LL) {
+      expireTime_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(expiration);
+    }
+  }
+
+  bool expires() const { return expireTime_ != std::chrono::steady_clock::time_point(); }
+
+  bool expired(const std::chrono::steady_clock::time_point& now) const {
+    return expires() && expireTime_ < now;
+  }
+
+  const shared_ptr<Runnable>& getRunnable() const { return runnable_; }
+
+private:
+  shared_ptr<Runnable> runnable_;
+  std::chrono::steady_clock::time_point expireTime_;
+};
+
+/**
+ * Bounded multi-producer multi-consumer queue of tasks.  Each slot carries a
+ * sequence number telling producers and consumers whose turn it is, so that
+ * a push or a pop is a single compare-and-swap on the tail or the head.
+ */
+class WorkStealingThreadManager::TaskQueue {
+
+public:
+  static const size_t CAPACITY = 1024;
+
+  TaskQueue() : slots_(new Slot[CAPACITY]), head_(0), tail_(0) {
+    for (size_t ix = 0; ix < CAPACITY; ix++) {
+      slots_[ix].sequence.store(ix, std::memory_order_relaxed);
+    }
+  }
+
+  /** Returns false if the queue is full. */
+  bool push(Task* task) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &slots_[pos & (CAPACITY - 1)];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      if (sequence == pos) {
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (sequence < pos) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->task = task;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Returns nullptr if the queue is empty. */
+  Task* pop() {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &slots_[pos & (CAPACITY - 1)];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      if (sequence == pos + 1) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (sequence < pos + 1) {
+        return nullptr;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    Task* task = slot->task;
+    slot->sequence.store(pos + CAPACITY, std::memory_order_release);
+    return task;
+  }
+
+private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    Task* task;
+  };
+
+  // Producers and consumers each get a cache line of their own
+  std::unique_ptr<Slot[]> slots_;
+  char pad0_[64];
+  std::atomic<size_t> head_;
+  char pad1_[64];
+  std::atomic<size_t> tail_;
+  char pad2_[64];
+};
+
+class WorkStealingThreadManager::Worker : public Runnable {
+
+public:
+  Worker(WorkStealingThreadManager* manager) : manager_(manager), home_(0), victim_(0) {}
+
+  ~Worker() override = default;
+
+private:
+  bool isActive() const {
+    return (manager_->workerCount_ <= manager_->workerMaxCount_)
+           || (manager_->state_ == JOINING && manager_->pending_ > 0);
+  }
+
+  /**
+   * Waits, holding the manager mutex_, until there are tasks to run or the
+   * worker has to go.  Either way the worker leaves counted as searching.
+   */
+  bool sleep() {
+    ++manager_->sleepers_;
+    bool active = isActive();
+    while (active && manager_->queued_ == 0) {
+      manager_->monitor_.wait();
+      active = isActive();
+
+      // Whoever woke us up counted us as searching, we count ourselves below
+      if (manager_->signalled_ > 0) {
+        manager_->signalled_--;
+        --manager_->searching_;
+      }
+    }
+    --manager_->sleepers_;
+    ++manager_->searching_;
+    return active;
+  }
+
+  /**
+   * Runs tasks without holding the manager mutex_ until there are none
+   * left, or until the worker count has been lowered.
+   */
+  void work() {
+    bool searching = true;
+    for (;;) {
+      Task* task = manager_->take(home_, victim_);
+      if (task == nullptr) {
+        if (manager_->queued_ == 0 || manager_->shrink_) {
+          break;
+        }
+        // A task is about to be queued, or was taken but is still counted
+        std::this_thread::yield();
+        continue;
+      }
+      manager_->claimed(task);
+
+      /* If a thread is blocked on add, we just dropped below the pending
+          task max so wake it up. */
+      if (manager_->blockedAdders_ > 0) {
+        Guard g(manager_->mutex_);
+        manager_->maxMonitor_.notify();
+      }
+
+      if (searching) {
+        searching = false;
+        // The last worker to stop searching hands over to a sleeping one
+        if (--manager_->searching_ == 0 && manager_->queued_ > 0) {
+          manager_->wakeWorker();
+        }
+      }
+
+      execute(task);
+
+      if (manager_->shrink_) {
+        return;
+      }
+      searching = true;
+      ++manager_->searching_;
+    }
+    if (searching) {
+      --manager_->searching_;
+    }
+  }
+
+  void execute(Task* task) {
+    std::unique_ptr<Task> owned(task);
+    if (!task->expired(std::chrono::steady_clock::now())) {
+      try {
+        task->getRunnable()->run();
+      } catch (const std::exception& e) {
+        TOutput::instance().printf("[ERROR] task->run() raised an exception: %s", e.what());
+      } catch (...) {
+        TOutput::instance().printf("[ERROR] task->run() raised an unknown exception");
+      }
+      return;
+    }
+
+    ExpireCallback expireCallback;
+    {
+      Guard g(manager_->mutex_);
+      expireCallback = manager_->expireCallback_;
+    }
+    if (expireCallback) {
+      expireCallback(task->getRunnable());
+      ++manager_->expiredCount_;
+    }
+  }
+
+public:
+  /**
+   * Worker entry point
+   *
+   * Sleeps under the manager mutex_ while there is nothing to do, and runs
+   * tasks without it otherwise.
+   */
+  void run() override {
+    Guard g(manager_->mutex_);
+
+    /**
+     * Increment worker semaphore and notify manager if worker count reached
+     * desired max
+     */
+    bool active = manager_->workerCount_ < manager_->workerMaxCount_;
+    if (active) {
+      home_ = victim_ = manager_->nextHome_++ % manager_->queues_.size();
+      if (++manager_->workerCount_ == manager_->workerMaxCount_) {
+        manager_->workerMonitor_.notify();
+      }
+    }
+
+    while (active && sleep()) {
+      manager_->mutex_.unlock();
+      work();
+      manager_->mutex_.lock();
+    }
+
+    /**
+     * Final accounting for the worker thread that is done working
+     */
+    if (active) {
+      --manager_->searching_;
+    }
+    manager_->deadWorkers_.insert(this->thread());
+    if (--manager_->workerCount_ == manager_->workerMaxCount_) {
+      manager_->shrink_ = false;
+      manager_->workerMonitor_.notify();
+    }
+  }
+
+private:
+  WorkStealingThreadManager* manager_;
+  size_t home_;
+  size_t victim_;
+};
+
+WorkStealingThreadManager::WorkStealingThreadManager(size_t workerCount,
+                                                     size_t pendingTaskCountMax)
+  : initialWorkerCount_(workerCount),
+    pendingTaskCountMax_(pendingTaskCountMax),
+    pending_(0),
+    queued_(0),
+    expiring_(0),
+    overflowCount_(0),
+    searching_(0),
+    sleepers_(0),
+    blockedAdders_(0),
+    expiredCount_(0),
+    shrink_(false),
+    state_(ThreadManager::UNINITIALIZED),
+    workerCount_(0),
+    workerMaxCount_(0),
+    signalled_(0),
+    nextHome_(0),
+    monitor_(&mutex_),
+    maxMonitor_(&mutex_),
+    workerMonitor_(&mutex_) {
+  for (size_t ix = 0; ix < (workerCount > 0 ? workerCount : 1); ix++) {
+    queues_.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+  }
+}
+
+WorkStealingThreadManager::~WorkStealingThreadManager() {
+  stop();
+  std::deque<Task*> tasks;
+  drain(tasks);
+  for (auto task : tasks) {
+    delete task;
+  }
+}
+
+void WorkStealingThreadManager::addWorker(size_t value) {
+  std::set<shared_ptr<Thread> > newThreads;
+  for (size_t ix = 0; ix < value; ix++) {
+    shared_ptr<WorkStealingThreadManager::Worker> worker
+        = std::make_shared<WorkStealingThreadManager::Worker>(this);
+    newThreads.insert(threadFactory_->newThread(worker));
+  }
+
+  Guard g(mutex_);
+  workerMaxCount_ += value;
+  workers_.insert(newThreads.begin(), newThreads.end());
+
+  for (const auto & newThread : newThreads) {
+    newThread->start();
+    idMap_.insert(std::pair<const Thread::id_t, shared_ptr<Thread> >(newThread->getId(), newThread));
+  }
+
+  while (workerCount_ != workerMaxCount_) {
+    workerMonitor_.wait();
+  }
+}
+
+void WorkStealingThreadManager::start() {
+  {
+    Guard g(mutex_);
+    if (state_ != ThreadManager::UNINITIALIZED) {
+      return;
+    }
+    if (!threadFactory_) {
+      throw InvalidArgumentException();
+    }
+    state_ = ThreadManager::STARTED;
+  }
+  addWorker(initialWorkerCount_);
+}
+
+void WorkStealingThreadManager::stop() {
+  Guard g(mutex_);
+  bool doStop = false;
+
+  if (state_ != ThreadManager::STOPPING && state_ != ThreadManager::JOINING
+      && state_ != ThreadManager::STOPPED) {
+    doStop = true;
+    state_ = ThreadManager::JOINING;
+  }
+
+  if (doStop) {
+    removeWorkersUnderLock(workerCount_);
+  }
+
+  state_ = ThreadManager::STOPPED;
+}
+
+void WorkStealingThreadManager::removeWorker(size_t value) {
+  Guard g(mutex_);
+  removeWorkersUnderLock(value);
+}
+
+void WorkStealingThreadManager::removeWorkersUnderLock(size_t value) {
+  if (value > workerMaxCount_) {
+    throw InvalidArgumentException();
+  }
+
+  workerMaxCount_ -= value;
+  if (workerCount_ != workerMaxCount_) {
+    shrink_ = true;
+    monitor_.notifyAll();
+  }
+
+  while (workerCount_ != workerMaxCount_) {
+    workerMonitor_.wait();
+  }
+
+  for (const auto & deadWorker : deadWorkers_) {
+
+    // when used with a joinable thread factory, we join the threads as we remove them
+    if (!threadFactory_->isDetached()) {
+      deadWorker->join();
+    }
+
+    idMap_.erase(deadWorker->getId());
+    workers_.erase(deadWorker);
+  }
+
+  deadWorkers_.clear();
+}
+
+bool WorkStealingThreadManager::canSleep() const {
+  const Thread::id_t id = threadFactory_->getCurrentThreadId();
+  return idMap_.find(id) == idMap_.end();
+}
+
+void WorkStealingThreadManager::add(shared_ptr<Runnable> value,
+                                    int64_t timeout,
+                                    int64_t expiration) {
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException(
+        "WorkStealingThreadManager::add ThreadManager "
+        "not started");
+  }
+
+  reserve(timeout);
+  push(new Task(value, expiration));
+
+  // If nobody is looking for work, wake up an idle worker, otherwise the
+  // worker that is will get around to this task
+  if (searching_ == 0 && sleepers_ > 0) {
+    wakeWorker();
+  }
+}
+
+void WorkStealingThreadManager::reserve(int64_t timeout) {
+  if (pendingTaskCountMax_ == 0) {
+    ++pending_;
+    return;
+  }
+
+  size_t pending = pending_;
+  for (;;) {
+    if (pending < pendingTaskCountMax_) {
+      if (pending_.compare_exchange_weak(pending, pending + 1)) {
+        return;
+      }
+      continue;
+    }
+
+    Guard g(mutex_);
+
+    // if we're at a limit, remove an expired task to see if the limit clears
+    if (pending_ >= pendingTaskCountMax_) {
+      removeExpired(true);
+    }
+
+    if (pending_ >= pendingTaskCountMax_) {
+      if (!canSleep() || timeout < 0) {
+        throw TooManyPendingTasksException();
+      }
+      ++blockedAdders_;
+      try {
+        while (pending_ >= pendingTaskCountMax_) {
+          // This is thread safe because the mutex is shared between monitors.
+          maxMonitor_.wait(timeout);
+        }
+      } catch (...) {
+        --blockedAdders_;
+        throw;
+      }
+      --blockedAdders_;
+    }
+    pending = pending_;
+  }
+}
+
+void WorkStealingThreadManager::push(Task* task) {
+  if (task->expires()) {
+    ++expiring_;
+  }
+  ++queued_;
+
+  // Spread the tasks of each adding thread over all queues
+  static thread_local size_t cursor = std::hash<std::thread::id>()(std::this_thread::get_id());
+  const size_t count = queues_.size();
+  size_t first = cursor++;
+
+  // Once tasks overflow, later ones queue up behind them until they drain
+  if (overflowCount_ == 0) {
+    for (size_t ix = 0; ix < count; ix++) {
+      if (queues_[(first + ix) % count]->push(task)) {
+        return;
+      }
+    }
+  }
+
+  Guard g(overflowMutex_);
+  overflow_.push_back(task);
+  ++overflowCount_;
+}
+
+WorkStealingThreadManager::Task* WorkStealingThreadManager::take(size_t home, size_t& victim) {
+  if (queued_ == 0) {
+    return nullptr;
+  }
+
+  Task* task = queues_[home]->pop();
+  if (task != nullptr) {
+    --queued_;
+    return task;
+  }
+
+  const size_t count = queues_.size();
+  for (size_t ix = 0; ix < count; ix++) {
+    size_t queue = (victim + ix) % count;
+    task = queues_[queue]->pop();
+    if (task != nullptr) {
+      victim = queue;
+      --queued_;
+      return task;
+    }
+  }
+
+  if (overflowCount_ > 0) {
+    Guard g(overflowMutex_);
+    if (!overflow_.empty()) {
+      task = overflow_.front();
+      overflow_.pop_front();
+      --overflowCount_;
+      --queued_;
+
+      // Move a batch over to our own queue rather than coming back for each
+      size_t moved = 0;
+      while (moved < TaskQueue::CAPACITY / 2 && !overflow_.empty()
+             && queues_[home]->push(overflow_.front())) {
+        overflow_.pop_front();
+        moved++;
+      }
+      overflowCount_ -= moved;
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+void WorkStealingThreadManager::claimed(Task* task) {
+  if (task->expires()) {
+    --expiring_;
+  }
+  --pending_;
+}
+
+void WorkStealingThreadManager::drain(std::deque<Task*>& tasks) {
+  for (auto & queue : queues_) {
+    while (Task* task = queue->pop()) {
+      tasks.push_back(task);
+    }
+  }
+
+  {
+    Guard g(overflowMutex_);
+    tasks.insert(tasks.end(), overflow_.begin(), overflow_.end());
+    overflowCount_ -= overflow_.size();
+    overflow_.clear();
+  }
+  queued_ -= tasks.size();
+}
+
+void WorkStealingThreadManager::requeue(const std::deque<Task*>& tasks) {
+  // this is always called under a lock
+  for (auto task : tasks) {
+    if (task->expires()) {
+      --expiring_;
+    }
+    push(task);
+  }
+
+  // Workers may have gone to sleep while the tasks were off the queues
+  if (!tasks.empty() && sleepers_ > 0) {
+    monitor_.notifyAll();
+  }
+}
+
+void WorkStealingThreadManager::wakeWorker() {
+  // Count the worker as searching before it wakes up, so that adds in the
+  // meantime leave the others sleeping
+  size_t expected = 0;
+  if (!searching_.compare_exchange_strong(expected, 1)) {
+    return;
+  }
+
+  Guard g(mutex_);
+  if (sleepers_ > signalled_) {
+    signalled_++;
+    monitor_.notify();
+  } else {
+    // Every worker is busy and will look for tasks when it is done
+    --searching_;
+  }
+}
+
+void WorkStealingThreadManager::remove(shared_ptr<Runnable> task) {
+  Guard g(mutex_);
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException(
+        "WorkStealingThreadManager::remove ThreadManager not "
+        "started");
+  }
+
+  std::deque<Task*> tasks;
+  drain(tasks);
+  for (auto it = tasks.begin(); it != tasks.end(); ++it) {
+    if ((*it)->getRunnable() == task) {
+      claimed(*it);
+      delete *it;
+      tasks.erase(it);
+      maxMonitor_.notify();
+      break;
+    }
+  }
+  requeue(tasks);
+}
+
+shared_ptr<Runnable> WorkStealingThreadManager::removeNextPending() {
+  Guard g(mutex_);
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException(
+        "WorkStealingThreadManager::removeNextPending "
+        "ThreadManager not started");
+  }
+
+  size_t victim = 0;
+  std::unique_ptr<Task> task(take(0, victim));
+  if (!task) {
+    return shared_ptr<Runnable>();
+  }
+
+  claimed(task.get());
+  maxMonitor_.notify();
+  return task->getRunnable();
+}
+
+void WorkStealingThreadManager::removeExpired(bool justOne) {
+  // this is always called under a lock
+  if (expiring_ == 0) {
+    return;
+  }
+
+  std::deque<Task*> tasks;
+  drain(tasks);
+  auto now = std::chrono::steady_clock::now();
+
+  for (auto it = tasks.begin(); it != tasks.end(); )
+  {
+    if ((*it)->expired(now)) {
+      if (expireCallback_) {
+        expireCallback_((*it)->getRunnable());
+      }
+      claimed(*it);
+      delete *it;
+      it = tasks.erase(it);
+      ++expiredCount_;
+      maxMonitor_.notify();
+      if (justOne) {
+        break;
+      }
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  requeue(tasks);
+}
+
+void WorkStealingThreadManager::setExpireCallback(ExpireCallback expireCallback) {
+  Guard g(mutex_);
+  expireCallback_ = expireCallback;
+}
+
+shared_ptr<ThreadManager> ThreadManager::newWorkStealingThreadManager(size_t count,
+                                                                      size_t pendingTaskCountMax) {
+  return shared_ptr<ThreadManager>(new WorkStealingThreadManager(count, pendingTaskCountMax));
+}
+}
+}
+} // apache::thrift::concurrency
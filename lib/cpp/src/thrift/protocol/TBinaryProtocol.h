@@ -21,6 +21,7 @@
 #define _THRIFT_PROTOCOL_TBINARYPROTOCOL_H_ 1
 
 #include <thrift/protocol/TProtocol.h>
+#include <thrift/protocol/TSerializedSize.h>
 #include <thrift/protocol/TVirtualProtocol.h>
 
 #include <memory>
@@ -121,6 +122,30 @@ public:
 
   inline uint32_t writeUUID(const TUuid& uuid);
 
+  inline uint32_t writeStringView(const TStringView& str) { return writeString(str); }
+
+  inline uint32_t writeBinaryView(const TStringView& str) { return writeString(str); }
+
+  /*
+   * Numbers are fixed size on the wire, so arrays of them are copied as a
+   * whole, with their bytes reversed in bulk where the byte order needs it.
+   */
+  inline uint32_t writeI16Array(const int16_t* values, uint32_t count) {
+    return writeArray(values, count);
+  }
+
+  inline uint32_t writeI32Array(const int32_t* values, uint32_t count) {
+    return writeArray(values, count);
+  }
+
+  inline uint32_t writeI64Array(const int64_t* values, uint32_t count) {
+    return writeArray(values, count);
+  }
+
+  inline uint32_t writeDoubleArray(const double* values, uint32_t count) {
+    return writeArray(values, count);
+  }
+
   /**
    * Reading functions
    */
@@ -170,8 +195,34 @@ public:
 
   inline uint32_t readUUID(TUuid& uuid);
 
+  inline uint32_t readStringView(TStringView& str);
+
+  inline uint32_t readBinaryView(TStringView& str) { return readStringView(str); }
+
+  inline uint32_t readI16Array(int16_t* values, uint32_t count) { return readArray(values, count); }
+
+  inline uint32_t readI32Array(int32_t* values, uint32_t count) { return readArray(values, count); }
+
+  inline uint32_t readI64Array(int64_t* values, uint32_t count) { return readArray(values, count); }
+
+  inline uint32_t readDoubleArray(double* values, uint32_t count) {
+    return readArray(values, count);
+  }
+
+  /**
+   * Skip a value. Strings, and lists, sets and maps of fixed-width elements,
+   * are consumed as a whole, straight from the transport's buffer where it
+   * lends them. Skipping never allocates memory, and enforces the same
+   * limits as reading the value would.
+   */
+  uint32_t skip(TType type);
+
   int getMinSerializedSize(TType type) override;
 
+  const TRawFormat* getRawFormat() const override {
+    return &TRawFormatOf<TBinaryProtocolT<TTransport, ByteOrder_> >::format;
+  }
+
   void checkReadBytesAvailable(TSet& set) override
   {
       trans_->checkReadBytesAvailable(static_cast<int64_t>(set.size_) * getMinSerializedSize(set.elemType_));
@@ -192,6 +243,19 @@ protected:
   template <typename StrType>
   uint32_t readStringBody(StrType& str, int32_t sz);
 
+  template <typename T>
+  uint32_t readArray(T* values, uint32_t count);
+
+  template <typename T>
+  uint32_t writeArray(const T* values, uint32_t count);
+
+  uint32_t skipBytes(uint32_t len);
+
+  // The size of a value of the type on the wire, or 0 if it varies
+  static uint32_t fixedWireSize(TType type);
+
+  static uint32_t fixedBodySize(uint32_t size, uint32_t width);
+
   Transport_* trans_;
 
   int32_t string_limit_;
@@ -205,6 +269,15 @@ protected:
 typedef TBinaryProtocolT<TTransport> TBinaryProtocol;
 typedef TBinaryProtocolT<TTransport, TNetworkLittleEndian> TLEBinaryProtocol;
 
+template <class Transport_, class ByteOrder_>
+struct TProtocolSizer<TBinaryProtocolT<Transport_, ByteOrder_> > {
+  typedef TBinaryProtocolSizer type;
+
+  static const TRawFormat* rawFormat() {
+    return &TRawFormatOf<TBinaryProtocolT<TTransport, ByteOrder_> >::format;
+  }
+};
+
 /**
  * Constructs binary protocol handlers
  */
@@ -21,14 +21,65 @@
 #define _THRIFT_PROTOCOL_TBINARYPROTOCOL_TCC_ 1
 
 #include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TByteSwapUtils.h>
 #include <thrift/transport/TTransportException.h>
 
+#include <algorithm>
 #include <limits>
 
 namespace apache {
 namespace thrift {
 namespace protocol {
 
+namespace detail {
+
+/*
+ * Whether ByteOrder_ reverses the bytes of values of type T. The array
+ * methods assume that it either does that or leaves them alone, as
+ * TNetworkBigEndian and TNetworkLittleEndian do.
+ */
+template <class ByteOrder_>
+inline bool wireSwaps(const int16_t*) {
+  return ByteOrder_::toWire16(0x0102) != 0x0102;
+}
+
+template <class ByteOrder_>
+inline bool wireSwaps(const int32_t*) {
+  return ByteOrder_::toWire32(0x01020304) != 0x01020304;
+}
+
+template <class ByteOrder_>
+inline bool wireSwaps(const int64_t*) {
+  return ByteOrder_::toWire64(0x0102030405060708ULL) != 0x0102030405060708ULL;
+}
+
+template <class ByteOrder_>
+inline bool wireSwaps(const double*) {
+  return wireSwaps<ByteOrder_>(static_cast<const int64_t*>(nullptr));
+}
+
+inline void byteSwapCopy(const void* src, int16_t* dst, uint32_t count) {
+  byte_swap_copy_16(src, dst, count);
+}
+
+inline void byteSwapCopy(const void* src, int32_t* dst, uint32_t count) {
+  byte_swap_copy_32(src, dst, count);
+}
+
+inline void byteSwapCopy(const void* src, int64_t* dst, uint32_t count) {
+  byte_swap_copy_64(src, dst, count);
+}
+
+inline void byteSwapCopy(const void* src, double* dst, uint32_t count) {
+  byte_swap_copy_64(src, dst, count);
+}
+
+// Arrays are moved in pieces of this many bytes, which stay in cache
+// between the copy and the byte swap
+const uint32_t ARRAY_CHUNK_BYTES = 8192;
+
+} // namespace detail
+
 template <class Transport_, class ByteOrder_>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeMessageBegin(const std::string& name,
                                                                      const TMessageType messageType,
@@ -441,6 +492,93 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readUUID(TUuid& uuid) {
   return 16;
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringView(TStringView& str) {
+  uint32_t result;
+  int32_t size;
+  result = readI32(size);
+  if (size == 0) {
+    str.clear();
+    return result;
+  }
+
+  // Refer into the transport's buffer if the whole string is there
+  if (size > 0 && (this->string_limit_ <= 0 || size <= this->string_limit_)
+      && this->trans_->isBorrowStable()) {
+    uint32_t got = size;
+    const uint8_t* borrow_buf = this->trans_->borrow(nullptr, &got);
+    if (borrow_buf) {
+      str = TStringView::borrow(borrow_buf, size);
+      this->trans_->consume(size);
+      return result + size;
+    }
+  }
+
+  std::string copy;
+  result += readStringBody(copy, size);
+  str = TStringView(std::move(copy));
+  return result;
+}
+
+/**
+ * Read count numbers, swapping them straight out of the transport's buffer
+ * when it lends them, or else in place after reading them.
+ */
+template <class Transport_, class ByteOrder_>
+template <typename T>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readArray(T* values, uint32_t count) {
+  const uint32_t chunk = detail::ARRAY_CHUNK_BYTES / sizeof(T);
+  bool swaps = detail::wireSwaps<ByteOrder_>(values);
+  uint32_t rsize = 0;
+  for (uint32_t done = 0; done < count;) {
+    uint32_t n = (std::min)(count - done, chunk);
+    uint32_t len = n * static_cast<uint32_t>(sizeof(T));
+    uint8_t* dst = reinterpret_cast<uint8_t*>(values + done);
+    if (!swaps) {
+      this->trans_->readAll(dst, len);
+    } else {
+      uint32_t got = len;
+      const uint8_t* borrow_buf = this->trans_->borrow(nullptr, &got);
+      if (borrow_buf) {
+        detail::byteSwapCopy(borrow_buf, values + done, n);
+        this->trans_->consume(len);
+      } else {
+        this->trans_->readAll(dst, len);
+        detail::byteSwapCopy(dst, values + done, n);
+      }
+    }
+    rsize += len;
+    done += n;
+  }
+  return rsize;
+}
+
+/**
+ * Write count numbers, as they are or through a buffer they are swapped
+ * into.
+ */
+template <class Transport_, class ByteOrder_>
+template <typename T>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeArray(const T* values, uint32_t count) {
+  const uint32_t chunk = detail::ARRAY_CHUNK_BYTES / sizeof(T);
+  bool swaps = detail::wireSwaps<ByteOrder_>(values);
+  T buf[detail::ARRAY_CHUNK_BYTES / sizeof(T)];
+  uint32_t wsize = 0;
+  for (uint32_t done = 0; done < count;) {
+    uint32_t n = (std::min)(count - done, chunk);
+    uint32_t len = n * static_cast<uint32_t>(sizeof(T));
+    if (!swaps) {
+      this->trans_->write(reinterpret_cast<const uint8_t*>(values + done), len);
+    } else {
+      detail::byteSwapCopy(values + done, buf, n);
+      this->trans_->write(reinterpret_cast<const uint8_t*>(buf), len);
+    }
+    wsize += len;
+    done += n;
+  }
+  return wsize;
+}
+
 template <class Transport_, class ByteOrder_>
 template <typename StrType>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringBody(StrType& str, int32_t size) {
@@ -477,6 +615,145 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringBody(StrType& str,
   return (uint32_t)size;
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::skip(TType type) {
+  TInputRecursionTracker tracker(*this);
+
+  switch (type) {
+  case T_STRING: {
+    int32_t size;
+    uint32_t result = readI32(size);
+    if (size < 0) {
+      throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+    }
+    if (this->string_limit_ > 0 && size > this->string_limit_) {
+      throw TProtocolException(TProtocolException::SIZE_LIMIT);
+    }
+    return result + skipBytes(static_cast<uint32_t>(size));
+  }
+  case T_STRUCT: {
+    // Field headers are read directly, there is no name to fill in
+    uint32_t result = 0;
+    while (true) {
+      int8_t ftype;
+      result += readByte(ftype);
+      if (ftype == T_STOP) {
+        break;
+      }
+      int16_t fid;
+      result += readI16(fid);
+      result += skip(static_cast<TType>(ftype));
+    }
+    return result;
+  }
+  case T_MAP: {
+    TType keyType;
+    TType valType;
+    uint32_t size;
+    uint32_t result = readMapBegin(keyType, valType, size);
+    uint32_t width = fixedWireSize(keyType) && fixedWireSize(valType)
+                         ? fixedWireSize(keyType) + fixedWireSize(valType)
+                         : 0;
+    if (width) {
+      result += skipBytes(fixedBodySize(size, width));
+    } else {
+      for (uint32_t i = 0; i < size; i++) {
+        result += skip(keyType);
+        result += skip(valType);
+      }
+    }
+    return result + readMapEnd();
+  }
+  case T_SET:
+  case T_LIST: {
+    TType elemType;
+    uint32_t size;
+    uint32_t result = type == T_SET ? readSetBegin(elemType, size) : readListBegin(elemType, size);
+    uint32_t width = fixedWireSize(elemType);
+    if (width) {
+      result += skipBytes(fixedBodySize(size, width));
+    } else {
+      for (uint32_t i = 0; i < size; i++) {
+        result += skip(elemType);
+      }
+    }
+    return result + (type == T_SET ? readSetEnd() : readListEnd());
+  }
+  default:
+    if (uint32_t width = fixedWireSize(type)) {
+      return skipBytes(width);
+    }
+    break;
+  }
+
+  throw TProtocolException(TProtocolException::INVALID_DATA, "invalid TType");
+}
+
+/**
+ * Skip len bytes, consuming them in place if the transport lends them.
+ * Otherwise whatever the transport has buffered is consumed in place, and
+ * only the rest goes through a small buffer on the stack.
+ */
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::skipBytes(uint32_t len) {
+  if (len == 0) {
+    return 0;
+  }
+  uint32_t got = len;
+  if (this->trans_->borrow(nullptr, &got)) {
+    this->trans_->consume(len);
+    return len;
+  }
+
+  this->trans_->checkReadBytesAvailable(len);
+  uint8_t buf[256];
+  for (uint32_t left = len; left > 0;) {
+    got = 1;
+    if (this->trans_->borrow(nullptr, &got)) {
+      uint32_t n = (std::min)(left, got);
+      this->trans_->consume(n);
+      left -= n;
+    } else {
+      uint32_t n = (std::min)(left, static_cast<uint32_t>(sizeof(buf)));
+      this->trans_->readAll(buf, n);
+      left -= n;
+    }
+  }
+  return len;
+}
+
+/**
+ * The size of a container body of size elements of width bytes each.
+ */
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::fixedBodySize(uint32_t size, uint32_t width) {
+  uint64_t bytes = static_cast<uint64_t>(size) * width;
+  if (bytes > (std::numeric_limits<uint32_t>::max)()) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  return static_cast<uint32_t>(bytes);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::fixedWireSize(TType type) {
+  switch (type) {
+  case T_BOOL:
+  case T_BYTE:
+    return 1;
+  case T_I16:
+    return 2;
+  case T_I32:
+    return 4;
+  case T_I64:
+  case T_DOUBLE:
+    return 8;
+  case T_UUID:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
 // Return the minimum number of bytes a type will consume on the wire
 template <class Transport_, class ByteOrder_>
 int TBinaryProtocolT<Transport_, ByteOrder_>::getMinSerializedSize(TType type)
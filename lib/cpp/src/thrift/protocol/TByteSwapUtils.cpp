@@ -0,0 +1,171 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TByteSwapUtils.h>
+
+#include <cstddef>
+#include <cstring>
+
+// pshufb (SSSE3) and its AVX2 form are not part of the x86-64 baseline, so
+// they are compiled per function and only used when the CPU has them
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define THRIFT_BYTESWAP_X86 1
+#include <immintrin.h>
+#endif
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+namespace {
+
+inline uint16_t swap(uint16_t x) {
+  return static_cast<uint16_t>((x >> 8) | (x << 8));
+}
+
+inline uint32_t swap(uint32_t x) {
+  return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+}
+
+inline uint64_t swap(uint64_t x) {
+  return (static_cast<uint64_t>(swap(static_cast<uint32_t>(x))) << 32)
+         | swap(static_cast<uint32_t>(x >> 32));
+}
+
+template <typename UInt>
+void swap_scalar(const uint8_t* src, uint8_t* dst, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    UInt value;
+    std::memcpy(&value, src + i * sizeof(UInt), sizeof(UInt));
+    value = swap(value);
+    std::memcpy(dst + i * sizeof(UInt), &value, sizeof(UInt));
+  }
+}
+
+#ifdef THRIFT_BYTESWAP_X86
+
+// pshufb masks reversing each 2, 4 or 8 byte group of a 16 byte vector
+inline __m128i swap_mask(uint16_t*) {
+  return _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+}
+
+inline __m128i swap_mask(uint32_t*) {
+  return _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+}
+
+inline __m128i swap_mask(uint64_t*) {
+  return _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+}
+
+template <typename UInt>
+__attribute__((target("ssse3"))) void swap_ssse3(const uint8_t* src, uint8_t* dst, size_t count) {
+  const __m128i mask = swap_mask(static_cast<UInt*>(nullptr));
+  size_t bytes = count * sizeof(UInt);
+  size_t i = 0;
+  for (; i + 64 <= bytes; i += 64) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 32));
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 48));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(a, mask));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 16), _mm_shuffle_epi8(b, mask));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 32), _mm_shuffle_epi8(c, mask));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 48), _mm_shuffle_epi8(d, mask));
+  }
+  for (; i + 16 <= bytes; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(a, mask));
+  }
+  swap_scalar<UInt>(src + i, dst + i, (bytes - i) / sizeof(UInt));
+}
+
+// The AVX2 shuffle works within each 16 byte half, which suits us fine
+template <typename UInt>
+__attribute__((target("avx2"))) void swap_avx2(const uint8_t* src, uint8_t* dst, size_t count) {
+  const __m256i mask = _mm256_broadcastsi128_si256(swap_mask(static_cast<UInt*>(nullptr)));
+  size_t bytes = count * sizeof(UInt);
+  size_t i = 0;
+  for (; i + 128 <= bytes; i += 128) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 64));
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 96));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(a, mask));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), _mm256_shuffle_epi8(b, mask));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 64), _mm256_shuffle_epi8(c, mask));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 96), _mm256_shuffle_epi8(d, mask));
+  }
+  for (; i + 32 <= bytes; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(a, mask));
+  }
+  swap_scalar<UInt>(src + i, dst + i, (bytes - i) / sizeof(UInt));
+}
+
+#endif // THRIFT_BYTESWAP_X86
+
+typedef void (*Swapper)(const uint8_t*, uint8_t*, size_t);
+
+template <typename UInt>
+Swapper pick_swapper() {
+#ifdef THRIFT_BYTESWAP_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return swap_avx2<UInt>;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    return swap_ssse3<UInt>;
+  }
+#endif
+  return swap_scalar<UInt>;
+}
+
+template <typename UInt>
+void swap_copy(const void* src, void* dst, uint32_t count) {
+  static const Swapper swapper = pick_swapper<UInt>();
+  swapper(static_cast<const uint8_t*>(src), static_cast<uint8_t*>(dst), count);
+}
+} // namespace
+
+void byte_swap_16(void* data, uint32_t count) {
+  swap_copy<uint16_t>(data, data, count);
+}
+
+void byte_swap_32(void* data, uint32_t count) {
+  swap_copy<uint32_t>(data, data, count);
+}
+
+void byte_swap_64(void* data, uint32_t count) {
+  swap_copy<uint64_t>(data, data, count);
+}
+
+void byte_swap_copy_16(const void* src, void* dst, uint32_t count) {
+  swap_copy<uint16_t>(src, dst, count);
+}
+
+void byte_swap_copy_32(const void* src, void* dst, uint32_t count) {
+  swap_copy<uint32_t>(src, dst, count);
+}
+
+void byte_swap_copy_64(const void* src, void* dst, uint32_t count) {
+  swap_copy<uint64_t>(src, dst, count);
+}
+}
+}
+} // apache::thrift::protocol
@@ -0,0 +1,47 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TBYTESWAPUTILS_H_
+#define _THRIFT_PROTOCOL_TBYTESWAPUTILS_H_
+
+#include <stdint.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+// Bulk byte order reversal, as needed for arrays of numbers in
+// TBinaryProtocol. These use SSSE3 or AVX2, picked at runtime, where
+// available.
+
+// reverses the bytes of each of the count 2 (4, 8) byte values at data
+// data need not be aligned
+void byte_swap_16(void* data, uint32_t count);
+void byte_swap_32(void* data, uint32_t count);
+void byte_swap_64(void* data, uint32_t count);
+
+// the same, from src into dst; these must either not overlap or be equal
+void byte_swap_copy_16(const void* src, void* dst, uint32_t count);
+void byte_swap_copy_32(const void* src, void* dst, uint32_t count);
+void byte_swap_copy_64(const void* src, void* dst, uint32_t count);
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TBYTESWAPUTILS_H_
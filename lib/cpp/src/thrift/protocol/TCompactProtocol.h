@@ -20,10 +20,12 @@
 #ifndef _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_H_
 #define _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_H_ 1
 
+#include <thrift/protocol/TSerializedSize.h>
 #include <thrift/protocol/TVirtualProtocol.h>
 
 #include <stack>
 #include <memory>
+#include <vector>
 
 namespace apache {
 namespace thrift {
@@ -67,10 +69,11 @@ protected:
 
   /**
    * Used to keep track of the last field for the current and previous structs,
-   * so we can do the delta stuff.
+   * so we can do the delta stuff. A vector keeps its capacity, so nesting
+   * structs allocates no memory once it has been as deep before.
    */
 
-  std::stack<int16_t> lastField_;
+  std::stack<int16_t, std::vector<int16_t> > lastField_;
   int16_t lastFieldId_;
 
 public:
@@ -142,8 +145,20 @@ public:
 
   uint32_t writeUUID(const TUuid& str);
 
+  uint32_t writeStringView(const TStringView& str) { return writeBinaryView(str); }
+
+  uint32_t writeBinaryView(const TStringView& str);
+
+  uint32_t writeI32Array(const int32_t* values, uint32_t count);
+
+  uint32_t writeI64Array(const int64_t* values, uint32_t count);
+
   int getMinSerializedSize(TType type) override;
 
+  const TRawFormat* getRawFormat() const override {
+    return &TRawFormatOf<TCompactProtocolT<TTransport> >::format;
+  }
+
   void checkReadBytesAvailable(TSet& set) override
   {
       trans_->checkReadBytesAvailable(static_cast<int64_t>(set.size_) * getMinSerializedSize(set.elemType_));
@@ -176,6 +191,7 @@ protected:
                                   const int16_t fieldId,
                                   int8_t typeOverride);
   uint32_t writeCollectionBegin(const TType elemType, int32_t size);
+  uint32_t writeBinaryBody(const char* data, size_t size);
   uint32_t writeVarint32(uint32_t n);
   uint32_t writeVarint64(uint64_t n);
   uint64_t i64ToZigzag(const int64_t l);
@@ -217,6 +233,22 @@ public:
 
   uint32_t readUUID(TUuid& str);
 
+  uint32_t readStringView(TStringView& str) { return readBinaryView(str); }
+
+  uint32_t readBinaryView(TStringView& str);
+
+  uint32_t readI32Array(int32_t* values, uint32_t count);
+
+  uint32_t readI64Array(int64_t* values, uint32_t count);
+
+  /**
+   * Skip a value. Strings, and lists, sets and maps of fixed-width elements,
+   * are consumed as a whole, straight from the transport's buffer where it
+   * lends them, as are runs of varints. Skipping never allocates memory,
+   * and enforces the same limits as reading the value would.
+   */
+  uint32_t skip(TType type);
+
   /*
    *These methods are here for the struct to call, but don't have any wire
    * encoding.
@@ -233,6 +265,13 @@ protected:
   int32_t zigzagToI32(uint32_t n);
   int64_t zigzagToI64(uint64_t n);
   TType getTType(int8_t type);
+  uint32_t skipBytes(uint32_t len);
+  uint32_t skipVarints(uint32_t count);
+
+  // The size of a container element of the type on the wire, or 0 if it varies
+  static uint32_t fixedElementSize(TType type);
+  static bool isVarintType(TType type);
+  static uint32_t fixedBodySize(uint32_t size, uint32_t width);
 
   // Buffer for reading strings, save for the lifetime of the protocol to
   // avoid memory churn allocating memory on every string read
@@ -244,6 +283,15 @@ protected:
 
 typedef TCompactProtocolT<TTransport> TCompactProtocol;
 
+template <class Transport_>
+struct TProtocolSizer<TCompactProtocolT<Transport_> > {
+  typedef TCompactProtocolSizer type;
+
+  static const TRawFormat* rawFormat() {
+    return &TRawFormatOf<TCompactProtocolT<TTransport> >::format;
+  }
+};
+
 /**
  * Constructs compact protocol handlers
  */
@@ -19,10 +19,12 @@
 #ifndef _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_TCC_
 #define _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_TCC_ 1
 
+#include <algorithm>
 #include <limits>
 #include <cstdlib>
 
 #include "thrift/config.h"
+#include <thrift/protocol/TVarintUtils.h>
 
 /*
  * TCompactProtocol::i*ToZigzag depend on the fact that the right shift
@@ -251,6 +253,38 @@ uint32_t TCompactProtocolT<Transport_>::writeI64(const int64_t i64) {
   return writeVarint64(i64ToZigzag(i64));
 }
 
+/**
+ * Write i32 list elements, encoding them in bulk through a buffer on the
+ * stack.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI32Array(const int32_t* values, uint32_t count) {
+  uint8_t buf[256 * 5];
+  uint32_t wsize = 0;
+  for (uint32_t done = 0; done < count;) {
+    uint32_t n = (std::min)(count - done, 256u);
+    uint32_t len = varint_encode_zigzag32(values + done, n, buf);
+    trans_->write(buf, len);
+    wsize += len;
+    done += n;
+  }
+  return wsize;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI64Array(const int64_t* values, uint32_t count) {
+  uint8_t buf[256 * 10];
+  uint32_t wsize = 0;
+  for (uint32_t done = 0; done < count;) {
+    uint32_t n = (std::min)(count - done, 256u);
+    uint32_t len = varint_encode_zigzag64(values + done, n, buf);
+    trans_->write(buf, len);
+    wsize += len;
+    done += n;
+  }
+  return wsize;
+}
+
 /**
  * Write a double to the wire as 8 bytes.
  */
@@ -275,17 +309,12 @@ uint32_t TCompactProtocolT<Transport_>::writeString(const std::string& str) {
 
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::writeBinary(const std::string& str) {
-  if(str.size() > (std::numeric_limits<uint32_t>::max)())
-    throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  auto ssize = static_cast<uint32_t>(str.size());
-  uint32_t wsize = writeVarint32(ssize) ;
-  // checking ssize + wsize > uint_max, but we don't want to overflow while checking for overflows.
-  // transforming the check to ssize > uint_max - wsize
-  if(ssize > (std::numeric_limits<uint32_t>::max)() - wsize)
-    throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  wsize += ssize;
-  trans_->write(reinterpret_cast<const uint8_t*>(str.data()), ssize);
-  return wsize;
+  return writeBinaryBody(str.data(), str.size());
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeBinaryView(const TStringView& str) {
+  return writeBinaryBody(str.data(), str.size());
 }
 
 /**
@@ -301,6 +330,24 @@ uint32_t TCompactProtocolT<Transport_>::writeUUID(const TUuid& uuid) {
 // Internal Writing methods
 //
 
+/**
+ * Write a length-prefixed byte[] to the wire.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeBinaryBody(const char* data, size_t size) {
+  if(size > (std::numeric_limits<uint32_t>::max)())
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  auto ssize = static_cast<uint32_t>(size);
+  uint32_t wsize = writeVarint32(ssize) ;
+  // checking ssize + wsize > uint_max, but we don't want to overflow while checking for overflows.
+  // transforming the check to ssize > uint_max - wsize
+  if(ssize > (std::numeric_limits<uint32_t>::max)() - wsize)
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  wsize += ssize;
+  trans_->write(reinterpret_cast<const uint8_t*>(data), ssize);
+  return wsize;
+}
+
 /**
  * The workhorse of writeFieldBegin. It has the option of doing a
  * 'type override' of the type header. This is used specifically in the
@@ -666,6 +713,53 @@ uint32_t TCompactProtocolT<Transport_>::readI64(int64_t& i64) {
   return rsize;
 }
 
+/**
+ * Read i32 list elements, decoding as many as possible in bulk straight out
+ * of the transport's buffer. A value that straddles the end of the buffer,
+ * or a transport that lends nothing, falls back to readI32().
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI32Array(int32_t* values, uint32_t count) {
+  uint32_t rsize = 0;
+  uint32_t done = 0;
+  while (done < count) {
+    uint32_t decoded = 0;
+    uint32_t avail = 1;
+    const uint8_t* buf = trans_->borrow(nullptr, &avail);
+    if (buf) {
+      uint32_t used = varint_decode_zigzag32(buf, avail, values + done, count - done, &decoded);
+      trans_->consume(used);
+      rsize += used;
+      done += decoded;
+    }
+    if (decoded == 0) {
+      rsize += readI32(values[done++]);
+    }
+  }
+  return rsize;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI64Array(int64_t* values, uint32_t count) {
+  uint32_t rsize = 0;
+  uint32_t done = 0;
+  while (done < count) {
+    uint32_t decoded = 0;
+    uint32_t avail = 1;
+    const uint8_t* buf = trans_->borrow(nullptr, &avail);
+    if (buf) {
+      uint32_t used = varint_decode_zigzag64(buf, avail, values + done, count - done, &decoded);
+      trans_->consume(used);
+      rsize += used;
+      done += decoded;
+    }
+    if (decoded == 0) {
+      rsize += readI64(values[done++]);
+    }
+  }
+  return rsize;
+}
+
 /**
  * No magic here - just read a double off the wire.
  */
@@ -731,6 +825,51 @@ uint32_t TCompactProtocolT<Transport_>::readBinary(std::string& str) {
 }
 
 
+/**
+ * Read a byte[] from the wire, referring into the transport's buffer if it
+ * can be borrowed.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBinaryView(TStringView& str) {
+  int32_t rsize = 0;
+  int32_t size;
+
+  rsize += readVarint32(size);
+  // Catch empty string case
+  if (size == 0) {
+    str.clear();
+    return rsize;
+  }
+
+  // Catch error cases
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && size > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  if (trans_->isBorrowStable()) {
+    uint32_t got = static_cast<uint32_t>(size);
+    const uint8_t* borrow_buf = trans_->borrow(nullptr, &got);
+    if (borrow_buf) {
+      str = TStringView::borrow(borrow_buf, static_cast<uint32_t>(size));
+      trans_->consume(static_cast<uint32_t>(size));
+      return rsize + static_cast<uint32_t>(size);
+    }
+  }
+
+  // Check against MaxMessageSize before alloc
+  trans_->checkReadBytesAvailable(static_cast<uint32_t>(size));
+
+  std::string copy;
+  copy.resize(size);
+  trans_->readAll(reinterpret_cast<uint8_t*>(&copy[0]), size);
+  str = TStringView(std::move(copy));
+
+  return rsize + static_cast<uint32_t>(size);
+}
+
 /**
  * Read a TUuid from the wire.
  */
@@ -853,6 +992,208 @@ TType TCompactProtocolT<Transport_>::getTType(int8_t type) {
   }
 }
 
+/**
+ * Skip a value of the given type, consuming string and binary bodies in
+ * place and packed runs of fixed width elements in one step.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skip(TType type) {
+  TInputRecursionTracker tracker(*this);
+
+  switch (type) {
+  case T_BOOL: {
+    // A bool field was read along with its header
+    bool value;
+    return readBool(value);
+  }
+  case T_I16:
+  case T_I32:
+  case T_I64: {
+    int64_t value;
+    return readVarint64(value);
+  }
+  case T_STRING: {
+    int32_t size;
+    uint32_t rsize = readVarint32(size);
+    if (size < 0) {
+      throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+    }
+    if (string_limit_ > 0 && size > string_limit_) {
+      throw TProtocolException(TProtocolException::SIZE_LIMIT);
+    }
+    return rsize + skipBytes(static_cast<uint32_t>(size));
+  }
+  case T_STRUCT: {
+    // Field ids are only needed to decode the deltas of the fields that are
+    // read, so the headers are read directly and lastField_ is left alone.
+    uint32_t rsize = 0;
+    while (true) {
+      int8_t byte;
+      rsize += readByte(byte);
+      auto ctype = static_cast<int8_t>(byte & 0x0f);
+      if (ctype == T_STOP) {
+        break;
+      }
+      if ((byte & 0xf0) == 0) {
+        int16_t fid;
+        rsize += readI16(fid);
+      }
+      // The value of a bool field is in its header
+      if (ctype != detail::compact::CT_BOOLEAN_TRUE && ctype != detail::compact::CT_BOOLEAN_FALSE) {
+        rsize += skip(getTType(ctype));
+      }
+    }
+    return rsize;
+  }
+  case T_MAP: {
+    TType keyType;
+    TType valType;
+    uint32_t size;
+    uint32_t rsize = readMapBegin(keyType, valType, size);
+    uint32_t width = fixedElementSize(keyType) && fixedElementSize(valType)
+                         ? fixedElementSize(keyType) + fixedElementSize(valType)
+                         : 0;
+    if (width) {
+      rsize += skipBytes(fixedBodySize(size, width));
+    } else if (isVarintType(keyType) && isVarintType(valType)) {
+      rsize += skipVarints(fixedBodySize(size, 2));
+    } else {
+      for (uint32_t i = 0; i < size; i++) {
+        rsize += skip(keyType);
+        rsize += skip(valType);
+      }
+    }
+    return rsize + readMapEnd();
+  }
+  case T_SET:
+  case T_LIST: {
+    TType elemType;
+    uint32_t size;
+    uint32_t rsize = readListBegin(elemType, size);
+    uint32_t width = fixedElementSize(elemType);
+    if (width) {
+      rsize += skipBytes(fixedBodySize(size, width));
+    } else if (isVarintType(elemType)) {
+      rsize += skipVarints(size);
+    } else {
+      for (uint32_t i = 0; i < size; i++) {
+        rsize += skip(elemType);
+      }
+    }
+    return rsize + readListEnd();
+  }
+  default:
+    if (uint32_t width = fixedElementSize(type)) {
+      return skipBytes(width);
+    }
+    break;
+  }
+
+  throw TProtocolException(TProtocolException::INVALID_DATA, "invalid TType");
+}
+
+/**
+ * Skip len bytes, consuming them in place if the transport lends them.
+ * Otherwise whatever the transport has buffered is consumed in place, and
+ * only the rest goes through a small buffer on the stack.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skipBytes(uint32_t len) {
+  if (len == 0) {
+    return 0;
+  }
+  uint32_t got = len;
+  if (trans_->borrow(nullptr, &got)) {
+    trans_->consume(len);
+    return len;
+  }
+
+  trans_->checkReadBytesAvailable(len);
+  uint8_t buf[256];
+  for (uint32_t left = len; left > 0;) {
+    got = 1;
+    if (trans_->borrow(nullptr, &got)) {
+      uint32_t n = (std::min)(left, got);
+      trans_->consume(n);
+      left -= n;
+    } else {
+      uint32_t n = (std::min)(left, static_cast<uint32_t>(sizeof(buf)));
+      trans_->readAll(buf, n);
+      left -= n;
+    }
+  }
+  return len;
+}
+
+/**
+ * Skip count varints. Those that end in the bytes the transport lends are
+ * found by their last byte and consumed together.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skipVarints(uint32_t count) {
+  uint32_t rsize = 0;
+  while (count > 0) {
+    uint32_t got = 1;
+    const uint8_t* borrowed = trans_->borrow(nullptr, &got);
+    uint32_t end = 0;
+    if (borrowed != nullptr) {
+      uint32_t run = 0;
+      for (uint32_t i = 0; i < got && count > 0; i++) {
+        if (!(borrowed[i] & 0x80)) {
+          end = i + 1;
+          run = 0;
+          count--;
+        } else if (UNLIKELY(++run == 10)) {
+          throw TProtocolException(TProtocolException::INVALID_DATA, "Variable-length int over 10 bytes.");
+        }
+      }
+    }
+
+    if (end > 0) {
+      trans_->consume(end);
+      rsize += end;
+    } else {
+      // The next varint is not lent in whole
+      int64_t value;
+      rsize += readVarint64(value);
+      count--;
+    }
+  }
+  return rsize;
+}
+
+/**
+ * The size of a container body of size elements of width bytes each.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::fixedBodySize(uint32_t size, uint32_t width) {
+  uint64_t bytes = static_cast<uint64_t>(size) * width;
+  if (bytes > (std::numeric_limits<uint32_t>::max)()) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  return static_cast<uint32_t>(bytes);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::fixedElementSize(TType type) {
+  switch (type) {
+  case T_BOOL:
+  case T_BYTE:
+    return 1;
+  case T_DOUBLE:
+    return 8;
+  case T_UUID:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+template <class Transport_>
+bool TCompactProtocolT<Transport_>::isVarintType(TType type) {
+  return type == T_I16 || type == T_I32 || type == T_I64;
+}
+
 // Return the minimum number of bytes a type will consume on the wire
 template <class Transport_>
 int TCompactProtocolT<Transport_>::getMinSerializedSize(TType type)
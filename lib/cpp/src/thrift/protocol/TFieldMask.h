@@ -0,0 +1,81 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TFIELDMASK_H_
+#define _THRIFT_PROTOCOL_TFIELDMASK_H_ 1
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * A set of field ids, which the readPartial() methods generated with the
+ * cpp:read_partial option decode while they skip all other fields.
+ *
+ * Looking an id up is a bit test, so that a reader scanning many records
+ * pays next to nothing for the mask itself.
+ */
+class TFieldMask {
+public:
+  TFieldMask() = default;
+
+  TFieldMask(std::initializer_list<int16_t> ids) {
+    for (int16_t id : ids) {
+      add(id);
+    }
+  }
+
+  TFieldMask& add(int16_t id) {
+    uint32_t index = bitIndex(id);
+    if (index / 64 >= bits_.size()) {
+      bits_.resize(index / 64 + 1, 0);
+    }
+    bits_[index / 64] |= uint64_t(1) << (index % 64);
+    return *this;
+  }
+
+  TFieldMask& remove(int16_t id) {
+    uint32_t index = bitIndex(id);
+    if (index / 64 < bits_.size()) {
+      bits_[index / 64] &= ~(uint64_t(1) << (index % 64));
+    }
+    return *this;
+  }
+
+  bool contains(int16_t id) const {
+    uint32_t index = bitIndex(id);
+    return index / 64 < bits_.size() && ((bits_[index / 64] >> (index % 64)) & 1) != 0;
+  }
+
+private:
+  // Negative ids, which the compiler gives fields declared without one, come
+  // after all positive ones.
+  static uint32_t bitIndex(int16_t id) { return static_cast<uint16_t>(id); }
+
+  std::vector<uint64_t> bits_;
+};
+}
+}
+} // apache::thrift::protocol
+
+#endif // _THRIFT_PROTOCOL_TFIELDMASK_H_
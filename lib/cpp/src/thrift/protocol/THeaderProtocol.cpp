@@ -150,6 +150,30 @@ uint32_t THeaderProtocol::writeUUID(const TUuid& uuid) {
   return proto_->writeUUID(uuid);
 }
 
+uint32_t THeaderProtocol::writeStringView(const TStringView& str) {
+  return proto_->writeStringView(str);
+}
+
+uint32_t THeaderProtocol::writeBinaryView(const TStringView& str) {
+  return proto_->writeBinaryView(str);
+}
+
+uint32_t THeaderProtocol::writeI32Array(const int32_t* values, uint32_t count) {
+  return proto_->writeI32Array(values, count);
+}
+
+uint32_t THeaderProtocol::writeI64Array(const int64_t* values, uint32_t count) {
+  return proto_->writeI64Array(values, count);
+}
+
+uint32_t THeaderProtocol::writeI16Array(const int16_t* values, uint32_t count) {
+  return proto_->writeI16Array(values, count);
+}
+
+uint32_t THeaderProtocol::writeDoubleArray(const double* values, uint32_t count) {
+  return proto_->writeDoubleArray(values, count);
+}
+
 /**
  * Reading functions
  */
@@ -254,6 +278,34 @@ uint32_t THeaderProtocol::readBinary(std::string& binary) {
 uint32_t THeaderProtocol::readUUID(TUuid& uuid) {
   return proto_->readUUID(uuid);
 }
+
+uint32_t THeaderProtocol::skip(TType type) {
+  return proto_->skip(type);
+}
+
+uint32_t THeaderProtocol::readStringView(TStringView& str) {
+  return proto_->readStringView(str);
+}
+
+uint32_t THeaderProtocol::readBinaryView(TStringView& str) {
+  return proto_->readBinaryView(str);
+}
+
+uint32_t THeaderProtocol::readI32Array(int32_t* values, uint32_t count) {
+  return proto_->readI32Array(values, count);
+}
+
+uint32_t THeaderProtocol::readI64Array(int64_t* values, uint32_t count) {
+  return proto_->readI64Array(values, count);
+}
+
+uint32_t THeaderProtocol::readI16Array(int16_t* values, uint32_t count) {
+  return proto_->readI16Array(values, count);
+}
+
+uint32_t THeaderProtocol::readDoubleArray(double* values, uint32_t count) {
+  return proto_->readDoubleArray(values, count);
+}
 }
 }
 } // apache::thrift::protocol
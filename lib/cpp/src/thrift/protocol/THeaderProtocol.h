@@ -137,6 +137,18 @@ public:
 
   uint32_t writeUUID(const TUuid& uuid);
 
+  uint32_t writeStringView(const TStringView& str);
+
+  uint32_t writeBinaryView(const TStringView& str);
+
+  uint32_t writeI32Array(const int32_t* values, uint32_t count);
+
+  uint32_t writeI64Array(const int64_t* values, uint32_t count);
+
+  uint32_t writeI16Array(const int16_t* values, uint32_t count);
+
+  uint32_t writeDoubleArray(const double* values, uint32_t count);
+
   /**
    * Reading functions
    */
@@ -185,6 +197,20 @@ public:
 
   uint32_t readUUID(TUuid& uuid);
 
+  uint32_t readStringView(TStringView& str);
+
+  uint32_t readBinaryView(TStringView& str);
+
+  uint32_t readI32Array(int32_t* values, uint32_t count);
+
+  uint32_t readI64Array(int64_t* values, uint32_t count);
+
+  uint32_t readI16Array(int16_t* values, uint32_t count);
+
+  uint32_t readDoubleArray(double* values, uint32_t count);
+
+  uint32_t skip(TType type);
+
 protected:
   std::shared_ptr<THeaderTransport> trans_;
 
@@ -21,11 +21,31 @@
 
 #include <boost/locale.hpp>
 
+#include <algorithm>
+#include <cerrno>
+#include <clocale>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
-#include <locale>
-#include <sstream>
 #include <stdexcept>
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define THRIFT_JSON_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define THRIFT_JSON_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define THRIFT_JSON_NEON 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #include <thrift/protocol/TBase64Utils.h>
 #include <thrift/transport/TTransportException.h>
@@ -227,6 +247,188 @@ const static uint8_t kEscapeCharVals[7] = {
     '\t',
 };
 
+namespace {
+
+// The index of the lowest set bit of the non-zero mask
+inline unsigned lowestBit(uint32_t mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+#if !defined(THRIFT_JSON_AVX2) && !defined(THRIFT_JSON_SSE2) && !defined(THRIFT_JSON_NEON)
+const uint64_t kOnes = 0x0101010101010101ULL;
+const uint64_t kHighBits = 0x8080808080808080ULL;
+
+// Whether any of the 8 bytes in word is zero
+inline bool hasZeroByte(uint64_t word) {
+  return ((word - kOnes) & ~word & kHighBits) != 0;
+}
+#endif
+
+/**
+ * The first byte in [p, end) that is a quote or a backslash, or also a
+ * control character if controls is set, or end if there is none. Looks at
+ * 16 or 32 bytes at a time where there are vector instructions, and at 8
+ * otherwise.
+ */
+const uint8_t* findJSONSpecial(const uint8_t* p, const uint8_t* end, bool controls) {
+#if defined(THRIFT_JSON_AVX2)
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i lastControl = _mm256_set1_epi8(0x1f);
+  for (; end - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash));
+    if (controls) {
+      special = _mm256_or_si256(special, _mm256_cmpeq_epi8(_mm256_min_epu8(v, lastControl), v));
+    }
+    auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(special));
+    if (mask != 0) {
+      return p + lowestBit(mask);
+    }
+  }
+#elif defined(THRIFT_JSON_SSE2)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i lastControl = _mm_set1_epi8(0x1f);
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash));
+    if (controls) {
+      special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_min_epu8(v, lastControl), v));
+    }
+    auto mask = static_cast<uint32_t>(_mm_movemask_epi8(special));
+    if (mask != 0) {
+      return p + lowestBit(mask);
+    }
+  }
+#elif defined(THRIFT_JSON_NEON)
+  const uint8x16_t quote = vdupq_n_u8('"');
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  const uint8x16_t space = vdupq_n_u8(0x20);
+  for (; end - p >= 16; p += 16) {
+    uint8x16_t v = vld1q_u8(p);
+    uint8x16_t special = vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash));
+    if (controls) {
+      special = vorrq_u8(special, vcltq_u8(v, space));
+    }
+    if (vmaxvq_u8(special) != 0) {
+      break;
+    }
+  }
+#else
+  for (; end - p >= 8; p += 8) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    // Any byte below 0x20 leaves a high bit behind when 0x20 is subtracted
+    bool special = hasZeroByte(word ^ (kOnes * '"')) || hasZeroByte(word ^ (kOnes * '\\'))
+                   || (controls && ((word - kOnes * 0x20) & ~word & kHighBits) != 0);
+    if (special) {
+      break;
+    }
+  }
+#endif
+  for (; p != end; ++p) {
+    if (*p == '"' || *p == '\\' || (controls && *p < 0x20)) {
+      return p;
+    }
+  }
+  return end;
+}
+
+// The first byte in [p, end) that is not ASCII, or end if there is none
+const uint8_t* skipASCII(const uint8_t* p, const uint8_t* end) {
+#if defined(THRIFT_JSON_AVX2)
+  for (; end - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+    if (mask != 0) {
+      return p + lowestBit(mask);
+    }
+  }
+#elif defined(THRIFT_JSON_SSE2)
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    auto mask = static_cast<uint32_t>(_mm_movemask_epi8(v));
+    if (mask != 0) {
+      return p + lowestBit(mask);
+    }
+  }
+#elif defined(THRIFT_JSON_NEON)
+  for (; end - p >= 16; p += 16) {
+    if (vmaxvq_u8(vld1q_u8(p)) >= 0x80) {
+      break;
+    }
+  }
+#else
+  for (; end - p >= 8; p += 8) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    if ((word & kHighBits) != 0) {
+      break;
+    }
+  }
+#endif
+  while (p != end && *p < 0x80) {
+    ++p;
+  }
+  return p;
+}
+
+/**
+ * Whether [p, end) is well-formed UTF-8: no overlong forms, no surrogates
+ * and nothing past U+10FFFF (see table 3-7 of the Unicode standard).
+ */
+bool isValidUtf8(const uint8_t* p, const uint8_t* end) {
+  while ((p = skipASCII(p, end)) != end) {
+    uint8_t lead = *p++;
+    int continuations;
+    uint8_t low = 0x80;
+    uint8_t high = 0xbf;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+      continuations = 1;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+      continuations = 2;
+      if (lead == 0xe0) {
+        low = 0xa0;
+      } else if (lead == 0xed) {
+        high = 0x9f;
+      }
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+      continuations = 3;
+      if (lead == 0xf0) {
+        low = 0x90;
+      } else if (lead == 0xf4) {
+        high = 0x8f;
+      }
+    } else {
+      return false;
+    }
+    if (end - p < continuations || *p < low || *p > high) {
+      return false;
+    }
+    for (++p; --continuations > 0; ++p) {
+      if (*p < 0x80 || *p > 0xbf) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void checkUtf8(const std::string& str) {
+  const auto* p = reinterpret_cast<const uint8_t*>(str.data());
+  if (!isValidUtf8(p, p + str.size())) {
+    throw TProtocolException(TProtocolException::INVALID_DATA, "Invalid UTF-8 in string.");
+  }
+}
+}
+
 // Static helper functions
 
 // Read 1 character from the transport trans and verify that it is the
@@ -405,7 +607,8 @@ TJSONProtocol::TJSONProtocol(std::shared_ptr<TTransport> ptrans)
   : TVirtualProtocol<TJSONProtocol>(ptrans),
     trans_(ptrans.get()),
     context_(new TJSONContext()),
-    reader_(*ptrans) {
+    reader_(*ptrans),
+    validateUtf8_(false) {
 }
 
 TJSONProtocol::~TJSONProtocol() = default;
@@ -461,13 +664,27 @@ uint32_t TJSONProtocol::writeJSONChar(uint8_t ch) {
 // Write out the contents of the string str as a JSON string, escaping
 // characters as appropriate.
 uint32_t TJSONProtocol::writeJSONString(const std::string& str) {
+  if (validateUtf8_) {
+    checkUtf8(str);
+  }
   uint32_t result = context_->write(*trans_);
   result += 2; // For quotes
   trans_->write(&kJSONStringDelimiter, 1);
-  std::string::const_iterator iter(str.begin());
-  std::string::const_iterator end(str.end());
-  while (iter != end) {
-    result += writeJSONChar(*iter++);
+  const auto* p = reinterpret_cast<const uint8_t*>(str.data());
+  const uint8_t* end = p + str.size();
+  while (true) {
+    // Characters that need no escaping are written a run at a time
+    const uint8_t* special = findJSONSpecial(p, end, true);
+    auto len = static_cast<uint32_t>(special - p);
+    if (len > 0) {
+      trans_->write(p, len);
+      result += len;
+    }
+    if (special == end) {
+      break;
+    }
+    result += writeJSONChar(*special);
+    p = special + 1;
   }
   trans_->write(&kJSONStringDelimiter, 1);
   return result;
@@ -501,78 +718,294 @@ uint32_t TJSONProtocol::writeJSONBase64(const std::string& str) {
   return result;
 }
 
+namespace {
+
+// Room for any int64_t, and for the shortest form of any double, such as
+// "-2.2250738585072014e-308"
+const int kMaxNumberChars = 32;
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+
+char* formatInteger(char* buf, int64_t num) {
+  return std::to_chars(buf, buf + kMaxNumberChars, num).ptr;
+}
+
+// The shortest form that reads back as the same double
+char* formatDouble(char* buf, double num) {
+  return std::to_chars(buf, buf + kMaxNumberChars, num).ptr;
+}
+
+template <typename T>
+bool parseNumber(const char* first, const char* last, T& num) {
+  std::from_chars_result result = std::from_chars(first, last, num);
+  return result.ec == std::errc() && result.ptr == last;
+}
+
+#else
+
+char* formatInteger(char* buf, int64_t num) {
+  uint64_t magnitude = num < 0 ? 0 - static_cast<uint64_t>(num) : static_cast<uint64_t>(num);
+  char digits[20];
+  char* first = digits + sizeof(digits);
+  do {
+    *--first = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (num < 0) {
+    *buf++ = '-';
+  }
+  size_t len = digits + sizeof(digits) - first;
+  std::memcpy(buf, first, len);
+  return buf + len;
+}
+
+template <typename T>
+bool parseNumber(const char* first, const char* last, T& num) {
+  bool negative = first != last && *first == '-';
+  if (negative) {
+    ++first;
+  }
+  if (first == last || (negative && !std::numeric_limits<T>::is_signed)) {
+    return false;
+  }
+  const uint64_t limit = negative ? 0 - static_cast<uint64_t>((std::numeric_limits<T>::min)())
+                                  : static_cast<uint64_t>((std::numeric_limits<T>::max)());
+  uint64_t magnitude = 0;
+  for (; first != last; ++first) {
+    unsigned digit = static_cast<unsigned char>(*first) - '0';
+    if (digit > 9 || magnitude > (limit - digit) / 10) {
+      return false;
+    }
+    magnitude = magnitude * 10 + digit;
+  }
+  num = negative ? static_cast<T>(0 - magnitude) : static_cast<T>(magnitude);
+  return true;
+}
+
+// strtod() reads the decimal point of the current locale
+template <>
+bool parseNumber(const char* first, const char* last, double& num) {
+  if (first == last) {
+    return false;
+  }
+  char buf[64];
+  std::string copy;
+  auto len = static_cast<size_t>(last - first);
+  char* str = buf;
+  if (len >= sizeof(buf)) {
+    copy.assign(first, last);
+    str = &copy[0];
+  } else {
+    std::memcpy(buf, first, len);
+    buf[len] = '\0';
+  }
+  const char* point = std::localeconv()->decimal_point;
+  if (point[0] != '.' && point[0] != '\0' && point[1] == '\0') {
+    std::replace(str, str + len, '.', point[0]);
+  }
+  char* end;
+  errno = 0;
+  double value = std::strtod(str, &end);
+  if (end != str + len || (errno == ERANGE && (value == 0 || std::isinf(value)))) {
+    return false;
+  }
+  num = value;
+  return true;
+}
+
+// Rounds the decimal digits [first, last) up in place, and returns true if
+// they were all nines and are now zeros
+bool roundDigitsUp(char* first, char* last) {
+  while (last != first) {
+    if (*--last != '9') {
+      ++*last;
+      return false;
+    }
+    *last = '0';
+  }
+  return true;
+}
+
+// The significant digits of the positive num, rounded to precision of them
+// and without trailing zeros, and the decimal exponent of the first one
+int decimalDigits(double num, int precision, char* digits, int& exponent) {
+  char sci[kMaxNumberChars];
+  // "d.ddde+xx", in whatever notation the locale has for the point
+  std::snprintf(sci, sizeof(sci), "%.*e", precision - 1, num);
+  const char* p = sci;
+  int count = 0;
+  digits[count++] = *p++;
+  for (++p; *p >= '0' && *p <= '9'; ++p) {
+    digits[count++] = *p;
+  }
+  exponent = std::atoi(p + 1);
+  while (count > 1 && digits[count - 1] == '0') {
+    --count;
+  }
+  return count;
+}
+
+// Whether digits * 10^(exponent - count + 1) reads back as num
+bool roundTrips(const char* digits, int count, int exponent, double num) {
+  char str[kMaxNumberChars];
+  std::memcpy(str, digits, count);
+  int len = count + std::snprintf(str + count, sizeof(str) - count, "e%d", exponent - count + 1);
+  double value;
+  return parseNumber(str, str + len, value) && value == num;
+}
+
+// The same as std::to_chars(): the fewest digits that read back as the
+// same double, closest to it where there is a choice, laid out as "%f"
+// would or as "%e" would, whichever is shorter
+char* formatDouble(char* buf, double num) {
+  if (std::signbit(num)) {
+    *buf++ = '-';
+    num = -num;
+  }
+
+  // The correctly rounded 17 digits always read back as num, and give the
+  // 15 and 16 digit candidates by rounding them again, unless what is cut
+  // off is exactly half a unit and the true value could be on either side
+  char digits[17];
+  int exponent;
+  int count = decimalDigits(num, 17, digits, exponent);
+  std::fill(digits + count, digits + 17, '0');
+  for (int precision = 15; precision < 17; ++precision) {
+    char candidate[17];
+    int candidateExponent = exponent;
+    int candidateCount;
+    char* cut = digits + precision;
+    bool half = *cut == '5' && std::count(cut + 1, digits + 17, '0') == digits + 16 - cut;
+    if (half) {
+      candidateCount = decimalDigits(num, precision, candidate, candidateExponent);
+    } else {
+      std::copy(digits, cut, candidate);
+      if (*cut >= '5' && roundDigitsUp(candidate, candidate + precision)) {
+        candidate[0] = '1';
+        ++candidateExponent;
+      }
+      candidateCount = precision;
+      while (candidateCount > 1 && candidate[candidateCount - 1] == '0') {
+        --candidateCount;
+      }
+    }
+    if (roundTrips(candidate, candidateCount, candidateExponent, num)) {
+      std::copy(candidate, candidate + candidateCount, digits);
+      count = candidateCount;
+      exponent = candidateExponent;
+      break;
+    }
+  }
+  while (count > 1 && digits[count - 1] == '0') {
+    --count;
+  }
+
+  int exponentDigits = exponent <= -100 || exponent >= 100 ? 3 : 2;
+  int scientificLength = count + (count > 1 ? 1 : 0) + 2 + exponentDigits;
+  int fixedLength = exponent < 0 ? 1 - exponent + count
+                                 : (count > exponent + 1 ? count + 1 : exponent + 1);
+  if (fixedLength <= scientificLength) {
+    if (exponent < 0) {
+      *buf++ = '0';
+      *buf++ = '.';
+      buf = std::fill_n(buf, -exponent - 1, '0');
+      return std::copy(digits, digits + count, buf);
+    }
+    if (count > exponent + 1) {
+      buf = std::copy(digits, digits + exponent + 1, buf);
+      *buf++ = '.';
+      return std::copy(digits + exponent + 1, digits + count, buf);
+    }
+    buf = std::copy(digits, digits + count, buf);
+    return std::fill_n(buf, exponent + 1 - count, '0');
+  }
+  *buf++ = digits[0];
+  if (count > 1) {
+    *buf++ = '.';
+    buf = std::copy(digits + 1, digits + count, buf);
+  }
+  return buf + std::snprintf(buf, kMaxNumberChars, "e%c%02d", exponent < 0 ? '-' : '+',
+                             exponent < 0 ? -exponent : exponent);
+}
+
+#endif
+
+template <>
+bool parseNumber(const char* first, const char* last, bool& num) {
+  if (last - first != 1 || (*first != '0' && *first != '1')) {
+    return false;
+  }
+  num = *first == '1';
+  return true;
+}
+
+// Parses a number the way JSON writes it, with an optional leading '+'
+template <typename T>
+bool parseJSONNumber(const std::string& str, T& num) {
+  const char* first = str.data();
+  const char* last = first + str.size();
+  // Quoted numbers must look like unquoted ones, not "inf", " 1" or "0x1"
+  for (const char* p = first; p != last; ++p) {
+    if (!isJSONNumeric(static_cast<uint8_t>(*p))) {
+      return false;
+    }
+  }
+  if (last - first > 1 && *first == '+' && first[1] != '-' && first[1] != '+') {
+    ++first;
+  }
+  return parseNumber(first, last, num);
+}
+}
+
 // Convert the given integer type to a JSON number, or a string
 // if the context requires it (eg: key in a map pair).
 template <typename NumberType>
 uint32_t TJSONProtocol::writeJSONInteger(NumberType num) {
   uint32_t result = context_->write(*trans_);
-  std::string val(to_string(num));
-  bool escapeNum = context_->escapeNum();
-  if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
-  }
-  if (val.length() > (std::numeric_limits<uint32_t>::max)())
-    throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  trans_->write((const uint8_t*)val.c_str(), static_cast<uint32_t>(val.length()));
-  result += static_cast<uint32_t>(val.length());
-  if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+  char buf[kMaxNumberChars + 2];
+  char* first = buf + 1;
+  char* last = formatInteger(first, static_cast<int64_t>(num));
+  if (context_->escapeNum()) {
+    *--first = kJSONStringDelimiter;
+    *last++ = kJSONStringDelimiter;
   }
-  return result;
-}
-
-namespace {
-std::string doubleToString(double d) {
-  std::ostringstream str;
-  str.imbue(std::locale::classic());
-  const std::streamsize max_digits10 = 2 + std::numeric_limits<double>::digits10;
-  str.precision(max_digits10);
-  str << d;
-  return str.str();
-}
+  auto len = static_cast<uint32_t>(last - first);
+  trans_->write(reinterpret_cast<const uint8_t*>(first), len);
+  return result + len;
 }
 
 // Convert the given double to a JSON string, which is either the number,
 // "NaN" or "Infinity" or "-Infinity".
 uint32_t TJSONProtocol::writeJSONDouble(double num) {
   uint32_t result = context_->write(*trans_);
-  std::string val;
+  char buf[kMaxNumberChars + 2];
+  char* first = buf + 1;
+  char* last;
 
   bool special = false;
   switch (std::fpclassify(num)) {
-  case FP_INFINITE:
-    if (std::signbit(num)) {
-      val = kThriftNegativeInfinity;
-    } else {
-      val = kThriftInfinity;
-    }
+  case FP_INFINITE: {
+    const std::string& val = std::signbit(num) ? kThriftNegativeInfinity : kThriftInfinity;
+    last = std::copy(val.begin(), val.end(), first);
     special = true;
     break;
+  }
   case FP_NAN:
-    val = kThriftNan;
+    last = std::copy(kThriftNan.begin(), kThriftNan.end(), first);
     special = true;
     break;
   default:
-    val = doubleToString(num);
+    last = formatDouble(first, num);
     break;
   }
 
-  bool escapeNum = special || context_->escapeNum();
-  if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+  if (special || context_->escapeNum()) {
+    *--first = kJSONStringDelimiter;
+    *last++ = kJSONStringDelimiter;
   }
-  if (val.length() > (std::numeric_limits<uint32_t>::max)())
-    throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  trans_->write((const uint8_t*)val.c_str(), static_cast<uint32_t>(val.length()));
-  result += static_cast<uint32_t>(val.length());
-  if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
-  }
-  return result;
+  auto len = static_cast<uint32_t>(last - first);
+  trans_->write(reinterpret_cast<const uint8_t*>(first), len);
+  return result + len;
 }
 
 uint32_t TJSONProtocol::writeJSONObjectStart() {
@@ -759,6 +1192,25 @@ uint32_t TJSONProtocol::readJSONString(std::string& str, bool skipContext) {
   uint8_t ch;
   str.clear();
   while (true) {
+    // Take the characters up to the next quote or backslash straight from
+    // the transport's buffer where it has one
+    uint32_t avail;
+    const uint8_t* buf = reader_.borrow(&avail);
+    if (buf != nullptr) {
+      auto len = static_cast<uint32_t>(findJSONSpecial(buf, buf + avail, false) - buf);
+      if (len > 0) {
+        if (!codeunits.empty()) {
+          throw TProtocolException(TProtocolException::INVALID_DATA,
+                                   "Missing UTF-16 low surrogate pair.");
+        }
+        result += len;
+        if (static_cast<int64_t>(result) > maxSize) {
+          throw TTransportException(TTransportException::END_OF_FILE, "MaxMessageSize reached");
+        }
+        str.append(reinterpret_cast<const char*>(buf), len);
+        reader_.consume(len);
+      }
+    }
     ch = reader_.read();
     ++result;
     if (static_cast<int64_t>(result) > maxSize) {
@@ -808,6 +1260,9 @@ uint32_t TJSONProtocol::readJSONString(std::string& str, bool skipContext) {
     throw TProtocolException(TProtocolException::INVALID_DATA,
                              "Missing UTF-16 low surrogate pair.");
   }
+  if (validateUtf8_) {
+    checkUtf8(str);
+  }
   return result;
 }
 
@@ -864,19 +1319,6 @@ uint32_t TJSONProtocol::readJSONNumericChars(std::string& str) {
   return result;
 }
 
-namespace {
-template <typename T>
-T fromString(const std::string& s) {
-  T t;
-  std::istringstream str(s);
-  str.imbue(std::locale::classic());
-  str >> t;
-  if (str.bad() || !str.eof())
-    throw std::runtime_error(s);
-  return t;
-}
-}
-
 // Reads a sequence of characters and assembles them into a number,
 // returning them via num
 template <typename NumberType>
@@ -887,9 +1329,7 @@ uint32_t TJSONProtocol::readJSONInteger(NumberType& num) {
   }
   std::string str;
   result += readJSONNumericChars(str);
-  try {
-    num = fromString<NumberType>(str);
-  } catch (const std::runtime_error&) {
+  if (!parseJSONNumber(str, num)) {
     throw TProtocolException(TProtocolException::INVALID_DATA,
                              "Expected numeric value; got \"" + str + "\"");
   }
@@ -918,9 +1358,7 @@ uint32_t TJSONProtocol::readJSONDouble(double& num) {
         throw TProtocolException(TProtocolException::INVALID_DATA,
                                      "Numeric data unexpectedly quoted");
       }
-      try {
-        num = fromString<double>(str);
-      } catch (const std::runtime_error&) {
+      if (!parseJSONNumber(str, num)) {
         throw TProtocolException(TProtocolException::INVALID_DATA,
                                      "Expected numeric value; got \"" + str + "\"");
       }
@@ -931,9 +1369,7 @@ uint32_t TJSONProtocol::readJSONDouble(double& num) {
       readJSONSyntaxChar(kJSONStringDelimiter);
     }
     result += readJSONNumericChars(str);
-    try {
-      num = fromString<double>(str);
-    } catch (const std::runtime_error&) {
+    if (!parseJSONNumber(str, num)) {
       throw TProtocolException(TProtocolException::INVALID_DATA,
                                    "Expected numeric value; got \"" + str + "\"");
     }
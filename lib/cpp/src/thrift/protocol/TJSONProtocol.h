@@ -83,15 +83,13 @@ class TJSONContext;
  *    version #, the message name, the message type, and the sequence ID as
  *    the first 4 elements.
  *
- * More discussion of the double handling is probably warranted. The aim of
- * the current implementation is to match as closely as possible the behavior
- * of Java's Double.toString(), which has no precision loss.  Implementors in
- * other languages should strive to achieve that where possible. I have not
- * yet verified whether std::istringstream::operator>>, which is doing that
- * work for me in C++, loses any precision, but I am leaving this as a future
- * improvement. I may try to provide a C component for this, so that other
- * languages could bind to the same underlying implementation for maximum
- * consistency.
+ * Doubles are written in the shortest form that reads back as the same
+ * value, as std::to_chars() does, which like Java's Double.toString() has no
+ * precision loss. Numbers are formatted and parsed the same way regardless
+ * of the locale.
+ *
+ * JSON text is UTF-8, but strings are written and read byte for byte as they
+ * always have been, unless setValidateUtf8() asks for them to be checked.
  *
  */
 class TJSONProtocol : public TVirtualProtocol<TJSONProtocol> {
@@ -100,6 +98,13 @@ public:
 
   ~TJSONProtocol() override;
 
+  /**
+   * Whether strings that are not valid UTF-8 are rejected with INVALID_DATA
+   * when they are written or read, rather than passed through. Off by
+   * default.
+   */
+  void setValidateUtf8(bool validate) { validateUtf8_ = validate; }
+
 private:
   void pushContext(std::shared_ptr<TJSONContext> c);
 
@@ -289,6 +294,20 @@ public:
       return data_;
     }
 
+    /**
+     * The bytes that follow, straight from the transport's buffer, or
+     * nullptr if the transport has none to lend. Read them with consume().
+     */
+    const uint8_t* borrow(uint32_t* len) {
+      if (hasData_) {
+        return nullptr;
+      }
+      *len = 1;
+      return trans_->borrow(nullptr, len);
+    }
+
+    void consume(uint32_t len) { trans_->consume(len); }
+
   private:
     TTransport* trans_;
     bool hasData_;
@@ -301,6 +320,7 @@ private:
   std::stack<std::shared_ptr<TJSONContext> > contexts_;
   std::shared_ptr<TJSONContext> context_;
   LookaheadReader reader_;
+  bool validateUtf8_;
 };
 
 /**
@@ -308,13 +328,18 @@ private:
  */
 class TJSONProtocolFactory : public TProtocolFactory {
 public:
-  TJSONProtocolFactory() = default;
+  TJSONProtocolFactory(bool validateUtf8 = false) : validateUtf8_(validateUtf8) {}
 
   ~TJSONProtocolFactory() override = default;
 
   std::shared_ptr<TProtocol> getProtocol(std::shared_ptr<TTransport> trans) override {
-    return std::shared_ptr<TProtocol>(new TJSONProtocol(trans));
+    std::shared_ptr<TJSONProtocol> protocol(new TJSONProtocol(trans));
+    protocol->setValidateUtf8(validateUtf8_);
+    return protocol;
   }
+
+private:
+  bool validateUtf8_;
 };
 }
 }
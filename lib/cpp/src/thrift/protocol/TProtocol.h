@@ -49,6 +49,7 @@
 #include <thrift/protocol/TList.h>
 #include <thrift/protocol/TSet.h>
 #include <thrift/protocol/TMap.h>
+#include <thrift/TStringView.h>
 #include <thrift/TUuid.h>
 
 #include <memory>
@@ -207,6 +208,36 @@ namespace protocol {
 
 using apache::thrift::transport::TTransport;
 
+class TProtocol;
+
+/**
+ * Identifies the encoding a protocol writes structs and containers in, so
+ * that bytes read by one protocol can be copied verbatim to another one using
+ * the same encoding, or decoded later (see TLazy). Formats are compared by
+ * address.
+ */
+struct TRawFormat {
+  /**
+   * Creates a protocol that reads and writes this format on the transport.
+   */
+  std::shared_ptr<TProtocol> (*newProtocol)(std::shared_ptr<TTransport> trans);
+};
+
+/**
+ * The TRawFormat of the encoding of a protocol class.
+ */
+template <class Protocol_>
+struct TRawFormatOf {
+  static std::shared_ptr<TProtocol> newProtocol(std::shared_ptr<TTransport> trans) {
+    return std::make_shared<Protocol_>(trans);
+  }
+
+  static const TRawFormat format;
+};
+
+template <class Protocol_>
+const TRawFormat TRawFormatOf<Protocol_>::format = {&TRawFormatOf<Protocol_>::newProtocol};
+
 /**
  * Abstract class for a thrift protocol driver. These are all the methods that
  * a protocol must implement. Essentially, there must be some way of reading
@@ -278,6 +309,53 @@ public:
 
   virtual uint32_t writeUUID_virt(const TUuid& uuid) = 0;
 
+  /*
+   * The TStringView variants default to going through a std::string, so
+   * that only protocols able to do better need to implement them.
+   */
+  virtual uint32_t writeStringView_virt(const TStringView& str) {
+    return writeString_virt(str.str());
+  }
+
+  virtual uint32_t writeBinaryView_virt(const TStringView& str) {
+    return writeBinary_virt(str.str());
+  }
+
+  /*
+   * Likewise the array variants default to one element at a time.
+   */
+  virtual uint32_t writeI16Array_virt(const int16_t* values, uint32_t count) {
+    uint32_t wsize = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      wsize += writeI16_virt(values[i]);
+    }
+    return wsize;
+  }
+
+  virtual uint32_t writeI32Array_virt(const int32_t* values, uint32_t count) {
+    uint32_t wsize = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      wsize += writeI32_virt(values[i]);
+    }
+    return wsize;
+  }
+
+  virtual uint32_t writeI64Array_virt(const int64_t* values, uint32_t count) {
+    uint32_t wsize = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      wsize += writeI64_virt(values[i]);
+    }
+    return wsize;
+  }
+
+  virtual uint32_t writeDoubleArray_virt(const double* values, uint32_t count) {
+    uint32_t wsize = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      wsize += writeDouble_virt(values[i]);
+    }
+    return wsize;
+  }
+
   uint32_t writeMessageBegin(const std::string& name,
                              const TMessageType messageType,
                              const int32_t seqid) {
@@ -390,6 +468,41 @@ public:
     return writeUUID_virt(uuid);
   }
 
+  uint32_t writeStringView(const TStringView& str) {
+    T_VIRTUAL_CALL();
+    return writeStringView_virt(str);
+  }
+
+  uint32_t writeBinaryView(const TStringView& str) {
+    T_VIRTUAL_CALL();
+    return writeBinaryView_virt(str);
+  }
+
+  /**
+   * Writes the elements of a list or set of i16, i32, i64 or double, after
+   * writeListBegin() or writeSetBegin(). The same as writing them one by
+   * one, but protocols can encode them in bulk.
+   */
+  uint32_t writeI16Array(const int16_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI16Array_virt(values, count);
+  }
+
+  uint32_t writeI32Array(const int32_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI32Array_virt(values, count);
+  }
+
+  uint32_t writeI64Array(const int64_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI64Array_virt(values, count);
+  }
+
+  uint32_t writeDoubleArray(const double* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeDoubleArray_virt(values, count);
+  }
+
   /**
    * Reading functions
    */
@@ -440,6 +553,52 @@ public:
 
   virtual uint32_t readUUID_virt(TUuid& uuid) = 0;
 
+  virtual uint32_t readStringView_virt(TStringView& str) {
+    std::string tmp;
+    uint32_t result = readString_virt(tmp);
+    str = TStringView(std::move(tmp));
+    return result;
+  }
+
+  virtual uint32_t readBinaryView_virt(TStringView& str) {
+    std::string tmp;
+    uint32_t result = readBinary_virt(tmp);
+    str = TStringView(std::move(tmp));
+    return result;
+  }
+
+  virtual uint32_t readI16Array_virt(int16_t* values, uint32_t count) {
+    uint32_t rsize = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      rsize += readI16_virt(values[i]);
+    }
+    return rsize;
+  }
+
+  virtual uint32_t readI32Array_virt(int32_t* values, uint32_t count) {
+    uint32_t rsize = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      rsize += readI32_virt(values[i]);
+    }
+    return rsize;
+  }
+
+  virtual uint32_t readI64Array_virt(int64_t* values, uint32_t count) {
+    uint32_t rsize = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      rsize += readI64_virt(values[i]);
+    }
+    return rsize;
+  }
+
+  virtual uint32_t readDoubleArray_virt(double* values, uint32_t count) {
+    uint32_t rsize = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      rsize += readDouble_virt(values[i]);
+    }
+    return rsize;
+  }
+
   uint32_t readMessageBegin(std::string& name, TMessageType& messageType, int32_t& seqid) {
     T_VIRTUAL_CALL();
     return readMessageBegin_virt(name, messageType, seqid);
@@ -545,6 +704,45 @@ public:
     return readUUID_virt(uuid);
   }
 
+  /**
+   * Reads a string into a TStringView, which refers into the transport's
+   * read buffer when the protocol supports it. See TStringView for how long
+   * such a value stays valid.
+   */
+  uint32_t readStringView(TStringView& str) {
+    T_VIRTUAL_CALL();
+    return readStringView_virt(str);
+  }
+
+  uint32_t readBinaryView(TStringView& str) {
+    T_VIRTUAL_CALL();
+    return readBinaryView_virt(str);
+  }
+
+  /**
+   * Reads count elements of a list or set of i16, i32, i64 or double into
+   * values, after readListBegin() or readSetBegin().
+   */
+  uint32_t readI16Array(int16_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI16Array_virt(values, count);
+  }
+
+  uint32_t readI32Array(int32_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI32Array_virt(values, count);
+  }
+
+  uint32_t readI64Array(int64_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI64Array_virt(values, count);
+  }
+
+  uint32_t readDoubleArray(double* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readDoubleArray_virt(values, count);
+  }
+
   /*
    * std::vector is specialized for bool, and its elements are individual bits
    * rather than bools.   We need to define a different version of readBool()
@@ -596,6 +794,13 @@ public:
     return 0;
   }
 
+  /**
+   * The encoding of the values this protocol reads and writes, if a value can
+   * be moved between two protocols of the same format as its raw bytes.
+   * Returns nullptr for protocols that keep state between values.
+   */
+  virtual const TRawFormat* getRawFormat() const { return nullptr; }
+
 protected:
   TProtocol(std::shared_ptr<TTransport> ptrans)
     : ptrans_(ptrans), input_recursion_depth_(0), output_recursion_depth_(0),
@@ -0,0 +1,304 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TPROTOCOLTRANSCODER_H_
+#define _THRIFT_PROTOCOL_TPROTOCOLTRANSCODER_H_ 1
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include <thrift/TStringView.h>
+#include <thrift/protocol/TProtocol.h>
+#include <thrift/protocol/TProtocolException.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * Copies messages and values from one protocol to another as they are
+ * read, without decoding them into generated types or needing their IDL,
+ * e.g. to turn TBinaryProtocol requests into TCompactProtocol ones.
+ *
+ * Every read call on the source is answered by the matching write call on
+ * the sink. Strings are handed over as a TStringView into the source
+ * transport's read buffer where it keeps the whole message around (see
+ * TTransport::isBorrowStable(), e.g. TMemoryBuffer), and numeric lists and
+ * sets in chunks on the stack, so that transcoding between such transports
+ * allocates no memory once the sink's buffer has grown to fit a message.
+ *
+ * The protocol types can be TProtocol, or the concrete protocol classes
+ * to avoid the virtual calls. Strings and binaries look the same on the
+ * wire, so both are transcoded as strings: protocols that encode binary
+ * differently, such as TJSONProtocol, do not round trip binary fields.
+ * Empty maps from TCompactProtocol have no key and value types, so they
+ * are written with T_STOP for both.
+ *
+ * The sink's transport is not flushed.
+ */
+template <class InProtocol_ = TProtocol, class OutProtocol_ = TProtocol>
+class TProtocolTranscoder {
+public:
+  TProtocolTranscoder(std::shared_ptr<InProtocol_> source, std::shared_ptr<OutProtocol_> sink)
+    : source_(source),
+      sink_(sink),
+      borrowStrings_(source->getTransport()->isBorrowStable()) {}
+
+  /**
+   * Transcode a message: its envelope, the struct that holds the call's
+   * arguments, result or exception, and its end. Returns the number of
+   * bytes read from the source.
+   */
+  uint32_t transcodeMessage() {
+    TMessageType messageType;
+    int32_t seqid;
+    uint32_t rsize = source_->readMessageBegin(name_, messageType, seqid);
+    sink_->writeMessageBegin(name_, messageType, seqid);
+    rsize += transcode(T_STRUCT);
+    rsize += source_->readMessageEnd();
+    sink_->writeMessageEnd();
+    return rsize;
+  }
+
+  /**
+   * Transcode a single value of the given type. Returns the number of bytes
+   * read from the source.
+   */
+  uint32_t transcode(TType type) {
+    TInputRecursionTracker tracker(*source_);
+
+    switch (type) {
+    case T_BOOL: {
+      bool value;
+      uint32_t rsize = source_->readBool(value);
+      sink_->writeBool(value);
+      return rsize;
+    }
+    case T_BYTE: {
+      int8_t value;
+      uint32_t rsize = source_->readByte(value);
+      sink_->writeByte(value);
+      return rsize;
+    }
+    case T_I16: {
+      int16_t value;
+      uint32_t rsize = source_->readI16(value);
+      sink_->writeI16(value);
+      return rsize;
+    }
+    case T_I32: {
+      int32_t value;
+      uint32_t rsize = source_->readI32(value);
+      sink_->writeI32(value);
+      return rsize;
+    }
+    case T_I64: {
+      int64_t value;
+      uint32_t rsize = source_->readI64(value);
+      sink_->writeI64(value);
+      return rsize;
+    }
+    case T_DOUBLE: {
+      double value;
+      uint32_t rsize = source_->readDouble(value);
+      sink_->writeDouble(value);
+      return rsize;
+    }
+    case T_UUID: {
+      TUuid value;
+      uint32_t rsize = source_->readUUID(value);
+      sink_->writeUUID(value);
+      return rsize;
+    }
+    case T_STRING: {
+      if (borrowStrings_) {
+        TStringView value;
+        uint32_t rsize = source_->readStringView(value);
+        sink_->writeStringView(value);
+        return rsize;
+      }
+      // Reuses the capacity of the last string
+      uint32_t rsize = source_->readString(value_);
+      sink_->writeString(value_);
+      return rsize;
+    }
+    case T_STRUCT: {
+      TType ftype;
+      int16_t fid;
+      uint32_t rsize = source_->readStructBegin(name_);
+      sink_->writeStructBegin(name_.c_str());
+      while (true) {
+        rsize += source_->readFieldBegin(name_, ftype, fid);
+        if (ftype == T_STOP) {
+          sink_->writeFieldStop();
+          break;
+        }
+        checkType(ftype);
+        sink_->writeFieldBegin(name_.c_str(), ftype, fid);
+        rsize += transcode(ftype);
+        rsize += source_->readFieldEnd();
+        sink_->writeFieldEnd();
+      }
+      rsize += source_->readStructEnd();
+      sink_->writeStructEnd();
+      return rsize;
+    }
+    case T_MAP: {
+      TType keyType;
+      TType valType;
+      uint32_t size;
+      uint32_t rsize = source_->readMapBegin(keyType, valType, size);
+      if (size > 0) {
+        checkType(keyType);
+        checkType(valType);
+      }
+      sink_->writeMapBegin(keyType, valType, size);
+      for (uint32_t i = 0; i < size; i++) {
+        rsize += transcode(keyType);
+        rsize += transcode(valType);
+      }
+      rsize += source_->readMapEnd();
+      sink_->writeMapEnd();
+      return rsize;
+    }
+    case T_SET: {
+      TType elemType;
+      uint32_t size;
+      uint32_t rsize = source_->readSetBegin(elemType, size);
+      if (size > 0) {
+        checkType(elemType);
+      }
+      sink_->writeSetBegin(elemType, size);
+      rsize += transcodeElements(elemType, size);
+      rsize += source_->readSetEnd();
+      sink_->writeSetEnd();
+      return rsize;
+    }
+    case T_LIST: {
+      TType elemType;
+      uint32_t size;
+      uint32_t rsize = source_->readListBegin(elemType, size);
+      if (size > 0) {
+        checkType(elemType);
+      }
+      sink_->writeListBegin(elemType, size);
+      rsize += transcodeElements(elemType, size);
+      rsize += source_->readListEnd();
+      sink_->writeListEnd();
+      return rsize;
+    }
+    default:
+      break;
+    }
+
+    throw TProtocolException(TProtocolException::INVALID_DATA, "invalid TType");
+  }
+
+  std::shared_ptr<InProtocol_> getSource() const { return source_; }
+
+  std::shared_ptr<OutProtocol_> getSink() const { return sink_; }
+
+private:
+  // Elements of numeric lists and sets transcoded at a time
+  static const int CHUNK = 64;
+
+  // Types are checked before they are handed to the sink, as writers trust
+  // theirs
+  static void checkType(TType type) {
+    switch (type) {
+    case T_BOOL:
+    case T_BYTE:
+    case T_I16:
+    case T_I32:
+    case T_I64:
+    case T_DOUBLE:
+    case T_STRING:
+    case T_STRUCT:
+    case T_MAP:
+    case T_SET:
+    case T_LIST:
+    case T_UUID:
+      return;
+    default:
+      throw TProtocolException(TProtocolException::INVALID_DATA, "invalid TType");
+    }
+  }
+
+  uint32_t transcodeElements(TType elemType, uint32_t size) {
+    switch (elemType) {
+    case T_I16: {
+      int16_t values[CHUNK];
+      return transcodeArray(values, size);
+    }
+    case T_I32: {
+      int32_t values[CHUNK];
+      return transcodeArray(values, size);
+    }
+    case T_I64: {
+      int64_t values[CHUNK];
+      return transcodeArray(values, size);
+    }
+    case T_DOUBLE: {
+      double values[CHUNK];
+      return transcodeArray(values, size);
+    }
+    default: {
+      uint32_t rsize = 0;
+      for (uint32_t i = 0; i < size; i++) {
+        rsize += transcode(elemType);
+      }
+      return rsize;
+    }
+    }
+  }
+
+  template <typename T>
+  uint32_t transcodeArray(T (&values)[CHUNK], uint32_t size) {
+    uint32_t rsize = 0;
+    for (uint32_t done = 0; done < size;) {
+      uint32_t n = (std::min)(size - done, static_cast<uint32_t>(CHUNK));
+      rsize += readArray(values, n);
+      writeArray(values, n);
+      done += n;
+    }
+    return rsize;
+  }
+
+  uint32_t readArray(int16_t* values, uint32_t n) { return source_->readI16Array(values, n); }
+  uint32_t readArray(int32_t* values, uint32_t n) { return source_->readI32Array(values, n); }
+  uint32_t readArray(int64_t* values, uint32_t n) { return source_->readI64Array(values, n); }
+  uint32_t readArray(double* values, uint32_t n) { return source_->readDoubleArray(values, n); }
+
+  void writeArray(const int16_t* values, uint32_t n) { sink_->writeI16Array(values, n); }
+  void writeArray(const int32_t* values, uint32_t n) { sink_->writeI32Array(values, n); }
+  void writeArray(const int64_t* values, uint32_t n) { sink_->writeI64Array(values, n); }
+  void writeArray(const double* values, uint32_t n) { sink_->writeDoubleArray(values, n); }
+
+  std::shared_ptr<InProtocol_> source_;
+  std::shared_ptr<OutProtocol_> sink_;
+  bool borrowStrings_;
+  std::string name_;
+  std::string value_;
+};
+}
+}
+} // apache::thrift::protocol
+
+#endif // _THRIFT_PROTOCOL_TPROTOCOLTRANSCODER_H_
@@ -0,0 +1,235 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TSERIALIZEDSIZE_H_
+#define _THRIFT_PROTOCOL_TSERIALIZEDSIZE_H_ 1
+
+#include <thrift/protocol/TProtocol.h>
+
+#include <string>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * Maps a protocol to the sizer that computes how many bytes it writes,
+ * as used by the serializedSize<Protocol>() methods generated with
+ * cpp:serialized_size.  Protocols with a sizer specialize it next to their
+ * definition, with a member typedef type, and a static rawFormat() that
+ * returns the same TRawFormat as the protocol's getRawFormat() whatever
+ * transport the protocol is specialized for.
+ */
+template <class Protocol_>
+struct TProtocolSizer;
+
+/**
+ * Sizers have the write methods of a protocol, and return what the protocol
+ * would return from each, without encoding or writing anything.  They also
+ * have the raw format of the protocol, when it is set, so that a TLazy value
+ * can tell whether write() would copy its bytes.
+ */
+class TBinaryProtocolSizer {
+public:
+  explicit TBinaryProtocolSizer(bool strict_write = true)
+    : strict_write_(strict_write), format_(nullptr) {}
+
+  const TRawFormat* getRawFormat() const { return format_; }
+  void setRawFormat(const TRawFormat* format) { format_ = format; }
+
+  uint32_t writeMessageBegin(const std::string& name, const TMessageType, const int32_t) {
+    return (strict_write_ ? 8u : 5u) + writeString(name);
+  }
+  uint32_t writeMessageEnd() { return 0; }
+  uint32_t writeStructBegin(const char*) { return 0; }
+  uint32_t writeStructEnd() { return 0; }
+  uint32_t writeFieldBegin(const char*, const TType, const int16_t) { return 3; }
+  uint32_t writeFieldEnd() { return 0; }
+  uint32_t writeFieldStop() { return 1; }
+  uint32_t writeMapBegin(const TType, const TType, const uint32_t) { return 6; }
+  uint32_t writeMapEnd() { return 0; }
+  uint32_t writeListBegin(const TType, const uint32_t) { return 5; }
+  uint32_t writeListEnd() { return 0; }
+  uint32_t writeSetBegin(const TType, const uint32_t) { return 5; }
+  uint32_t writeSetEnd() { return 0; }
+  uint32_t writeBool(const bool) { return 1; }
+  uint32_t writeByte(const int8_t) { return 1; }
+  uint32_t writeI16(const int16_t) { return 2; }
+  uint32_t writeI32(const int32_t) { return 4; }
+  uint32_t writeI64(const int64_t) { return 8; }
+  uint32_t writeDouble(const double) { return 8; }
+  uint32_t writeString(const std::string& str) { return 4 + static_cast<uint32_t>(str.size()); }
+  uint32_t writeBinary(const std::string& str) { return writeString(str); }
+  uint32_t writeStringView(const TStringView& str) { return 4 + static_cast<uint32_t>(str.size()); }
+  uint32_t writeBinaryView(const TStringView& str) { return writeStringView(str); }
+  uint32_t writeUUID(const TUuid&) { return 16; }
+  uint32_t writeI16Array(const int16_t*, uint32_t count) { return 2 * count; }
+  uint32_t writeI32Array(const int32_t*, uint32_t count) { return 4 * count; }
+  uint32_t writeI64Array(const int64_t*, uint32_t count) { return 8 * count; }
+  uint32_t writeDoubleArray(const double*, uint32_t count) { return 8 * count; }
+
+private:
+  bool strict_write_;
+  const TRawFormat* format_;
+};
+
+class TCompactProtocolSizer {
+public:
+  TCompactProtocolSizer() : lastFieldId_(0), depth_(0), boolFieldSize_(0), format_(nullptr) {}
+
+  const TRawFormat* getRawFormat() const { return format_; }
+  void setRawFormat(const TRawFormat* format) { format_ = format; }
+
+  uint32_t writeMessageBegin(const std::string& name, const TMessageType, const int32_t seqid) {
+    return 2 + varint32Size(static_cast<uint32_t>(seqid)) + writeString(name);
+  }
+  uint32_t writeMessageEnd() { return 0; }
+
+  uint32_t writeStructBegin(const char*) {
+    // The field ids of a nested struct are relative to its own first field
+    if (depth_ < FIXED_DEPTH) {
+      lastFields_[depth_] = lastFieldId_;
+    } else {
+      deepLastFields_.push_back(lastFieldId_);
+    }
+    ++depth_;
+    lastFieldId_ = 0;
+    return 0;
+  }
+
+  uint32_t writeStructEnd() {
+    --depth_;
+    if (depth_ < FIXED_DEPTH) {
+      lastFieldId_ = lastFields_[depth_];
+    } else {
+      lastFieldId_ = deepLastFields_.back();
+      deepLastFields_.pop_back();
+    }
+    return 0;
+  }
+
+  uint32_t writeFieldBegin(const char*, const TType fieldType, const int16_t fieldId) {
+    // The header of a bool field is written by writeBool, with the value in it
+    uint32_t wsize = (fieldId > lastFieldId_ && fieldId - lastFieldId_ <= 15)
+                         ? 1
+                         : 1 + writeI16(fieldId);
+    lastFieldId_ = fieldId;
+    if (fieldType == T_BOOL) {
+      boolFieldSize_ = wsize;
+      return 0;
+    }
+    return wsize;
+  }
+
+  uint32_t writeFieldEnd() { return 0; }
+  uint32_t writeFieldStop() { return 1; }
+  uint32_t writeMapBegin(const TType, const TType, const uint32_t size) {
+    return size == 0 ? 1 : 1 + varint32Size(size);
+  }
+  uint32_t writeMapEnd() { return 0; }
+  uint32_t writeListBegin(const TType, const uint32_t size) { return collectionBeginSize(size); }
+  uint32_t writeListEnd() { return 0; }
+  uint32_t writeSetBegin(const TType, const uint32_t size) { return collectionBeginSize(size); }
+  uint32_t writeSetEnd() { return 0; }
+
+  uint32_t writeBool(const bool) {
+    uint32_t wsize = boolFieldSize_ ? boolFieldSize_ : 1;
+    boolFieldSize_ = 0;
+    return wsize;
+  }
+
+  uint32_t writeByte(const int8_t) { return 1; }
+  uint32_t writeI16(const int16_t i16) { return writeI32(i16); }
+  uint32_t writeI32(const int32_t i32) {
+    return varint32Size((static_cast<uint32_t>(i32) << 1) ^ static_cast<uint32_t>(i32 >> 31));
+  }
+  uint32_t writeI64(const int64_t i64) {
+    return varint64Size((static_cast<uint64_t>(i64) << 1) ^ static_cast<uint64_t>(i64 >> 63));
+  }
+  uint32_t writeDouble(const double) { return 8; }
+  uint32_t writeString(const std::string& str) { return binarySize(str.size()); }
+  uint32_t writeBinary(const std::string& str) { return binarySize(str.size()); }
+  uint32_t writeStringView(const TStringView& str) { return binarySize(str.size()); }
+  uint32_t writeBinaryView(const TStringView& str) { return binarySize(str.size()); }
+  uint32_t writeUUID(const TUuid&) { return 16; }
+  uint32_t writeI16Array(const int16_t* values, uint32_t count) {
+    uint32_t wsize = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      wsize += writeI16(values[i]);
+    }
+    return wsize;
+  }
+  uint32_t writeI32Array(const int32_t* values, uint32_t count) {
+    uint32_t wsize = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      wsize += writeI32(values[i]);
+    }
+    return wsize;
+  }
+  uint32_t writeI64Array(const int64_t* values, uint32_t count) {
+    uint32_t wsize = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      wsize += writeI64(values[i]);
+    }
+    return wsize;
+  }
+  uint32_t writeDoubleArray(const double*, uint32_t count) { return 8 * count; }
+
+  static uint32_t varint32Size(uint32_t n) {
+    uint32_t size = 1;
+    while (n >= 0x80) {
+      n >>= 7;
+      ++size;
+    }
+    return size;
+  }
+
+  static uint32_t varint64Size(uint64_t n) {
+    uint32_t size = 1;
+    while (n >= 0x80) {
+      n >>= 7;
+      ++size;
+    }
+    return size;
+  }
+
+private:
+  static const int FIXED_DEPTH = 16;
+
+  static uint32_t collectionBeginSize(uint32_t size) {
+    return size <= 14 ? 1 : 1 + varint32Size(size);
+  }
+
+  static uint32_t binarySize(size_t size) {
+    return varint32Size(static_cast<uint32_t>(size)) + static_cast<uint32_t>(size);
+  }
+
+  int16_t lastFieldId_;
+  int16_t lastFields_[FIXED_DEPTH];
+  std::vector<int16_t> deepLastFields_;
+  int depth_;
+  uint32_t boolFieldSize_;
+  const TRawFormat* format_;
+};
+}
+}
+} // apache::thrift::protocol
+
+#endif // #ifndef _THRIFT_PROTOCOL_TSERIALIZEDSIZE_H_
@@ -0,0 +1,423 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TVarintUtils.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define THRIFT_VARINT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 is not part of any baseline, so it is compiled per function and only
+// used when the CPU running us has it
+#if defined(THRIFT_VARINT_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define THRIFT_VARINT_AVX2 1
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+namespace {
+
+template <typename T>
+struct Zigzag;
+
+template <>
+struct Zigzag<int32_t> {
+  typedef uint32_t UInt;
+  static const int maxBytes = 5;
+  static int32_t decode(uint32_t n) {
+    return static_cast<int32_t>((n >> 1) ^ static_cast<uint32_t>(-static_cast<int32_t>(n & 1)));
+  }
+  static uint32_t encode(int32_t n) {
+    return (static_cast<uint32_t>(n) << 1) ^ static_cast<uint32_t>(n >> 31);
+  }
+};
+
+template <>
+struct Zigzag<int64_t> {
+  typedef uint64_t UInt;
+  static const int maxBytes = 10;
+  static int64_t decode(uint64_t n) {
+    return static_cast<int64_t>((n >> 1) ^ static_cast<uint64_t>(-static_cast<int64_t>(n & 1)));
+  }
+  static uint64_t encode(int64_t n) {
+    return (static_cast<uint64_t>(n) << 1) ^ static_cast<uint64_t>(n >> 63);
+  }
+};
+
+inline int highest_bit(uint32_t v) {
+#if defined(__GNUC__)
+  return 31 - __builtin_clz(v);
+#elif defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse(&index, v);
+  return static_cast<int>(index);
+#else
+  int index = 0;
+  while (v >>= 1) {
+    ++index;
+  }
+  return index;
+#endif
+}
+
+/**
+ * Decodes the varints that start before stop, up to values[count - 1].
+ * Moves p past them, and stops at a varint that is too long or does not end
+ * before stop.
+ *
+ * @return false if it stopped early
+ */
+template <typename T>
+inline bool decode_run(const uint8_t*& p,
+                       const uint8_t* stop,
+                       T* values,
+                       uint32_t& n,
+                       uint32_t count) {
+  typedef typename Zigzag<T>::UInt UInt;
+  while (p < stop && n < count) {
+    UInt val = 0;
+    int i = 0;
+    for (;;) {
+      if (i == Zigzag<T>::maxBytes || p + i == stop) {
+        return false;
+      }
+      uint8_t byte = p[i];
+      val |= static_cast<UInt>(byte & 0x7f) << (7 * i);
+      ++i;
+      if (!(byte & 0x80)) {
+        break;
+      }
+    }
+    p += i;
+    values[n++] = Zigzag<T>::decode(val);
+  }
+  return n == count || p == stop;
+}
+
+template <typename T>
+inline uint8_t* encode_one(T value, uint8_t* p) {
+  typename Zigzag<T>::UInt n = Zigzag<T>::encode(value);
+  while (n >= 0x80) {
+    *p++ = static_cast<uint8_t>(n | 0x80);
+    n >>= 7;
+  }
+  *p++ = static_cast<uint8_t>(n);
+  return p;
+}
+
+template <typename T>
+uint32_t decode_scalar(const uint8_t* buf,
+                       uint32_t len,
+                       T* values,
+                       uint32_t count,
+                       uint32_t* decoded) {
+  const uint8_t* p = buf;
+  uint32_t n = 0;
+  decode_run(p, buf + len, values, n, count);
+  *decoded = n;
+  return static_cast<uint32_t>(p - buf);
+}
+
+#ifdef THRIFT_VARINT_SSE2
+
+/*
+ * A chunk without continuation bits holds one value per byte. Zigzag
+ * decoding those in 8 bit lanes gives values in [-64, 63], which then only
+ * need sign extending.
+ */
+inline __m128i zigzag_decode_bytes(__m128i bytes) {
+  __m128i half = _mm_and_si128(_mm_srli_epi16(bytes, 1), _mm_set1_epi8(0x7f));
+  __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(bytes, _mm_set1_epi8(1)));
+  return _mm_xor_si128(half, sign);
+}
+
+inline void widen_bytes(__m128i v8, __m128i (&v32)[4]) {
+  __m128i lo16 = _mm_srai_epi16(_mm_unpacklo_epi8(v8, v8), 8);
+  __m128i hi16 = _mm_srai_epi16(_mm_unpackhi_epi8(v8, v8), 8);
+  v32[0] = _mm_srai_epi32(_mm_unpacklo_epi16(lo16, lo16), 16);
+  v32[1] = _mm_srai_epi32(_mm_unpackhi_epi16(lo16, lo16), 16);
+  v32[2] = _mm_srai_epi32(_mm_unpacklo_epi16(hi16, hi16), 16);
+  v32[3] = _mm_srai_epi32(_mm_unpackhi_epi16(hi16, hi16), 16);
+}
+
+inline void store_bytes(__m128i v8, int32_t* out) {
+  __m128i v32[4];
+  widen_bytes(v8, v32);
+  for (int k = 0; k < 4; ++k) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * k), v32[k]);
+  }
+}
+
+inline void store_bytes(__m128i v8, int64_t* out) {
+  __m128i v32[4];
+  widen_bytes(v8, v32);
+  for (int k = 0; k < 4; ++k) {
+    __m128i sign = _mm_srai_epi32(v32[k], 31);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * k), _mm_unpacklo_epi32(v32[k], sign));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * k + 2),
+                     _mm_unpackhi_epi32(v32[k], sign));
+  }
+}
+
+/*
+ * Takes 16 bytes at a time. If none has its continuation bit set they are 16
+ * values, decoded together; otherwise the varints ending in the chunk are
+ * decoded one by one, without bounds checks per byte.
+ */
+template <typename T>
+uint32_t decode_sse2(const uint8_t* buf,
+                     uint32_t len,
+                     T* values,
+                     uint32_t count,
+                     uint32_t* decoded) {
+  const uint8_t* p = buf;
+  const uint8_t* end = buf + len;
+  uint32_t n = 0;
+  while (end - p >= 16 && n < count) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    uint32_t more = static_cast<uint32_t>(_mm_movemask_epi8(chunk));
+    if (more == 0 && count - n >= 16) {
+      store_bytes(zigzag_decode_bytes(chunk), values + n);
+      p += 16;
+      n += 16;
+      continue;
+    }
+    uint32_t ends = ~more & 0xffff;
+    if (ends == 0 || !decode_run(p, p + highest_bit(ends) + 1, values, n, count)) {
+      break;
+    }
+  }
+  decode_run(p, end, values, n, count);
+  *decoded = n;
+  return static_cast<uint32_t>(p - buf);
+}
+
+template <typename T>
+uint32_t encode_sse2(const T* values, uint32_t count, uint8_t* buf);
+
+/*
+ * Sixteen values that all zigzag to less than 128 are one byte each, and
+ * are narrowed together.
+ */
+template <>
+uint32_t encode_sse2<int32_t>(const int32_t* values, uint32_t count, uint8_t* buf) {
+  uint8_t* p = buf;
+  uint32_t i = 0;
+  const __m128i high_bits = _mm_set1_epi32(~0x7f);
+  while (count - i >= 16) {
+    __m128i z[4];
+    __m128i any = _mm_setzero_si128();
+    for (int k = 0; k < 4; ++k) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 4 * k));
+      z[k] = _mm_xor_si128(_mm_slli_epi32(v, 1), _mm_srai_epi32(v, 31));
+      any = _mm_or_si128(any, z[k]);
+    }
+    __m128i big = _mm_cmpeq_epi32(_mm_and_si128(any, high_bits), _mm_setzero_si128());
+    if (_mm_movemask_epi8(big) == 0xffff) {
+      __m128i packed = _mm_packus_epi16(_mm_packs_epi32(z[0], z[1]), _mm_packs_epi32(z[2], z[3]));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p), packed);
+      p += 16;
+    } else {
+      for (int k = 0; k < 16; ++k) {
+        p = encode_one(values[i + k], p);
+      }
+    }
+    i += 16;
+  }
+  for (; i < count; ++i) {
+    p = encode_one(values[i], p);
+  }
+  return static_cast<uint32_t>(p - buf);
+}
+
+template <>
+uint32_t encode_sse2<int64_t>(const int64_t* values, uint32_t count, uint8_t* buf) {
+  uint8_t* p = buf;
+  uint32_t i = 0;
+  const __m128i high_bits = _mm_set_epi32(-1, ~0x7f, -1, ~0x7f);
+  while (count - i >= 16) {
+    __m128i z[8];
+    __m128i any = _mm_setzero_si128();
+    for (int k = 0; k < 8; ++k) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 2 * k));
+      __m128i sign = _mm_srai_epi32(_mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 1, 1)), 31);
+      z[k] = _mm_xor_si128(_mm_slli_epi64(v, 1), sign);
+      any = _mm_or_si128(any, z[k]);
+    }
+    __m128i big = _mm_cmpeq_epi32(_mm_and_si128(any, high_bits), _mm_setzero_si128());
+    if (_mm_movemask_epi8(big) == 0xffff) {
+      // All fit in their low 32 bits, so gather those and narrow as above
+      __m128i z32[4];
+      for (int k = 0; k < 4; ++k) {
+        z32[k] = _mm_unpacklo_epi64(_mm_shuffle_epi32(z[2 * k], _MM_SHUFFLE(2, 0, 2, 0)),
+                                    _mm_shuffle_epi32(z[2 * k + 1], _MM_SHUFFLE(2, 0, 2, 0)));
+      }
+      __m128i packed
+          = _mm_packus_epi16(_mm_packs_epi32(z32[0], z32[1]), _mm_packs_epi32(z32[2], z32[3]));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p), packed);
+      p += 16;
+    } else {
+      for (int k = 0; k < 16; ++k) {
+        p = encode_one(values[i + k], p);
+      }
+    }
+    i += 16;
+  }
+  for (; i < count; ++i) {
+    p = encode_one(values[i], p);
+  }
+  return static_cast<uint32_t>(p - buf);
+}
+
+#endif // THRIFT_VARINT_SSE2
+
+#ifdef THRIFT_VARINT_AVX2
+
+__attribute__((target("avx2"))) inline void store_bytes_avx2(__m256i v8, int32_t* out) {
+  __m128i lo = _mm256_castsi256_si128(v8);
+  __m128i hi = _mm256_extracti128_si256(v8, 1);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_cvtepi8_epi32(lo));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 8),
+                      _mm256_cvtepi8_epi32(_mm_srli_si128(lo, 8)));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 16), _mm256_cvtepi8_epi32(hi));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 24),
+                      _mm256_cvtepi8_epi32(_mm_srli_si128(hi, 8)));
+}
+
+__attribute__((target("avx2"))) inline void store_bytes_avx2(__m256i v8, int64_t* out) {
+  __m128i lo = _mm256_castsi256_si128(v8);
+  __m128i hi = _mm256_extracti128_si256(v8, 1);
+  __m256i* o = reinterpret_cast<__m256i*>(out);
+  _mm256_storeu_si256(o + 0, _mm256_cvtepi8_epi64(lo));
+  _mm256_storeu_si256(o + 1, _mm256_cvtepi8_epi64(_mm_srli_si128(lo, 4)));
+  _mm256_storeu_si256(o + 2, _mm256_cvtepi8_epi64(_mm_srli_si128(lo, 8)));
+  _mm256_storeu_si256(o + 3, _mm256_cvtepi8_epi64(_mm_srli_si128(lo, 12)));
+  _mm256_storeu_si256(o + 4, _mm256_cvtepi8_epi64(hi));
+  _mm256_storeu_si256(o + 5, _mm256_cvtepi8_epi64(_mm_srli_si128(hi, 4)));
+  _mm256_storeu_si256(o + 6, _mm256_cvtepi8_epi64(_mm_srli_si128(hi, 8)));
+  _mm256_storeu_si256(o + 7, _mm256_cvtepi8_epi64(_mm_srli_si128(hi, 12)));
+}
+
+/*
+ * decode_sse2() with 32 byte chunks.
+ */
+template <typename T>
+__attribute__((target("avx2"))) uint32_t decode_avx2(const uint8_t* buf,
+                                                     uint32_t len,
+                                                     T* values,
+                                                     uint32_t count,
+                                                     uint32_t* decoded) {
+  const uint8_t* p = buf;
+  const uint8_t* end = buf + len;
+  uint32_t n = 0;
+  const __m256i low_bits = _mm256_set1_epi8(0x7f);
+  const __m256i one = _mm256_set1_epi8(1);
+  while (end - p >= 32 && n < count) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    uint32_t more = static_cast<uint32_t>(_mm256_movemask_epi8(chunk));
+    if (more == 0 && count - n >= 32) {
+      __m256i half = _mm256_and_si256(_mm256_srli_epi16(chunk, 1), low_bits);
+      __m256i sign = _mm256_sub_epi8(_mm256_setzero_si256(), _mm256_and_si256(chunk, one));
+      store_bytes_avx2(_mm256_xor_si256(half, sign), values + n);
+      p += 32;
+      n += 32;
+      continue;
+    }
+    uint32_t ends = ~more;
+    if (ends == 0 || !decode_run(p, p + highest_bit(ends) + 1, values, n, count)) {
+      break;
+    }
+  }
+  decode_run(p, end, values, n, count);
+  *decoded = n;
+  return static_cast<uint32_t>(p - buf);
+}
+
+#endif // THRIFT_VARINT_AVX2
+
+template <typename T>
+struct Decoder {
+  typedef uint32_t (*Function)(const uint8_t*, uint32_t, T*, uint32_t, uint32_t*);
+};
+
+template <typename T>
+typename Decoder<T>::Function pick_decoder() {
+#ifdef THRIFT_VARINT_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return decode_avx2<T>;
+  }
+#endif
+#ifdef THRIFT_VARINT_SSE2
+  return decode_sse2<T>;
+#else
+  return decode_scalar<T>;
+#endif
+}
+
+template <typename T>
+uint32_t encode(const T* values, uint32_t count, uint8_t* buf) {
+#ifdef THRIFT_VARINT_SSE2
+  return encode_sse2<T>(values, count, buf);
+#else
+  uint8_t* p = buf;
+  for (uint32_t i = 0; i < count; ++i) {
+    p = encode_one(values[i], p);
+  }
+  return static_cast<uint32_t>(p - buf);
+#endif
+}
+} // namespace
+
+uint32_t varint_decode_zigzag32(const uint8_t* buf,
+                                uint32_t len,
+                                int32_t* values,
+                                uint32_t count,
+                                uint32_t* decoded) {
+  static const Decoder<int32_t>::Function decode = pick_decoder<int32_t>();
+  return decode(buf, len, values, count, decoded);
+}
+
+uint32_t varint_decode_zigzag64(const uint8_t* buf,
+                                uint32_t len,
+                                int64_t* values,
+                                uint32_t count,
+                                uint32_t* decoded) {
+  static const Decoder<int64_t>::Function decode = pick_decoder<int64_t>();
+  return decode(buf, len, values, count, decoded);
+}
+
+uint32_t varint_encode_zigzag32(const int32_t* values, uint32_t count, uint8_t* buf) {
+  return encode(values, count, buf);
+}
+
+uint32_t varint_encode_zigzag64(const int64_t* values, uint32_t count, uint8_t* buf) {
+  return encode(values, count, buf);
+}
+}
+}
+} // apache::thrift::protocol
@@ -0,0 +1,56 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TVARINTUTILS_H_
+#define _THRIFT_PROTOCOL_TVARINTUTILS_H_
+
+#include <stdint.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+// Bulk zigzag varint coding, as used for integers by TCompactProtocol.
+// These use SSE2 or AVX2, picked at runtime, where available.
+
+// decodes up to count values from the len bytes at buf into values
+// stops early at a varint that does not end within len bytes, or that is
+// longer than 5 (10 for the 64 bit version) bytes, leaving it to the caller
+// *decoded is set to the number of values decoded
+// returns the number of bytes used
+uint32_t varint_decode_zigzag32(const uint8_t* buf,
+                                uint32_t len,
+                                int32_t* values,
+                                uint32_t count,
+                                uint32_t* decoded);
+uint32_t varint_decode_zigzag64(const uint8_t* buf,
+                                uint32_t len,
+                                int64_t* values,
+                                uint32_t count,
+                                uint32_t* decoded);
+
+// encodes count values into buf, which must hold 5 (10) bytes per value
+// returns the number of bytes written
+uint32_t varint_encode_zigzag32(const int32_t* values, uint32_t count, uint8_t* buf);
+uint32_t varint_encode_zigzag64(const int64_t* values, uint32_t count, uint8_t* buf);
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TVARINTUTILS_H_
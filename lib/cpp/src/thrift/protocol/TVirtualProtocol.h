@@ -169,6 +169,26 @@ public:
                              "this protocol does not support reading (yet).");
   }
 
+  uint32_t readStringView(TStringView& str) { return this->TProtocol::readStringView_virt(str); }
+
+  uint32_t readBinaryView(TStringView& str) { return this->TProtocol::readBinaryView_virt(str); }
+
+  uint32_t readI32Array(int32_t* values, uint32_t count) {
+    return this->TProtocol::readI32Array_virt(values, count);
+  }
+
+  uint32_t readI64Array(int64_t* values, uint32_t count) {
+    return this->TProtocol::readI64Array_virt(values, count);
+  }
+
+  uint32_t readI16Array(int16_t* values, uint32_t count) {
+    return this->TProtocol::readI16Array_virt(values, count);
+  }
+
+  uint32_t readDoubleArray(double* values, uint32_t count) {
+    return this->TProtocol::readDoubleArray_virt(values, count);
+  }
+
   uint32_t writeMessageBegin(const std::string& name,
                              const TMessageType messageType,
                              const int32_t seqid) {
@@ -298,6 +318,30 @@ public:
                              "this protocol does not support writing (yet).");
   }
 
+  uint32_t writeStringView(const TStringView& str) {
+    return this->TProtocol::writeStringView_virt(str);
+  }
+
+  uint32_t writeBinaryView(const TStringView& str) {
+    return this->TProtocol::writeBinaryView_virt(str);
+  }
+
+  uint32_t writeI32Array(const int32_t* values, uint32_t count) {
+    return this->TProtocol::writeI32Array_virt(values, count);
+  }
+
+  uint32_t writeI64Array(const int64_t* values, uint32_t count) {
+    return this->TProtocol::writeI64Array_virt(values, count);
+  }
+
+  uint32_t writeI16Array(const int16_t* values, uint32_t count) {
+    return this->TProtocol::writeI16Array_virt(values, count);
+  }
+
+  uint32_t writeDoubleArray(const double* values, uint32_t count) {
+    return this->TProtocol::writeDoubleArray_virt(values, count);
+  }
+
   uint32_t skip(TType type) { return ::apache::thrift::protocol::skip(*this, type); }
 
 protected:
@@ -397,6 +441,30 @@ public:
     return static_cast<Protocol_*>(this)->writeUUID(uuid);
   }
 
+  uint32_t writeStringView_virt(const TStringView& str) override {
+    return static_cast<Protocol_*>(this)->writeStringView(str);
+  }
+
+  uint32_t writeBinaryView_virt(const TStringView& str) override {
+    return static_cast<Protocol_*>(this)->writeBinaryView(str);
+  }
+
+  uint32_t writeI32Array_virt(const int32_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeI32Array(values, count);
+  }
+
+  uint32_t writeI64Array_virt(const int64_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeI64Array(values, count);
+  }
+
+  uint32_t writeI16Array_virt(const int16_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeI16Array(values, count);
+  }
+
+  uint32_t writeDoubleArray_virt(const double* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeDoubleArray(values, count);
+  }
+
   /**
    * Reading functions
    */
@@ -479,6 +547,30 @@ public:
     return static_cast<Protocol_*>(this)->readUUID(uuid);
   }
 
+  uint32_t readStringView_virt(TStringView& str) override {
+    return static_cast<Protocol_*>(this)->readStringView(str);
+  }
+
+  uint32_t readBinaryView_virt(TStringView& str) override {
+    return static_cast<Protocol_*>(this)->readBinaryView(str);
+  }
+
+  uint32_t readI32Array_virt(int32_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readI32Array(values, count);
+  }
+
+  uint32_t readI64Array_virt(int64_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readI64Array(values, count);
+  }
+
+  uint32_t readI16Array_virt(int16_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readI16Array(values, count);
+  }
+
+  uint32_t readDoubleArray_virt(double* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readDoubleArray(values, count);
+  }
+
   uint32_t skip_virt(TType type) override { return static_cast<Protocol_*>(this)->skip(type); }
 
   /*
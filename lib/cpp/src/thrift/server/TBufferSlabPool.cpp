@@ -0,0 +1,133 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cstdlib>
+#include <new>
+
+#include <thrift/server/TBufferSlabPool.h>
+
+using apache::thrift::concurrency::Guard;
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+TBufferSlabPoolStats& TBufferSlabPoolStats::operator+=(const TBufferSlabPoolStats& other) {
+  slabsInUse += other.slabsInUse;
+  slabsInUseHighWater += other.slabsInUseHighWater;
+  freeSlabs += other.freeSlabs;
+  freeBytes += other.freeBytes;
+  freeBytesHighWater += other.freeBytesHighWater;
+  allocations += other.allocations;
+  reuses += other.reuses;
+  return *this;
+}
+
+TBufferSlabPool::TBufferSlabPool(size_t maxFreeBytes) : maxFreeBytes_(maxFreeBytes) {
+}
+
+TBufferSlabPool::~TBufferSlabPool() {
+  for (auto& slabs : free_) {
+    for (uint8_t* slab : slabs) {
+      std::free(slab);
+    }
+  }
+}
+
+int TBufferSlabPool::classOf(uint32_t capacity) {
+  uint32_t size = MIN_SLAB_SIZE;
+  for (int c = 0; c < NUM_CLASSES; ++c, size <<= 1) {
+    if (capacity == size) {
+      return c;
+    }
+  }
+  return -1;
+}
+
+uint8_t* TBufferSlabPool::allocate(uint32_t size, uint32_t* capacity) {
+  int c = -1;
+  uint32_t slabSize = size;
+  if (size <= MAX_SLAB_SIZE) {
+    c = 0;
+    slabSize = MIN_SLAB_SIZE;
+    while (slabSize < size) {
+      slabSize <<= 1;
+      ++c;
+    }
+  }
+
+  {
+    Guard g(mutex_);
+    if (c >= 0 && !free_[c].empty()) {
+      uint8_t* slab = free_[c].back();
+      free_[c].pop_back();
+      --stats_.freeSlabs;
+      stats_.freeBytes -= slabSize;
+      ++stats_.reuses;
+      if (++stats_.slabsInUse > stats_.slabsInUseHighWater) {
+        stats_.slabsInUseHighWater = stats_.slabsInUse;
+      }
+      *capacity = slabSize;
+      return slab;
+    }
+  }
+
+  auto* slab = static_cast<uint8_t*>(std::malloc(slabSize));
+  if (slab == nullptr) {
+    throw std::bad_alloc();
+  }
+  {
+    Guard g(mutex_);
+    ++stats_.allocations;
+    if (++stats_.slabsInUse > stats_.slabsInUseHighWater) {
+      stats_.slabsInUseHighWater = stats_.slabsInUse;
+    }
+  }
+  *capacity = slabSize;
+  return slab;
+}
+
+void TBufferSlabPool::release(uint8_t* slab, uint32_t capacity) {
+  if (slab == nullptr) {
+    return;
+  }
+  int c = classOf(capacity);
+  {
+    Guard g(mutex_);
+    --stats_.slabsInUse;
+    if (c >= 0 && stats_.freeBytes + capacity <= maxFreeBytes_) {
+      free_[c].push_back(slab);
+      ++stats_.freeSlabs;
+      stats_.freeBytes += capacity;
+      if (stats_.freeBytes > stats_.freeBytesHighWater) {
+        stats_.freeBytesHighWater = stats_.freeBytes;
+      }
+      return;
+    }
+  }
+  std::free(slab);
+}
+
+TBufferSlabPoolStats TBufferSlabPool::getStats() const {
+  Guard g(mutex_);
+  return stats_;
+}
+}
+}
+} // apache::thrift::server
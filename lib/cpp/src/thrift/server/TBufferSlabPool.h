@@ -0,0 +1,139 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_TBUFFERSLABPOOL_H_
+#define _THRIFT_SERVER_TBUFFERSLABPOOL_H_ 1
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <thrift/concurrency/Mutex.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+/**
+ * Counters of a TBufferSlabPool. Adding the stats of several pools gives
+ * their total, with the high-water marks summed.
+ */
+struct TBufferSlabPoolStats {
+  TBufferSlabPoolStats()
+    : slabsInUse(0),
+      slabsInUseHighWater(0),
+      freeSlabs(0),
+      freeBytes(0),
+      freeBytesHighWater(0),
+      allocations(0),
+      reuses(0) {}
+
+  TBufferSlabPoolStats& operator+=(const TBufferSlabPoolStats& other);
+
+  /// Slabs handed out and not yet released
+  size_t slabsInUse;
+
+  /// Most slabs ever in use at once
+  size_t slabsInUseHighWater;
+
+  /// Slabs kept for reuse
+  size_t freeSlabs;
+
+  /// Bytes in the slabs kept for reuse
+  size_t freeBytes;
+
+  /// Most bytes ever kept for reuse
+  size_t freeBytesHighWater;
+
+  /// Slabs that had to be malloc'd
+  uint64_t allocations;
+
+  /// Slabs served from the free lists
+  uint64_t reuses;
+};
+
+/**
+ * Buffers for requests and responses, in power-of-two size classes from
+ * MIN_SLAB_SIZE to MAX_SLAB_SIZE, kept on a free list for each class once
+ * released. TNonblockingServer gives each IO thread one, and its connections
+ * borrow a read and a write buffer for each request, so a steady load stops
+ * calling malloc() and free() at all.
+ *
+ * Slabs come from std::malloc(), so a TMemoryBuffer may own one and grow it
+ * with realloc(); release() takes back whatever capacity it ended up with,
+ * and only pools it if that is still a class size. Requests beyond
+ * MAX_SLAB_SIZE get a buffer of their own size, freed when released.
+ *
+ * The pool is mostly used by its own IO thread, but any thread may release
+ * to it.
+ */
+class TBufferSlabPool {
+public:
+  static const uint32_t MIN_SLAB_SIZE = 512;
+
+  static const uint32_t MAX_SLAB_SIZE = 1024 * 1024;
+
+  /**
+   * @param maxFreeBytes Bytes of free slabs to keep across all classes; any
+   *                     more are freed
+   */
+  explicit TBufferSlabPool(size_t maxFreeBytes);
+
+  ~TBufferSlabPool();
+
+  TBufferSlabPool(const TBufferSlabPool&) = delete;
+  TBufferSlabPool& operator=(const TBufferSlabPool&) = delete;
+
+  /**
+   * A slab of at least size bytes.
+   *
+   * @param size     bytes needed
+   * @param capacity set to the size of the slab
+   * @throws std::bad_alloc if there is no memory for a new slab
+   */
+  uint8_t* allocate(uint32_t size, uint32_t* capacity);
+
+  /**
+   * Takes back a slab from allocate().
+   *
+   * @param slab     the slab, possibly moved by realloc() since
+   * @param capacity its size now
+   */
+  void release(uint8_t* slab, uint32_t capacity);
+
+  size_t getMaxFreeBytes() const { return maxFreeBytes_; }
+
+  TBufferSlabPoolStats getStats() const;
+
+private:
+  static const int NUM_CLASSES = 12;
+
+  // The class a slab of this capacity goes back to, or -1 for none
+  static int classOf(uint32_t capacity);
+
+  const size_t maxFreeBytes_;
+  mutable concurrency::Mutex mutex_;
+  std::vector<uint8_t*> free_[NUM_CLASSES];
+  TBufferSlabPoolStats stats_;
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TBUFFERSLABPOOL_H_
@@ -20,13 +20,16 @@
 #include <thrift/thrift-config.h>
 
 #include <thrift/server/TNonblockingServer.h>
+#include <thrift/TApplicationException.h>
 #include <thrift/concurrency/Exception.h>
 #include <thrift/transport/TSocket.h>
 #include <thrift/concurrency/ThreadFactory.h>
 #include <thrift/transport/PlatformSocket.h>
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <stdexcept>
 
 #ifdef HAVE_POLL_H
 #include <poll.h>
@@ -160,9 +163,21 @@ private:
   /// Largest size of write buffer seen since buffer was constructed
   size_t largestWriteBufferSize_;
 
+  /// Whether the socket took none of the response at some point
+  bool sendStalled_;
+
   /// Count of the number of calls for use with getResizeBufferEveryN().
   int32_t callsForResize_;
 
+  /// Pool the read and write buffers are borrowed from (empty if not pooled)
+  std::shared_ptr<TBufferSlabPool> bufferPool_;
+
+  /// Whether outputTransport_ owns a slab from bufferPool_
+  bool writeSlab_;
+
+  /// Size of the last response, to borrow a big enough write slab
+  uint32_t writeSizeHint_;
+
   /// Transport to read from
   std::shared_ptr<TMemoryBuffer> inputTransport_;
 
@@ -209,6 +224,12 @@ private:
    */
   void workSocket();
 
+  /// Give the read buffer back to bufferPool_, if one is borrowed.
+  void releaseReadSlab();
+
+  /// Give the write buffer back to bufferPool_, if one is borrowed.
+  void releaseWriteSlab();
+
 public:
   class Task;
 
@@ -217,6 +238,7 @@ public:
               TNonblockingIOThread* ioThread) {
     readBuffer_ = nullptr;
     readBufferSize_ = 0;
+    writeSlab_ = false;
 
     ioThread_ = ioThread;
     server_ = ioThread->getServer();
@@ -224,15 +246,27 @@ public:
     // Allocate input and output transports these only need to be allocated
     // once per TConnection (they don't need to be reallocated on init() call)
     inputTransport_.reset(new TMemoryBuffer(readBuffer_, readBufferSize_));
-    outputTransport_.reset(
-        new TMemoryBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+    if (ioThread->getBufferPool()) {
+      // Given a slab for each request
+      outputTransport_.reset(new TMemoryBuffer(nullptr, 0));
+    } else {
+      outputTransport_.reset(
+          new TMemoryBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+    }
 
     tSocket_ =  socket;
 
     init(ioThread);
   }
 
-  ~TConnection() { std::free(readBuffer_); }
+  ~TConnection() {
+    if (bufferPool_) {
+      releaseReadSlab();
+      releaseWriteSlab();
+    } else {
+      std::free(readBuffer_);
+    }
+  }
 
   /// Close this connection and free or reset its resources.
   void close();
@@ -325,16 +359,26 @@ public:
       output_(output),
       connection_(connection),
       serverEventHandler_(connection_->getServerEventHandler()),
-      connectionContext_(connection_->getConnectionContext()) {}
+      connectionContext_(connection_->getConnectionContext()),
+      queued_(std::chrono::steady_clock::now()) {}
 
   void run() override {
+    auto sojourn = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - queued_);
+    bool shed = connection_->server_->sojournMonitor_.record(sojourn.count());
     try {
       for (;;) {
-        if (serverEventHandler_) {
-          serverEventHandler_->processContext(connectionContext_, connection_->getTSocket());
+        if (shed) {
+          reject();
+        } else {
+          if (serverEventHandler_) {
+            serverEventHandler_->processContext(connectionContext_, connection_->getTSocket());
+          }
+          if (!processor_->process(input_, output_, connectionContext_)) {
+            break;
+          }
         }
-        if (!processor_->process(input_, output_, connectionContext_)
-            || !input_->getTransport()->peek()) {
+        if (!input_->getTransport()->peek()) {
           break;
         }
       }
@@ -363,12 +407,34 @@ public:
   TConnection* getTConnection() { return connection_; }
 
 private:
+  // Answers a request with an exception instead of processing it
+  void reject() {
+    std::string fname;
+    TMessageType mtype;
+    int32_t seqid;
+    input_->readMessageBegin(fname, mtype, seqid);
+    input_->skip(T_STRUCT);
+    input_->readMessageEnd();
+    input_->getTransport()->readEnd();
+    if (mtype == T_ONEWAY) {
+      return;
+    }
+    TApplicationException x(TApplicationException::INTERNAL_ERROR,
+                            "Server overloaded, request shed: '" + fname + "'");
+    output_->writeMessageBegin(fname, T_EXCEPTION, seqid);
+    x.write(output_.get());
+    output_->writeMessageEnd();
+    output_->getTransport()->writeEnd();
+    output_->getTransport()->flush();
+  }
+
   std::shared_ptr<TProcessor> processor_;
   std::shared_ptr<TProtocol> input_;
   std::shared_ptr<TProtocol> output_;
   TConnection* connection_;
   std::shared_ptr<TServerEventHandler> serverEventHandler_;
   void* connectionContext_;
+  std::chrono::steady_clock::time_point queued_;
 };
 
 void TNonblockingServer::TConnection::init(TNonblockingIOThread* ioThread) {
@@ -384,10 +450,14 @@ void TNonblockingServer::TConnection::init(TNonblockingIOThread* ioThread) {
   writeBufferSize_ = 0;
   writeBufferPos_ = 0;
   largestWriteBufferSize_ = 0;
+  sendStalled_ = false;
 
   socketState_ = SOCKET_RECV_FRAMING;
   callsForResize_ = 0;
 
+  bufferPool_ = ioThread->getBufferPool();
+  writeSizeHint_ = 0;
+
   // get input/transports
   factoryInputTransport_ = server_->getInputTransportFactory()->getTransport(inputTransport_);
   factoryOutputTransport_ = server_->getOutputTransportFactory()->getTransport(outputTransport_);
@@ -418,6 +488,34 @@ void TNonblockingServer::TConnection::setSocket(std::shared_ptr<TSocket> socket)
   tSocket_ = socket;
 }
 
+void TNonblockingServer::TConnection::releaseReadSlab() {
+  if (readBuffer_ == nullptr) {
+    return;
+  }
+  inputTransport_->resetBuffer(nullptr, 0);
+  bufferPool_->release(readBuffer_, readBufferSize_);
+  readBuffer_ = nullptr;
+  readBufferSize_ = 0;
+}
+
+void TNonblockingServer::TConnection::releaseWriteSlab() {
+  if (!writeSlab_) {
+    return;
+  }
+  // The processor may have grown the slab, so ask where it is now
+  uint8_t* slab;
+  uint32_t size;
+  outputTransport_->resetBuffer();
+  outputTransport_->getBuffer(&slab, &size);
+  uint32_t capacity = outputTransport_->getBufferSize();
+  // Observing the slab first makes the transport let go of it without
+  // freeing it
+  outputTransport_->resetBuffer(slab, 0);
+  outputTransport_->resetBuffer(nullptr, 0);
+  writeSlab_ = false;
+  bufferPool_->release(slab, capacity);
+}
+
 void TNonblockingServer::TConnection::workSocket() {
   while (true) {
     int got = 0, left = 0, sent = 0;
@@ -565,7 +663,18 @@ void TNonblockingServer::TConnection::workSocket() {
       // We are done!
       if (writeBufferPos_ == writeBufferSize_) {
         transition();
+        return;
+      }
+
+      if (sent == 0) {
+        sendStalled_ = true;
+        if (tSocket_->isWriteWaitingForRead()) {
+          // The peer rings the socket once it has made room
+          setRead();
+          return;
+        }
       }
+      setWrite();
 
       return;
 
@@ -598,6 +707,16 @@ void TNonblockingServer::TConnection::transition() {
   switch (appState_) {
 
   case APP_READ_REQUEST:
+    // Borrow a write slab big enough for a response like the last one
+    if (bufferPool_ && !writeSlab_) {
+      uint32_t capacity;
+      uint8_t* slab = bufferPool_->allocate(
+          (std::max)(static_cast<uint32_t>(server_->getWriteBufferDefaultSize()), writeSizeHint_),
+          &capacity);
+      outputTransport_->resetBuffer(slab, capacity, TMemoryBuffer::TAKE_OWNERSHIP);
+      writeSlab_ = true;
+    }
+
     // We are done reading the request, package the read buffer into transport
     // and get back some data from the dispatch function
     if (server_->getHeaderTransport()) {
@@ -688,6 +807,13 @@ void TNonblockingServer::TConnection::transition() {
     // Get the result of the operation
     outputTransport_->getBuffer(&writeBuffer_, &writeBufferSize_);
 
+    // The request has been read, so its slab can serve another connection
+    // while the response goes out
+    if (bufferPool_) {
+      releaseReadSlab();
+      writeSizeHint_ = writeBufferSize_;
+    }
+
     // If the function call generated return data, then move into the send
     // state and get going
     // 4 bytes were reserved for frame size
@@ -713,15 +839,18 @@ void TNonblockingServer::TConnection::transition() {
     goto LABEL_APP_INIT;
 
   case APP_SEND_RESULT:
-    // it's now safe to perform buffer size housekeeping.
-    if (writeBufferSize_ > largestWriteBufferSize_) {
-      largestWriteBufferSize_ = writeBufferSize_;
-    }
-    if (server_->getResizeBufferEveryN() > 0
-        && ++callsForResize_ >= server_->getResizeBufferEveryN()) {
-      checkIdleBufferMemLimit(server_->getIdleReadBufferLimit(),
-                              server_->getIdleWriteBufferLimit());
-      callsForResize_ = 0;
+    // it's now safe to perform buffer size housekeeping, which pooled
+    // buffers need none of.
+    if (!bufferPool_) {
+      if (writeBufferSize_ > largestWriteBufferSize_) {
+        largestWriteBufferSize_ = writeBufferSize_;
+      }
+      if (server_->getResizeBufferEveryN() > 0
+          && ++callsForResize_ >= server_->getResizeBufferEveryN()) {
+        checkIdleBufferMemLimit(server_->getIdleReadBufferLimit(),
+                                server_->getIdleWriteBufferLimit());
+        callsForResize_ = 0;
+      }
     }
     // fallthrough
 
@@ -730,6 +859,11 @@ void TNonblockingServer::TConnection::transition() {
   LABEL_APP_INIT:
   case APP_INIT:
 
+    // The response has been sent
+    if (bufferPool_) {
+      releaseWriteSlab();
+    }
+
     // Clear write buffer variables
     writeBuffer_ = nullptr;
     writeBufferPos_ = 0;
@@ -744,14 +878,27 @@ void TNonblockingServer::TConnection::transition() {
     // Register read event
     setRead();
 
+    // Waiting for room may have taken the notice of a request that is
+    // already there
+    if (sendStalled_) {
+      sendStalled_ = false;
+      if (tSocket_->hasPendingDataToRead()) {
+        workSocket();
+      }
+    }
+
     return;
 
   case APP_READ_FRAME_SIZE:
     readWant_ += 4;
 
     // We just read the request length
-    // Double the buffer size until it is big enough
-    if (readWant_ > readBufferSize_) {
+    if (bufferPool_) {
+      // Borrow a slab for the frame
+      assert(readBuffer_ == nullptr);
+      readBuffer_ = bufferPool_->allocate(readWant_, &readBufferSize_);
+    } else if (readWant_ > readBufferSize_) {
+      // Double the buffer size until it is big enough
       if (readBufferSize_ == 0) {
         readBufferSize_ = 1;
       }
@@ -866,6 +1013,11 @@ void TNonblockingServer::TConnection::close() {
   // release processor and handler
   processor_.reset();
 
+  if (bufferPool_) {
+    releaseReadSlab();
+    releaseWriteSlab();
+  }
+
   // Give this object back to the server that owns it
   server_->returnConnection(this);
 }
@@ -909,16 +1061,19 @@ TNonblockingServer::~TNonblockingServer() {
  * Creates a new connection either by reusing an object off the stack or
  * by allocating a new one entirely
  */
-TNonblockingServer::TConnection* TNonblockingServer::createConnection(std::shared_ptr<TSocket> socket) {
+TNonblockingServer::TConnection* TNonblockingServer::createConnection(std::shared_ptr<TSocket> socket,
+                                                                     TNonblockingIOThread* ioThread) {
   // Check the stack
   Guard g(connMutex_);
 
   // pick an IO thread to handle this connection -- currently round robin
-  assert(nextIOThread_ < ioThreads_.size());
-  int selectedThreadIdx = nextIOThread_;
-  nextIOThread_ = static_cast<uint32_t>((nextIOThread_ + 1) % ioThreads_.size());
+  if (ioThread == nullptr) {
+    assert(nextIOThread_ < ioThreads_.size());
+    int selectedThreadIdx = nextIOThread_;
+    nextIOThread_ = static_cast<uint32_t>((nextIOThread_ + 1) % ioThreads_.size());
 
-  TNonblockingIOThread* ioThread = ioThreads_[selectedThreadIdx].get();
+    ioThread = ioThreads_[selectedThreadIdx].get();
+  }
 
   // Check the connection stack to see if we can re-use
   TConnection* result = nullptr;
@@ -936,6 +1091,29 @@ TNonblockingServer::TConnection* TNonblockingServer::createConnection(std::share
   return result;
 }
 
+void TNonblockingServer::setIOThreadCpus(const std::vector<int>& cpus) {
+  for (int cpu : cpus) {
+#ifdef CPU_SETSIZE
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+#else
+    if (cpu < 0) {
+#endif
+      throw std::invalid_argument("IO thread CPU " + std::to_string(cpu) + " out of range");
+    }
+  }
+  ioThreadCpus_ = cpus;
+}
+
+TBufferSlabPoolStats TNonblockingServer::getBufferPoolStats() const {
+  TBufferSlabPoolStats stats;
+  for (const auto& ioThread : ioThreads_) {
+    if (ioThread->getBufferPool()) {
+      stats += ioThread->getBufferPool()->getStats();
+    }
+  }
+  return stats;
+}
+
 /**
  * Returns a connection to the stack
  */
@@ -956,15 +1134,22 @@ void TNonblockingServer::returnConnection(TConnection* connection) {
  * Server socket had something happen.  We accept all waiting client
  * connections on fd and assign TConnection objects to handle those requests.
  */
-void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
+void TNonblockingServer::handleEvent(TNonblockingIOThread* ioThread,
+                                     THRIFT_SOCKET fd,
+                                     short which) {
   (void)which;
+  std::shared_ptr<TNonblockingServerTransport> listener = ioThread->getListener();
+  if (!listener) {
+    listener = serverTransport_;
+  }
   // Make sure that libevent didn't mess up the socket handles
-  assert(fd == serverSocket_);
+  assert(fd == listener->getSocketFD());
+  (void)fd;
 
   // Going to accept a new client socket
   std::shared_ptr<TSocket> clientSocket;
 
-  clientSocket = serverTransport_->accept();
+  clientSocket = listener->accept();
   if (clientSocket) {
     // If we're overloaded, take action here
     if (overloadAction_ != T_OVERLOAD_NO_ACTION && serverOverloaded()) {
@@ -983,8 +1168,10 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
       }
     }
 
-    // Create a new TConnection for this client socket.
-    TConnection* clientConnection = createConnection(clientSocket);
+    // Create a new TConnection for this client socket. A thread with its
+    // own listener keeps what it accepts; otherwise spread round robin.
+    TConnection* clientConnection
+        = createConnection(clientSocket, reusePortListeners_ ? ioThread : nullptr);
 
     // Fail fast if we could not create a TConnection object
     if (clientConnection == nullptr) {
@@ -1001,11 +1188,10 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
      * (We need to avoid writing to our own notification pipe, to
      * avoid possible deadlocks if the pipe is full.)
      *
-     * The IO thread #0 is the only one that handles these listen
-     * events, so unless the connection has been assigned to thread #0
-     * we know it's not on our thread.
+     * Unless the connection has been assigned to the thread that
+     * accepted it, we know it's not on our thread.
      */
-    if (clientConnection->getIOThreadNumber() == 0) {
+    if (clientConnection->getIOThreadNumber() == ioThread->getThreadNumber()) {
       clientConnection->transition();
     } else {
       if (!clientConnection->notifyIOThread()) {
@@ -1091,8 +1277,15 @@ void TNonblockingServer::registerEvents(event_base* user_event_base) {
   userEventBase_ = user_event_base;
 
   // init listen socket
-  if (serverSocket_ == THRIFT_INVALID_SOCKET)
+  if (serverSocket_ == THRIFT_INVALID_SOCKET) {
+    if (reusePortListeners_ && numIOThreads_ > 1 && !serverTransport_->setReusePort(true)) {
+      TOutput::instance().printf(
+          "TNonblockingServer: SO_REUSEPORT not supported by the server transport, "
+          "IO thread #0 accepts for all IO threads.");
+      reusePortListeners_ = false;
+    }
     createAndListenOnSocket();
+  }
 
   // set up the IO threads
   assert(ioThreads_.empty());
@@ -1102,12 +1295,46 @@ void TNonblockingServer::registerEvents(event_base* user_event_base) {
   // User-provided event-base doesn't works for multi-threaded servers
   assert(numIOThreads_ == 1 || !userEventBase_);
 
+  // the other IO threads get a listener of their own on the same port, or
+  // they all share the first one if any of them cannot get one
+  std::vector<std::shared_ptr<TNonblockingServerTransport> > listeners;
+  for (uint32_t id = 1; reusePortListeners_ && id < numIOThreads_; ++id) {
+    std::shared_ptr<TNonblockingServerTransport> listener
+        = serverTransport_->createReusePortListener();
+    try {
+      if (listener) {
+        listener->listen();
+        listeners.push_back(listener);
+        continue;
+      }
+    } catch (const TTransportException& ex) {
+      TOutput::instance().printf("TNonblockingServer: listen() for IO thread #%d failed: %s",
+                                 id,
+                                 ex.what());
+    }
+    TOutput::instance().printf(
+        "TNonblockingServer: could not create a listener for IO thread #%d, "
+        "IO thread #0 accepts for all IO threads.",
+        id);
+    for (auto& created : listeners) {
+      created->close();
+    }
+    listeners.clear();
+    reusePortListeners_ = false;
+  }
+
   for (uint32_t id = 0; id < numIOThreads_; ++id) {
     // the first IO thread also does the listening on server socket
     THRIFT_SOCKET listenFd = (id == 0 ? serverSocket_ : THRIFT_INVALID_SOCKET);
 
     shared_ptr<TNonblockingIOThread> thread(
         new TNonblockingIOThread(this, id, listenFd, useHighPriorityIOThreads_));
+    if (id > 0 && reusePortListeners_) {
+      thread->setListener(listeners[id - 1]);
+    }
+    if (!ioThreadCpus_.empty()) {
+      thread->setCpu(ioThreadCpus_[id % ioThreadCpus_.size()]);
+    }
     ioThreads_.push_back(thread);
   }
 
@@ -1173,6 +1400,10 @@ TNonblockingIOThread::TNonblockingIOThread(TNonblockingServer* server,
     threadId_{},
     listenSocket_(listenSocket),
     useHighPriority_(useHighPriority),
+    cpu_(-1),
+    bufferPool_(server->getBufferPoolLimit()
+                    ? std::make_shared<TBufferSlabPool>(server->getBufferPoolLimit())
+                    : nullptr),
     eventBase_(nullptr),
     ownEventBase_(false),
     serverEvent_{},
@@ -1190,7 +1421,10 @@ TNonblockingIOThread::~TNonblockingIOThread() {
     ownEventBase_ = false;
   }
 
-  if (listenSocket_ != THRIFT_INVALID_SOCKET) {
+  if (listener_) {
+    listener_->close();
+    listenSocket_ = THRIFT_INVALID_SOCKET;
+  } else if (listenSocket_ != THRIFT_INVALID_SOCKET) {
     if (0 != ::THRIFT_CLOSESOCKET(listenSocket_)) {
       TOutput::instance().perror("TNonblockingIOThread listenSocket_ close(): ", THRIFT_GET_SOCKET_ERROR);
     }
@@ -1208,6 +1442,12 @@ TNonblockingIOThread::~TNonblockingIOThread() {
   }
 }
 
+void TNonblockingIOThread::setListener(const std::shared_ptr<TNonblockingServerTransport>& listener) {
+  assert(listenSocket_ == THRIFT_INVALID_SOCKET);
+  listener_ = listener;
+  listenSocket_ = listener->getSocketFD();
+}
+
 void TNonblockingIOThread::createNotificationPipe() {
   if (evutil_socketpair(AF_LOCAL, SOCK_STREAM, 0, notificationPipeFDs_) == -1) {
     TOutput::instance().perror("TNonblockingServer::createNotificationPipe ", EVUTIL_SOCKET_ERROR());
@@ -1262,7 +1502,7 @@ void TNonblockingIOThread::registerEvents() {
               listenSocket_,
               EV_READ | EV_PERSIST,
               TNonblockingIOThread::listenHandler,
-              server_);
+              this);
     event_base_set(eventBase_, &serverEvent_);
 
     // Add the event and start up the server
@@ -1467,10 +1707,30 @@ void TNonblockingIOThread::setCurrentThreadHighPriority(bool value) {
 #endif
 }
 
+void TNonblockingIOThread::setCurrentThreadAffinity() {
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu_, &cpus);
+  int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (0 == err) {
+    TOutput::instance().printf("TNonblocking: IO Thread #%d pinned to CPU %d", number_, cpu_);
+  } else {
+    TOutput::instance().perror("TNonblocking: pthread_setaffinity_np(): ", err);
+  }
+#else
+  TOutput::instance().printf("TNonblocking: IO Thread #%d cannot be pinned on this platform",
+                             number_);
+#endif
+}
+
 void TNonblockingIOThread::run() {
   if (eventBase_ == nullptr) {
     registerEvents();
   }
+  if (cpu_ >= 0) {
+    setCurrentThreadAffinity();
+  }
   if (useHighPriority_) {
     setCurrentThreadHighPriority(true);
   }
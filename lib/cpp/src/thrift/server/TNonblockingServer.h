@@ -22,7 +22,9 @@
 
 #include <thrift/Thrift.h>
 #include <memory>
+#include <thrift/server/TBufferSlabPool.h>
 #include <thrift/server/TServer.h>
+#include <thrift/server/TSojournMonitor.h>
 #include <thrift/transport/PlatformSocket.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TSocket.h>
@@ -144,6 +146,9 @@ private:
   /// # of calls before resizing oversized buffers (0 = check only on close)
   static const int RESIZE_BUFFER_EVERY_N = 512;
 
+  /// Free bytes each IO thread's buffer pool keeps (0 = no pooling)
+  static const size_t BUFFER_POOL_LIMIT = 0;
+
   /// # of IO threads to use by default
   static const int DEFAULT_IO_THREADS = 1;
 
@@ -153,6 +158,12 @@ private:
   /// Whether to set high scheduling priority for IO threads
   bool useHighPriorityIOThreads_;
 
+  /// Whether every IO thread accepts on its own SO_REUSEPORT listener
+  bool reusePortListeners_;
+
+  /// CPUs to pin the IO threads to, by thread number (empty = no pinning)
+  std::vector<int> ioThreadCpus_;
+
   /// Server socket file descriptor
   THRIFT_SOCKET serverSocket_;
 
@@ -208,6 +219,9 @@ private:
   /// Action to take when we're overloaded.
   TOverloadAction overloadAction_;
 
+  /// How long tasks wait for the thread pool, and whether to shed them.
+  TSojournMonitor sojournMonitor_;
+
   /**
    * The write buffer is initialized (and when idleWriteBufferLimit_ is checked
    * and found to be exceeded, reinitialized) to this size.
@@ -237,6 +251,13 @@ private:
    */
   int32_t resizeBufferEveryN_;
 
+  /**
+   * Bytes of free buffers each IO thread keeps for its connections to borrow
+   * for their next requests. 0 disables pooling, and each connection keeps
+   * buffers of its own, trimmed by the limits above.
+   */
+  size_t bufferPoolLimit_;
+
   /// Set if we are currently in an overloaded state.
   bool overloaded_;
 
@@ -271,15 +292,17 @@ private:
    * client connections on listen socket fd and assign TConnection objects
    * to handle those requests.
    *
+   * @param ioThread the IO thread that owns the listen socket.
    * @param which the event flag that triggered the handler.
    */
-  void handleEvent(THRIFT_SOCKET fd, short which);
+  void handleEvent(TNonblockingIOThread* ioThread, THRIFT_SOCKET fd, short which);
 
   void init() {
     serverSocket_ = THRIFT_INVALID_SOCKET;
     numIOThreads_ = DEFAULT_IO_THREADS;
     nextIOThread_ = 0;
     useHighPriorityIOThreads_ = false;
+    reusePortListeners_ = false;
     userEventBase_ = nullptr;
     threadPoolProcessing_ = false;
     numTConnections_ = 0;
@@ -295,6 +318,7 @@ private:
     idleReadBufferLimit_ = IDLE_READ_BUFFER_LIMIT;
     idleWriteBufferLimit_ = IDLE_WRITE_BUFFER_LIMIT;
     resizeBufferEveryN_ = RESIZE_BUFFER_EVERY_N;
+    bufferPoolLimit_ = BUFFER_POOL_LIMIT;
     overloaded_ = false;
     nConnectionsDropped_ = 0;
     nTotalConnectionsDropped_ = 0;
@@ -403,6 +427,32 @@ public:
   /** Return the number of IO threads used by this server. */
   size_t getNumIOThreads() const { return numIOThreads_; }
 
+  /**
+   * Give every IO thread its own listen socket bound with SO_REUSEPORT, so
+   * the kernel spreads new connections across the threads and each thread
+   * keeps the connections it accepted. Without this, IO thread #0 accepts
+   * everything and hands connections to the others through their
+   * notification pipes. Must be set before serve(); falls back to a single
+   * listener if the server transport does not support SO_REUSEPORT or any
+   * IO thread cannot get a listener of its own.
+   */
+  void setReusePortListeners(bool val) { reusePortListeners_ = val; }
+
+  /** Return whether each IO thread gets its own SO_REUSEPORT listener. */
+  bool getReusePortListeners() const { return reusePortListeners_; }
+
+  /**
+   * Pin IO thread #i to CPU cpus[i % cpus.size()]. IO thread #0 runs in the
+   * thread that calls serve(), so that thread gets pinned too. Must be set
+   * before serve(); ignored where thread affinity is not supported.
+   * \throws std::invalid_argument if a CPU is negative or not below
+   *         CPU_SETSIZE
+   */
+  void setIOThreadCpus(const std::vector<int>& cpus);
+
+  /** Return the CPUs the IO threads are pinned to (empty if not pinned). */
+  const std::vector<int>& getIOThreadCpus() const { return ioThreadCpus_; }
+
   /**
    * Get the maximum number of unused TConnection we will hold in reserve.
    *
@@ -562,6 +612,50 @@ public:
    */
   void setTaskExpireTime(int64_t taskExpireTime) { taskExpireTime_ = taskExpireTime; }
 
+  /**
+   * Get the time in milliseconds a task may wait for the thread pool before
+   * the queue counts as overloaded (0 == never).
+   *
+   * @return a 64-bit time in milliseconds.
+   */
+  int64_t getSojournTarget() const { return sojournMonitor_.getTarget(); }
+
+  /**
+   * Shed requests by how long they wait for the thread pool. Once every
+   * task in an interval (see setSojournInterval()) has waited longer than
+   * the target, tasks that waited more than twice the target are answered
+   * with a TApplicationException instead of being processed, until an
+   * interval has a task that waited less. Unlike maxActiveProcessors_ this
+   * holds whether requests are cheap or costly. Only applies with a thread
+   * manager.
+   *
+   * @param target a 64-bit time in milliseconds, or 0 to never shed.
+   */
+  void setSojournTarget(int64_t target) { sojournMonitor_.setTarget(target); }
+
+  /**
+   * Get the interval in milliseconds over which task waits are judged.
+   *
+   * @return a 64-bit time in milliseconds.
+   */
+  int64_t getSojournInterval() const { return sojournMonitor_.getInterval(); }
+
+  /**
+   * Set the interval in milliseconds over which task waits are judged.
+   * It should be about the time the slowest requests take.
+   *
+   * @param interval a 64-bit time in milliseconds (> 0).
+   */
+  void setSojournInterval(int64_t interval) { sojournMonitor_.setInterval(interval); }
+
+  /**
+   * Get a histogram of how long tasks have waited for the thread pool, and
+   * how many were shed. Safe to call from any thread while the server runs.
+   *
+   * @return the stats since the server was created.
+   */
+  TSojournStats getSojournStats() const { return sojournMonitor_.getStats(); }
+
   /**
    * Determine if the server is currently overloaded.
    * This function checks the maximums for open connections and connections
@@ -665,6 +759,33 @@ public:
    */
   void setResizeBufferEveryN(int32_t count) { resizeBufferEveryN_ = count; }
 
+  /**
+   * Get the bytes of free buffers each IO thread keeps for reuse.
+   *
+   * @return # bytes, or 0 if buffers are not pooled.
+   */
+  size_t getBufferPoolLimit() const { return bufferPoolLimit_; }
+
+  /**
+   * Set the bytes of free buffers each IO thread keeps for reuse. With
+   * pooling, a connection borrows its read and write buffers from its IO
+   * thread for each request and gives them back when the request is done,
+   * and the idle buffer limits and resizeBufferEveryN_ do not apply. 0, the
+   * default, disables pooling. A few MB per IO thread is enough for most
+   * servers. Must be set before serve().
+   *
+   * @param limit # bytes of free buffers per IO thread, or 0.
+   */
+  void setBufferPoolLimit(size_t limit) { bufferPoolLimit_ = limit; }
+
+  /**
+   * Get the buffer pool counters of all the IO threads added together.
+   * Safe to call from any thread while the server runs.
+   *
+   * @return the summed stats; all zero if buffers are not pooled.
+   */
+  TBufferSlabPoolStats getBufferPoolStats() const;
+
   /**
    * Main workhorse function, starts up the server listening on a port and
    * loops over the libevent handler.
@@ -715,11 +836,12 @@ private:
    * and flags.
    *
    * @param socket FD of socket associated with this connection.
-   * @param addr the sockaddr of the client
-   * @param addrLen the length of addr
+   * @param ioThread the IO thread to own the connection, or nullptr to
+   *        pick one round robin.
    * @return pointer to initialized TConnection object.
    */
-  TConnection* createConnection(std::shared_ptr<TSocket> socket);
+  TConnection* createConnection(std::shared_ptr<TSocket> socket,
+                                TNonblockingIOThread* ioThread = nullptr);
 
   /**
    * Returns a connection to pool or deletion.  If the connection pool
@@ -783,6 +905,21 @@ public:
   /// Registers the events for the notification & listen sockets
   void registerEvents();
 
+  /**
+   * Makes this thread accept on its own listener instead of listenSocket.
+   * The listener is closed along with the thread.
+   */
+  void setListener(const std::shared_ptr<TNonblockingServerTransport>& listener);
+
+  /// Returns the listener set with setListener(), if any.
+  std::shared_ptr<TNonblockingServerTransport> getListener() const { return listener_; }
+
+  /// Pins the thread to the given CPU when it starts running (-1 = don't).
+  void setCpu(int cpu) { cpu_ = cpu; }
+
+  /// Returns the pool this thread's connections borrow buffers from, if any.
+  std::shared_ptr<TBufferSlabPool> getBufferPool() const { return bufferPool_; }
+
 private:
   /**
    * C-callable event handler for signaling task completion.  Provides a
@@ -800,10 +937,11 @@ private:
    *
    * @param fd the descriptor the event occurred on.
    * @param which the flags associated with the event.
-   * @param v void* callback arg where we placed TNonblockingServer's "this".
+   * @param v void* callback arg where we placed the TNonblockingIOThread.
    */
   static void listenHandler(evutil_socket_t fd, short which, void* v) {
-    ((TNonblockingServer*)v)->handleEvent(fd, which);
+    auto* ioThread = (TNonblockingIOThread*)v;
+    ioThread->getServer()->handleEvent(ioThread, fd, which);
   }
 
   /// Exits the loop ASAP in case of shutdown or error.
@@ -818,6 +956,9 @@ private:
   /// Sets (or clears) high priority scheduling status for the current thread.
   void setCurrentThreadHighPriority(bool value);
 
+  /// Restricts the current thread to cpu_.
+  void setCurrentThreadAffinity();
+
 private:
   /// associated server
   TNonblockingServer* server_;
@@ -834,6 +975,15 @@ private:
   /// Sets a high scheduling priority when running
   bool useHighPriority_;
 
+  /// This thread's own listener, owning listenSocket_ (may be empty)
+  std::shared_ptr<TNonblockingServerTransport> listener_;
+
+  /// CPU to pin the thread to, or -1
+  int cpu_;
+
+  /// Buffers for this thread's connections (empty if not pooled)
+  std::shared_ptr<TBufferSlabPool> bufferPool_;
+
   /// pointer to eventbase to be used for looping
   event_base* eventBase_;
 
@@ -0,0 +1,123 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cmath>
+
+#include <thrift/server/TSojournMonitor.h>
+#include <thrift/Thrift.h>
+
+using apache::thrift::concurrency::Guard;
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+int64_t TSojournStats::percentileUs(double fraction) const {
+  if (tasks == 0) {
+    return 0;
+  }
+  auto wanted = static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(tasks)));
+  uint64_t seen = 0;
+  for (int i = 0; i < NUM_BUCKETS; ++i) {
+    seen += buckets[i];
+    if (seen >= wanted) {
+      return bucketLimitUs(i);
+    }
+  }
+  return bucketLimitUs(NUM_BUCKETS - 1);
+}
+
+const int64_t TSojournMonitor::DEFAULT_INTERVAL;
+
+TSojournMonitor::TSojournMonitor()
+  : targetUs_(0), intervalUs_(DEFAULT_INTERVAL * 1000), intervalMinUs_(0) {
+}
+
+int64_t TSojournMonitor::getTarget() const {
+  Guard g(mutex_);
+  return targetUs_ / 1000;
+}
+
+void TSojournMonitor::setTarget(int64_t target) {
+  Guard g(mutex_);
+  targetUs_ = target > 0 ? target * 1000 : 0;
+}
+
+int64_t TSojournMonitor::getInterval() const {
+  Guard g(mutex_);
+  return intervalUs_ / 1000;
+}
+
+void TSojournMonitor::setInterval(int64_t interval) {
+  if (interval > 0) {
+    Guard g(mutex_);
+    intervalUs_ = interval * 1000;
+  }
+}
+
+bool TSojournMonitor::record(int64_t sojournUs) {
+  int bucket = 0;
+  while (bucket < TSojournStats::NUM_BUCKETS - 1
+         && TSojournStats::bucketLimitUs(bucket) <= sojournUs) {
+    ++bucket;
+  }
+
+  Guard g(mutex_);
+  ++stats_.buckets[bucket];
+  ++stats_.tasks;
+  if (targetUs_ == 0) {
+    stats_.overloaded = false;
+    return false;
+  }
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (now >= intervalEnd_) {
+    // Judge the interval just over by its shortest wait
+    bool overloaded = intervalMinUs_ > targetUs_;
+    if (overloaded != stats_.overloaded) {
+      if (overloaded) {
+        TOutput::instance().printf("TSojournMonitor: queue wait above target, shedding begun.");
+      } else {
+        TOutput::instance().printf("TSojournMonitor: queue wait back under target, "
+                                   "%llu shed in total",
+                                   static_cast<unsigned long long>(stats_.shed));
+      }
+      stats_.overloaded = overloaded;
+    }
+    stats_.intervalMinUs = intervalMinUs_;
+    intervalMinUs_ = sojournUs;
+    intervalEnd_ = now + std::chrono::microseconds(intervalUs_);
+  } else if (sojournUs < intervalMinUs_) {
+    intervalMinUs_ = sojournUs;
+  }
+
+  if (stats_.overloaded && sojournUs > 2 * targetUs_) {
+    ++stats_.shed;
+    return true;
+  }
+  return false;
+}
+
+TSojournStats TSojournMonitor::getStats() const {
+  Guard g(mutex_);
+  return stats_;
+}
+}
+}
+} // apache::thrift::server
@@ -0,0 +1,127 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_TSOJOURNMONITOR_H_
+#define _THRIFT_SERVER_TSOJOURNMONITOR_H_ 1
+
+#include <chrono>
+#include <cstdint>
+
+#include <thrift/concurrency/Mutex.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+/**
+ * How long tasks waited in a queue before a thread picked them up, as a
+ * histogram with a bucket for each power of two microseconds.
+ */
+struct TSojournStats {
+  static const int NUM_BUCKETS = 24;
+
+  /// Waits in bucket i are under this many microseconds; the last bucket
+  /// has no limit.
+  static int64_t bucketLimitUs(int bucket) { return static_cast<int64_t>(1) << bucket; }
+
+  TSojournStats() : tasks(0), shed(0), overloaded(false), intervalMinUs(0) {
+    for (auto& bucket : buckets) {
+      bucket = 0;
+    }
+  }
+
+  /**
+   * The limit of the bucket holding the given fraction of the waits, e.g.
+   * 0.99 for the 99th percentile.
+   *
+   * @return microseconds, or 0 if no task has been recorded.
+   */
+  int64_t percentileUs(double fraction) const;
+
+  /// buckets[i] counts the waits of at least bucketLimitUs(i - 1) and under
+  /// bucketLimitUs(i) microseconds
+  uint64_t buckets[NUM_BUCKETS];
+
+  /// Tasks recorded
+  uint64_t tasks;
+
+  /// Tasks that were shed
+  uint64_t shed;
+
+  /// Whether tasks are being shed
+  bool overloaded;
+
+  /// Shortest wait in the last interval, in microseconds
+  int64_t intervalMinUs;
+};
+
+/**
+ * Decides when to shed work from how long it waits in a queue, after
+ * CoDel. A queue that bursts and drains has some tasks go through with
+ * hardly any wait; one that only grows makes every task wait. So the
+ * shortest wait in each interval is what counts: once that is above the
+ * target, the queue is overloaded for the next interval, and tasks that
+ * waited more than twice the target are shed, to be failed without
+ * running. The tasks that waited less still run, so the queue drains
+ * from the back while the newest requests are served.
+ *
+ * Counting tasks cannot tell a queue of cheap requests from one of costly
+ * ones; their waits can. Any number of threads may record.
+ */
+class TSojournMonitor {
+public:
+  /// Default length of an interval, in milliseconds
+  static const int64_t DEFAULT_INTERVAL = 100;
+
+  TSojournMonitor();
+
+  TSojournMonitor(const TSojournMonitor&) = delete;
+  TSojournMonitor& operator=(const TSojournMonitor&) = delete;
+
+  /// Target wait in milliseconds; 0 (the default) never sheds.
+  int64_t getTarget() const;
+  void setTarget(int64_t target);
+
+  /// Interval in milliseconds.
+  int64_t getInterval() const;
+  void setInterval(int64_t interval);
+
+  /**
+   * Records that a task has waited for sojournUs microseconds and is about
+   * to run.
+   *
+   * @return true if the task should be shed instead.
+   */
+  bool record(int64_t sojournUs);
+
+  TSojournStats getStats() const;
+
+private:
+  mutable concurrency::Mutex mutex_;
+  int64_t targetUs_;
+  int64_t intervalUs_;
+  std::chrono::steady_clock::time_point intervalEnd_;
+  int64_t intervalMinUs_;
+  TSojournStats stats_;
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TSOJOURNMONITOR_H_
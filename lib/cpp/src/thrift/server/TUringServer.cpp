@@ -0,0 +1,1290 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <thrift/server/TUringServer.h>
+#include <thrift/concurrency/Exception.h>
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/concurrency/Mutex.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TSocket.h>
+#include <thrift/transport/PlatformSocket.h>
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+
+#ifdef HAVE_INTTYPES_H
+#include <inttypes.h>
+#endif
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace apache::thrift::concurrency;
+using std::shared_ptr;
+
+namespace {
+
+int uring_setup(unsigned entries, io_uring_params* p) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+int uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+  return static_cast<int>(
+      syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int uring_register(int fd, unsigned opcode, const void* arg, unsigned nrArgs) {
+  return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+std::string errnoString(const char* what, int errno_copy) {
+  return std::string(what) + ": " + TOutput::strerror_s(errno_copy);
+}
+
+/**
+ * Just enough of an io_uring to drive one IO thread, written against the
+ * raw system calls so that no liburing dependency is needed. A ring is only
+ * ever touched by the thread that runs its loop.
+ */
+class Ring {
+public:
+  Ring() = default;
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+  ~Ring() { destroy(); }
+
+  void init(unsigned entries) {
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    fd_ = uring_setup(entries, &p);
+    if (fd_ < 0) {
+      throw TException(errnoString("io_uring_setup", errno));
+    }
+
+    sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) {
+      sqRingSize_ = cqRingSize_ = (std::max)(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                   IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+      sqRing_ = nullptr;
+      throw TException(errnoString("mmap(IORING_OFF_SQ_RING)", errno));
+    }
+    if (singleMmap) {
+      cqRing_ = sqRing_;
+    } else {
+      cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                     IORING_OFF_CQ_RING);
+      if (cqRing_ == MAP_FAILED) {
+        cqRing_ = nullptr;
+        throw TException(errnoString("mmap(IORING_OFF_CQ_RING)", errno));
+      }
+    }
+    sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                      IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      throw TException(errnoString("mmap(IORING_OFF_SQES)", errno));
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    auto* sq = static_cast<uint8_t*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_entries);
+    auto* array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    // SQEs are always filled in ring order, so the index array is the identity
+    for (unsigned i = 0; i < sqEntries_; ++i) {
+      array[i] = i;
+    }
+    sqeTail_ = *sqTail_;
+
+    auto* cq = static_cast<uint8_t*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+  }
+
+  void destroy() {
+    if (sqes_) {
+      munmap(sqes_, sqesSize_);
+      sqes_ = nullptr;
+    }
+    if (cqRing_ && cqRing_ != sqRing_) {
+      munmap(cqRing_, cqRingSize_);
+    }
+    cqRing_ = nullptr;
+    if (sqRing_) {
+      munmap(sqRing_, sqRingSize_);
+      sqRing_ = nullptr;
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  int fd() const { return fd_; }
+
+  /**
+   * Returns a zeroed submission entry, flushing queued entries to the kernel
+   * first if the submission queue is full.
+   */
+  io_uring_sqe* getSqe() {
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqeTail_ - head >= sqEntries_) {
+      submit(0);
+      head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+      if (sqeTail_ - head >= sqEntries_) {
+        throw TException("io_uring submission queue overflow");
+      }
+    }
+    io_uring_sqe* sqe = &sqes_[sqeTail_ & sqMask_];
+    ++sqeTail_;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+  }
+
+  /**
+   * Publishes all queued submissions and, if waitNr > 0, blocks until that
+   * many completions are available. Both happen in one system call.
+   */
+  void submit(unsigned waitNr) {
+    unsigned toSubmit = sqeTail_ - *sqTail_;
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+    if (toSubmit == 0 && waitNr == 0) {
+      return;
+    }
+    unsigned flags = waitNr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+    do {
+      ret = uring_enter(fd_, toSubmit, waitNr, flags);
+      ++enterCalls_;
+    } while (ret < 0 && errno == EINTR);
+    // EBUSY/EAGAIN means completions must be reaped first, which the caller
+    // does next; anything not consumed is picked up by the following call.
+    if (ret < 0 && errno != EBUSY && errno != EAGAIN) {
+      throw TException(errnoString("io_uring_enter", errno));
+    }
+  }
+
+  /**
+   * Removes one completion from the queue.
+   *
+   * @return false if the completion queue is empty.
+   */
+  bool popCqe(io_uring_cqe& cqe) {
+    unsigned head = *cqHead_;
+    if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+      return false;
+    }
+    cqe = cqes_[head & cqMask_];
+    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  uint64_t takeEnterCalls() {
+    uint64_t calls = enterCalls_;
+    enterCalls_ = 0;
+    return calls;
+  }
+
+private:
+  int fd_ = -1;
+  void* sqRing_ = nullptr;
+  void* cqRing_ = nullptr;
+  size_t sqRingSize_ = 0;
+  size_t cqRingSize_ = 0;
+  size_t sqesSize_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  unsigned* sqHead_ = nullptr;
+  unsigned* sqTail_ = nullptr;
+  unsigned sqMask_ = 0;
+  unsigned sqEntries_ = 0;
+  unsigned sqeTail_ = 0;
+  unsigned* cqHead_ = nullptr;
+  unsigned* cqTail_ = nullptr;
+  unsigned cqMask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  uint64_t enterCalls_ = 0;
+};
+
+/**
+ * A group of equally sized receive buffers registered with a ring. The
+ * kernel picks a free buffer for each completed receive, so no memory is
+ * committed to idle connections.
+ */
+class BufferRing {
+public:
+  static const uint16_t GROUP_ID = 0;
+
+  BufferRing() = default;
+  BufferRing(const BufferRing&) = delete;
+  BufferRing& operator=(const BufferRing&) = delete;
+  ~BufferRing() { destroy(); }
+
+  void init(int ringFd, uint32_t count, uint32_t size) {
+    if (count == 0 || count > 32768 || (count & (count - 1)) != 0) {
+      throw TException("TUringServer: receive buffer count must be a power of two <= 32768");
+    }
+    count_ = count;
+    size_ = size;
+    ringBytes_ = count * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, ringBytes_, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE,
+                      -1, 0);
+    if (ring == MAP_FAILED) {
+      throw TException(errnoString("mmap(buffer ring)", errno));
+    }
+    ring_ = static_cast<io_uring_buf_ring*>(ring);
+    pool_ = static_cast<uint8_t*>(std::malloc(static_cast<size_t>(count) * size));
+    if (pool_ == nullptr) {
+      throw std::bad_alloc();
+    }
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring_);
+    reg.ring_entries = count;
+    reg.bgid = GROUP_ID;
+    if (uring_register(ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+      throw TException(errnoString("io_uring_register(IORING_REGISTER_PBUF_RING)", errno));
+    }
+
+    tail_ = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      put(static_cast<uint16_t>(i));
+    }
+    publish();
+  }
+
+  void destroy() {
+    std::free(pool_);
+    pool_ = nullptr;
+    if (ring_) {
+      munmap(ring_, ringBytes_);
+      ring_ = nullptr;
+    }
+  }
+
+  const uint8_t* data(uint16_t bid) const { return pool_ + static_cast<size_t>(bid) * size_; }
+
+  /// Hands a consumed buffer back to the kernel.
+  void recycle(uint16_t bid) {
+    put(bid);
+    publish();
+  }
+
+private:
+  void put(uint16_t bid) {
+    // The entries start at the beginning of the ring. Indexing the flexible
+    // bufs member is avoided because C++ lays it out after a dummy member.
+    io_uring_buf* buf = reinterpret_cast<io_uring_buf*>(ring_) + (tail_ & (count_ - 1));
+    buf->addr = reinterpret_cast<uint64_t>(data(bid));
+    buf->len = size_;
+    buf->bid = bid;
+    ++tail_;
+  }
+
+  void publish() { __atomic_store_n(&ring_->tail, tail_, __ATOMIC_RELEASE); }
+
+  io_uring_buf_ring* ring_ = nullptr;
+  size_t ringBytes_ = 0;
+  uint8_t* pool_ = nullptr;
+  uint32_t count_ = 0;
+  uint32_t size_ = 0;
+  uint16_t tail_ = 0;
+};
+
+/// Operation kinds, stored in the low bits of each submission's user_data.
+enum TUringOp : uint64_t {
+  OP_ACCEPT = 1,
+  OP_NOTIFY = 2,
+  OP_RECV = 3,
+  OP_SEND = 4,
+  OP_CANCEL = 5
+};
+const uint64_t OP_MASK = 7;
+
+uint64_t userData(const void* ptr, TUringOp op) {
+  return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr)) | op;
+}
+}
+
+/**
+ * Application states of a connection; the same progression as the
+ * connections of TNonblockingServer.
+ */
+enum TUringAppState {
+  APP_READ_FRAME_SIZE,
+  APP_READ_REQUEST,
+  APP_WAIT_TASK,
+  APP_SEND_RESULT,
+  APP_CLOSE_CONNECTION
+};
+
+/**
+ * One IO thread: a ring, its registered receive buffers, the connections it
+ * accepted and an eventfd through which workers report finished tasks.
+ */
+class TUringServer::IOThread : public Runnable {
+public:
+  IOThread(TUringServer* server, int number, THRIFT_SOCKET listenSocket)
+    : server_(server),
+      number_(number),
+      listenSocket_(listenSocket),
+      eventFd_(-1),
+      eventValue_(0),
+      multishotAccept_(true),
+      multishotRecv_(true),
+      stopping_(false),
+      tasksDone_(&completedMutex_),
+      stopped_(false) {}
+
+  ~IOThread() override;
+
+  /// Creates the ring and registers buffers; throws if io_uring is unusable.
+  void setup();
+
+  TUringServer* getServer() const { return server_; }
+
+  int getThreadNumber() const { return number_; }
+
+  std::shared_ptr<Thread> getThread() const { return thread_; }
+
+  void setThread(const std::shared_ptr<Thread>& t) { thread_ = t; }
+
+  /// Used by tasks to indicate processing has finished. Safe from any thread.
+  void notify(TConnection* conn);
+
+  /// Enters the completion loop and does not return until a call to stop().
+  void run() override;
+
+  /// Exits the completion loop as soon as possible.
+  void stop();
+
+  void join();
+
+  void armRecv(TConnection* conn);
+  void cancelRecv(TConnection* conn);
+  void armSend(TConnection* conn, const uint8_t* buf, uint32_t len);
+
+  const uint8_t* recvData(uint16_t bid) const { return buffers_.data(bid); }
+  void recycle(uint16_t bid) { buffers_.recycle(bid); }
+
+  void removeConnection(TConnection* conn) { connections_.erase(conn); }
+
+private:
+  void armAccept();
+  void armNotify();
+  void handleAccept(const io_uring_cqe& cqe);
+  void handleNotify(const io_uring_cqe& cqe);
+  void closeAll();
+
+  TUringServer* server_;
+  const int number_;
+  THRIFT_SOCKET listenSocket_;
+  Ring ring_;
+  BufferRing buffers_;
+  int eventFd_;
+  uint64_t eventValue_;
+  bool multishotAccept_;
+  bool multishotRecv_;
+  std::atomic<bool> stopping_;
+
+  /// Connections owned by this thread; only touched by this thread
+  std::unordered_set<TConnection*> connections_;
+
+  /// Connections whose task finished, handed over by worker threads
+  Mutex completedMutex_;
+  std::vector<TConnection*> completed_;
+
+  /// Signalled for each finished task once the loop has stopped
+  Monitor tasksDone_;
+
+  /// Set once the loop no longer reads eventFd_; guarded by completedMutex_
+  bool stopped_;
+
+  std::shared_ptr<Thread> thread_;
+};
+
+/**
+ * Represents a connection that is handled via io_uring. Data received from
+ * the socket is assembled into frames here, and frames are handed to the
+ * processor either inline or through the ThreadManager.
+ */
+class TUringServer::TConnection {
+public:
+  class Task;
+
+  TConnection(IOThread* ioThread, std::shared_ptr<TSocket> socket)
+    : ioThread_(ioThread),
+      server_(ioThread->getServer()),
+      socket_(socket),
+      fd_(socket->getSocketFD()),
+      appState_(APP_READ_FRAME_SIZE),
+      frameBuffer_(nullptr),
+      frameBufferSize_(0),
+      framePos_(0),
+      frameWant_(0),
+      writeBuffer_(nullptr),
+      writeBufferSize_(0),
+      writeBufferPos_(0),
+      recvArmed_(false),
+      recvCancelling_(false),
+      sendInFlight_(false),
+      inCallback_(false),
+      closing_(false),
+      taskExpired_(false),
+      connectionContext_(nullptr) {
+    inputTransport_.reset(new TMemoryBuffer(frameBuffer_, frameBufferSize_));
+    outputTransport_.reset(
+        new TMemoryBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+
+    factoryInputTransport_ = server_->getInputTransportFactory()->getTransport(inputTransport_);
+    factoryOutputTransport_ = server_->getOutputTransportFactory()->getTransport(outputTransport_);
+
+    if (server_->getHeaderTransport()) {
+      inputProtocol_ = server_->getInputProtocolFactory()->getProtocol(factoryInputTransport_,
+                                                                       factoryOutputTransport_);
+      outputProtocol_ = inputProtocol_;
+    } else {
+      inputProtocol_ = server_->getInputProtocolFactory()->getProtocol(factoryInputTransport_);
+      outputProtocol_ = server_->getOutputProtocolFactory()->getProtocol(factoryOutputTransport_);
+    }
+
+    serverEventHandler_ = server_->getEventHandler();
+    if (serverEventHandler_) {
+      connectionContext_ = serverEventHandler_->createContext(inputProtocol_, outputProtocol_);
+    }
+
+    processor_ = server_->getProcessor(inputProtocol_, outputProtocol_, socket_);
+  }
+
+  ~TConnection() { std::free(frameBuffer_); }
+
+  int getSocketFD() const { return fd_; }
+
+  bool isRecvArmed() const { return recvArmed_; }
+  void setRecvArmed(bool armed) { recvArmed_ = armed; }
+  void setSendInFlight(bool inFlight) { sendInFlight_ = inFlight; }
+
+  /// Handles the completion of a receive.
+  void recvDone(const io_uring_cqe& cqe);
+
+  /// Handles the completion of a send.
+  void sendDone(int res);
+
+  /// Called on the IO thread once the task for this connection has finished.
+  void taskDone();
+
+  /**
+   * Starts closing this connection. The object is released once no
+   * submission or task refers to it anymore.
+   */
+  void close();
+
+  /// Marks the pending task as expired; the IO thread will close us.
+  void expire() {
+    taskExpired_ = true;
+    ioThread_->notify(this);
+  }
+
+  std::shared_ptr<TSocket> getTSocket() const { return socket_; }
+  std::shared_ptr<TServerEventHandler> getServerEventHandler() { return serverEventHandler_; }
+  void* getConnectionContext() { return connectionContext_; }
+  IOThread* getIOThread() const { return ioThread_; }
+  TUringAppState getState() const { return appState_; }
+
+private:
+  /// Feeds received bytes into the frame state machine.
+  void consume(const uint8_t* data, size_t len);
+
+  /// Hands a complete frame to the processor.
+  void dispatch();
+
+  /// Queues the processor's output for sending, or starts the next read.
+  void sendResult();
+
+  /// Returns to reading frames, replaying bytes that arrived meanwhile.
+  void readNext();
+
+  /// Frees the connection if nothing refers to it anymore.
+  void maybeRelease();
+
+  /// Whether a request is being processed or its result sent.
+  bool isBusy() const { return appState_ == APP_WAIT_TASK || appState_ == APP_SEND_RESULT; }
+
+  /// Marks entry into a completion handler.
+  void enterCallback() { inCallback_ = true; }
+
+  /// Marks the end of a completion handler; may free the connection.
+  void leaveCallback() {
+    inCallback_ = false;
+    if (closing_) {
+      maybeRelease();
+    }
+  }
+
+  IOThread* ioThread_;
+  TUringServer* server_;
+  std::shared_ptr<TSocket> socket_;
+  int fd_;
+
+  TUringAppState appState_;
+
+  /// Current frame, including its 4 byte length prefix
+  uint8_t* frameBuffer_;
+  uint32_t frameBufferSize_;
+  uint32_t framePos_;
+  uint32_t frameWant_;
+
+  /// Bytes of later (pipelined) requests received while busy with this one
+  std::string backlog_;
+
+  uint8_t* writeBuffer_;
+  uint32_t writeBufferSize_;
+  uint32_t writeBufferPos_;
+
+  bool recvArmed_;
+  /// Set once the receive was cancelled to stop the backlog growing
+  bool recvCancelling_;
+  bool sendInFlight_;
+  /// Set while a completion is being handled, so that we are not freed midway
+  bool inCallback_;
+  bool closing_;
+  std::atomic<bool> taskExpired_;
+
+  std::shared_ptr<TProcessor> processor_;
+  std::shared_ptr<TMemoryBuffer> inputTransport_;
+  std::shared_ptr<TMemoryBuffer> outputTransport_;
+  std::shared_ptr<TTransport> factoryInputTransport_;
+  std::shared_ptr<TTransport> factoryOutputTransport_;
+  std::shared_ptr<TProtocol> inputProtocol_;
+  std::shared_ptr<TProtocol> outputProtocol_;
+  std::shared_ptr<TServerEventHandler> serverEventHandler_;
+  void* connectionContext_;
+};
+
+class TUringServer::TConnection::Task : public Runnable {
+public:
+  Task(std::shared_ptr<TProcessor> processor,
+       std::shared_ptr<TProtocol> input,
+       std::shared_ptr<TProtocol> output,
+       TConnection* connection)
+    : processor_(processor),
+      input_(input),
+      output_(output),
+      connection_(connection),
+      serverEventHandler_(connection_->getServerEventHandler()),
+      connectionContext_(connection_->getConnectionContext()) {}
+
+  void run() override {
+    try {
+      for (;;) {
+        if (serverEventHandler_) {
+          serverEventHandler_->processContext(connectionContext_, connection_->getTSocket());
+        }
+        if (!processor_->process(input_, output_, connectionContext_)
+            || !input_->getTransport()->peek()) {
+          break;
+        }
+      }
+    } catch (const TTransportException& ttx) {
+      TOutput::instance().printf("TUringServer: client died: %s", ttx.what());
+    } catch (const std::bad_alloc&) {
+      TOutput::instance()("TUringServer: caught bad_alloc exception.");
+      exit(1);
+    } catch (const std::exception& x) {
+      TOutput::instance().printf("TUringServer: process() exception: %s: %s",
+                                 typeid(x).name(),
+                                 x.what());
+    } catch (...) {
+      TOutput::instance().printf("TUringServer: unknown exception while processing.");
+    }
+
+    // Hand the connection back to its IO thread
+    connection_->getIOThread()->notify(connection_);
+  }
+
+  TConnection* getTConnection() { return connection_; }
+
+private:
+  std::shared_ptr<TProcessor> processor_;
+  std::shared_ptr<TProtocol> input_;
+  std::shared_ptr<TProtocol> output_;
+  TConnection* connection_;
+  std::shared_ptr<TServerEventHandler> serverEventHandler_;
+  void* connectionContext_;
+};
+
+void TUringServer::TConnection::recvDone(const io_uring_cqe& cqe) {
+  enterCallback();
+  if (cqe.res > 0) {
+    assert(cqe.flags & IORING_CQE_F_BUFFER);
+    auto bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+    if (!closing_) {
+      consume(ioThread_->recvData(bid), static_cast<size_t>(cqe.res));
+    }
+    ioThread_->recycle(bid);
+  } else if (cqe.res == 0) {
+    // Whenever we get here it means a remote disconnect
+    close();
+  } else if (cqe.res == -ECANCELED && !closing_) {
+    // Stopped by cancelRecv(); receiving starts again once no longer busy
+  } else if (cqe.res != -ENOBUFS) {
+    // ENOBUFS only means that all registered buffers were in use; anything
+    // else is a real socket error.
+    if (!closing_ && cqe.res != -ECANCELED) {
+      TOutput::instance().perror("TUringServer: recv() ", -cqe.res);
+    }
+    close();
+  }
+
+  if (!(cqe.flags & IORING_CQE_F_MORE)) {
+    recvArmed_ = false;
+    recvCancelling_ = false;
+    // While busy, later requests wait in the socket rather than backlog_
+    if (!closing_ && !isBusy()) {
+      ioThread_->armRecv(this);
+    }
+  }
+  leaveCallback();
+}
+
+void TUringServer::TConnection::consume(const uint8_t* data, size_t len) {
+  while (len > 0) {
+    if (isBusy()) {
+      // Busy with the previous request; keep the rest for later, but stop
+      // receiving until then, so that a client sending without reading
+      // cannot make it grow without bound
+      if (backlog_.size() + len > server_->getMaxFrameSize() + sizeof(uint32_t)) {
+        TOutput::instance().printf(
+            "TUringServer: more than a frame sent ahead by client %s",
+            socket_->getSocketInfo().c_str());
+        close();
+        return;
+      }
+      backlog_.append(reinterpret_cast<const char*>(data), len);
+      if (recvArmed_ && !recvCancelling_) {
+        recvCancelling_ = true;
+        ioThread_->cancelRecv(this);
+      }
+      return;
+    }
+
+    if (appState_ == APP_READ_FRAME_SIZE) {
+      if (frameBufferSize_ < sizeof(uint32_t)) {
+        auto* newBuffer = static_cast<uint8_t*>(std::realloc(frameBuffer_, sizeof(uint32_t)));
+        if (newBuffer == nullptr) {
+          throw std::bad_alloc();
+        }
+        frameBuffer_ = newBuffer;
+        frameBufferSize_ = sizeof(uint32_t);
+      }
+      size_t fetch = (std::min)(len, sizeof(uint32_t) - framePos_);
+      memcpy(frameBuffer_ + framePos_, data, fetch);
+      framePos_ += static_cast<uint32_t>(fetch);
+      data += fetch;
+      len -= fetch;
+      if (framePos_ < sizeof(uint32_t)) {
+        return;
+      }
+
+      uint32_t size;
+      memcpy(&size, frameBuffer_, sizeof(size));
+      size = ntohl(size);
+      if (size > server_->getMaxFrameSize()) {
+        // Don't allow giant frame sizes.  This prevents bad clients from
+        // causing us to try and allocate a giant buffer.
+        TOutput::instance().printf(
+            "TUringServer: frame size too large "
+            "(%" PRIu32 " > %" PRIu64
+            ") from client %s. "
+            "Remote side not using TFramedTransport?",
+            size,
+            (uint64_t)server_->getMaxFrameSize(),
+            socket_->getSocketInfo().c_str());
+        close();
+        return;
+      }
+
+      frameWant_ = size + sizeof(uint32_t);
+      if (frameWant_ > frameBufferSize_) {
+        // Double the buffer size until it is big enough
+        uint32_t newSize = frameBufferSize_;
+        while (frameWant_ > newSize) {
+          newSize *= 2;
+        }
+        auto* newBuffer = static_cast<uint8_t*>(std::realloc(frameBuffer_, newSize));
+        if (newBuffer == nullptr) {
+          throw std::bad_alloc();
+        }
+        frameBuffer_ = newBuffer;
+        frameBufferSize_ = newSize;
+      }
+      appState_ = APP_READ_REQUEST;
+    }
+
+    size_t fetch = (std::min)(len, static_cast<size_t>(frameWant_ - framePos_));
+    memcpy(frameBuffer_ + framePos_, data, fetch);
+    framePos_ += static_cast<uint32_t>(fetch);
+    data += fetch;
+    len -= fetch;
+
+    if (framePos_ == frameWant_) {
+      if (len > 0) {
+        backlog_.append(reinterpret_cast<const char*>(data), len);
+        len = 0;
+      }
+      dispatch();
+    }
+  }
+}
+
+void TUringServer::TConnection::dispatch() {
+  // We are done reading the request, package the frame into the input
+  // transport and get back some data from the processor
+  if (server_->getHeaderTransport()) {
+    inputTransport_->resetBuffer(frameBuffer_, framePos_);
+    outputTransport_->resetBuffer();
+  } else {
+    inputTransport_->resetBuffer(frameBuffer_ + 4, framePos_ - 4);
+    outputTransport_->resetBuffer();
+
+    // Prepend four bytes of blank space to the buffer so we can
+    // write the frame size there later.
+    outputTransport_->getWritePtr(4);
+    outputTransport_->wroteBytes(4);
+  }
+
+  if (server_->isThreadPoolProcessing()) {
+    std::shared_ptr<Runnable> task = std::shared_ptr<Runnable>(
+        new Task(processor_, inputProtocol_, outputProtocol_, this));
+    appState_ = APP_WAIT_TASK;
+
+    try {
+      server_->addTask(task);
+    } catch (IllegalStateException& ise) {
+      // The ThreadManager is not ready to handle any more tasks (it's probably shutting down).
+      TOutput::instance().printf("IllegalStateException: Server::process() %s", ise.what());
+      appState_ = APP_CLOSE_CONNECTION;
+      close();
+    } catch (TimedOutException& to) {
+      TOutput::instance().printf("[ERROR] TimedOutException: Server::process() %s", to.what());
+      appState_ = APP_CLOSE_CONNECTION;
+      close();
+    }
+    return;
+  }
+
+  try {
+    if (serverEventHandler_) {
+      serverEventHandler_->processContext(connectionContext_, socket_);
+    }
+    processor_->process(inputProtocol_, outputProtocol_, connectionContext_);
+  } catch (const TTransportException& ttx) {
+    TOutput::instance().printf("TUringServer transport error in process(): %s", ttx.what());
+    close();
+    return;
+  } catch (const std::exception& x) {
+    TOutput::instance().printf("Server::process() uncaught exception: %s: %s",
+                               typeid(x).name(),
+                               x.what());
+    close();
+    return;
+  } catch (...) {
+    TOutput::instance().printf("Server::process() unknown exception");
+    close();
+    return;
+  }
+
+  sendResult();
+}
+
+void TUringServer::TConnection::taskDone() {
+  enterCallback();
+  if (taskExpired_ || closing_) {
+    taskExpired_ = false;
+    appState_ = APP_CLOSE_CONNECTION;
+    close();
+  } else {
+    sendResult();
+  }
+  leaveCallback();
+}
+
+void TUringServer::TConnection::sendResult() {
+  // The result has been written into the outputTransport_, so we grab its
+  // contents and hand them to the ring for sending
+  outputTransport_->getBuffer(&writeBuffer_, &writeBufferSize_);
+
+  // 4 bytes were reserved for frame size
+  if (writeBufferSize_ > 4) {
+    auto frameSize = (int32_t)htonl(writeBufferSize_ - 4);
+    memcpy(writeBuffer_, &frameSize, 4);
+
+    writeBufferPos_ = 0;
+    appState_ = APP_SEND_RESULT;
+    ioThread_->armSend(this, writeBuffer_, writeBufferSize_);
+    return;
+  }
+
+  // In this case, the request was oneway and we go right back to reading
+  readNext();
+}
+
+void TUringServer::TConnection::sendDone(int res) {
+  sendInFlight_ = false;
+  enterCallback();
+  if (closing_) {
+    // nothing left to do
+  } else if (res < 0) {
+    TOutput::instance().perror("TUringServer: send() ", -res);
+    close();
+  } else {
+    writeBufferPos_ += static_cast<uint32_t>(res);
+    assert(writeBufferPos_ <= writeBufferSize_);
+    if (writeBufferPos_ < writeBufferSize_) {
+      ioThread_->armSend(this, writeBuffer_ + writeBufferPos_, writeBufferSize_ - writeBufferPos_);
+    } else {
+      ++server_->numResponses_;
+      readNext();
+    }
+  }
+  leaveCallback();
+}
+
+void TUringServer::TConnection::readNext() {
+  writeBuffer_ = nullptr;
+  writeBufferSize_ = 0;
+  writeBufferPos_ = 0;
+
+  appState_ = APP_READ_FRAME_SIZE;
+  framePos_ = 0;
+  frameWant_ = 0;
+
+  if (!backlog_.empty()) {
+    std::string pending;
+    pending.swap(backlog_);
+    consume(reinterpret_cast<const uint8_t*>(pending.data()), pending.size());
+  }
+  if (!closing_ && !recvArmed_) {
+    ioThread_->armRecv(this);
+  }
+}
+
+void TUringServer::TConnection::close() {
+  if (closing_) {
+    return;
+  }
+  closing_ = true;
+
+  // Completes any outstanding receive or send on this socket
+  ::shutdown(fd_, SHUT_RDWR);
+  maybeRelease();
+}
+
+void TUringServer::TConnection::maybeRelease() {
+  if (inCallback_ || recvArmed_ || sendInFlight_ || appState_ == APP_WAIT_TASK) {
+    return;
+  }
+
+  if (serverEventHandler_) {
+    serverEventHandler_->deleteContext(connectionContext_, inputProtocol_, outputProtocol_);
+  }
+  socket_->close();
+  factoryInputTransport_->close();
+  factoryOutputTransport_->close();
+  processor_.reset();
+
+  --server_->numConnections_;
+  ioThread_->removeConnection(this);
+  delete this;
+}
+
+TUringServer::IOThread::~IOThread() {
+  join();
+  closeAll();
+  if (eventFd_ >= 0) {
+    ::close(eventFd_);
+    eventFd_ = -1;
+  }
+}
+
+void TUringServer::IOThread::setup() {
+  ring_.init(server_->getRingEntries());
+  buffers_.init(ring_.fd(), server_->getRecvBufferCount(), server_->getRecvBufferSize());
+
+  eventFd_ = eventfd(0, EFD_CLOEXEC);
+  if (eventFd_ < 0) {
+    throw TException(errnoString("TUringServer eventfd", errno));
+  }
+}
+
+void TUringServer::IOThread::armAccept() {
+  io_uring_sqe* sqe = ring_.getSqe();
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = listenSocket_;
+  sqe->accept_flags = SOCK_CLOEXEC;
+  if (multishotAccept_) {
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  }
+  sqe->user_data = userData(nullptr, OP_ACCEPT);
+}
+
+void TUringServer::IOThread::armNotify() {
+  io_uring_sqe* sqe = ring_.getSqe();
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = eventFd_;
+  sqe->addr = reinterpret_cast<uint64_t>(&eventValue_);
+  sqe->len = sizeof(eventValue_);
+  sqe->user_data = userData(nullptr, OP_NOTIFY);
+}
+
+void TUringServer::IOThread::armRecv(TConnection* conn) {
+  io_uring_sqe* sqe = ring_.getSqe();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = conn->getSocketFD();
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = BufferRing::GROUP_ID;
+  if (multishotRecv_) {
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+  }
+  sqe->user_data = userData(conn, OP_RECV);
+  conn->setRecvArmed(true);
+}
+
+void TUringServer::IOThread::cancelRecv(TConnection* conn) {
+  io_uring_sqe* sqe = ring_.getSqe();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->addr = userData(conn, OP_RECV);
+  // The connection may be gone by the time this completes
+  sqe->user_data = userData(nullptr, OP_CANCEL);
+}
+
+void TUringServer::IOThread::armSend(TConnection* conn, const uint8_t* buf, uint32_t len) {
+  io_uring_sqe* sqe = ring_.getSqe();
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = conn->getSocketFD();
+  sqe->addr = reinterpret_cast<uint64_t>(buf);
+  sqe->len = len;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = userData(conn, OP_SEND);
+  conn->setSendInFlight(true);
+}
+
+void TUringServer::IOThread::handleAccept(const io_uring_cqe& cqe) {
+  bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+  if (cqe.res == -EINVAL && multishotAccept_) {
+    // Kernel without multishot accept; use one submission per connection
+    multishotAccept_ = false;
+  } else if (cqe.res < 0) {
+    if (!stopping_ && cqe.res != -ECANCELED) {
+      TOutput::instance().perror("TUringServer: accept() ", -cqe.res);
+    }
+  } else {
+    THRIFT_SOCKET clientSocket = cqe.res;
+    if (server_->getNumConnections() >= server_->getMaxConnections()) {
+      ::THRIFT_CLOSESOCKET(clientSocket);
+    } else {
+      int one = 1;
+      // Not a TCP socket when listening on a unix domain socket; ignore
+      setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+      TConnection* conn = new TConnection(this, std::make_shared<TSocket>(clientSocket));
+      connections_.insert(conn);
+      ++server_->numConnections_;
+      armRecv(conn);
+    }
+  }
+
+  if (!more && !stopping_) {
+    armAccept();
+  }
+}
+
+void TUringServer::IOThread::handleNotify(const io_uring_cqe& cqe) {
+  (void)cqe;
+  std::vector<TConnection*> completed;
+  {
+    Guard g(completedMutex_);
+    completed.swap(completed_);
+  }
+  for (auto conn : completed) {
+    conn->taskDone();
+  }
+  if (!stopping_) {
+    armNotify();
+  }
+}
+
+void TUringServer::IOThread::notify(TConnection* conn) {
+  bool wake;
+  {
+    Guard g(completedMutex_);
+    wake = completed_.empty();
+    completed_.push_back(conn);
+    if (stopped_) {
+      // closeAll() is waiting for this, and eventFd_ may be closed
+      tasksDone_.notify();
+      return;
+    }
+  }
+  // Only the first completion of a batch needs to wake the IO thread
+  if (wake) {
+    uint64_t one = 1;
+    if (::write(eventFd_, &one, sizeof(one)) != sizeof(one)) {
+      TOutput::instance().perror("TUringServer: eventfd write() ", errno);
+    }
+  }
+}
+
+void TUringServer::IOThread::run() {
+  armNotify();
+  if (listenSocket_ != THRIFT_INVALID_SOCKET) {
+    armAccept();
+  }
+
+  TOutput::instance().printf("TUringServer: IO thread #%d entering loop...", number_);
+  while (!stopping_) {
+    ring_.submit(1);
+    server_->numEnterCalls_ += ring_.takeEnterCalls();
+
+    io_uring_cqe cqe;
+    while (!stopping_ && ring_.popCqe(cqe)) {
+      auto op = static_cast<TUringOp>(cqe.user_data & OP_MASK);
+      auto* conn = reinterpret_cast<TConnection*>(static_cast<uintptr_t>(cqe.user_data & ~OP_MASK));
+      switch (op) {
+      case OP_ACCEPT:
+        handleAccept(cqe);
+        break;
+      case OP_NOTIFY:
+        handleNotify(cqe);
+        break;
+      case OP_RECV:
+        if (cqe.res == -EINVAL && multishotRecv_) {
+          // Kernel without multishot receive; use one submission per read
+          multishotRecv_ = false;
+          conn->setRecvArmed(false);
+          armRecv(conn);
+        } else {
+          conn->recvDone(cqe);
+        }
+        break;
+      case OP_SEND:
+        conn->sendDone(cqe.res);
+        break;
+      case OP_CANCEL:
+        // The cancelled receive completes on its own
+        break;
+      default:
+        TOutput::instance().printf("TUringServer: unexpected completion %" PRIu64, cqe.user_data);
+        assert(0);
+      }
+    }
+  }
+
+  closeAll();
+  TOutput::instance().printf("TUringServer: IO thread #%d run() done!", number_);
+}
+
+void TUringServer::IOThread::closeAll() {
+  // Tearing down the ring cancels every outstanding submission, after which
+  // connections that are not waiting on a task can be freed directly.
+  ring_.destroy();
+  buffers_.destroy();
+  std::vector<TConnection*> connections(connections_.begin(), connections_.end());
+  for (auto conn : connections) {
+    conn->setRecvArmed(false);
+    conn->setSendInFlight(false);
+    conn->close();
+  }
+
+  // The rest wait on tasks, which refer to them and to this thread; each is
+  // freed once its task is done
+  {
+    Guard g(completedMutex_);
+    stopped_ = true;
+  }
+  while (!connections_.empty()) {
+    std::vector<TConnection*> completed;
+    {
+      Guard g(completedMutex_);
+      while (completed_.empty()) {
+        tasksDone_.waitForever();
+      }
+      completed.swap(completed_);
+    }
+    for (auto conn : completed) {
+      conn->taskDone();
+    }
+  }
+}
+
+void TUringServer::IOThread::stop() {
+  stopping_ = true;
+  if (eventFd_ >= 0) {
+    uint64_t one = 1;
+    if (::write(eventFd_, &one, sizeof(one)) != sizeof(one)) {
+      TOutput::instance().perror("TUringServer: eventfd write() ", errno);
+    }
+  }
+}
+
+void TUringServer::IOThread::join() {
+  // If this was a thread created by a factory (not the thread that called
+  // serve()), we join() it to make sure we shut down fully.
+  if (thread_) {
+    try {
+      thread_->join();
+    } catch (...) {
+      // swallow everything
+    }
+  }
+}
+
+TUringServer::~TUringServer() {
+  // The IOThread objects have shared_ptrs to the Thread objects and the
+  // Thread objects have shared_ptrs to the IOThread objects (as runnable)
+  // so these objects will never deallocate without help.
+  while (!ioThreads_.empty()) {
+    std::shared_ptr<IOThread> iot = ioThreads_.back();
+    ioThreads_.pop_back();
+    iot->join();
+    iot->setThread(std::shared_ptr<Thread>());
+  }
+}
+
+bool TUringServer::isSupported() {
+  try {
+    Ring ring;
+    ring.init(2);
+    BufferRing buffers;
+    buffers.init(ring.fd(), 1, 64);
+    return true;
+  } catch (const TException&) {
+    return false;
+  }
+}
+
+bool TUringServer::getHeaderTransport() {
+  // Currently if there is no output protocol factory,
+  // we assume header transport (without having to create
+  // a new transport and check)
+  return getOutputProtocolFactory() == nullptr;
+}
+
+void TUringServer::setThreadManager(std::shared_ptr<ThreadManager> threadManager) {
+  threadManager_ = threadManager;
+  if (threadManager) {
+    threadManager->setExpireCallback(
+        std::bind(&TUringServer::expireClose, this, std::placeholders::_1));
+    threadPoolProcessing_ = true;
+  } else {
+    threadPoolProcessing_ = false;
+  }
+}
+
+void TUringServer::expireClose(std::shared_ptr<Runnable> task) {
+  TConnection* connection = static_cast<TConnection::Task*>(task.get())->getTConnection();
+  assert(connection && connection->getState() == APP_WAIT_TASK);
+  connection->expire();
+}
+
+void TUringServer::stop() {
+  for (auto& ioThread : ioThreads_) {
+    ioThread->stop();
+  }
+}
+
+void TUringServer::serve() {
+  serverTransport_->listen();
+  THRIFT_SOCKET listenSocket = serverTransport_->getSocketFD();
+
+  // The rings wait for connections themselves; a non-blocking listen socket
+  // would make older kernels complete accepts with EAGAIN.
+  int flags = THRIFT_FCNTL(listenSocket, THRIFT_F_GETFL, 0);
+  if (flags != -1) {
+    THRIFT_FCNTL(listenSocket, THRIFT_F_SETFL, flags & ~THRIFT_O_NONBLOCK);
+  }
+
+  if (!numIOThreads_) {
+    numIOThreads_ = DEFAULT_IO_THREADS;
+  }
+  for (uint32_t id = 0; id < numIOThreads_; ++id) {
+    // every IO thread accepts on the shared listen socket
+    shared_ptr<IOThread> thread(new IOThread(this, id, listenSocket));
+    thread->setup();
+    ioThreads_.push_back(thread);
+  }
+
+  // Notify handler of the preServe event
+  if (eventHandler_) {
+    eventHandler_->preServe();
+  }
+
+  TOutput::instance().printf("TUringServer: Serving with %d io threads.", ioThreads_.size());
+
+  // Launch all the secondary IO threads in separate threads
+  if (ioThreads_.size() > 1) {
+    ioThreadFactory_.reset(new ThreadFactory(false));
+    for (uint32_t i = 1; i < ioThreads_.size(); ++i) {
+      shared_ptr<Thread> thread = ioThreadFactory_->newThread(ioThreads_[i]);
+      ioThreads_[i]->setThread(thread);
+      thread->start();
+    }
+  }
+
+  // Run the primary IO thread loop in our main thread; this will only
+  // return when the server is shutting down.
+  ioThreads_[0]->run();
+
+  for (uint32_t i = 0; i < ioThreads_.size(); ++i) {
+    ioThreads_[i]->join();
+  }
+  serverTransport_->close();
+}
+}
+}
+} // apache::thrift::server
@@ -0,0 +1,340 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_TURINGSERVER_H_
+#define _THRIFT_SERVER_TURINGSERVER_H_ 1
+
+#include <thrift/Thrift.h>
+#include <thrift/server/TServer.h>
+#include <thrift/transport/TNonblockingServerTransport.h>
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/concurrency/ThreadFactory.h>
+#include <atomic>
+#include <climits>
+#include <memory>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+using apache::thrift::transport::TNonblockingServerTransport;
+using apache::thrift::concurrency::Runnable;
+using apache::thrift::concurrency::ThreadManager;
+using apache::thrift::concurrency::ThreadFactory;
+
+/**
+ * This is a non-blocking server for Linux that drives all socket IO through
+ * io_uring rather than libevent. Like TNonblockingServer it assumes that all
+ * requests are framed with a 4 byte length indicator and writes responses
+ * using the same framing, and it can hand requests off to a ThreadManager.
+ *
+ * Each IO thread owns one ring. Connections are accepted with a multishot
+ * accept on the shared listen socket and read with a multishot receive that
+ * selects from a kernel-registered buffer ring, so a busy connection costs
+ * one io_uring_enter() per loop iteration instead of a readiness wakeup plus
+ * one recv() per read. A connection stays on the IO thread that accepted it.
+ *
+ * Requires Linux 5.19 or newer (multishot receive needs 6.0; older kernels
+ * fall back to single-shot receives). Use isSupported() to probe at runtime.
+ */
+class TUringServer : public TServer {
+private:
+  class TConnection;
+  class IOThread;
+
+  /// Default limit on frame size
+  static const int MAX_FRAME_SIZE = 256 * 1024 * 1024;
+
+  /// Default limit on total number of connected sockets
+  static const int MAX_CONNECTIONS = INT_MAX;
+
+  /// # of IO threads to use by default
+  static const int DEFAULT_IO_THREADS = 1;
+
+  /// Default submission queue depth of each ring
+  static const int DEFAULT_RING_ENTRIES = 1024;
+
+  /// Default size of each registered receive buffer
+  static const int DEFAULT_RECV_BUFFER_SIZE = 16 * 1024;
+
+  /// Default number of registered receive buffers per IO thread
+  static const int DEFAULT_RECV_BUFFER_COUNT = 256;
+
+  /// Default size of write buffer
+  static const int WRITE_BUFFER_DEFAULT_SIZE = 1024;
+
+  /// # of IO threads this server will use
+  size_t numIOThreads_;
+
+  /// Submission queue depth of each ring
+  uint32_t ringEntries_;
+
+  /// Size of each registered receive buffer
+  uint32_t recvBufferSize_;
+
+  /// Number of registered receive buffers per IO thread (a power of two)
+  uint32_t recvBufferCount_;
+
+  /// For processing via thread pool, may be nullptr
+  std::shared_ptr<ThreadManager> threadManager_;
+
+  /// Is thread pool processing?
+  bool threadPoolProcessing_;
+
+  /// Factory to create the secondary IO threads
+  std::shared_ptr<ThreadFactory> ioThreadFactory_;
+
+  /// IO threads; thread 0 runs inside serve()
+  std::vector<std::shared_ptr<IOThread> > ioThreads_;
+
+  /// Limit for number of open connections
+  size_t maxConnections_;
+
+  /// Limit for frame size
+  size_t maxFrameSize_;
+
+  /// Time in milliseconds before an unperformed task expires (0 == infinite).
+  int64_t taskExpireTime_;
+
+  /// Starting size of the per-connection write buffer
+  size_t writeBufferDefaultSize_;
+
+  /// Number of connections currently open
+  std::atomic<size_t> numConnections_;
+
+  /// Number of responses completely written since the server started
+  std::atomic<uint64_t> numResponses_;
+
+  /// Number of io_uring_enter() calls made by all IO threads
+  std::atomic<uint64_t> numEnterCalls_;
+
+  std::shared_ptr<TNonblockingServerTransport> serverTransport_;
+
+  void init() {
+    numIOThreads_ = DEFAULT_IO_THREADS;
+    ringEntries_ = DEFAULT_RING_ENTRIES;
+    recvBufferSize_ = DEFAULT_RECV_BUFFER_SIZE;
+    recvBufferCount_ = DEFAULT_RECV_BUFFER_COUNT;
+    threadPoolProcessing_ = false;
+    maxConnections_ = MAX_CONNECTIONS;
+    maxFrameSize_ = MAX_FRAME_SIZE;
+    taskExpireTime_ = 0;
+    writeBufferDefaultSize_ = WRITE_BUFFER_DEFAULT_SIZE;
+    numConnections_ = 0;
+    numResponses_ = 0;
+    numEnterCalls_ = 0;
+  }
+
+public:
+  TUringServer(const std::shared_ptr<TProcessorFactory>& processorFactory,
+               const std::shared_ptr<TNonblockingServerTransport>& serverTransport)
+    : TServer(processorFactory), serverTransport_(serverTransport) {
+    init();
+  }
+
+  TUringServer(const std::shared_ptr<TProcessor>& processor,
+               const std::shared_ptr<TNonblockingServerTransport>& serverTransport)
+    : TServer(processor), serverTransport_(serverTransport) {
+    init();
+  }
+
+  TUringServer(const std::shared_ptr<TProcessorFactory>& processorFactory,
+               const std::shared_ptr<TProtocolFactory>& protocolFactory,
+               const std::shared_ptr<TNonblockingServerTransport>& serverTransport,
+               const std::shared_ptr<ThreadManager>& threadManager
+               = std::shared_ptr<ThreadManager>())
+    : TServer(processorFactory), serverTransport_(serverTransport) {
+    init();
+
+    setInputProtocolFactory(protocolFactory);
+    setOutputProtocolFactory(protocolFactory);
+    setThreadManager(threadManager);
+  }
+
+  TUringServer(const std::shared_ptr<TProcessor>& processor,
+               const std::shared_ptr<TProtocolFactory>& protocolFactory,
+               const std::shared_ptr<TNonblockingServerTransport>& serverTransport,
+               const std::shared_ptr<ThreadManager>& threadManager
+               = std::shared_ptr<ThreadManager>())
+    : TServer(processor), serverTransport_(serverTransport) {
+    init();
+
+    setInputProtocolFactory(protocolFactory);
+    setOutputProtocolFactory(protocolFactory);
+    setThreadManager(threadManager);
+  }
+
+  ~TUringServer() override;
+
+  /**
+   * Checks whether the running kernel provides the io_uring features this
+   * server depends on.
+   *
+   * @return true if serve() can be expected to work.
+   */
+  static bool isSupported();
+
+  void setThreadManager(std::shared_ptr<ThreadManager> threadManager);
+
+  std::shared_ptr<ThreadManager> getThreadManager() { return threadManager_; }
+
+  bool isThreadPoolProcessing() const { return threadPoolProcessing_; }
+
+  int getListenPort() { return serverTransport_->getListenPort(); }
+
+  /**
+   * Sets the number of IO threads (and rings) used by this server. Can only
+   * be used before the call to serve() and has no effect afterwards.
+   */
+  void setNumIOThreads(size_t numThreads) { numIOThreads_ = numThreads; }
+
+  /** Return the number of IO threads used by this server. */
+  size_t getNumIOThreads() const { return numIOThreads_; }
+
+  /** Get the submission queue depth of each ring. */
+  uint32_t getRingEntries() const { return ringEntries_; }
+
+  /** Set the submission queue depth of each ring; must be set before serve(). */
+  void setRingEntries(uint32_t entries) { ringEntries_ = entries; }
+
+  /** Get the size of each registered receive buffer. */
+  uint32_t getRecvBufferSize() const { return recvBufferSize_; }
+
+  /** Set the size of each registered receive buffer; must be set before serve(). */
+  void setRecvBufferSize(uint32_t size) { recvBufferSize_ = size; }
+
+  /** Get the number of registered receive buffers per IO thread. */
+  uint32_t getRecvBufferCount() const { return recvBufferCount_; }
+
+  /**
+   * Set the number of registered receive buffers per IO thread. The kernel
+   * requires a power of two no larger than 32768; must be set before serve().
+   */
+  void setRecvBufferCount(uint32_t count) { recvBufferCount_ = count; }
+
+  /**
+   * Get the maximum # of connections allowed before new ones are dropped.
+   *
+   * @return current setting.
+   */
+  size_t getMaxConnections() const { return maxConnections_; }
+
+  /**
+   * Set the maximum # of connections allowed before new ones are dropped.
+   *
+   * @param maxConnections new setting for maximum # of connections.
+   */
+  void setMaxConnections(size_t maxConnections) { maxConnections_ = maxConnections; }
+
+  /**
+   * Get the maximum allowed frame size.
+   *
+   * If a client tries to send a message larger than this limit,
+   * its connection will be closed.
+   *
+   * @return Maxium frame size, in bytes.
+   */
+  size_t getMaxFrameSize() const { return maxFrameSize_; }
+
+  /**
+   * Set the maximum allowed frame size.
+   *
+   * @param maxFrameSize The new maximum frame size.
+   */
+  void setMaxFrameSize(size_t maxFrameSize) { maxFrameSize_ = maxFrameSize; }
+
+  /**
+   * Get the time in milliseconds after which a task expires (0 == infinite).
+   *
+   * @return a 64-bit time in milliseconds.
+   */
+  int64_t getTaskExpireTime() const { return taskExpireTime_; }
+
+  /**
+   * Set the time in milliseconds after which a task expires (0 == infinite).
+   *
+   * @param taskExpireTime a 64-bit time in milliseconds.
+   */
+  void setTaskExpireTime(int64_t taskExpireTime) { taskExpireTime_ = taskExpireTime; }
+
+  /**
+   * Get the starting size of a connection's write buffer.
+   *
+   * @return # bytes we initialize a connection's write buffer to.
+   */
+  size_t getWriteBufferDefaultSize() const { return writeBufferDefaultSize_; }
+
+  /**
+   * Set the starting size of a connection's write buffer.
+   *
+   * @param size # bytes we initialize a connection's write buffer to.
+   */
+  void setWriteBufferDefaultSize(size_t size) { writeBufferDefaultSize_ = size; }
+
+  /**
+   * Return the count of sockets currently connected to.
+   *
+   * @return count of connected sockets.
+   */
+  size_t getNumConnections() const { return numConnections_; }
+
+  /**
+   * Return the number of responses written since the server started.
+   * Together with getNumEnterCalls() this gives the system calls per RPC.
+   */
+  uint64_t getNumResponses() const { return numResponses_; }
+
+  /** Return the number of io_uring_enter() calls made by all IO threads. */
+  uint64_t getNumEnterCalls() const { return numEnterCalls_; }
+
+  /**
+   * Main workhorse function, starts up the server listening on a port and
+   * loops over the completion queue of the first ring.
+   */
+  void serve() override;
+
+  /**
+   * Causes the server to terminate gracefully (can be called from any thread).
+   */
+  void stop() override;
+
+  /** Some transports, like THeaderTransport, require passing through
+   * the framing size instead of stripping it.
+   */
+  bool getHeaderTransport();
+
+private:
+  void addTask(std::shared_ptr<Runnable> task) {
+    threadManager_->add(task, 0LL, taskExpireTime_);
+  }
+
+  /**
+   * Callback function that the threadmanager calls when a task reaches
+   * its expiration time.  It is needed to clean up the expired connection.
+   *
+   * @param task the runnable associated with the expired task.
+   */
+  void expireClose(std::shared_ptr<Runnable> task);
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TURINGSERVER_H_
@@ -89,16 +89,19 @@ void TBufferedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
   // policy would require predicting the size of future writes, so we're just
   // going to always eschew syscalls if we have less than 2N bytes to write.
 
-  // The case where we have to do two syscalls.
+  // The case where we hand both to the underlying transport without copying,
+  // in one vectored write (a single syscall for transports like TSocket).
   // This case also covers the case where the buffer is empty,
   // but it is clearer (I think) to think of it as two separate cases.
   if ((have_bytes + len >= 2 * wBufSize_) || (have_bytes == 0)) {
-    // TODO(dreiss): writev
+    // Reset wBase_ first so the buffer is sane if the write throws
+    wBase_ = wBuf_.get();
     if (have_bytes > 0) {
-      transport_->write(wBuf_.get(), have_bytes);
+      TIOVec iov[2] = {{wBuf_.get(), have_bytes}, {buf, len}};
+      transport_->write_iov(iov, 2);
+    } else {
+      transport_->write(buf, len);
     }
-    transport_->write(buf, len);
-    wBase_ = wBuf_.get();
     return;
   }
 
@@ -239,25 +242,42 @@ void TFramedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
   while (new_size < len + have) {
     new_size = new_size > 0 ? new_size * 2 : 1;
   }
+  resizeWriteBuffer(new_size);
+
+  // Copy the data into the new buffer.
+  memcpy(wBase_, buf, len);
+  wBase_ += len;
+}
+
+void TFramedTransport::reserve(uint32_t len) {
+  if (len <= static_cast<uint32_t>(wBound_ - wBase_)) {
+    return;
+  }
+  auto have = static_cast<uint32_t>(wBase_ - wBuf_.get());
+  if (len + have < have /* overflow */ || len + have > 0x7fffffff) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "Attempted to write over 2 GB to TFramedTransport.");
+  }
+  resizeWriteBuffer(have + len);
+}
+
+void TFramedTransport::resizeWriteBuffer(uint32_t newSize) {
+  auto have = static_cast<uint32_t>(wBase_ - wBuf_.get());
 
   // TODO(dreiss): Consider modifying this class to use malloc/free
   // so we can use realloc here.
 
   // Allocate new buffer.
-  auto* new_buf = new uint8_t[new_size];
+  auto* new_buf = new uint8_t[newSize];
 
   // Copy the old buffer to the new one.
   memcpy(new_buf, wBuf_.get(), have);
 
   // Now point buf to the new one.
   wBuf_.reset(new_buf);
-  wBufSize_ = new_size;
+  wBufSize_ = newSize;
   wBase_ = wBuf_.get() + have;
   wBound_ = wBuf_.get() + wBufSize_;
-
-  // Copy the data into the new buffer.
-  memcpy(wBase_, buf, len);
-  wBase_ += len;
 }
 
 void TFramedTransport::flush() {
@@ -368,7 +388,7 @@ uint32_t TMemoryBuffer::readAppendToString(std::string& str, uint32_t len) {
   return give;
 }
 
-void TMemoryBuffer::ensureCanWrite(uint32_t len) {
+void TMemoryBuffer::ensureCanWrite(uint32_t len, bool exact) {
   // Check available space
   uint32_t avail = available_write();
   if (len <= avail) {
@@ -387,8 +407,9 @@ void TMemoryBuffer::ensureCanWrite(uint32_t len) {
                               "Internal buffer size overflow when requesting a buffer of size " + std::to_string(required_buffer_size));
   }
 
-  // Always grow to the next bigger power of two:
-  const double suggested_buffer_size = std::exp2(std::ceil(std::log2(required_buffer_size)));
+  // Grow to the next bigger power of two:
+  const double suggested_buffer_size = exact ? static_cast<double>(required_buffer_size)
+                                             : std::exp2(std::ceil(std::log2(required_buffer_size)));
   // Unless the power of two exceeds maxBufferSize_:
   const uint64_t new_size = static_cast<uint64_t>((std::min)(suggested_buffer_size, static_cast<double>(maxBufferSize_)));
 
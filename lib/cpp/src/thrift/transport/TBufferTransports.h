@@ -366,6 +366,14 @@ public:
 
   bool peek() override { return (rBase_ < rBound_) || transport_->peek(); }
 
+  /**
+   * The frame is read as a whole, and its buffer is only reused for the next
+   * one, unless a reclaim threshold lets readEnd() free it.
+   */
+  bool isBorrowStable() const override {
+    return bufReclaimThresh_ == (std::numeric_limits<uint32_t>::max)();
+  }
+
   void close() override {
     flush();
     transport_->close();
@@ -375,6 +383,13 @@ public:
 
   void writeSlow(const uint8_t* buf, uint32_t len) override;
 
+  /**
+   * Makes room in the frame to write len more bytes, growing the buffer to
+   * exactly the size needed, so a message of known size is written without
+   * the buffer doubling and copying as it fills.
+   */
+  void reserve(uint32_t len);
+
   void flush() override;
 
   void onewayComplete() override { transport_->onewayComplete(); }
@@ -417,6 +432,11 @@ protected:
    */
   virtual bool readFrame();
 
+  /**
+   * Moves what has been written so far into a new write buffer of newSize.
+   */
+  void resizeWriteBuffer(uint32_t newSize);
+
   void initPointers() {
     setReadBuffer(nullptr, 0);
     setWriteBuffer(wBuf_.get(), wBufSize_);
@@ -580,6 +600,8 @@ public:
 
   bool peek() override { return (rBase_ < wBase_); }
 
+  bool isBorrowStable() const override { return true; }
+
   void open() override {}
 
   void close() override {}
@@ -623,17 +645,27 @@ public:
 
   /// See constructor documentation.
   void resetBuffer(uint8_t* buf, uint32_t sz, MemoryPolicy policy = OBSERVE) {
+    // Observing or taking over a buffer is done in place, as it is how
+    // servers and codecs reuse one TMemoryBuffer for every message, and a
+    // temporary TMemoryBuffer would allocate a TConfiguration each time.
+    if (policy == OBSERVE || policy == TAKE_OWNERSHIP) {
+      if (buf == nullptr && sz != 0) {
+        throw TTransportException(TTransportException::BAD_ARGS,
+                                  "TMemoryBuffer given null buffer with non-zero size.");
+      }
+      uint8_t* old = owner_ ? buffer_ : nullptr;
+      uint32_t maxBufferSize = maxBufferSize_;
+      initCommon(buf, sz, policy == TAKE_OWNERSHIP, sz);
+      maxBufferSize_ = maxBufferSize;
+      if (old != buf) {
+        std::free(old);
+      }
+      return;
+    }
+
     // Use a variant of the copy-and-swap trick for assignment operators.
-    // This is sub-optimal in terms of performance for two reasons:
-    //   1/ The constructing and swapping of the (small) values
-    //      in the temporary object takes some time, and is not necessary.
-    //   2/ If policy == COPY, we allocate the new buffer before
-    //      freeing the old one, precluding the possibility of
-    //      reusing that memory.
-    // I doubt that either of these problems could be optimized away,
-    // but the second is probably no a common case, and the first is minor.
-    // I don't expect resetBuffer to be a common operation, so I'm willing to
-    // bite the performance bullet to make the method this simple.
+    // If policy == COPY, we allocate the new buffer before freeing the old
+    // one, precluding the possibility of reusing that memory.
 
     // Construct the new buffer.
     TMemoryBuffer new_buffer(buf, sz, policy);
@@ -697,6 +729,12 @@ public:
   // that had been provided by getWritePtr().
   void wroteBytes(uint32_t len);
 
+  // Makes room to write 'len' more bytes.  Unlike the growth on write, which
+  // doubles the buffer, this grows it to exactly the size needed, so a
+  // message of known size, e.g. from a generated serializedSize<Protocol>(),
+  // is written with at most one allocation and no copying.
+  void reserve(uint32_t len) { ensureCanWrite(len, true); }
+
   /*
    * TVirtualTransport provides a default implementation of readAll().
    * We want to use the TBufferBase version instead.
@@ -741,7 +779,8 @@ protected:
   }
 
   // Make sure there's at least 'len' bytes available for writing.
-  void ensureCanWrite(uint32_t len);
+  // Unless exact, the buffer grows to the next power of two.
+  void ensureCanWrite(uint32_t len, bool exact = false);
 
   // Compute the position and available data for reading.
   void computeRead(uint32_t len, uint8_t** out_start, uint32_t* out_give);
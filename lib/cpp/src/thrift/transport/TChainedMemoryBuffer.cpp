@@ -0,0 +1,242 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include <thrift/transport/TChainedMemoryBuffer.h>
+
+using apache::thrift::concurrency::Guard;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+TMemorySegmentPool::TMemorySegmentPool(uint32_t segmentSize, uint32_t maxFree)
+  : segmentSize_(segmentSize), maxFree_(maxFree) {
+  if (segmentSize == 0) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TMemorySegmentPool segment size must not be 0");
+  }
+}
+
+TMemorySegmentPool::~TMemorySegmentPool() {
+  for (uint8_t* segment : free_) {
+    delete[] segment;
+  }
+}
+
+uint8_t* TMemorySegmentPool::allocate() {
+  {
+    Guard g(mutex_);
+    if (!free_.empty()) {
+      uint8_t* segment = free_.back();
+      free_.pop_back();
+      return segment;
+    }
+  }
+  return new uint8_t[segmentSize_];
+}
+
+void TMemorySegmentPool::release(uint8_t* segment) {
+  {
+    Guard g(mutex_);
+    if (free_.size() < maxFree_) {
+      free_.push_back(segment);
+      return;
+    }
+  }
+  delete[] segment;
+}
+
+uint32_t TMemorySegmentPool::getFreeCount() const {
+  Guard g(mutex_);
+  return static_cast<uint32_t>(free_.size());
+}
+
+std::shared_ptr<TMemorySegmentPool> TMemorySegmentPool::getDefault() {
+  static std::shared_ptr<TMemorySegmentPool> pool(new TMemorySegmentPool());
+  return pool;
+}
+
+TChainedMemoryBuffer::TChainedMemoryBuffer(std::shared_ptr<TMemorySegmentPool> pool,
+                                           std::shared_ptr<TConfiguration> config)
+  : TVirtualTransport(config),
+    pool_(pool ? pool : TMemorySegmentPool::getDefault()),
+    segmentSize_(pool_->getSegmentSize()),
+    releasedSegments_(0) {
+}
+
+TChainedMemoryBuffer::~TChainedMemoryBuffer() {
+  for (uint8_t* segment : segments_) {
+    pool_->release(segment);
+  }
+}
+
+uint32_t TChainedMemoryBuffer::available_read() const {
+  if (segments_.empty()) {
+    return 0;
+  }
+  if (segments_.size() == 1) {
+    return static_cast<uint32_t>(wBase_ - rBase_);
+  }
+  // writeSlow() keeps the total within a uint32_t
+  return static_cast<uint32_t>((segments_.front() + segmentSize_ - rBase_)
+                               + (segments_.size() - 2) * segmentSize_
+                               + (wBase_ - segments_.back()));
+}
+
+void TChainedMemoryBuffer::getIOVecs(std::vector<TIOVec>& iov) const {
+  size_t last = segments_.size() - 1;
+  for (size_t i = 0; i < segments_.size(); ++i) {
+    const uint8_t* start = (i == 0) ? rBase_ : segments_[i];
+    const uint8_t* end = (i == last) ? wBase_ : segments_[i] + segmentSize_;
+    if (end > start) {
+      TIOVec vec = {start, static_cast<uint32_t>(end - start)};
+      iov.push_back(vec);
+    }
+  }
+}
+
+void TChainedMemoryBuffer::writeTo(TTransport& transport) {
+  std::vector<TIOVec> iov;
+  iov.reserve(segments_.size());
+  getIOVecs(iov);
+  if (!iov.empty()) {
+    transport.write_iov(iov.data(), static_cast<uint32_t>(iov.size()));
+  }
+  resetBuffer();
+}
+
+std::string TChainedMemoryBuffer::getBufferAsString() const {
+  std::vector<TIOVec> iov;
+  getIOVecs(iov);
+  std::string str;
+  str.reserve(available_read());
+  for (const TIOVec& vec : iov) {
+    str.append(reinterpret_cast<const char*>(vec.base), vec.len);
+  }
+  return str;
+}
+
+void TChainedMemoryBuffer::resetBuffer() {
+  while (segments_.size() > 1) {
+    pool_->release(segments_.back());
+    segments_.pop_back();
+  }
+  releasedSegments_ = 0;
+  if (!segments_.empty()) {
+    setReadBuffer(segments_.front(), 0);
+    setWriteBuffer(segments_.front(), segmentSize_);
+  }
+}
+
+uint32_t TChainedMemoryBuffer::readEnd() {
+  uint32_t bytes = 0;
+  if (!segments_.empty()) {
+    bytes = static_cast<uint32_t>(releasedSegments_ * segmentSize_
+                                  + (rBase_ - segments_.front()));
+    if (available_read() == 0) {
+      resetBuffer();
+    }
+  }
+  resetConsumedMessageSize();
+  return bytes;
+}
+
+uint32_t TChainedMemoryBuffer::writeEnd() {
+  if (segments_.empty()) {
+    return 0;
+  }
+  return static_cast<uint32_t>((releasedSegments_ + segments_.size() - 1) * segmentSize_
+                               + (wBase_ - segments_.back()));
+}
+
+void TChainedMemoryBuffer::nextReadSegment() {
+  pool_->release(segments_.front());
+  segments_.pop_front();
+  ++releasedSegments_;
+  setReadBuffer(segments_.front(), static_cast<uint32_t>(readBound() - segments_.front()));
+}
+
+uint32_t TChainedMemoryBuffer::readSlow(uint8_t* buf, uint32_t len) {
+  uint32_t got = 0;
+  while (got < len && !segments_.empty()) {
+    rBound_ = readBound();
+    if (rBase_ == rBound_) {
+      if (segments_.size() == 1) {
+        break;
+      }
+      nextReadSegment();
+    }
+    auto give = static_cast<uint32_t>((std::min)(static_cast<ptrdiff_t>(len - got),
+                                                 rBound_ - rBase_));
+    std::memcpy(buf + got, rBase_, give);
+    rBase_ += give;
+    got += give;
+  }
+  return got;
+}
+
+void TChainedMemoryBuffer::writeSlow(const uint8_t* buf, uint32_t len) {
+  if (static_cast<uint64_t>(writeEnd()) + len > (std::numeric_limits<uint32_t>::max)()) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TChainedMemoryBuffer would grow past 4 GB");
+  }
+  while (len > 0) {
+    if (wBase_ == wBound_) {
+      uint8_t* segment = pool_->allocate();
+      try {
+        segments_.push_back(segment);
+      } catch (...) {
+        pool_->release(segment);
+        throw;
+      }
+      setWriteBuffer(segment, segmentSize_);
+      if (segments_.size() == 1) {
+        rBase_ = segment;
+      }
+      rBound_ = readBound();
+    }
+    auto put = static_cast<uint32_t>((std::min)(static_cast<ptrdiff_t>(len), wBound_ - wBase_));
+    std::memcpy(wBase_, buf, put);
+    wBase_ += put;
+    buf += put;
+    len -= put;
+  }
+}
+
+const uint8_t* TChainedMemoryBuffer::borrowSlow(uint8_t* buf, uint32_t* len) {
+  (void)buf;
+  if (segments_.empty()) {
+    return nullptr;
+  }
+  rBound_ = readBound();
+  if (rBase_ == rBound_ && segments_.size() > 1) {
+    nextReadSegment();
+  }
+  if (rBound_ - rBase_ >= static_cast<ptrdiff_t>(*len)) {
+    *len = static_cast<uint32_t>(rBound_ - rBase_);
+    return rBase_;
+  }
+  return nullptr;
+}
+}
+}
+} // apache::thrift::transport
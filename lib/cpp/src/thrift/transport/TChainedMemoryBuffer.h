@@ -0,0 +1,178 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TCHAINEDMEMORYBUFFER_H_
+#define _THRIFT_TRANSPORT_TCHAINEDMEMORYBUFFER_H_ 1
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <thrift/concurrency/Mutex.h>
+#include <thrift/transport/TBufferTransports.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Fixed-size blocks of memory for TChainedMemoryBuffer, kept for reuse when
+ * a buffer is done with them. Any number of buffers, on any threads, may
+ * share one pool.
+ */
+class TMemorySegmentPool {
+public:
+  static const uint32_t DEFAULT_SEGMENT_SIZE = 64 * 1024;
+
+  /// Free segments kept by default, 16 MB of them.
+  static const uint32_t DEFAULT_MAX_FREE = 256;
+
+  /**
+   * @param segmentSize Bytes in each segment
+   * @param maxFree     Free segments to keep; any more are deleted
+   */
+  TMemorySegmentPool(uint32_t segmentSize = DEFAULT_SEGMENT_SIZE,
+                     uint32_t maxFree = DEFAULT_MAX_FREE);
+
+  ~TMemorySegmentPool();
+
+  TMemorySegmentPool(const TMemorySegmentPool&) = delete;
+  TMemorySegmentPool& operator=(const TMemorySegmentPool&) = delete;
+
+  /// A free segment, or a new one if there are none.
+  uint8_t* allocate();
+
+  /// Takes back a segment from allocate().
+  void release(uint8_t* segment);
+
+  uint32_t getSegmentSize() const { return segmentSize_; }
+
+  /// Segments waiting to be reused.
+  uint32_t getFreeCount() const;
+
+  /// The pool that buffers use unless they are given one.
+  static std::shared_ptr<TMemorySegmentPool> getDefault();
+
+private:
+  const uint32_t segmentSize_;
+  const uint32_t maxFree_;
+  mutable concurrency::Mutex mutex_;
+  std::vector<uint8_t*> free_;
+};
+
+/**
+ * A memory buffer made of a chain of fixed-size segments from a
+ * TMemorySegmentPool.
+ *
+ * Unlike TMemoryBuffer, which doubles its one block of memory and copies
+ * everything into the new one as it grows, writing never moves what has
+ * been written: it only takes another segment. A large message costs no
+ * copies while it is serialized and no more memory than its size rounded
+ * up to a segment. The segments go out to a socket or a file with one
+ * vectored write, so the message is never gathered into one block either.
+ *
+ * Reads and writes that fit in the current segment take the TBufferBase
+ * fast path. borrow() only returns what is left of the current segment.
+ */
+class TChainedMemoryBuffer : public TVirtualTransport<TChainedMemoryBuffer, TBufferBase> {
+public:
+  /**
+   * @param pool Where the segments come from and go back to; the default
+   *             pool if null
+   */
+  TChainedMemoryBuffer(std::shared_ptr<TMemorySegmentPool> pool = nullptr,
+                       std::shared_ptr<TConfiguration> config = nullptr);
+
+  ~TChainedMemoryBuffer() override;
+
+  bool isOpen() const override { return true; }
+
+  bool peek() override { return available_read() > 0; }
+
+  void open() override {}
+
+  void close() override {}
+
+  /*
+   * TVirtualTransport provides a default implementation of readAll().
+   * We want to use the TBufferBase version instead.
+   */
+  uint32_t readAll(uint8_t* buf, uint32_t len) { return TBufferBase::readAll(buf, len); }
+
+  /// Bytes written and not yet read.
+  uint32_t available_read() const;
+
+  /**
+   * Appends an entry to iov for each segment holding bytes that have not
+   * been read, in order, without consuming them. They stay valid until the
+   * buffer is next read, written or reset.
+   */
+  void getIOVecs(std::vector<TIOVec>& iov) const;
+
+  /**
+   * Writes all the bytes that have not been read to transport with one
+   * write_iov() call, then empties the buffer. TSocket and TFDTransport
+   * pass the segments down to the kernel in place.
+   */
+  void writeTo(TTransport& transport);
+
+  /// Copies out the bytes that have not been read, without consuming them.
+  std::string getBufferAsString() const;
+
+  /**
+   * Empties the buffer, keeping one segment for the next message and giving
+   * the rest back to the pool.
+   */
+  void resetBuffer();
+
+  uint32_t readEnd() override;
+
+  uint32_t writeEnd() override;
+
+  std::shared_ptr<TMemorySegmentPool> getPool() const { return pool_; }
+
+protected:
+  uint32_t readSlow(uint8_t* buf, uint32_t len) override;
+
+  void writeSlow(const uint8_t* buf, uint32_t len) override;
+
+  const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len) override;
+
+private:
+  // Where reading the first segment has to stop
+  uint8_t* readBound() const {
+    return segments_.size() == 1 ? wBase_ : segments_.front() + segmentSize_;
+  }
+
+  // Give the first segment back to the pool and read from the next one
+  void nextReadSegment();
+
+  std::shared_ptr<TMemorySegmentPool> pool_;
+  uint32_t segmentSize_;
+  // Reads are in the first segment and writes in the last
+  std::deque<uint8_t*> segments_;
+  // Segments read to the end and given back since the last reset
+  uint32_t releasedSegments_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TCHAINEDMEMORYBUFFER_H_
@@ -29,6 +29,9 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 
 #include <thrift/transport/PlatformSocket.h>
 #include <thrift/transport/TFDTransport.h>
@@ -95,6 +98,64 @@ void TFDTransport::write(const uint8_t* buf, uint32_t len) {
     len -= static_cast<uint32_t>(rv);
   }
 }
+
+void TFDTransport::write_iov(const TIOVec* iov, uint32_t iovcnt) {
+#ifdef HAVE_SYS_UIO_H
+  // Bytes of iov[0] that have already been written
+  uint32_t offset = 0;
+
+  for (;;) {
+    while (iovcnt > 0 && iov->len == offset) {
+      ++iov;
+      --iovcnt;
+      offset = 0;
+    }
+    if (iovcnt == 0) {
+      return;
+    }
+
+    // Keep the total within what a single call can report back
+    const int MAX_IOV = 64;
+    struct iovec vec[MAX_IOV];
+    int n = 0;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < iovcnt && n < MAX_IOV && total < 0x40000000; ++i) {
+      uint32_t skip = (i == 0) ? offset : 0;
+      vec[n].iov_base = const_cast<uint8_t*>(iov[i].base + skip);
+      vec[n].iov_len = iov[i].len - skip;
+      total += vec[n].iov_len;
+      ++n;
+    }
+
+    ssize_t rv = ::writev(fd_, vec, n);
+    if (rv < 0) {
+      int errno_copy = THRIFT_ERRNO;
+      if (errno_copy == THRIFT_EINTR) {
+        continue;
+      }
+      throw TTransportException(TTransportException::UNKNOWN, "TFDTransport::write_iov()", errno_copy);
+    } else if (rv == 0) {
+      throw TTransportException(TTransportException::END_OF_FILE, "TFDTransport::write_iov()");
+    }
+
+    // Step over what went out, leaving offset inside the first unfinished buffer
+    auto b = static_cast<uint64_t>(rv);
+    while (b > 0) {
+      uint32_t rest = iov->len - offset;
+      if (b < rest) {
+        offset += static_cast<uint32_t>(b);
+        break;
+      }
+      b -= rest;
+      ++iov;
+      --iovcnt;
+      offset = 0;
+    }
+  }
+#else
+  TVirtualTransport<TFDTransport>::write_iov(iov, iovcnt);
+#endif
+}
 }
 }
 } // apache::thrift::transport
@@ -65,6 +65,12 @@ public:
 
   void write(const uint8_t* buf, uint32_t len);
 
+  /**
+   * Writes the buffers with writev() where it is available, a batch at a
+   * time, instead of one write() per buffer.
+   */
+  void write_iov(const TIOVec* iov, uint32_t iovcnt);
+
   void setFD(int fd) { fd_ = fd; }
   int getFD() { return fd_; }
 
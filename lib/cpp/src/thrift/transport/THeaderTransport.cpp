@@ -25,11 +25,19 @@
 
 #include <boost/numeric/conversion/cast.hpp>
 
+#include <algorithm>
 #include <limits>
 #include <utility>
 #include <string>
 #include <string.h>
 #include <zlib.h>
+#ifdef HAVE_ZSTD_H
+#include <zstd.h>
+#include <zstd_errors.h>
+#endif
+#ifdef HAVE_LZ4_H
+#include <lz4.h>
+#endif
 
 using std::map;
 using std::string;
@@ -59,6 +67,64 @@ template <typename To, typename From> To safe_numeric_cast(From i) {
 using namespace apache::thrift::protocol;
 using apache::thrift::protocol::TBinaryProtocol;
 
+struct THeaderTransport::Codecs {
+  Codecs() : deflateLevel(0), deflating(false), inflating(false) {}
+
+  ~Codecs() {
+    if (deflating) {
+      deflateEnd(&deflater);
+    }
+    if (inflating) {
+      inflateEnd(&inflater);
+    }
+#ifdef HAVE_ZSTD_H
+    ZSTD_freeCCtx(zstdCompress);
+    ZSTD_freeDCtx(zstdDecompress);
+#endif
+  }
+
+  z_stream deflater;
+  int deflateLevel;
+  bool deflating;
+  z_stream inflater;
+  bool inflating;
+#ifdef HAVE_ZSTD_H
+  ZSTD_CCtx* zstdCompress = nullptr;
+  ZSTD_DCtx* zstdDecompress = nullptr;
+#endif
+#ifdef HAVE_LZ4_H
+  std::unique_ptr<char[]> lz4State;
+#endif
+};
+
+void THeaderTransport::CodecsDeleter::operator()(Codecs* codecs) const {
+  delete codecs;
+}
+
+THeaderTransport::Codecs& THeaderTransport::codecs() {
+  if (!codecs_) {
+    codecs_.reset(new Codecs());
+  }
+  return *codecs_;
+}
+
+bool THeaderTransport::isTransformSupported(uint16_t transId) {
+  switch (transId) {
+  case ZLIB_TRANSFORM:
+    return true;
+#ifdef HAVE_ZSTD_H
+  case ZSTD_TRANSFORM:
+    return true;
+#endif
+#ifdef HAVE_LZ4_H
+  case LZ4_TRANSFORM:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
 uint32_t THeaderTransport::readSlow(uint8_t* buf, uint32_t len) {
   if (clientType == THRIFT_UNFRAMED_BINARY || clientType == THRIFT_UNFRAMED_COMPACT) {
     return transport_->read(buf, len);
@@ -295,58 +361,133 @@ void THeaderTransport::untransform(uint8_t* ptr, uint32_t sz) {
   // Update the transform buffer size if needed
   resizeTransformBuffer();
 
-  for (vector<uint16_t>::const_iterator it = readTrans_.begin(); it != readTrans_.end(); ++it) {
+  // The last transform applied is undone first
+  for (vector<uint16_t>::const_reverse_iterator it = readTrans_.rbegin(); it != readTrans_.rend();
+       ++it) {
     const uint16_t transId = *it;
+    // The decompressed size is bounded by the configured frame-size limit,
+    // as an untransformed frame is in readFrame(), and checked before the
+    // buffer grows to hold it where the payload says what it will be
+    uint64_t untransformedSize;
 
     if (transId == ZLIB_TRANSFORM) {
-      z_stream stream;
-      int err;
-
+      Codecs& c = codecs();
+      if (!c.inflating) {
+        c.inflater.zalloc = (alloc_func)nullptr;
+        c.inflater.zfree = (free_func)nullptr;
+        c.inflater.opaque = (voidpf)nullptr;
+        c.inflater.next_in = nullptr;
+        c.inflater.avail_in = 0;
+        if (inflateInit(&c.inflater) != Z_OK) {
+          throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                      "Error while zlib inflateInit");
+        }
+        c.inflating = true;
+      } else if (inflateReset(&c.inflater) != Z_OK) {
+        throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                    "Error while zlib inflateReset");
+      }
+      z_stream& stream = c.inflater;
       stream.next_in = ptr;
       stream.avail_in = sz;
-
-      // Setting these to 0 means use the default free/alloc functions
-      stream.zalloc = (alloc_func)nullptr;
-      stream.zfree = (free_func)nullptr;
-      stream.opaque = (voidpf)nullptr;
-      err = inflateInit(&stream);
-      if (err != Z_OK) {
+      int err = Z_OK;
+      while (err == Z_OK) {
+        if (stream.total_out > maxFrameSize_) {
+          throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                    "Received an oversized frame after transform");
+        }
+        if (stream.total_out == tBufSize_) {
+          growTransformBuffer(static_cast<uint32_t>((std::min)(
+                                  2 * static_cast<uint64_t>(tBufSize_),
+                                  static_cast<uint64_t>(maxFrameSize_) + 1)),
+                              tBufSize_);
+        }
+        stream.next_out = tBuf_.get() + stream.total_out;
+        stream.avail_out = tBufSize_ - static_cast<uint32_t>(stream.total_out);
+        err = inflate(&stream, Z_NO_FLUSH);
+      }
+      if (err != Z_STREAM_END) {
         throw TApplicationException(TApplicationException::MISSING_RESULT,
-                                    "Error while zlib deflateInit");
+                                    "Error while zlib inflate");
       }
-      stream.next_out = tBuf_.get();
-      stream.avail_out = tBufSize_;
-      err = inflate(&stream, Z_FINISH);
-      if (err != Z_STREAM_END || stream.avail_out == 0) {
+      untransformedSize = stream.total_out;
+#ifdef HAVE_ZSTD_H
+    } else if (transId == ZSTD_TRANSFORM) {
+      Codecs& c = codecs();
+      if (c.zstdDecompress == nullptr && (c.zstdDecompress = ZSTD_createDCtx()) == nullptr) {
+        throw std::bad_alloc();
+      }
+      unsigned long long contentSize = ZSTD_getFrameContentSize(ptr, sz);
+      if (contentSize == ZSTD_CONTENTSIZE_ERROR) {
         throw TApplicationException(TApplicationException::MISSING_RESULT,
-                                    "Error while zlib deflate");
+                                    "Error while zstd decompress: not a zstd frame");
       }
-      sz = stream.total_out;
-
-      // Apply the configured frame-size limit to the post-transform payload as
-      // well: the decompressed data is what the caller ultimately reads, so it
-      // is bounded the same way an untransformed frame is in readFrame().
-      if (sz > maxFrameSize_) {
+      if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN) {
+        if (contentSize > maxFrameSize_) {
+          throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                    "Received an oversized frame after transform");
+        }
+        growTransformBuffer(static_cast<uint32_t>(contentSize), 0);
+      }
+      while (true) {
+        size_t result = ZSTD_decompressDCtx(c.zstdDecompress, tBuf_.get(), tBufSize_, ptr, sz);
+        if (!ZSTD_isError(result)) {
+          untransformedSize = result;
+          break;
+        }
+        // Frames that do not say how big they are grow the buffer until
+        // they fit
+        if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN
+            || ZSTD_getErrorCode(result) != ZSTD_error_dstSize_tooSmall) {
+          throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                      std::string("Error while zstd decompress: ")
+                                          + ZSTD_getErrorName(result));
+        }
+        if (tBufSize_ > maxFrameSize_) {
+          throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                    "Received an oversized frame after transform");
+        }
+        growTransformBuffer(static_cast<uint32_t>((std::min)(
+                                2 * static_cast<uint64_t>(tBufSize_),
+                                static_cast<uint64_t>(maxFrameSize_) + 1)),
+                            0);
+      }
+#endif
+#ifdef HAVE_LZ4_H
+    } else if (transId == LZ4_TRANSFORM) {
+      int32_t size;
+      uint32_t prefix = readVarint32(ptr, &size, ptr + sz);
+      if (size < 0 || static_cast<uint32_t>(size) > maxFrameSize_) {
         throw TTransportException(TTransportException::CORRUPTED_DATA,
                                   "Received an oversized frame after transform");
       }
-
-      err = inflateEnd(&stream);
-      if (err != Z_OK) {
+      growTransformBuffer(static_cast<uint32_t>(size), 0);
+      int result = LZ4_decompress_safe(reinterpret_cast<const char*>(ptr + prefix),
+                                       reinterpret_cast<char*>(tBuf_.get()),
+                                       static_cast<int>(sz - prefix), size);
+      if (result != size) {
         throw TApplicationException(TApplicationException::MISSING_RESULT,
-                                    "Error while zlib deflateEnd");
+                                    "Error while lz4 decompress");
       }
-
-      // The result now lives in tBuf_ and is typically larger than the source
-      // section it was read from, so it does not fit back into the receive
-      // buffer at ptr.  Swap the transform buffer in as the receive buffer and
-      // continue from its start instead of copying the result back in place.
-      rBuf_.swap(tBuf_);
-      std::swap(rBufSize_, tBufSize_);
-      ptr = rBuf_.get();
+      untransformedSize = static_cast<uint32_t>(size);
+#endif
     } else {
       throw TApplicationException(TApplicationException::MISSING_RESULT, "Unknown transform");
     }
+
+    if (untransformedSize > maxFrameSize_) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Received an oversized frame after transform");
+    }
+    sz = static_cast<uint32_t>(untransformedSize);
+
+    // The result now lives in tBuf_ and is typically larger than the source
+    // section it was read from, so it does not fit back into the receive
+    // buffer at ptr.  Swap the transform buffer in as the receive buffer and
+    // continue from its start instead of copying the result back in place.
+    rBuf_.swap(tBuf_);
+    std::swap(rBufSize_, tBufSize_);
+    ptr = rBuf_.get();
   }
 
   setReadBuffer(ptr, sz);
@@ -368,51 +509,118 @@ void THeaderTransport::resizeTransformBuffer(uint32_t additionalSize) {
   }
 }
 
+void THeaderTransport::growTransformBuffer(uint32_t size, uint32_t used) {
+  if (tBufSize_ < size) {
+    std::unique_ptr<uint8_t[]> new_buf(new uint8_t[size]);
+    if (used > 0) {
+      memcpy(new_buf.get(), tBuf_.get(), used);
+    }
+    tBuf_.swap(new_buf);
+    tBufSize_ = size;
+  }
+}
+
 void THeaderTransport::transform(uint8_t* ptr, uint32_t sz) {
   // Update the transform buffer size if needed
   resizeTransformBuffer();
 
-  for (vector<uint16_t>::const_iterator it = writeTrans_.begin(); it != writeTrans_.end(); ++it) {
-    const uint16_t transId = *it;
+  const uint32_t payloadSize = sz;
+  messageTrans_.clear();
+  for (size_t i = 0; i < writeTrans_.size(); ++i) {
+    const uint16_t transId = writeTrans_[i];
+    if (payloadSize < writeTransMinSize_[i]) {
+      continue;
+    }
+    const int level = writeTransLevel_[i];
 
     if (transId == ZLIB_TRANSFORM) {
-      z_stream stream;
-      int err;
-
+      Codecs& c = codecs();
+      int zlibLevel = level != 0 ? level : Z_DEFAULT_COMPRESSION;
+      if (c.deflating && c.deflateLevel != zlibLevel) {
+        deflateEnd(&c.deflater);
+        c.deflating = false;
+      }
+      if (!c.deflating) {
+        c.deflater.zalloc = (alloc_func)nullptr;
+        c.deflater.zfree = (free_func)nullptr;
+        c.deflater.opaque = (voidpf)nullptr;
+        if (deflateInit(&c.deflater, zlibLevel) != Z_OK) {
+          throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                    "Error while zlib deflateInit");
+        }
+        c.deflateLevel = zlibLevel;
+        c.deflating = true;
+      } else if (deflateReset(&c.deflater) != Z_OK) {
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Error while zlib deflateReset");
+      }
+      z_stream& stream = c.deflater;
+      growTransformBuffer(safe_numeric_cast<uint32_t>(deflateBound(&stream, sz)), 0);
       stream.next_in = ptr;
       stream.avail_in = sz;
-
-      stream.zalloc = (alloc_func)nullptr;
-      stream.zfree = (free_func)nullptr;
-      stream.opaque = (voidpf)nullptr;
-      err = deflateInit(&stream, Z_DEFAULT_COMPRESSION);
-      if (err != Z_OK) {
+      stream.next_out = tBuf_.get();
+      stream.avail_out = tBufSize_;
+      if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
         throw TTransportException(TTransportException::CORRUPTED_DATA,
-                                  "Error while zlib deflateInit");
+                                  "Error while zlib deflate");
       }
-      uint32_t tbuf_size = 0;
-      while (err == Z_OK) {
-        resizeTransformBuffer(tbuf_size);
-
-        stream.next_out = tBuf_.get();
-        stream.avail_out = tBufSize_;
-        err = deflate(&stream, Z_FINISH);
-        tbuf_size += DEFAULT_BUFFER_SIZE;
+      sz = static_cast<uint32_t>(stream.total_out);
+#ifdef HAVE_ZSTD_H
+    } else if (transId == ZSTD_TRANSFORM) {
+      Codecs& c = codecs();
+      if (c.zstdCompress == nullptr && (c.zstdCompress = ZSTD_createCCtx()) == nullptr) {
+        throw std::bad_alloc();
       }
-      sz = stream.total_out;
-
-      err = deflateEnd(&stream);
-      if (err != Z_OK) {
+      growTransformBuffer(safe_numeric_cast<uint32_t>(ZSTD_compressBound(sz)), 0);
+      size_t result = ZSTD_compressCCtx(c.zstdCompress, tBuf_.get(), tBufSize_, ptr, sz, level);
+      if (ZSTD_isError(result)) {
         throw TTransportException(TTransportException::CORRUPTED_DATA,
-                                  "Error while zlib deflateEnd");
+                                  std::string("Error while zstd compress: ")
+                                      + ZSTD_getErrorName(result));
       }
-
-      memcpy(ptr, tBuf_.get(), sz);
+      sz = static_cast<uint32_t>(result);
+#endif
+#ifdef HAVE_LZ4_H
+    } else if (transId == LZ4_TRANSFORM) {
+      Codecs& c = codecs();
+      if (!c.lz4State) {
+        c.lz4State.reset(new char[LZ4_sizeofState()]);
+      }
+      if (sz > static_cast<uint32_t>(LZ4_MAX_INPUT_SIZE)) {
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Attempting to lz4 compress a frame that is too large");
+      }
+      int bound = LZ4_compressBound(static_cast<int>(sz));
+      growTransformBuffer(static_cast<uint32_t>(bound) + THRIFT_MAX_VARINT32_BYTES, 0);
+      uint32_t prefix = writeVarint32(static_cast<int32_t>(sz), tBuf_.get());
+      int result = LZ4_compress_fast_extState(c.lz4State.get(),
+                                              reinterpret_cast<const char*>(ptr),
+                                              reinterpret_cast<char*>(tBuf_.get() + prefix),
+                                              static_cast<int>(sz), bound, level);
+      if (result <= 0) {
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Error while lz4 compress");
+      }
+      sz = prefix + static_cast<uint32_t>(result);
+#endif
     } else {
       throw TTransportException(TTransportException::CORRUPTED_DATA, "Unknown transform");
     }
+
+    // Incompressible payloads come out a little larger than they went in
+    if (sz > wBufSize_) {
+      wBuf_.reset(new uint8_t[sz]);
+      wBufSize_ = sz;
+      setWriteBuffer(wBuf_.get(), wBufSize_);
+    }
+    memcpy(wBuf_.get(), tBuf_.get(), sz);
+    ptr = wBuf_.get();
+    messageTrans_.push_back(transId);
   }
 
+  // The header is built in the transform buffer, which has to fit the
+  // payload too
+  resizeTransformBuffer();
   wBase_ = wBuf_.get() + sz;
 }
 
@@ -520,10 +728,11 @@ void THeaderTransport::flush() {
     headerStart = pkt;
 
     pkt += writeVarint32(protoId, pkt);
-    pkt += writeVarint32(getNumTransforms(), pkt);
+    pkt += writeVarint32(safe_numeric_cast<int32_t>(messageTrans_.size()), pkt);
 
     // For now, each transform is only the ID, no following data.
-    for (vector<uint16_t>::const_iterator it = writeTrans_.begin(); it != writeTrans_.end(); ++it) {
+    for (vector<uint16_t>::const_iterator it = messageTrans_.begin(); it != messageTrans_.end();
+         ++it) {
       pkt += writeVarint32(*it, pkt);
     }
 
@@ -569,14 +778,14 @@ void THeaderTransport::flush() {
     szNbo = htonl(szHbo);
     memcpy(pktStart, &szNbo, sizeof(szNbo));
 
-    outTransport_->write(pktStart, szHbo - haveBytes + 4);
-    outTransport_->write(wBuf_.get(), haveBytes);
+    TIOVec iov[2] = {{pktStart, szHbo - haveBytes + 4}, {wBuf_.get(), haveBytes}};
+    outTransport_->write_iov(iov, 2);
   } else if (clientType == THRIFT_FRAMED_BINARY || clientType == THRIFT_FRAMED_COMPACT) {
     auto szHbo = (uint32_t)haveBytes;
     uint32_t szNbo = htonl(szHbo);
 
-    outTransport_->write(reinterpret_cast<uint8_t*>(&szNbo), 4);
-    outTransport_->write(wBuf_.get(), haveBytes);
+    TIOVec iov[2] = {{reinterpret_cast<uint8_t*>(&szNbo), 4}, {wBuf_.get(), haveBytes}};
+    outTransport_->write_iov(iov, 2);
   } else if (clientType == THRIFT_UNFRAMED_BINARY || clientType == THRIFT_UNFRAMED_COMPACT) {
     outTransport_->write(wBuf_.get(), haveBytes);
   } else {
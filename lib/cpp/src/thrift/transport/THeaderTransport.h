@@ -26,6 +26,7 @@
 #include <stdexcept>
 #include <string>
 #include <map>
+#include <memory>
 
 #ifdef HAVE_STDINT_H
 #include <stdint.h>
@@ -144,7 +145,27 @@ public:
 
   uint16_t getNumTransforms() const;
 
-  void setTransform(uint16_t transId) { writeTrans_.push_back(transId); }
+  /**
+   * Apply the transform to the payload of the messages that are written from
+   * now on, or only to those of at least minSize bytes, so that e.g. small
+   * messages go out as they are and large ones are compressed. Transforms
+   * apply in the order they were set.
+   *
+   * level is the compression level for zlib and zstd, or the acceleration
+   * for LZ4, with 0 for the library's default. Each transform has its own,
+   * since the libraries take different ranges.
+   */
+  void setTransform(uint16_t transId, uint32_t minSize = 0, int level = 0) {
+    writeTrans_.push_back(transId);
+    writeTransMinSize_.push_back(minSize);
+    writeTransLevel_.push_back(level);
+  }
+
+  /**
+   * Whether this build can apply and undo the transform. Zstd and LZ4 need
+   * the libraries at build time.
+   */
+  static bool isTransformSupported(uint16_t transId);
 
   // Info headers
 
@@ -164,8 +185,15 @@ public:
   int32_t getSequenceNumber() const { return seqId; }
   void setSequenceNumber(int32_t seqId) { this->seqId = seqId; }
 
+  // ZLIB_TRANSFORM and ZSTD_TRANSFORM have the IDs of other THeader
+  // implementations; the zstd payload is a zstd frame. LZ4_TRANSFORM is an
+  // extension of this C++ library only: the other implementations end at
+  // ZSTD_TRANSFORM and reject messages that use it. Its payload is the
+  // uncompressed size as a varint and an LZ4 block.
   enum TRANSFORMS {
     ZLIB_TRANSFORM = 0x01,
+    ZSTD_TRANSFORM = 0x05,
+    LZ4_TRANSFORM = 0x06,
   };
 
 protected:
@@ -201,6 +229,12 @@ protected:
 
   std::vector<uint16_t> readTrans_;
   std::vector<uint16_t> writeTrans_;
+  // The smallest payload each of writeTrans_ applies to
+  std::vector<uint32_t> writeTransMinSize_;
+  // The compression level of each of writeTrans_
+  std::vector<int> writeTransLevel_;
+  // Those of writeTrans_ applied to the message being flushed
+  std::vector<uint16_t> messageTrans_;
 
   // Map to use for headers
   StringToStringMap readHeaders_;
@@ -223,6 +257,22 @@ protected:
   uint32_t tBufSize_;
   std::unique_ptr<uint8_t[]> tBuf_;
 
+  // Compression and decompression state, kept from one message to the next
+  // rather than set up again for each
+  struct Codecs;
+  struct CodecsDeleter {
+    void operator()(Codecs* codecs) const;
+  };
+  std::unique_ptr<Codecs, CodecsDeleter> codecs_;
+
+  Codecs& codecs();
+
+  /**
+   * Make the transform buffer hold at least size bytes, keeping the first
+   * used of them.
+   */
+  void growTransformBuffer(uint32_t size, uint32_t used);
+
   void readString(uint8_t*& ptr, /* out */ std::string& str, uint8_t const* headerBoundary);
 
   void writeString(uint8_t*& ptr, const std::string& str);
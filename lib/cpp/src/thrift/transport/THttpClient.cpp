@@ -135,8 +135,9 @@ void THttpClient::flush() {
   if (header.size() > (std::numeric_limits<uint32_t>::max)())
     throw TTransportException("Header too big");
   // Write the header, then the data, then flush
-  transport_->write((const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size()));
-  transport_->write(buf, len);
+  TIOVec iov[2] = {{(const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size())},
+                   {buf, len}};
+  transport_->write_iov(iov, 2);
   transport_->flush();
 
   // Reset the buffer and header variables
@@ -107,8 +107,9 @@ bool THttpServer::parseStatusLine(char* status) {
     string header = h.str();
 
     // Write the header, then the data, then flush
-    transport_->write((const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size()));
-    transport_->write(buf, len);
+    TIOVec iov[2] = {{(const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size())},
+                     {buf, len}};
+    transport_->write_iov(iov, 2);
     transport_->flush();
 
     // Reset the buffer and header variables
@@ -131,8 +132,9 @@ void THttpServer::flush() {
 
   // Write the header, then the data, then flush
   // cast should be fine, because none of "header" is under attacker control
-  transport_->write((const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size()));
-  transport_->write(buf, len);
+  TIOVec iov[2] = {{(const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size())},
+                   {buf, len}};
+  transport_->write_iov(iov, 2);
   transport_->flush();
 
   // Reset the buffer and header variables
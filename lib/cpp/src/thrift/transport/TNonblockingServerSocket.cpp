@@ -101,6 +101,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(int port)
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
+    reusePort_(false),
     listening_(false) {
 }
 
@@ -116,6 +117,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(int port, int sendTimeout, in
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
+    reusePort_(false),
     listening_(false) {
 }
 
@@ -132,6 +134,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(const string& address, int po
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
+    reusePort_(false),
     listening_(false) {
 }
 
@@ -148,6 +151,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(const string& path)
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
+    reusePort_(false),
     listening_(false) {
 }
 
@@ -212,6 +216,44 @@ void TNonblockingServerSocket::setTcpRecvBuffer(int tcpRecvBuffer) {
   tcpRecvBuffer_ = tcpRecvBuffer;
 }
 
+bool TNonblockingServerSocket::setReusePort(bool reusePort) {
+#ifdef SO_REUSEPORT
+  if (isUnixDomainSocket()) {
+    return !reusePort;
+  }
+  reusePort_ = reusePort;
+  return true;
+#else
+  return !reusePort;
+#endif
+}
+
+shared_ptr<TNonblockingServerTransport> TNonblockingServerSocket::createReusePortListener() {
+  if (!reusePort_ || !listening_) {
+    return shared_ptr<TNonblockingServerTransport>();
+  }
+
+  // Bind the port that was actually assigned, in case port 0 was requested
+  shared_ptr<TNonblockingServerSocket> listener = newListener(address_, listenPort_);
+  listener->acceptBacklog_ = acceptBacklog_;
+  listener->sendTimeout_ = sendTimeout_;
+  listener->recvTimeout_ = recvTimeout_;
+  listener->retryLimit_ = retryLimit_;
+  listener->retryDelay_ = retryDelay_;
+  listener->tcpSendBuffer_ = tcpSendBuffer_;
+  listener->tcpRecvBuffer_ = tcpRecvBuffer_;
+  listener->keepAlive_ = keepAlive_;
+  listener->reusePort_ = true;
+  listener->listenCallback_ = listenCallback_;
+  listener->acceptCallback_ = acceptCallback_;
+  return listener;
+}
+
+shared_ptr<TNonblockingServerSocket> TNonblockingServerSocket::newListener(const string& address,
+                                                                           int port) {
+  return std::make_shared<TNonblockingServerSocket>(address, port);
+}
+
 void TNonblockingServerSocket::_setup_sockopts() {
   int one = 1;
   if (!isUnixDomainSocket()) {
@@ -353,6 +395,19 @@ void TNonblockingServerSocket::_setup_tcp_sockopts() {
   }
 #endif
 
+#ifdef SO_REUSEPORT
+  if (reusePort_) {
+    if (-1 == setsockopt(serverSocket_, SOL_SOCKET, SO_REUSEPORT, cast_sockopt(&one), sizeof(one))) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      TOutput::instance().perror("TNonblockingServerSocket::listen() setsockopt() SO_REUSEPORT ", errno_copy);
+      close();
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "Could not set SO_REUSEPORT",
+                                errno_copy);
+    }
+  }
+#endif
+
 } // _setup_tcp_sockopts()
 
 void TNonblockingServerSocket::listen() {
@@ -88,6 +88,11 @@ public:
   void setTcpSendBuffer(int tcpSendBuffer);
   void setTcpRecvBuffer(int tcpRecvBuffer);
 
+  // Sets SO_REUSEPORT on TCP listen sockets, where the platform has it.
+  bool setReusePort(bool reusePort) override;
+
+  std::shared_ptr<TNonblockingServerTransport> createReusePortListener() override;
+
   // listenCallback gets called just before listen, and after all Thrift
   // setsockopt calls have been made.  If you have custom setsockopt
   // things that need to happen on the listening socket, this is the place to do it.
@@ -116,6 +121,13 @@ protected:
   std::shared_ptr<TSocket> acceptImpl() override;
   virtual std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET client);
 
+  /**
+   * Creates an unconfigured server socket of the same type as this one,
+   * used by createReusePortListener().
+   */
+  virtual std::shared_ptr<TNonblockingServerSocket> newListener(const std::string& address,
+                                                                int port);
+
 private:
   void _setup_sockopts();
   void _setup_unixdomain_sockopts();
@@ -134,6 +146,7 @@ private:
   int tcpSendBuffer_;
   int tcpRecvBuffer_;
   bool keepAlive_;
+  bool reusePort_;
   bool listening_;
 
   socket_func_t listenCallback_;
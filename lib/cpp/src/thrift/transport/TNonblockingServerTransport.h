@@ -76,6 +76,29 @@ public:
 
   virtual int getListenPort() = 0;
 
+  /**
+   * Lets further listeners bind the same address, so that the kernel
+   * spreads incoming connections across them (SO_REUSEPORT). Must be
+   * called before listen().
+   *
+   * @return false if the transport does not support this.
+   */
+  virtual bool setReusePort(bool reusePort) {
+    (void)reusePort;
+    return false;
+  }
+
+  /**
+   * Creates another transport for the address this one is listening on,
+   * configured like this one. listen() has not been called on it yet.
+   * Only available after listen() when setReusePort(true) succeeded.
+   *
+   * @return the new listener, or nullptr if not supported.
+   */
+  virtual std::shared_ptr<TNonblockingServerTransport> createReusePortListener() {
+    return std::shared_ptr<TNonblockingServerTransport>();
+  }
+
   /**
    * Closes this transport such that future calls to accept will do nothing.
    */
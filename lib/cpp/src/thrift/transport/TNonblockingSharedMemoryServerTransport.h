@@ -0,0 +1,55 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TNONBLOCKINGSHAREDMEMORYSERVERTRANSPORT_H_
+#define _THRIFT_TRANSPORT_TNONBLOCKINGSHAREDMEMORYSERVERTRANSPORT_H_ 1
+
+#include <thrift/transport/TNonblockingServerSocket.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Nonblocking server transport that accepts TSharedMemoryTransport clients
+ * on a UNIX domain socket, for TNonblockingServer.
+ *
+ * Nothing waits in accept: the connections it hands out take the client's
+ * shared memory on their first read, once the socket is readable. They do
+ * not wait to read or write either. The I/O thread waits on their sockets,
+ * which the clients make readable when they write to a ring the server has
+ * found empty, or read from one it has found full.
+ */
+class TNonblockingSharedMemoryServerTransport : public TNonblockingServerSocket {
+public:
+  /**
+   * Constructor.
+   *
+   * @param path Pathname for the UNIX domain socket
+   */
+  TNonblockingSharedMemoryServerTransport(const std::string& path);
+
+protected:
+  std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET client) override;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TNONBLOCKINGSHAREDMEMORYSERVERTRANSPORT_H_
@@ -590,6 +590,15 @@ uint32_t TSSLSocket::write_partial(const uint8_t* buf, uint32_t len) {
   return written;
 }
 
+void TSSLSocket::write_iov(const TIOVec* iov, uint32_t iovcnt) {
+  // SSL_write() takes one buffer at a time
+  for (uint32_t i = 0; i < iovcnt; ++i) {
+    if (iov[i].len > 0) {
+      write(iov[i].base, iov[i].len);
+    }
+  }
+}
+
 void TSSLSocket::flush() {
   resetConsumedMessageSize();
   // Don't throw exception if not open. Thrift servers close socket twice.
@@ -83,6 +83,7 @@ public:
   uint32_t read(uint8_t* buf, uint32_t len) override;
   void write(const uint8_t* buf, uint32_t len) override;
   uint32_t write_partial(const uint8_t* buf, uint32_t len) override;
+  void write_iov(const TIOVec* iov, uint32_t iovcnt) override;
   void flush() override;
   /**
   * Set whether to use client or server side SSL handshake protocol.
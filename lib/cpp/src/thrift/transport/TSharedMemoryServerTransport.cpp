@@ -0,0 +1,45 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/transport/TSharedMemoryServerTransport.h>
+#include <thrift/transport/TSharedMemoryTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+TSharedMemoryServerTransport::TSharedMemoryServerTransport(const std::string& path)
+  : TServerSocket(path), handshakeTimeout_(DEFAULT_HANDSHAKE_TIMEOUT) {
+}
+
+std::shared_ptr<TSocket> TSharedMemoryServerTransport::createSocket(THRIFT_SOCKET client) {
+  std::shared_ptr<THRIFT_SOCKET> interruptListener;
+  if (interruptableChildren_) {
+    interruptListener = pChildInterruptSockReader_;
+  }
+  // A client that fails the handshake is closed here and accept() throws a
+  // TTransportException that the server frameworks carry on from
+  std::shared_ptr<TSharedMemoryTransport> transport
+      = std::make_shared<TSharedMemoryTransport>(client, interruptListener);
+  transport->attach(handshakeTimeout_);
+  return transport;
+}
+}
+}
+} // apache::thrift::transport
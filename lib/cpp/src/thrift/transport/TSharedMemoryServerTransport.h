@@ -0,0 +1,57 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TSHAREDMEMORYSERVERTRANSPORT_H_
+#define _THRIFT_TRANSPORT_TSHAREDMEMORYSERVERTRANSPORT_H_ 1
+
+#include <thrift/transport/TServerSocket.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Server transport that accepts TSharedMemoryTransport clients on a UNIX
+ * domain socket, for TSimpleServer, TThreadedServer and TThreadPoolServer.
+ */
+class TSharedMemoryServerTransport : public TServerSocket {
+public:
+  /// How long accept waits for a client's shared memory, in ms.
+  static const int DEFAULT_HANDSHAKE_TIMEOUT = 1000;
+
+  /**
+   * Constructor.
+   *
+   * @param path Pathname for the UNIX domain socket
+   */
+  TSharedMemoryServerTransport(const std::string& path);
+
+  void setHandshakeTimeout(int handshakeTimeout) { handshakeTimeout_ = handshakeTimeout; }
+
+protected:
+  std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET client) override;
+
+private:
+  int handshakeTimeout_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TSHAREDMEMORYSERVERTRANSPORT_H_
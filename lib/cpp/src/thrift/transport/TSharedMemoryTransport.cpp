@@ -0,0 +1,676 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <thrift/transport/TSharedMemoryTransport.h>
+#include <thrift/TOutput.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "the rings are shared between processes, so their atomics must not use locks");
+
+/**
+ * The control block of one direction, followed in the mapping by the data.
+ * The counters only grow; the data is at counter modulo the ring size.
+ */
+struct TSharedMemoryTransport::Ring {
+  // Bytes written so far, by the producer
+  alignas(64) std::atomic<uint64_t> head;
+  // How the consumer wants to be woken when head moves
+  std::atomic<uint32_t> consumerWaiting;
+  // Bytes read so far, by the consumer
+  alignas(64) std::atomic<uint64_t> tail;
+  // How the producer wants to be woken when tail moves
+  std::atomic<uint32_t> producerWaiting;
+};
+
+namespace {
+
+const uint32_t SHARED_MEMORY_MAGIC = 0x54534d52; // "TSMR"
+const uint32_t SHARED_MEMORY_VERSION = 1;
+
+// The magic, version and ring size, then the ring to the server and the
+// ring to the client, then their data in the same order
+const size_t RINGS_OFFSET = 64;
+
+// The client sends the shared memory, its eventfd and the server's eventfd
+const int HANDSHAKE_FDS = 3;
+
+// Seals on the shared memory, which neither side can resize once they are
+// set
+const int SHARED_MEMORY_SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+
+// Values of the waiting flags
+const uint32_t WAKE_NONE = 0;
+const uint32_t WAKE_EVENTFD = 1;
+const uint32_t WAKE_SOCKET = 2;
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+void copyIn(uint8_t* data, uint32_t size, uint64_t pos, const uint8_t* src, uint32_t len) {
+  auto offset = static_cast<uint32_t>(pos & (size - 1));
+  uint32_t first = (std::min)(len, size - offset);
+  std::memcpy(data + offset, src, first);
+  std::memcpy(data, src + first, len - first);
+}
+
+void copyOut(const uint8_t* data, uint32_t size, uint64_t pos, uint8_t* dst, uint32_t len) {
+  auto offset = static_cast<uint32_t>(pos & (size - 1));
+  uint32_t first = (std::min)(len, size - offset);
+  std::memcpy(dst, data + offset, first);
+  std::memcpy(dst + first, data, len - first);
+}
+
+void closeFd(int& fd) {
+  if (fd != -1) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+// Whether a descriptor from the client is an eventfd, which cannot hold up
+// a write once it is nonblocking, unlike e.g. a pipe nobody reads
+bool isEventFd(int fd) {
+  static const char EVENTFD_LINK[] = "anon_inode:[eventfd]";
+  char path[32];
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+  char link[sizeof(EVENTFD_LINK)];
+  ssize_t len = readlink(path, link, sizeof(link));
+  return len == static_cast<ssize_t>(sizeof(EVENTFD_LINK) - 1)
+         && std::memcmp(link, EVENTFD_LINK, sizeof(EVENTFD_LINK) - 1) == 0;
+}
+}
+
+TSharedMemoryTransport::TSharedMemoryTransport(const std::string& path,
+                                               uint32_t ringSize,
+                                               std::shared_ptr<TConfiguration> config)
+  : TSocket(path, config),
+    map_(nullptr),
+    mapSize_(0),
+    in_(nullptr),
+    out_(nullptr),
+    inData_(nullptr),
+    outData_(nullptr),
+    ringSize_(ringSize),
+    wakeFd_(-1),
+    peerWakeFd_(-1),
+    nonblocking_(false),
+    handshakePending_(false),
+    writeWaitingForRead_(false),
+    peerClosed_(false),
+    spinCount_(0) {
+  if (ringSize < 4096 || ringSize > MAX_RING_SIZE || (ringSize & (ringSize - 1)) != 0) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "ring size must be a power of two from 4096 to MAX_RING_SIZE");
+  }
+}
+
+TSharedMemoryTransport::TSharedMemoryTransport(THRIFT_SOCKET socket,
+                                               std::shared_ptr<THRIFT_SOCKET> interruptListener,
+                                               std::shared_ptr<TConfiguration> config)
+  : TSocket(socket, interruptListener, config),
+    map_(nullptr),
+    mapSize_(0),
+    in_(nullptr),
+    out_(nullptr),
+    inData_(nullptr),
+    outData_(nullptr),
+    ringSize_(0),
+    wakeFd_(-1),
+    peerWakeFd_(-1),
+    nonblocking_(false),
+    handshakePending_(false),
+    writeWaitingForRead_(false),
+    peerClosed_(false),
+    spinCount_(0) {
+}
+
+TSharedMemoryTransport::~TSharedMemoryTransport() {
+  close();
+}
+
+bool TSharedMemoryTransport::isOpen() const {
+  return map_ != nullptr && TSocket::isOpen();
+}
+
+void TSharedMemoryTransport::open() {
+  if (isOpen()) {
+    return;
+  }
+  TSocket::open();
+
+  int memfd = -1;
+  try {
+    memfd = memfd_create("thrift-shared-memory", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    size_t size = RINGS_OFFSET + 2 * sizeof(Ring) + 2 * static_cast<size_t>(ringSize_);
+    // The size is sealed, so that the server can trust it not to shrink
+    // under its mapping
+    if (memfd == -1 || ftruncate(memfd, static_cast<off_t>(size)) == -1
+        || fcntl(memfd, F_ADD_SEALS, SHARED_MEMORY_SEALS) == -1) {
+      int errno_copy = errno;
+      TOutput::instance().perror("TSharedMemoryTransport::open() memfd_create() ", errno_copy);
+      throw TTransportException(TTransportException::NOT_OPEN, "memfd_create()", errno_copy);
+    }
+    map(memfd, size, true);
+
+    wakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    peerWakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd_ == -1 || peerWakeFd_ == -1) {
+      int errno_copy = errno;
+      TOutput::instance().perror("TSharedMemoryTransport::open() eventfd() ", errno_copy);
+      throw TTransportException(TTransportException::NOT_OPEN, "eventfd()", errno_copy);
+    }
+
+    // One byte of data to carry the descriptors
+    char byte = 0;
+    struct iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    union {
+      struct cmsghdr align;
+      char buf[CMSG_SPACE(sizeof(int) * HANDSHAKE_FDS)];
+    } control;
+    std::memset(&control, 0, sizeof(control));
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * HANDSHAKE_FDS);
+    int fds[HANDSHAKE_FDS] = {memfd, wakeFd_, peerWakeFd_};
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t sent;
+    do {
+      sent = sendmsg(socket_, &msg, MSG_NOSIGNAL);
+    } while (sent == -1 && errno == EINTR);
+    if (sent != 1) {
+      int errno_copy = errno;
+      TOutput::instance().perror("TSharedMemoryTransport::open() sendmsg() ", errno_copy);
+      throw TTransportException(TTransportException::NOT_OPEN, "sendmsg()", errno_copy);
+    }
+    closeFd(memfd);
+  } catch (...) {
+    closeFd(memfd);
+    close();
+    throw;
+  }
+}
+
+void TSharedMemoryTransport::attach(int timeoutMs) {
+  if (map_ != nullptr) {
+    return;
+  }
+  struct pollfd pfd;
+  pfd.fd = socket_;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  int ret;
+  do {
+    ret = poll(&pfd, 1, timeoutMs);
+  } while (ret == -1 && errno == EINTR);
+  if (ret == 0 || !receiveHandshake()) {
+    throw TTransportException(TTransportException::TIMED_OUT,
+                              "No shared memory from the client (timed out)");
+  }
+}
+
+void TSharedMemoryTransport::attachNonblocking() {
+  nonblocking_ = true;
+  handshakePending_ = (map_ == nullptr);
+}
+
+bool TSharedMemoryTransport::receiveHandshake() {
+  char byte;
+  struct iovec iov;
+  iov.iov_base = &byte;
+  iov.iov_len = 1;
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int) * HANDSHAKE_FDS)];
+  } control;
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  ssize_t got;
+  do {
+    got = recvmsg(socket_, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+  } while (got == -1 && errno == EINTR);
+  if (got == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return false;
+  }
+
+  int fds[HANDSHAKE_FDS];
+  int received = 0;
+  if (got == 1) {
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        received = static_cast<int>((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        received = (std::min)(received, HANDSHAKE_FDS);
+        std::memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * received);
+      }
+    }
+  }
+  if (received != HANDSHAKE_FDS || (msg.msg_flags & MSG_CTRUNC) != 0) {
+    for (int i = 0; i < received; ++i) {
+      closeFd(fds[i]);
+    }
+    throw TTransportException(TTransportException::CLIENT_DISCONNECT,
+                              "The client did not send its shared memory");
+  }
+
+  try {
+    // Memory the client could still truncate would fault the server
+    int seals = fcntl(fds[0], F_GET_SEALS);
+    if (seals == -1 || (seals & SHARED_MEMORY_SEALS) != SHARED_MEMORY_SEALS) {
+      throw TTransportException(TTransportException::CLIENT_DISCONNECT,
+                                "Shared memory that is not sealed");
+    }
+    // The server signals them from its I/O threads, which must not wait
+    for (int i = 1; i < HANDSHAKE_FDS; ++i) {
+      int flags = isEventFd(fds[i]) ? fcntl(fds[i], F_GETFL) : -1;
+      if (flags == -1 || fcntl(fds[i], F_SETFL, flags | O_NONBLOCK) == -1) {
+        throw TTransportException(TTransportException::CLIENT_DISCONNECT,
+                                  "Wake descriptors that are not eventfds");
+      }
+    }
+    struct stat st;
+    if (fstat(fds[0], &st) == -1) {
+      int errno_copy = errno;
+      throw TTransportException(TTransportException::CLIENT_DISCONNECT, "fstat()", errno_copy);
+    }
+    map(fds[0], static_cast<size_t>(st.st_size), false);
+  } catch (...) {
+    for (int i = 0; i < HANDSHAKE_FDS; ++i) {
+      closeFd(fds[i]);
+    }
+    throw;
+  }
+  closeFd(fds[0]);
+  peerWakeFd_ = fds[1];
+  wakeFd_ = fds[2];
+  return true;
+}
+
+void TSharedMemoryTransport::map(int fd, size_t size, bool client) {
+  const size_t dataOffset = RINGS_OFFSET + 2 * sizeof(Ring);
+  if (size < dataOffset || size > dataOffset + 2 * static_cast<size_t>(MAX_RING_SIZE)) {
+    throw TTransportException(TTransportException::CLIENT_DISCONNECT,
+                              "Shared memory of the wrong size");
+  }
+  void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    int errno_copy = errno;
+    TOutput::instance().perror("TSharedMemoryTransport mmap() ", errno_copy);
+    throw TTransportException(TTransportException::NOT_OPEN, "mmap()", errno_copy);
+  }
+  map_ = static_cast<uint8_t*>(addr);
+  mapSize_ = size;
+
+  auto* header = reinterpret_cast<uint32_t*>(map_);
+  auto* toServer = reinterpret_cast<Ring*>(map_ + RINGS_OFFSET);
+  Ring* toClient = toServer + 1;
+  if (client) {
+    header[0] = SHARED_MEMORY_MAGIC;
+    header[1] = SHARED_MEMORY_VERSION;
+    header[2] = ringSize_;
+    for (Ring* ring : {toServer, toClient}) {
+      new (ring) Ring;
+      ring->head.store(0, std::memory_order_relaxed);
+      ring->consumerWaiting.store(WAKE_NONE, std::memory_order_relaxed);
+      ring->tail.store(0, std::memory_order_relaxed);
+      ring->producerWaiting.store(WAKE_NONE, std::memory_order_relaxed);
+    }
+    // The first request rings the socket, so that a nonblocking server
+    // hears about it however early it comes; a blocking one drains it
+    toServer->consumerWaiting.store(WAKE_SOCKET, std::memory_order_relaxed);
+  } else {
+    // The size is read once: the client could change the header later
+    ringSize_ = header[2];
+    if (header[0] != SHARED_MEMORY_MAGIC || header[1] != SHARED_MEMORY_VERSION
+        || ringSize_ < 4096 || ringSize_ > MAX_RING_SIZE || (ringSize_ & (ringSize_ - 1)) != 0
+        || size != dataOffset + 2 * static_cast<size_t>(ringSize_)) {
+      unmap();
+      throw TTransportException(TTransportException::CLIENT_DISCONNECT,
+                                "Shared memory with an unknown layout");
+    }
+  }
+
+  uint8_t* toServerData = map_ + dataOffset;
+  uint8_t* toClientData = toServerData + ringSize_;
+  in_ = client ? toClient : toServer;
+  out_ = client ? toServer : toClient;
+  inData_ = client ? toClientData : toServerData;
+  outData_ = client ? toServerData : toClientData;
+}
+
+void TSharedMemoryTransport::unmap() {
+  if (map_ != nullptr) {
+    munmap(map_, mapSize_);
+    map_ = nullptr;
+    mapSize_ = 0;
+    in_ = out_ = nullptr;
+    inData_ = outData_ = nullptr;
+  }
+}
+
+void TSharedMemoryTransport::close() {
+  // Closing the socket is what tells the peer; it reads what is left in
+  // the ring first
+  unmap();
+  closeFd(wakeFd_);
+  closeFd(peerWakeFd_);
+  peerClosed_ = false;
+  TSocket::close();
+}
+
+void TSharedMemoryTransport::wait(std::atomic<uint32_t>& waiting,
+                                  const std::atomic<uint64_t>& counter,
+                                  uint64_t seen,
+                                  int timeoutMs,
+                                  bool interruptible) {
+  // Ask to be woken, then look again: either this sees what the peer did
+  // or the peer sees the flag
+  waiting.store(WAKE_EVENTFD, std::memory_order_seq_cst);
+  if (counter.load(std::memory_order_seq_cst) != seen) {
+    waiting.store(WAKE_NONE, std::memory_order_relaxed);
+    return;
+  }
+
+  struct pollfd fds[3];
+  std::memset(fds, 0, sizeof(fds));
+  fds[0].fd = wakeFd_;
+  fds[0].events = POLLIN;
+  // Readable on a hang up, or with a doorbell meant for a nonblocking reader
+  fds[1].fd = socket_;
+  fds[1].events = POLLIN;
+  nfds_t nfds = 2;
+  if (interruptible && interruptListener_) {
+    fds[2].fd = *interruptListener_;
+    fds[2].events = POLLIN;
+    nfds = 3;
+  }
+  int ret = poll(fds, nfds, (timeoutMs == 0) ? -1 : timeoutMs);
+  int errno_copy = errno;
+  waiting.store(WAKE_NONE, std::memory_order_relaxed);
+
+  if (ret < 0) {
+    if (errno_copy == EINTR) {
+      return;
+    }
+    TOutput::instance().perror("TSharedMemoryTransport poll() ", errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN, "Unknown", errno_copy);
+  } else if (ret == 0) {
+    throw TTransportException(TTransportException::TIMED_OUT, "THRIFT_EAGAIN (timed out)");
+  }
+  if (fds[0].revents & POLLIN) {
+    uint64_t count;
+    ssize_t drained = ::read(wakeFd_, &count, sizeof(count));
+    (void)drained;
+  }
+  if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+    drainDoorbells();
+  }
+  if (nfds == 3 && (fds[2].revents & POLLIN)) {
+    throw TTransportException(TTransportException::INTERRUPTED, "Interrupted");
+  }
+}
+
+void TSharedMemoryTransport::wake(std::atomic<uint32_t>& waiting) {
+  // Pairs with the store and load in wait()
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting.load(std::memory_order_relaxed) == WAKE_NONE) {
+    return;
+  }
+  uint32_t how = waiting.exchange(WAKE_NONE);
+  if (how == WAKE_EVENTFD) {
+    // The eventfds are nonblocking; one too full to add to is readable
+    // already
+    uint64_t one = 1;
+    ssize_t written = ::write(peerWakeFd_, &one, sizeof(one));
+    (void)written;
+  } else if (how == WAKE_SOCKET) {
+    // A full socket buffer already has the peer's attention
+    char byte = 0;
+    send(socket_, &byte, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+  }
+}
+
+void TSharedMemoryTransport::drainDoorbells() {
+  char buf[64];
+  while (true) {
+    ssize_t got = recv(socket_, buf, sizeof(buf), MSG_DONTWAIT);
+    if (got > 0) {
+      continue;
+    }
+    if (got == -1 && errno == EINTR) {
+      continue;
+    }
+    if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      peerClosed_ = true;
+    }
+    return;
+  }
+}
+
+bool TSharedMemoryTransport::hasPendingDataToRead() {
+  return map_ != nullptr
+         && in_->head.load(std::memory_order_acquire) != in_->tail.load(std::memory_order_relaxed);
+}
+
+bool TSharedMemoryTransport::peek() {
+  if (!isOpen()) {
+    return false;
+  }
+  uint64_t tail = in_->tail.load(std::memory_order_relaxed);
+  for (int spins = 0; in_->head.load(std::memory_order_acquire) == tail;) {
+    if (peerClosed_ || nonblocking_) {
+      return false;
+    }
+    if (spins < spinCount_) {
+      ++spins;
+      cpuRelax();
+      continue;
+    }
+    try {
+      wait(in_->consumerWaiting, in_->head, tail, recvTimeout_, true);
+    } catch (TTransportException& ex) {
+      if (ex.getType() == TTransportException::INTERRUPTED
+          || ex.getType() == TTransportException::TIMED_OUT) {
+        return false;
+      }
+      throw;
+    }
+  }
+  return true;
+}
+
+uint32_t TSharedMemoryTransport::read(uint8_t* buf, uint32_t len) {
+  checkReadBytesAvailable(len);
+  if (handshakePending_) {
+    bool received;
+    try {
+      received = receiveHandshake();
+    } catch (TTransportException& ex) {
+      TOutput::instance().printf("TSharedMemoryTransport: %s", ex.what());
+      handshakePending_ = false;
+      // Nothing more may come to make the socket readable
+      ::shutdown(socket_, SHUT_RDWR);
+      return 0;
+    }
+    if (!received) {
+      throw TTransportException(TTransportException::UNKNOWN, "retry again");
+    }
+    handshakePending_ = false;
+  }
+  if (map_ == nullptr) {
+    if (nonblocking_ && socket_ != THRIFT_INVALID_SOCKET) {
+      // The client failed the handshake; let the server drop it
+      return 0;
+    }
+    throw TTransportException(TTransportException::NOT_OPEN, "Called read on non-open transport");
+  }
+
+  uint64_t tail = in_->tail.load(std::memory_order_relaxed);
+  uint64_t available = in_->head.load(std::memory_order_acquire) - tail;
+  for (int spins = 0; available == 0; available = in_->head.load(std::memory_order_acquire) - tail) {
+    if (peerClosed_) {
+      return 0;
+    }
+    if (spins < spinCount_) {
+      ++spins;
+      cpuRelax();
+      continue;
+    }
+    if (nonblocking_) {
+      // Doorbells stay on the socket for as long as the ring has data, so
+      // that an event loop waiting on the socket does not miss any
+      drainDoorbells();
+      in_->consumerWaiting.store(WAKE_SOCKET, std::memory_order_seq_cst);
+      if (in_->head.load(std::memory_order_seq_cst) != tail) {
+        // The flag stays set: the peer may have seen it clear already, and
+        // the event loop goes back to the socket once this data is read
+        continue;
+      }
+      if (peerClosed_) {
+        return 0;
+      }
+      throw TTransportException(TTransportException::UNKNOWN, "retry again");
+    }
+    wait(in_->consumerWaiting, in_->head, tail, recvTimeout_, true);
+  }
+  if (available > ringSize_) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA, "Shared memory ring overrun");
+  }
+
+  auto got = static_cast<uint32_t>((std::min)(static_cast<uint64_t>(len), available));
+  copyOut(inData_, ringSize_, tail, buf, got);
+  in_->tail.store(tail + got, std::memory_order_release);
+  wake(in_->producerWaiting);
+  return got;
+}
+
+uint32_t TSharedMemoryTransport::waitForRoom(uint64_t head, bool block) {
+  uint64_t tail = out_->tail.load(std::memory_order_acquire);
+  for (int spins = 0; head - tail == ringSize_; tail = out_->tail.load(std::memory_order_acquire)) {
+    if (peerClosed_) {
+      break;
+    }
+    if (spins < spinCount_) {
+      ++spins;
+      cpuRelax();
+      continue;
+    }
+    if (!block) {
+      // Ask for a doorbell, then look again, as in read()
+      out_->producerWaiting.store(WAKE_SOCKET, std::memory_order_seq_cst);
+      if (out_->tail.load(std::memory_order_seq_cst) != tail) {
+        out_->producerWaiting.store(WAKE_NONE, std::memory_order_relaxed);
+        continue;
+      }
+      // Doorbells already on the socket would wake the event loop at once.
+      // Any drained with them are for room made since, seen below, or for
+      // a request, which TNonblockingServer looks for once it has written.
+      drainDoorbells();
+      if (peerClosed_) {
+        break;
+      }
+      writeWaitingForRead_ = (out_->tail.load(std::memory_order_acquire) == tail);
+      return 0;
+    }
+    wait(out_->producerWaiting, out_->tail, tail, sendTimeout_, false);
+  }
+  if (peerClosed_) {
+    throw TTransportException(TTransportException::END_OF_FILE, "The peer closed the connection");
+  }
+  if (head - tail > ringSize_) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA, "Shared memory ring overrun");
+  }
+  return static_cast<uint32_t>(ringSize_ - (head - tail));
+}
+
+uint32_t TSharedMemoryTransport::write_partial(const uint8_t* buf, uint32_t len) {
+  return writeSome(buf, len, !nonblocking_);
+}
+
+uint32_t TSharedMemoryTransport::writeSome(const uint8_t* buf, uint32_t len, bool block) {
+  writeWaitingForRead_ = false;
+  if (map_ == nullptr) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Called write on non-open transport");
+  }
+  if (len == 0) {
+    return 0;
+  }
+  uint64_t head = out_->head.load(std::memory_order_relaxed);
+  uint32_t sent = (std::min)(len, waitForRoom(head, block));
+  if (sent == 0) {
+    return 0;
+  }
+  copyIn(outData_, ringSize_, head, buf, sent);
+  out_->head.store(head + sent, std::memory_order_release);
+  wake(out_->consumerWaiting);
+  return sent;
+}
+
+void TSharedMemoryTransport::write(const uint8_t* buf, uint32_t len) {
+  for (uint32_t sent = 0; sent < len;) {
+    sent += writeSome(buf + sent, len - sent, true);
+  }
+}
+
+void TSharedMemoryTransport::write_iov(const TIOVec* iov, uint32_t iovcnt) {
+  for (uint32_t i = 0; i < iovcnt; ++i) {
+    write(iov[i].base, iov[i].len);
+  }
+}
+}
+}
+} // apache::thrift::transport
@@ -0,0 +1,180 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TSHAREDMEMORYTRANSPORT_H_
+#define _THRIFT_TRANSPORT_TSHAREDMEMORYTRANSPORT_H_ 1
+
+#include <atomic>
+#include <string>
+
+#include <thrift/transport/TSocket.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Transport between two processes on the same host that moves the data
+ * through a pair of ring buffers in shared memory instead of the kernel's
+ * network stack.
+ *
+ * The client connects to a TSharedMemoryServerTransport (or to a
+ * TNonblockingSharedMemoryServerTransport under TNonblockingServer) on a
+ * UNIX domain socket. It then creates the shared memory with memfd_create()
+ * and an eventfd for each side, and hands all three descriptors to the
+ * server over the socket. A side that finds its ring empty, or the other
+ * ring full, goes to sleep on its eventfd. The other side signals that
+ * eventfd only when it sees the sleeper's flag in the ring, so a busy
+ * connection makes no system calls at all. The socket stays open for the
+ * life of the connection, so either side sees the other close it or exit.
+ *
+ * It is a TSocket so that servers can use it wherever they take one; the
+ * host, port and socket options refer to the UNIX domain socket.
+ *
+ * Only available on Linux (HAVE_MEMFD_CREATE).
+ */
+class TSharedMemoryTransport : public TSocket {
+public:
+  /// Bytes in each direction, unless the client asks for another size.
+  static const uint32_t DEFAULT_RING_SIZE = 256 * 1024;
+
+  /// The largest ring size a server accepts.
+  static const uint32_t MAX_RING_SIZE = 64 * 1024 * 1024;
+
+  /**
+   * Client constructor: open() connects to the server listening on the
+   * UNIX domain socket at path.
+   *
+   * @param path     Path of the server's UNIX domain socket
+   * @param ringSize Bytes in each direction, a power of two
+   */
+  TSharedMemoryTransport(const std::string& path,
+                         uint32_t ringSize = DEFAULT_RING_SIZE,
+                         std::shared_ptr<TConfiguration> config = nullptr);
+
+  /**
+   * Server constructor, for a connection accepted on the UNIX domain socket.
+   * It is not open until attach() or attachNonblocking() has received the
+   * client's shared memory.
+   *
+   * @param socket            The accepted socket
+   * @param interruptListener Interrupts blocking reads, as for TSocket
+   */
+  TSharedMemoryTransport(THRIFT_SOCKET socket,
+                         std::shared_ptr<THRIFT_SOCKET> interruptListener,
+                         std::shared_ptr<TConfiguration> config = nullptr);
+
+  ~TSharedMemoryTransport() override;
+
+  bool isOpen() const override;
+  bool peek() override;
+  void open() override;
+  void close() override;
+  bool hasPendingDataToRead() override;
+  uint32_t read(uint8_t* buf, uint32_t len) override;
+  void write(const uint8_t* buf, uint32_t len) override;
+  uint32_t write_partial(const uint8_t* buf, uint32_t len) override;
+  void write_iov(const TIOVec* iov, uint32_t iovcnt) override;
+
+  /**
+   * Server side: wait up to timeoutMs for the client's shared memory and
+   * eventfds and map them.
+   *
+   * @throws TTransportException if the client sent nothing usable
+   */
+  void attach(int timeoutMs);
+
+  /**
+   * Server side, for an event loop such as TNonblockingServer's: nothing
+   * waits. The first read() once the socket is readable takes the client's
+   * shared memory. After that, read() throws a TTransportException whose
+   * message contains "retry" when there is nothing to read, and
+   * write_partial() returns 0 when the client has not made room in the
+   * ring, with isWriteWaitingForRead() set. Either way the client makes the
+   * socket readable once there is something to do. write() still waits for
+   * room. If the handshake fails, the socket is shut down and read()
+   * returns 0, for the event loop to drop the connection.
+   */
+  void attachNonblocking();
+
+  bool isWriteWaitingForRead() override { return writeWaitingForRead_; }
+
+  /**
+   * Check the ring this many times before going to sleep when it is empty
+   * or full. Spinning saves the wakeup when the other side answers within
+   * microseconds and there is a CPU to spare for each side; otherwise it
+   * only burns CPU. The default, 0, always goes to sleep.
+   */
+  void setSpinCount(int spinCount) { spinCount_ = spinCount; }
+
+  /**
+   * Bytes in each direction.
+   */
+  uint32_t getRingSize() const { return ringSize_; }
+
+private:
+  struct Ring;
+
+  // Receive and map the client's shared memory and eventfds; false if
+  // they have not arrived yet
+  bool receiveHandshake();
+
+  // Map size bytes of fd and find the rings in it
+  void map(int fd, size_t size, bool client);
+  void unmap();
+
+  // Wait until counter moves past seen, the peer goes away or the
+  // timeout passes; waiting is the flag in the ring that asks to be woken
+  void wait(std::atomic<uint32_t>& waiting,
+            const std::atomic<uint64_t>& counter,
+            uint64_t seen,
+            int timeoutMs,
+            bool interruptible);
+
+  // Wake the peer if it asked to be
+  void wake(std::atomic<uint32_t>& waiting);
+
+  // Read whatever the peer wrote to the socket to wake a nonblocking side
+  void drainDoorbells();
+
+  // Room in the ring to write to, waiting for some unless block is false
+  uint32_t waitForRoom(uint64_t head, bool block);
+
+  uint32_t writeSome(const uint8_t* buf, uint32_t len, bool block);
+
+  uint8_t* map_;
+  size_t mapSize_;
+  Ring* in_;
+  Ring* out_;
+  uint8_t* inData_;
+  uint8_t* outData_;
+  uint32_t ringSize_;
+  int wakeFd_;
+  int peerWakeFd_;
+  bool nonblocking_;
+  bool handshakePending_;
+  bool writeWaitingForRead_;
+  bool peerClosed_;
+  int spinCount_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TSHAREDMEMORYTRANSPORT_H_
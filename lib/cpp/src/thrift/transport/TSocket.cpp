@@ -33,6 +33,9 @@
 #ifdef HAVE_SYS_UN_H
 #include <sys/un.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 #ifdef HAVE_POLL_H
 #include <poll.h>
 #endif
@@ -207,6 +210,10 @@ try_again:
   return numBytesAvailable > 0;
 }
 
+bool TSocket::isWriteWaitingForRead() {
+  return false;
+}
+
 bool TSocket::isOpen() const {
   return (socket_ != THRIFT_INVALID_SOCKET);
 }
@@ -696,6 +703,104 @@ uint32_t TSocket::write_partial(const uint8_t* buf, uint32_t len) {
   return b;
 }
 
+void TSocket::write_iov(const TIOVec* iov, uint32_t iovcnt) {
+#ifdef HAVE_SYS_UIO_H
+  // Bytes of iov[0] that have already been sent
+  uint32_t offset = 0;
+
+  for (;;) {
+    while (iovcnt > 0 && iov->len == offset) {
+      ++iov;
+      --iovcnt;
+      offset = 0;
+    }
+    if (iovcnt == 0) {
+      return;
+    }
+
+    uint32_t b = write_iov_partial(iov, iovcnt, offset);
+    if (b == 0) {
+      // This should only happen if the timeout set with SO_SNDTIMEO expired.
+      // Raise an exception.
+      throw TTransportException(TTransportException::TIMED_OUT, "send timeout expired");
+    }
+
+    // Step over what went out, leaving offset inside the first unfinished buffer
+    while (b > 0) {
+      uint32_t rest = iov->len - offset;
+      if (b < rest) {
+        offset += b;
+        break;
+      }
+      b -= rest;
+      ++iov;
+      --iovcnt;
+      offset = 0;
+    }
+  }
+#else
+  TVirtualTransport<TSocket>::write_iov(iov, iovcnt);
+#endif
+}
+
+uint32_t TSocket::write_iov_partial(const TIOVec* iov, uint32_t iovcnt, uint32_t offset) {
+#ifdef HAVE_SYS_UIO_H
+  if (socket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Called write on non-open socket");
+  }
+
+  // Keep the total within what a single call can report back
+  const int MAX_IOV = 64;
+  struct iovec vec[MAX_IOV];
+  int n = 0;
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < iovcnt && n < MAX_IOV && total < 0x40000000; ++i) {
+    uint32_t skip = (i == 0) ? offset : 0;
+    if (iov[i].len == skip) {
+      continue;
+    }
+    vec[n].iov_base = const_cast<uint8_t*>(iov[i].base + skip);
+    vec[n].iov_len = iov[i].len - skip;
+    total += vec[n].iov_len;
+    ++n;
+  }
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = vec;
+  msg.msg_iovlen = n;
+
+  int flags = 0;
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif // ifdef MSG_NOSIGNAL
+
+  ssize_t b = sendmsg(socket_, &msg, flags);
+
+  if (b < 0) {
+    if (THRIFT_GET_SOCKET_ERROR == THRIFT_EWOULDBLOCK || THRIFT_GET_SOCKET_ERROR == THRIFT_EAGAIN) {
+      return 0;
+    }
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    TOutput::instance().perror("TSocket::write_iov() sendmsg() " + getSocketInfo(), errno_copy);
+
+    if (errno_copy == THRIFT_EPIPE || errno_copy == THRIFT_ECONNRESET
+        || errno_copy == THRIFT_ENOTCONN) {
+      throw TTransportException(TTransportException::NOT_OPEN, "write() sendmsg()", errno_copy);
+    }
+
+    throw TTransportException(TTransportException::UNKNOWN, "write() sendmsg()", errno_copy);
+  }
+
+  if (b == 0) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Socket send returned 0.");
+  }
+  return static_cast<uint32_t>(b);
+#else
+  return write_partial(iov->base + offset, iov->len - offset);
+#endif
+}
+
 std::string TSocket::getHost() const {
   return host_;
 }
@@ -114,6 +114,17 @@ public:
    */
   virtual bool hasPendingDataToRead();
 
+  /**
+   * Determines whether the last write_partial(), if it wrote nothing, is
+   * waiting for the socket to become readable rather than writable, as for
+   * a transport whose peer makes room somewhere other than the socket.
+   *
+   * This call does not block.
+   * \returns true if an event loop should wait for the socket to be readable
+   *          before writing again, false otherwise
+   */
+  virtual bool isWriteWaitingForRead();
+
   /**
    * Reads from the underlying socket.
    * \returns the number of bytes read or 0 indicates EOF
@@ -136,6 +147,12 @@ public:
    */
   virtual uint32_t write_partial(const uint8_t* buf, uint32_t len);
 
+  /**
+   * Writes all buffers to the underlying socket, handing as many of them as
+   * possible to each sendmsg().  Loops until done or fail.
+   */
+  virtual void write_iov(const TIOVec* iov, uint32_t iovcnt);
+
   /**
    * Get the host that the socket is connected to
    *
@@ -369,6 +386,7 @@ protected:
 private:
   void unix_open();
   void local_open();
+  uint32_t write_iov_partial(const TIOVec* iov, uint32_t iovcnt, uint32_t offset);
 };
 }
 }
@@ -50,6 +50,14 @@ uint32_t readAll(Transport_& trans, uint8_t* buf, uint32_t len) {
   return have;
 }
 
+/**
+ * One buffer of a vectored write. See TTransport::write_iov().
+ */
+struct TIOVec {
+  const uint8_t* base;
+  uint32_t len;
+};
+
 /**
  * Generic interface for a method of transporting data. A TTransport may be
  * capable of either reading or writing, but not necessarily both.
@@ -167,6 +175,28 @@ public:
     throw TTransportException(TTransportException::NOT_OPEN, "Base TTransport cannot write.");
   }
 
+  /**
+   * Writes several buffers in their entirety, in order, as if by one call
+   * to write() per buffer. Transports that can pass all of them down at
+   * once, such as TSocket through sendmsg(), avoid copying them together
+   * first.
+   *
+   * @param iov     The buffers to write out
+   * @param iovcnt  Number of entries in iov
+   * @throws TTransportException if an error occurs
+   */
+  void write_iov(const TIOVec* iov, uint32_t iovcnt) {
+    T_VIRTUAL_CALL();
+    write_iov_virt(iov, iovcnt);
+  }
+  virtual void write_iov_virt(const TIOVec* iov, uint32_t iovcnt) {
+    for (uint32_t i = 0; i < iovcnt; ++i) {
+      if (iov[i].len > 0) {
+        write(iov[i].base, iov[i].len);
+      }
+    }
+  }
+
   /**
    * Called when write is completed.
    * This can be over-ridden to perform a transport-specific action
@@ -249,6 +279,13 @@ public:
     throw TTransportException(TTransportException::NOT_OPEN, "Base TTransport cannot consume.");
   }
 
+  /**
+   * Whether a pointer returned by borrow() stays valid for the rest of the
+   * message being read, instead of only until the next read or borrow.
+   * Protocols only hand borrowed bytes out to their caller when it does.
+   */
+  virtual bool isBorrowStable() const { return false; }
+
   /**
    * Returns the origin of the transports call. The value depends on the
    * transport used. An IP based transport for example will return the
@@ -30,7 +30,7 @@ namespace transport {
  * Helper class that provides default implementations of TTransport methods.
  *
  * This class provides default implementations of read(), readAll(), write(),
- * borrow() and consume().
+ * write_iov(), borrow() and consume().
  *
  * In the TTransport base class, each of these methods simply invokes its
  * virtual counterpart.  This class overrides them to always perform the
@@ -51,6 +51,9 @@ public:
   uint32_t read(uint8_t* buf, uint32_t len) { return this->TTransport::read_virt(buf, len); }
   uint32_t readAll(uint8_t* buf, uint32_t len) { return this->TTransport::readAll_virt(buf, len); }
   void write(const uint8_t* buf, uint32_t len) { this->TTransport::write_virt(buf, len); }
+  void write_iov(const TIOVec* iov, uint32_t iovcnt) {
+    this->TTransport::write_iov_virt(iov, iovcnt);
+  }
   const uint8_t* borrow(uint8_t* buf, uint32_t* len) {
     return this->TTransport::borrow_virt(buf, len);
   }
@@ -96,6 +99,10 @@ public:
     static_cast<Transport_*>(this)->write(buf, len);
   }
 
+  void write_iov_virt(const TIOVec* iov, uint32_t iovcnt) override {
+    static_cast<Transport_*>(this)->write_iov(iov, iovcnt);
+  }
+
   const uint8_t* borrow_virt(uint8_t* buf, uint32_t* len) override {
     return static_cast<Transport_*>(this)->borrow(buf, len);
   }
@@ -0,0 +1,154 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TByteSwapUtils.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+#define BOOST_TEST_MODULE ByteSwapTest
+#include <boost/test/unit_test.hpp>
+
+using namespace apache::thrift::protocol;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransport;
+
+static void checkSwap(void (*swap)(void*, uint32_t),
+                      void (*swapCopy)(const void*, void*, uint32_t),
+                      uint32_t size) {
+  // Every count up to a few vectors' worth, at every alignment
+  for (uint32_t offset = 0; offset < 8; ++offset) {
+    for (uint32_t count = 0; count < 80; ++count) {
+      std::vector<uint8_t> data(offset + count * size);
+      for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 7 + 1);
+      }
+      std::vector<uint8_t> expected(data);
+      for (uint32_t i = 0; i < count; ++i) {
+        std::reverse(expected.begin() + offset + i * size,
+                     expected.begin() + offset + (i + 1) * size);
+      }
+
+      std::vector<uint8_t> copy(data.size());
+      swapCopy(data.data() + offset, copy.data() + offset, count);
+      BOOST_CHECK(std::equal(copy.begin() + offset, copy.end(), expected.begin() + offset));
+
+      swap(data.data() + offset, count);
+      BOOST_CHECK(data == expected);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_byte_swap) {
+  checkSwap(byte_swap_16, byte_swap_copy_16, 2);
+  checkSwap(byte_swap_32, byte_swap_copy_32, 4);
+  checkSwap(byte_swap_64, byte_swap_copy_64, 8);
+}
+
+/*
+ * Writes values in bulk and one by one, which must give the same bytes,
+ * then reads them back in bulk, straight from the buffer and through a
+ * transport that does not lend its buffer.
+ */
+template <typename Protocol_, typename T>
+static void checkArray(uint32_t (Protocol_::*writeArray)(const T*, uint32_t),
+                       uint32_t (Protocol_::*writeOne)(T),
+                       uint32_t (Protocol_::*readArray)(T*, uint32_t)) {
+  // More than one chunk of the protocol's
+  std::vector<T> values(3000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<T>(i * 2654435761u) / 3;
+  }
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ oprot(buffer);
+  uint32_t wsize = (oprot.*writeArray)(values.data(), static_cast<uint32_t>(values.size()));
+  BOOST_CHECK_EQUAL(wsize, values.size() * sizeof(T));
+  std::string bulk = buffer->getBufferAsString();
+
+  buffer->resetBuffer();
+  for (size_t i = 0; i < values.size(); ++i) {
+    (oprot.*writeOne)(values[i]);
+  }
+  BOOST_CHECK(buffer->getBufferAsString() == bulk);
+
+  for (int lend = 0; lend < 2; ++lend) {
+    std::shared_ptr<TMemoryBuffer> rbuffer(new TMemoryBuffer());
+    rbuffer->write(reinterpret_cast<const uint8_t*>(bulk.data()), static_cast<uint32_t>(bulk.size()));
+    std::shared_ptr<TTransport> trans = rbuffer;
+    if (!lend) {
+      trans.reset(new TBufferedTransport(rbuffer, 100));
+    }
+    Protocol_ iprot(trans);
+    std::vector<T> decoded(values.size());
+    uint32_t rsize = (iprot.*readArray)(decoded.data(), static_cast<uint32_t>(decoded.size()));
+    BOOST_CHECK_EQUAL(rsize, wsize);
+    BOOST_CHECK(decoded == values);
+  }
+}
+
+template <typename Protocol_>
+static void checkArrays() {
+  checkArray<Protocol_, int16_t>(&Protocol_::writeI16Array, &Protocol_::writeI16,
+                                 &Protocol_::readI16Array);
+  checkArray<Protocol_, int32_t>(&Protocol_::writeI32Array, &Protocol_::writeI32,
+                                 &Protocol_::readI32Array);
+  checkArray<Protocol_, int64_t>(&Protocol_::writeI64Array, &Protocol_::writeI64,
+                                 &Protocol_::readI64Array);
+  checkArray<Protocol_, double>(&Protocol_::writeDoubleArray, &Protocol_::writeDouble,
+                                &Protocol_::readDoubleArray);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_arrays) {
+  checkArrays<TBinaryProtocolT<TTransport> >();
+  checkArrays<TBinaryProtocolT<TTransport, TNetworkLittleEndian> >();
+}
+
+BOOST_AUTO_TEST_CASE(test_generated_lists_are_overwritten) {
+  using thrift::test::debug::CompactProtoTestStruct;
+  CompactProtoTestStruct expected;
+  for (int i = 0; i < 20; ++i) {
+    expected.i16_list.push_back(static_cast<int16_t>(i * 1000 - 5000));
+    expected.i32_list.push_back(i * 100000 - 500000);
+    expected.i64_list.push_back(static_cast<int64_t>(i) << 40);
+    expected.double_list.push_back(i / 3.0);
+    expected.i64_set.insert(-i);
+    expected.double_set.insert(i * 0.5);
+  }
+
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol prot(buffer);
+  expected.write(&prot);
+
+  // Lists read in bulk are resized rather than cleared first
+  CompactProtoTestStruct result;
+  result.i16_list.assign(100, 1);
+  result.double_list.assign(1, 1.0);
+  result.i64_set.insert(1);
+  result.read(&prot);
+  BOOST_CHECK(result.i16_list == expected.i16_list);
+  BOOST_CHECK(result.i32_list == expected.i32_list);
+  BOOST_CHECK(result.i64_list == expected.i64_list);
+  BOOST_CHECK(result.double_list == expected.double_list);
+  BOOST_CHECK(result.i64_set == expected.i64_set);
+  BOOST_CHECK(result.double_set == expected.double_set);
+}
@@ -0,0 +1,135 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TChainedMemoryBuffer.h>
+#include <thrift/transport/TFDTransport.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace thrift::test::debug;
+
+class Timer {
+public:
+  timeval vStart;
+
+  Timer() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+  void start() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+
+  double frame() {
+    timeval vEnd;
+    THRIFT_GETTIMEOFDAY(&vEnd, nullptr);
+    double dstart = vStart.tv_sec + ((double)vStart.tv_usec / 1000000.0);
+    double dend = vEnd.tv_sec + ((double)vEnd.tv_usec / 1000000.0);
+    return dend - dstart;
+  }
+};
+
+// Peak resident set size of the process so far, in MB
+static long peakRssMb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024;
+}
+
+static void report(const char* label, double serialize, double send, uint32_t size, int num) {
+  double mb = static_cast<double>(size) * num / (1024 * 1024);
+  std::cout << label << ":\n"
+            << "  serialize: " << mb / serialize << " MB/sec\n"
+            << "  write out: " << mb / send << " MB/sec\n"
+            << "  peak RSS so far: " << peakRssMb() << " MB\n";
+}
+
+/**
+ * Serializes the message with a fresh buffer each time, as a server does for
+ * each response, then writes it to /dev/null.
+ */
+template <typename Buffer>
+static uint32_t run(const ListDoublePerf& ldp,
+                    TFDTransport& out,
+                    int num,
+                    double& serialize,
+                    double& send,
+                    void (*writeOut)(Buffer&, TFDTransport&)) {
+  uint32_t size = 0;
+  serialize = send = 0;
+  for (int i = 0; i < num; ++i) {
+    std::shared_ptr<Buffer> buf(new Buffer());
+    TBinaryProtocolT<Buffer> prot(buf);
+    Timer timer;
+    ldp.write(&prot);
+    serialize += timer.frame();
+    size = buf->writeEnd();
+
+    timer.start();
+    writeOut(*buf, out);
+    send += timer.frame();
+  }
+  return size;
+}
+
+static void writeMemoryBuffer(TMemoryBuffer& buf, TFDTransport& out) {
+  uint8_t* data;
+  uint32_t size;
+  buf.getBuffer(&data, &size);
+  out.write(data, size);
+}
+
+static void writeChainedBuffer(TChainedMemoryBuffer& buf, TFDTransport& out) {
+  buf.writeTo(out);
+}
+
+/*
+ * Compares TChainedMemoryBuffer with TMemoryBuffer on a 64 MB message. The
+ * chained buffer runs first, so the second peak RSS shows what TMemoryBuffer
+ * adds on top.
+ */
+int main() {
+  ListDoublePerf ldp;
+  ldp.field.assign(8 * 1024 * 1024, 1.5);
+  int fd = open("/dev/null", O_WRONLY);
+  if (fd < 0) {
+    return 1;
+  }
+  TFDTransport out(fd, TFDTransport::CLOSE_ON_DESTROY);
+  std::cout << "message data: " << peakRssMb() << " MB peak RSS\n";
+
+  int num = 5;
+  double serialize;
+  double send;
+  uint32_t size = run<TChainedMemoryBuffer>(ldp, out, num, serialize, send, writeChainedBuffer);
+  report("TChainedMemoryBuffer", serialize, send, size, num);
+  size = run<TMemoryBuffer>(ldp, out, num, serialize, send, writeMemoryBuffer);
+  report("TMemoryBuffer", serialize, send, size, num);
+  return 0;
+}
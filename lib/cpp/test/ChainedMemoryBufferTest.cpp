@@ -0,0 +1,235 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE ChainedMemoryBufferTest
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TChainedMemoryBuffer.h>
+#include <thrift/transport/TFDTransport.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+using apache::thrift::protocol::TBinaryProtocolT;
+using apache::thrift::protocol::TCompactProtocolT;
+using apache::thrift::transport::TChainedMemoryBuffer;
+using apache::thrift::transport::TFDTransport;
+using apache::thrift::transport::TIOVec;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TMemorySegmentPool;
+using apache::thrift::transport::TTransportException;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+static string makePayload(uint32_t size) {
+  string payload(size, '\0');
+  for (uint32_t i = 0; i < size; ++i) {
+    payload[i] = static_cast<char>(i * 7 + (i >> 8));
+  }
+  return payload;
+}
+
+static void write(TChainedMemoryBuffer& buffer, const string& data) {
+  buffer.write(reinterpret_cast<const uint8_t*>(data.data()), static_cast<uint32_t>(data.size()));
+}
+
+static thrift::test::debug::HolyMoley makeHolyMoley() {
+  thrift::test::debug::HolyMoley hm;
+  for (int i = 0; i < 50; ++i) {
+    thrift::test::debug::OneOfEach ooe;
+    ooe.integer32 = i;
+    ooe.some_characters = "some characters " + std::to_string(i);
+    ooe.base64 = makePayload(i * 3);
+    hm.big.push_back(ooe);
+  }
+  hm.contain.insert(vector<string>(3, "contained"));
+  return hm;
+}
+
+BOOST_AUTO_TEST_CASE(test_read_write_across_segments) {
+  shared_ptr<TMemorySegmentPool> pool(new TMemorySegmentPool(16));
+  TChainedMemoryBuffer buffer(pool);
+  BOOST_CHECK(!buffer.peek());
+  BOOST_CHECK_EQUAL(buffer.available_read(), 0u);
+
+  string payload = makePayload(1000);
+  for (uint32_t step : {1u, 5u, 16u, 17u, 100u, 1000u}) {
+    for (uint32_t pos = 0; pos < payload.size(); pos += step) {
+      write(buffer, payload.substr(pos, step));
+    }
+    BOOST_CHECK_EQUAL(buffer.available_read(), payload.size());
+    BOOST_CHECK_EQUAL(buffer.writeEnd(), payload.size());
+    BOOST_CHECK(buffer.getBufferAsString() == payload);
+
+    string out(payload.size(), '\0');
+    uint32_t got = 0;
+    while (got < out.size()) {
+      uint32_t want = (std::min)(step + 3, static_cast<uint32_t>(out.size()) - got);
+      got += buffer.read(reinterpret_cast<uint8_t*>(&out[got]), want);
+    }
+    BOOST_CHECK(out == payload);
+    BOOST_CHECK_EQUAL(buffer.available_read(), 0u);
+    uint8_t byte;
+    BOOST_CHECK_EQUAL(buffer.read(&byte, 1), 0u);
+    BOOST_CHECK_EQUAL(buffer.readEnd(), payload.size());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_interleaved) {
+  // Reading keeps up with writing, so only a few segments are in use
+  shared_ptr<TMemorySegmentPool> pool(new TMemorySegmentPool(64));
+  TChainedMemoryBuffer buffer(pool);
+  string payload = makePayload(50);
+  string out(payload.size(), '\0');
+  for (int i = 0; i < 100; ++i) {
+    write(buffer, payload);
+    buffer.readAll(reinterpret_cast<uint8_t*>(&out[0]), static_cast<uint32_t>(out.size()));
+    BOOST_REQUIRE(out == payload);
+  }
+  BOOST_CHECK_LE(pool->getFreeCount(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(test_segments_go_back_to_the_pool) {
+  shared_ptr<TMemorySegmentPool> pool(new TMemorySegmentPool(32, 4));
+  {
+    TChainedMemoryBuffer buffer(pool);
+    write(buffer, makePayload(32 * 10));
+    BOOST_CHECK_EQUAL(pool->getFreeCount(), 0u);
+    buffer.resetBuffer();
+    // One kept for the next message, and no more than the pool holds
+    BOOST_CHECK_EQUAL(pool->getFreeCount(), 4u);
+    BOOST_CHECK_EQUAL(buffer.available_read(), 0u);
+
+    write(buffer, makePayload(32 * 3));
+    BOOST_CHECK_EQUAL(pool->getFreeCount(), 2u);
+    BOOST_CHECK(buffer.getBufferAsString() == makePayload(32 * 3));
+  }
+  BOOST_CHECK_EQUAL(pool->getFreeCount(), 4u);
+
+  BOOST_CHECK_THROW(TMemorySegmentPool(0), TTransportException);
+}
+
+BOOST_AUTO_TEST_CASE(test_borrow_consume) {
+  shared_ptr<TMemorySegmentPool> pool(new TMemorySegmentPool(16));
+  TChainedMemoryBuffer buffer(pool);
+  string payload = makePayload(40);
+  write(buffer, payload);
+
+  // Borrowing stops at the end of a segment
+  uint32_t len = 10;
+  const uint8_t* borrowed = buffer.borrow(nullptr, &len);
+  BOOST_REQUIRE(borrowed != nullptr);
+  BOOST_CHECK_EQUAL(len, 16u);
+  BOOST_CHECK(string(reinterpret_cast<const char*>(borrowed), 16) == payload.substr(0, 16));
+  buffer.consume(16);
+
+  len = 17;
+  BOOST_CHECK(buffer.borrow(nullptr, &len) == nullptr);
+  len = 16;
+  borrowed = buffer.borrow(nullptr, &len);
+  BOOST_REQUIRE(borrowed != nullptr);
+  BOOST_CHECK(string(reinterpret_cast<const char*>(borrowed), 16) == payload.substr(16, 16));
+  buffer.consume(10);
+
+  uint8_t out[14];
+  BOOST_CHECK_EQUAL(buffer.read(out, sizeof(out)), 14u);
+  BOOST_CHECK(string(reinterpret_cast<char*>(out), 14) == payload.substr(26, 14));
+}
+
+BOOST_AUTO_TEST_CASE(test_iovecs) {
+  shared_ptr<TMemorySegmentPool> pool(new TMemorySegmentPool(100));
+  TChainedMemoryBuffer buffer(pool);
+  string payload = makePayload(350);
+  write(buffer, payload);
+  uint8_t skip[30];
+  buffer.read(skip, sizeof(skip));
+
+  vector<TIOVec> iov;
+  buffer.getIOVecs(iov);
+  BOOST_REQUIRE_EQUAL(iov.size(), 4u);
+  BOOST_CHECK_EQUAL(iov[0].len, 70u);
+  BOOST_CHECK_EQUAL(iov[3].len, 50u);
+  string joined;
+  for (const TIOVec& vec : iov) {
+    joined.append(reinterpret_cast<const char*>(vec.base), vec.len);
+  }
+  BOOST_CHECK(joined == payload.substr(30));
+
+  // Any transport can take the chain, with or without a vectored write
+  shared_ptr<TMemoryBuffer> memory(new TMemoryBuffer());
+  buffer.writeTo(*memory);
+  BOOST_CHECK(memory->getBufferAsString() == payload.substr(30));
+  BOOST_CHECK_EQUAL(buffer.available_read(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_write_to_file) {
+  // More segments than one writev() takes
+  shared_ptr<TMemorySegmentPool> pool(new TMemorySegmentPool(100));
+  TChainedMemoryBuffer buffer(pool);
+  string payload = makePayload(100 * 200 + 33);
+  write(buffer, payload);
+
+  FILE* file = std::tmpfile();
+  BOOST_REQUIRE(file != nullptr);
+  TFDTransport fd(fileno(file));
+  buffer.writeTo(fd);
+  BOOST_CHECK_EQUAL(buffer.available_read(), 0u);
+
+  std::rewind(file);
+  string out(payload.size() + 1, '\0');
+  BOOST_CHECK_EQUAL(std::fread(&out[0], 1, out.size(), file), payload.size());
+  out.resize(payload.size());
+  BOOST_CHECK(out == payload);
+  std::fclose(file);
+}
+
+BOOST_AUTO_TEST_CASE(test_protocol_round_trip) {
+  thrift::test::debug::HolyMoley hm = makeHolyMoley();
+  shared_ptr<TMemorySegmentPool> pool(new TMemorySegmentPool(256));
+  shared_ptr<TChainedMemoryBuffer> buffer(new TChainedMemoryBuffer(pool));
+
+  // The compact protocol borrows on read, which falls back to reading
+  // whenever a value straddles two segments
+  TBinaryProtocolT<TChainedMemoryBuffer> binary(buffer);
+  TCompactProtocolT<TChainedMemoryBuffer> compact(buffer);
+  for (int i = 0; i < 2; ++i) {
+    apache::thrift::protocol::TProtocol& prot
+        = (i == 0) ? static_cast<apache::thrift::protocol::TProtocol&>(binary) : compact;
+    hm.write(&prot);
+
+    // The same bytes as TMemoryBuffer would hold
+    shared_ptr<TMemoryBuffer> memory(new TMemoryBuffer());
+    TBinaryProtocolT<TMemoryBuffer> memoryBinary(memory);
+    TCompactProtocolT<TMemoryBuffer> memoryCompact(memory);
+    hm.write((i == 0) ? static_cast<apache::thrift::protocol::TProtocol*>(&memoryBinary)
+                      : &memoryCompact);
+    BOOST_CHECK(buffer->getBufferAsString() == memory->getBufferAsString());
+
+    thrift::test::debug::HolyMoley result;
+    result.read(&prot);
+    BOOST_CHECK(result == hm);
+    BOOST_CHECK_EQUAL(buffer->available_read(), 0u);
+  }
+}
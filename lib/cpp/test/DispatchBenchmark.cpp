@@ -0,0 +1,115 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "gen-cpp/DispatchService.h"
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+class Timer {
+public:
+  timeval vStart;
+
+  Timer() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+  void start() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+
+  double frame() {
+    timeval vEnd;
+    THRIFT_GETTIMEOFDAY(&vEnd, nullptr);
+    double dstart = vStart.tv_sec + ((double)vStart.tv_usec / 1000000.0);
+    double dend = vEnd.tv_sec + ((double)vEnd.tv_usec / 1000000.0);
+    return dend - dstart;
+  }
+};
+
+/*
+ * Compares the switch based method lookup of a generated processor with the
+ * std::map lookup that processors used before, on a service with 128
+ * functions. Both are fed the same names, in the same order.
+ */
+int main() {
+  using dispatchbench::DispatchServiceProcessor;
+  using std::cout;
+
+  const char* verbs[] = {"get", "set", "list", "create", "delete", "update", "find", "count"};
+  const char* nouns[] = {"User", "Account", "Order", "Invoice", "Payment", "Session",
+                         "Product", "Review", "Address", "Shipment", "Coupon", "Cart",
+                         "Ticket", "Message", "Report", "Token"};
+
+  std::vector<std::string> names;
+  std::map<std::string, int32_t> processMap;
+  for (const char* noun : nouns) {
+    for (const char* verb : verbs) {
+      std::string name = std::string(verb) + noun;
+      processMap[name] = static_cast<int32_t>(names.size());
+      names.push_back(name);
+    }
+  }
+  // Some misses, as a server sees from mismatched clients
+  names.push_back("getUsers");
+  names.push_back("ping");
+
+  // Both lookups have to agree before their timings mean anything
+  for (const std::string& name : names) {
+    std::map<std::string, int32_t>::const_iterator it = processMap.find(name);
+    int32_t expected = it == processMap.end() ? -1 : it->second;
+    if (DispatchServiceProcessor::getMethodId(name) != expected) {
+      cout << "getMethodId(\"" << name << "\") returned "
+           << DispatchServiceProcessor::getMethodId(name) << ", expected " << expected << "\n";
+      return 1;
+    }
+  }
+
+  int num = 100000;
+  int64_t checksum = 0;
+
+  {
+    Timer timer;
+    for (int i = 0; i < num; ++i) {
+      for (const std::string& name : names) {
+        std::map<std::string, int32_t>::const_iterator it = processMap.find(name);
+        checksum += it == processMap.end() ? -1 : it->second;
+      }
+    }
+    double elapsed = timer.frame();
+    cout << "std::map lookup: " << num * names.size() / elapsed << " lookups/sec\n";
+  }
+
+  {
+    Timer timer;
+    for (int i = 0; i < num; ++i) {
+      for (const std::string& name : names) {
+        checksum -= DispatchServiceProcessor::getMethodId(name);
+      }
+    }
+    double elapsed = timer.frame();
+    cout << "getMethodId: " << num * names.size() / elapsed << " lookups/sec\n";
+  }
+
+  // Keeps the loops from being optimized away; always 0
+  return checksum == 0 ? 0 : 1;
+}
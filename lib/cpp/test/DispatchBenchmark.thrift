@@ -0,0 +1,154 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// A service with many methods of similar names, used by DispatchBenchmark
+// to time how generated processors look up the function being called.
+
+namespace cpp dispatchbench
+
+service DispatchService {
+  i32 getUser(1: i32 id)
+  i32 setUser(1: i32 id)
+  i32 listUser(1: i32 id)
+  i32 createUser(1: i32 id)
+  i32 deleteUser(1: i32 id)
+  i32 updateUser(1: i32 id)
+  i32 findUser(1: i32 id)
+  i32 countUser(1: i32 id)
+  i32 getAccount(1: i32 id)
+  i32 setAccount(1: i32 id)
+  i32 listAccount(1: i32 id)
+  i32 createAccount(1: i32 id)
+  i32 deleteAccount(1: i32 id)
+  i32 updateAccount(1: i32 id)
+  i32 findAccount(1: i32 id)
+  i32 countAccount(1: i32 id)
+  i32 getOrder(1: i32 id)
+  i32 setOrder(1: i32 id)
+  i32 listOrder(1: i32 id)
+  i32 createOrder(1: i32 id)
+  i32 deleteOrder(1: i32 id)
+  i32 updateOrder(1: i32 id)
+  i32 findOrder(1: i32 id)
+  i32 countOrder(1: i32 id)
+  i32 getInvoice(1: i32 id)
+  i32 setInvoice(1: i32 id)
+  i32 listInvoice(1: i32 id)
+  i32 createInvoice(1: i32 id)
+  i32 deleteInvoice(1: i32 id)
+  i32 updateInvoice(1: i32 id)
+  i32 findInvoice(1: i32 id)
+  i32 countInvoice(1: i32 id)
+  i32 getPayment(1: i32 id)
+  i32 setPayment(1: i32 id)
+  i32 listPayment(1: i32 id)
+  i32 createPayment(1: i32 id)
+  i32 deletePayment(1: i32 id)
+  i32 updatePayment(1: i32 id)
+  i32 findPayment(1: i32 id)
+  i32 countPayment(1: i32 id)
+  i32 getSession(1: i32 id)
+  i32 setSession(1: i32 id)
+  i32 listSession(1: i32 id)
+  i32 createSession(1: i32 id)
+  i32 deleteSession(1: i32 id)
+  i32 updateSession(1: i32 id)
+  i32 findSession(1: i32 id)
+  i32 countSession(1: i32 id)
+  i32 getProduct(1: i32 id)
+  i32 setProduct(1: i32 id)
+  i32 listProduct(1: i32 id)
+  i32 createProduct(1: i32 id)
+  i32 deleteProduct(1: i32 id)
+  i32 updateProduct(1: i32 id)
+  i32 findProduct(1: i32 id)
+  i32 countProduct(1: i32 id)
+  i32 getReview(1: i32 id)
+  i32 setReview(1: i32 id)
+  i32 listReview(1: i32 id)
+  i32 createReview(1: i32 id)
+  i32 deleteReview(1: i32 id)
+  i32 updateReview(1: i32 id)
+  i32 findReview(1: i32 id)
+  i32 countReview(1: i32 id)
+  i32 getAddress(1: i32 id)
+  i32 setAddress(1: i32 id)
+  i32 listAddress(1: i32 id)
+  i32 createAddress(1: i32 id)
+  i32 deleteAddress(1: i32 id)
+  i32 updateAddress(1: i32 id)
+  i32 findAddress(1: i32 id)
+  i32 countAddress(1: i32 id)
+  i32 getShipment(1: i32 id)
+  i32 setShipment(1: i32 id)
+  i32 listShipment(1: i32 id)
+  i32 createShipment(1: i32 id)
+  i32 deleteShipment(1: i32 id)
+  i32 updateShipment(1: i32 id)
+  i32 findShipment(1: i32 id)
+  i32 countShipment(1: i32 id)
+  i32 getCoupon(1: i32 id)
+  i32 setCoupon(1: i32 id)
+  i32 listCoupon(1: i32 id)
+  i32 createCoupon(1: i32 id)
+  i32 deleteCoupon(1: i32 id)
+  i32 updateCoupon(1: i32 id)
+  i32 findCoupon(1: i32 id)
+  i32 countCoupon(1: i32 id)
+  i32 getCart(1: i32 id)
+  i32 setCart(1: i32 id)
+  i32 listCart(1: i32 id)
+  i32 createCart(1: i32 id)
+  i32 deleteCart(1: i32 id)
+  i32 updateCart(1: i32 id)
+  i32 findCart(1: i32 id)
+  i32 countCart(1: i32 id)
+  i32 getTicket(1: i32 id)
+  i32 setTicket(1: i32 id)
+  i32 listTicket(1: i32 id)
+  i32 createTicket(1: i32 id)
+  i32 deleteTicket(1: i32 id)
+  i32 updateTicket(1: i32 id)
+  i32 findTicket(1: i32 id)
+  i32 countTicket(1: i32 id)
+  i32 getMessage(1: i32 id)
+  i32 setMessage(1: i32 id)
+  i32 listMessage(1: i32 id)
+  i32 createMessage(1: i32 id)
+  i32 deleteMessage(1: i32 id)
+  i32 updateMessage(1: i32 id)
+  i32 findMessage(1: i32 id)
+  i32 countMessage(1: i32 id)
+  i32 getReport(1: i32 id)
+  i32 setReport(1: i32 id)
+  i32 listReport(1: i32 id)
+  i32 createReport(1: i32 id)
+  i32 deleteReport(1: i32 id)
+  i32 updateReport(1: i32 id)
+  i32 findReport(1: i32 id)
+  i32 countReport(1: i32 id)
+  i32 getToken(1: i32 id)
+  i32 setToken(1: i32 id)
+  i32 listToken(1: i32 id)
+  i32 createToken(1: i32 id)
+  i32 deleteToken(1: i32 id)
+  i32 updateToken(1: i32 id)
+  i32 findToken(1: i32 id)
+  i32 countToken(1: i32 id)
+}
@@ -0,0 +1,192 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/FlatContainerBenchmark_types.h"
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+// Every heap allocation in the process goes through these
+static uint64_t allocations = 0;
+static uint64_t allocated = 0;
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  allocated += size;
+  if (void* p = std::malloc(size != 0 ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+class Timer {
+public:
+  timeval vStart;
+
+  Timer() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+  void start() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+
+  double frame() {
+    timeval vEnd;
+    THRIFT_GETTIMEOFDAY(&vEnd, nullptr);
+    double dstart = vStart.tv_sec + ((double)vStart.tv_usec / 1000000.0);
+    double dend = vEnd.tv_sec + ((double)vEnd.tv_usec / 1000000.0);
+    return dend - dstart;
+  }
+};
+
+/**
+ * Decodes the message num times into a T, then looks up every key of
+ * lookups in the names and ids of the last one, and reports the heap
+ * allocations and bytes of a decode and the time of each.
+ */
+template <typename T>
+static bool run(const char* label,
+                const T& expected,
+                uint8_t* data,
+                uint32_t datasize,
+                int num,
+                const std::vector<int64_t>& lookups) {
+  using namespace apache::thrift::transport;
+  using namespace apache::thrift::protocol;
+
+  std::shared_ptr<TMemoryBuffer> rbuf(new TMemoryBuffer(data, datasize));
+  TBinaryProtocolT<TMemoryBuffer> rprot(rbuf);
+  uint64_t allocationsBefore = allocations;
+  uint64_t allocatedBefore = allocated;
+  T result;
+  Timer timer;
+  for (int i = 0; i < num; ++i) {
+    rbuf->resetBuffer(data, datasize);
+    result = T();
+    result.read(&rprot);
+  }
+  double decodeElapsed = timer.frame();
+  uint64_t decodeAllocations = (allocations - allocationsBefore) / num;
+  uint64_t decodeBytes = (allocated - allocatedBefore) / num;
+  if (!(result == expected)) {
+    std::cout << label << ": decoded struct differs from the original\n";
+    return false;
+  }
+
+  // The best of a few rounds, as lookups are short enough to be skewed by
+  // anything else running on the machine
+  double lookupElapsed = 0;
+  for (int round = 0; round < 5; ++round) {
+    size_t found = 0;
+    timer.start();
+    for (int64_t key : lookups) {
+      found += result.names.count(key) + result.ids.count(key);
+    }
+    double elapsed = timer.frame();
+    if (found != 2 * lookups.size()) {
+      std::cout << label << ": " << found << " of " << 2 * lookups.size() << " lookups found\n";
+      return false;
+    }
+    if (round == 0 || elapsed < lookupElapsed) {
+      lookupElapsed = elapsed;
+    }
+  }
+
+  std::cout << label << ": " << decodeAllocations << " allocations and " << decodeBytes / 1024
+            << " KiB/decode, " << num / decodeElapsed << " decodes/sec, "
+            << lookups.size() / lookupElapsed / 1e6 << "M lookups/sec\n";
+  return true;
+}
+
+/*
+ * Compares an Index from FlatContainerBenchmark.thrift, whose maps and sets
+ * are TFlatMap and TFlatSet, with a TreeIndex, whose are std::map and
+ * std::set, on 20000 i64 keys: both are decoded from the same message.
+ */
+int main() {
+  using namespace thrift::test::flat;
+  using namespace apache::thrift::transport;
+  using namespace apache::thrift::protocol;
+
+  const int64_t count = 20000;
+  Index index;
+  TreeIndex tree;
+  for (int64_t i = 0; i < count; ++i) {
+    int64_t key = i * 7919;
+    std::string name = "name " + std::to_string(i);
+    index.names[key] = name;
+    tree.names[key] = name;
+    index.ids.insert(key);
+    tree.ids.insert(key);
+  }
+  for (int i = 0; i < 16; ++i) {
+    std::string group = "group " + std::to_string(i);
+    for (int32_t j = 0; j < 64; ++j) {
+      index.groups[group].insert(j * i);
+      tree.groups[group].insert(j * i);
+    }
+  }
+
+  std::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocolT<TMemoryBuffer> prot(buf);
+  index.write(&prot);
+  uint8_t* data = nullptr;
+  uint32_t datasize = 0;
+  buf->getBuffer(&data, &datasize);
+
+  // Both structs serialize to the same bytes
+  std::shared_ptr<TMemoryBuffer> treeBuf(new TMemoryBuffer());
+  TBinaryProtocolT<TMemoryBuffer> treeProt(treeBuf);
+  tree.write(&treeProt);
+  if (treeBuf->getBufferAsString() != buf->getBufferAsString()) {
+    std::cout << "TreeIndex and Index serialize differently\n";
+    return 1;
+  }
+
+  // Pseudo-random keys that are all present
+  std::vector<int64_t> lookups;
+  uint64_t state = 1;
+  for (int i = 0; i < 1000000; ++i) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    lookups.push_back(static_cast<int64_t>((state >> 33) % count) * 7919);
+  }
+
+  int num = 100;
+  if (!run("std::map/set", tree, data, datasize, num, lookups)
+      || !run("TFlatMap/Set", index, data, datasize, num, lookups)) {
+    return 1;
+  }
+  return 0;
+}
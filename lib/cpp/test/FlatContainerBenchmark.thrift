@@ -0,0 +1,44 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Generated with cpp:flat_containers by FlatContainerBenchmark and
+// FlatContainersTest
+
+namespace cpp thrift.test.flat
+
+/**
+ * Maps and sets as TFlatMap and TFlatSet
+ */
+struct Index {
+  1: map<i64, string> names
+  2: set<i64> ids
+  3: map<string, set<i32>> groups
+}
+
+/**
+ * The same fields as std::map and std::set
+ */
+struct TreeIndex {
+  1: map<i64, string> (cpp.flat = "false") names
+  2: set<i64> (cpp.flat = "false") ids
+  3: map<string, set<i32> (cpp.flat = "false")> (cpp.flat = "false") groups
+}
+
+const map<i64, string> NAMES = { 3: "three", 1: "one", 2: "two" }
@@ -0,0 +1,191 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE FlatContainersTest
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <thrift/TFlatContainers.h>
+#include <thrift/TToString.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/FlatContainerBenchmark_types.h"
+#include "gen-cpp/FlatContainerBenchmark_constants.h"
+
+using apache::thrift::TFlatMap;
+using apache::thrift::TFlatSet;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using thrift::test::flat::Index;
+using thrift::test::flat::TreeIndex;
+
+template <typename Protocol, typename T>
+static std::string serialize(const T& value) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol protocol(buffer);
+  value.write(&protocol);
+  return buffer->getBufferAsString();
+}
+
+template <typename Protocol, typename T>
+static void deserialize(const std::string& data, T& value) {
+  std::shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(data.data())),
+                        static_cast<uint32_t>(data.size())));
+  Protocol protocol(buffer);
+  value.read(&protocol);
+}
+
+BOOST_AUTO_TEST_CASE(test_map_ordering) {
+  TFlatMap<int, std::string> map;
+  BOOST_CHECK(map.insert(std::make_pair(5, std::string("five"))).second);
+  BOOST_CHECK(map.insert(std::make_pair(1, std::string("one"))).second);
+  BOOST_CHECK(map.emplace(3, "three").second);
+  map[9] = "nine";
+
+  // Existing keys keep their value
+  BOOST_CHECK(!map.insert(std::make_pair(3, std::string("drei"))).second);
+  BOOST_CHECK(!map.emplace(5, "FIVE").second);
+
+  std::vector<int> keys;
+  for (const auto& entry : map) {
+    keys.push_back(entry.first);
+  }
+  BOOST_CHECK((keys == std::vector<int>{1, 3, 5, 9}));
+  BOOST_CHECK_EQUAL(map.at(3), "three");
+  BOOST_CHECK_EQUAL(map[5], "five");
+  BOOST_CHECK_THROW(map.at(4), std::out_of_range);
+
+  BOOST_CHECK_EQUAL(map.count(9), 1u);
+  BOOST_CHECK_EQUAL(map.count(2), 0u);
+  BOOST_CHECK(map.find(2) == map.end());
+  BOOST_CHECK_EQUAL(map.lower_bound(2)->first, 3);
+  BOOST_CHECK_EQUAL(map.upper_bound(3)->first, 5);
+
+  BOOST_CHECK_EQUAL(map.erase(3), 1u);
+  BOOST_CHECK_EQUAL(map.erase(3), 0u);
+  BOOST_CHECK_EQUAL(map.size(), 3u);
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(map), "{1: one, 5: five, 9: nine}");
+}
+
+BOOST_AUTO_TEST_CASE(test_range_insert) {
+  TFlatMap<int, int> map{{4, 40}, {2, 20}};
+  std::vector<std::pair<int, int> > more{{3, 30}, {2, 0}, {7, 70}, {3, 0}, {1, 10}};
+  map.insert(more.begin(), more.end());
+
+  // The first value of each key wins, as with std::map
+  TFlatMap<int, int> expected{{1, 10}, {2, 20}, {3, 30}, {4, 40}, {7, 70}};
+  BOOST_CHECK(map == expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_set) {
+  TFlatSet<std::string> set{"pear", "apple", "fig", "apple"};
+  BOOST_CHECK_EQUAL(set.size(), 3u);
+  BOOST_CHECK(set.insert("banana").second);
+  BOOST_CHECK(!set.insert("fig").second);
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(set), "{apple, banana, fig, pear}");
+  BOOST_CHECK_EQUAL(set.erase("apple"), 1u);
+  BOOST_CHECK(set.find("apple") == set.end());
+  BOOST_CHECK(*set.begin() == "banana");
+}
+
+BOOST_AUTO_TEST_CASE(test_constant) {
+  const TFlatMap<int64_t, std::string>& names = thrift::test::flat::g_FlatContainerBenchmark_constants.NAMES;
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(names), "{1: one, 2: two, 3: three}");
+}
+
+template <typename Protocol>
+static void testWireCompatibility() {
+  TreeIndex tree;
+  Index flat;
+  for (int64_t i = 100; i > 0; --i) {
+    tree.names[i * 31] = std::to_string(i);
+    flat.names[i * 31] = std::to_string(i);
+    tree.ids.insert(i * 17);
+    flat.ids.insert(i * 17);
+    tree.groups["g" + std::to_string(i % 7)].insert(static_cast<int32_t>(i));
+    flat.groups["g" + std::to_string(i % 7)].insert(static_cast<int32_t>(i));
+  }
+
+  // Both keep their elements sorted, so they write the same bytes
+  std::string data = serialize<Protocol>(tree);
+  BOOST_CHECK(data == serialize<Protocol>(flat));
+
+  Index decoded;
+  deserialize<Protocol>(data, decoded);
+  BOOST_CHECK(decoded == flat);
+  BOOST_CHECK_EQUAL(decoded.names.capacity(), decoded.names.size());
+  BOOST_CHECK_EQUAL(decoded.names.at(31 * 42), "42");
+  BOOST_CHECK_EQUAL(decoded.groups.at("g3").count(10), 1u);
+
+  TreeIndex roundTrip;
+  deserialize<Protocol>(serialize<Protocol>(decoded), roundTrip);
+  BOOST_CHECK(roundTrip == tree);
+}
+
+BOOST_AUTO_TEST_CASE(test_unsorted_wire_order) {
+  // Written by hand: out of order, with repeated keys
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol protocol(buffer);
+  protocol.writeStructBegin("Index");
+  protocol.writeFieldBegin("names", apache::thrift::protocol::T_MAP, 1);
+  protocol.writeMapBegin(apache::thrift::protocol::T_I64, apache::thrift::protocol::T_STRING, 5);
+  const std::pair<int64_t, std::string> names[]
+      = {{5, "five"}, {1, "one"}, {5, "FIVE"}, {3, "three"}, {1, "ONE"}};
+  for (const auto& name : names) {
+    protocol.writeI64(name.first);
+    protocol.writeString(name.second);
+  }
+  protocol.writeMapEnd();
+  protocol.writeFieldEnd();
+  protocol.writeFieldBegin("ids", apache::thrift::protocol::T_SET, 2);
+  protocol.writeSetBegin(apache::thrift::protocol::T_I64, 4);
+  const int64_t ids[] = {9, 2, 9, 4};
+  for (int64_t id : ids) {
+    protocol.writeI64(id);
+  }
+  protocol.writeSetEnd();
+  protocol.writeFieldEnd();
+  protocol.writeFieldStop();
+  protocol.writeStructEnd();
+  std::string data = buffer->getBufferAsString();
+
+  // Read as std::map and std::set would: the last value of a key wins
+  Index flat;
+  deserialize<TBinaryProtocol>(data, flat);
+  TreeIndex tree;
+  deserialize<TBinaryProtocol>(data, tree);
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(flat.names), "{1: ONE, 3: three, 5: FIVE}");
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(flat.names), apache::thrift::to_string(tree.names));
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(flat.ids), "{2, 4, 9}");
+  BOOST_CHECK_EQUAL(flat.names.at(3), "three");
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_wire_compatibility) {
+  testWireCompatibility<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_wire_compatibility) {
+  testWireCompatibility<TCompactProtocol>();
+}
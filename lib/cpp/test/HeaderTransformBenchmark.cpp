@@ -0,0 +1,180 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/THeaderTransport.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace thrift::test::debug;
+
+class Timer {
+public:
+  timeval vStart;
+
+  Timer() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+  void start() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+
+  double frame() {
+    timeval vEnd;
+    THRIFT_GETTIMEOFDAY(&vEnd, nullptr);
+    double dstart = vStart.tv_sec + ((double)vStart.tv_usec / 1000000.0);
+    double dend = vEnd.tv_sec + ((double)vEnd.tv_usec / 1000000.0);
+    return dend - dstart;
+  }
+};
+
+static OneOfEach makeOneOfEach(int i) {
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.im_false = false;
+  ooe.a_bite = static_cast<int8_t>(i);
+  ooe.integer16 = static_cast<int16_t>(i * 27);
+  ooe.integer32 = i << 12;
+  ooe.integer64 = 6000000000LL + i;
+  ooe.double_precision = i / 7.0;
+  ooe.some_characters = "user-" + std::to_string(i * 7919 % 1000);
+  ooe.zomg_unicode = "\xd7\n\a\t";
+  ooe.base64 = std::string(16, static_cast<char>(i));
+  for (int j = 0; j < 8; ++j) {
+    ooe.byte_list.push_back(static_cast<int8_t>(j));
+    ooe.i16_list.push_back(static_cast<int16_t>(i + j));
+    ooe.i64_list.push_back(static_cast<int64_t>(i) << j);
+  }
+  return ooe;
+}
+
+/**
+ * A compact-encoded HolyMoley with count structs in it, the kind of payload
+ * that is worth compressing.
+ */
+static std::string makePayload(int count) {
+  HolyMoley hm;
+  for (int i = 0; i < count; ++i) {
+    hm.big.push_back(makeOneOfEach(i));
+  }
+  std::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TCompactProtocolT<TMemoryBuffer> prot(buf);
+  hm.write(&prot);
+  return buf->getBufferAsString();
+}
+
+/**
+ * Sends the payload num times through a THeaderTransport with the transform
+ * and reads it back. With fresh set, every message gets a new transport and
+ * so new compression contexts, as each message used to. Reports the size on
+ * the wire and the rate of both directions.
+ */
+static bool run(const char* label,
+                uint16_t transId,
+                const std::string& payload,
+                int num,
+                bool fresh) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(payload.data());
+  auto datasize = static_cast<uint32_t>(payload.size());
+  std::shared_ptr<TMemoryBuffer> wire(new TMemoryBuffer());
+  std::unique_ptr<THeaderTransport> writer;
+  std::unique_ptr<THeaderTransport> reader;
+  std::vector<uint8_t> out(datasize);
+  uint32_t framesize = 0;
+
+  double elapsed[2] = {0, 0};
+  for (int i = 0; i < num; ++i) {
+    wire->resetBuffer();
+    if (fresh || !writer) {
+      writer.reset(new THeaderTransport(wire));
+      reader.reset(new THeaderTransport(wire));
+      if (transId != 0) {
+        writer->setTransform(transId);
+      }
+    }
+
+    Timer timer;
+    writer->write(data, datasize);
+    writer->flush();
+    elapsed[0] += timer.frame();
+    framesize = wire->available_read();
+
+    timer.start();
+    reader->readAll(out.data(), datasize);
+    reader->readEnd();
+    elapsed[1] += timer.frame();
+  }
+
+  if (payload.compare(0, payload.size(), reinterpret_cast<const char*>(out.data()), datasize)
+      != 0) {
+    std::cout << label << ": read back a different payload\n";
+    return false;
+  }
+
+  double mb = static_cast<double>(datasize) * num / (1024 * 1024);
+  std::cout << "  " << label << (fresh ? " (new contexts)" : "") << ": " << framesize
+            << " bytes, ratio " << static_cast<double>(datasize) / framesize << "\n"
+            << "    write: " << num / elapsed[0] << " msgs/sec, " << mb / elapsed[0]
+            << " MB/sec\n"
+            << "    read:  " << num / elapsed[1] << " msgs/sec, " << mb / elapsed[1]
+            << " MB/sec\n";
+  return true;
+}
+
+static bool runAll(const std::string& payload, int num) {
+  std::cout << payload.size() << " byte payload:\n";
+  if (!run("none", 0, payload, num, false)
+      || !run("zlib", THeaderTransport::ZLIB_TRANSFORM, payload, num, false)
+      || !run("zlib", THeaderTransport::ZLIB_TRANSFORM, payload, num, true)) {
+    return false;
+  }
+  if (THeaderTransport::isTransformSupported(THeaderTransport::ZSTD_TRANSFORM)
+      && (!run("zstd", THeaderTransport::ZSTD_TRANSFORM, payload, num, false)
+          || !run("zstd", THeaderTransport::ZSTD_TRANSFORM, payload, num, true))) {
+    return false;
+  }
+  if (THeaderTransport::isTransformSupported(THeaderTransport::LZ4_TRANSFORM)
+      && (!run("lz4", THeaderTransport::LZ4_TRANSFORM, payload, num, false)
+          || !run("lz4", THeaderTransport::LZ4_TRANSFORM, payload, num, true))) {
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Compares the THeaderTransport compression transforms on small and large
+ * DebugProtoTest messages, with contexts kept across messages and set up
+ * for each.
+ */
+int main() {
+  int num = 4000;
+  if (!runAll(makePayload(4), num) || !runAll(makePayload(400), num / 40)) {
+    return 1;
+  }
+  return 0;
+}
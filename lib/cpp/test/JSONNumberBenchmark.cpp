@@ -0,0 +1,150 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace thrift::test::debug;
+
+class Timer {
+public:
+  timeval vStart;
+
+  Timer() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+  void start() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+
+  double frame() {
+    timeval vEnd;
+    THRIFT_GETTIMEOFDAY(&vEnd, nullptr);
+    double dstart = vStart.tv_sec + ((double)vStart.tv_usec / 1000000.0);
+    double dend = vEnd.tv_sec + ((double)vEnd.tv_usec / 1000000.0);
+    return dend - dstart;
+  }
+};
+
+// Doubles spread over the whole range, most of which need all 17 digits
+static ListDoublePerf makeListDoublePerf() {
+  ListDoublePerf ldp;
+  uint64_t seed = 88172645463325252ULL;
+  for (int i = 0; i < 1000; ++i) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    double value = static_cast<double>(seed % 2000000) / 7.0;
+    if (i % 4 == 1) {
+      value *= 1e200;
+    } else if (i % 4 == 2) {
+      value /= 1e200;
+    } else if (i % 4 == 3) {
+      value = static_cast<double>(static_cast<int64_t>(value));
+    }
+    ldp.field.push_back(i % 2 == 0 ? value : -value);
+  }
+  return ldp;
+}
+
+// Integer lists, and maps whose keys are quoted numbers
+static CompactProtoTestStruct makeCompactProtoTestStruct() {
+  CompactProtoTestStruct cpts;
+  cpts.a_byte = 127;
+  cpts.a_i16 = 32000;
+  cpts.a_i32 = 1000000000;
+  cpts.a_i64 = 0xffffffffffLL;
+  cpts.a_double = 5.6789;
+  cpts.a_string = "my string";
+  for (int16_t i = 0; i < 100; ++i) {
+    cpts.i16_list.push_back(static_cast<int16_t>(-i * 300));
+    cpts.i32_list.push_back(i * 21474836);
+    cpts.i64_list.push_back(static_cast<int64_t>(i) * -92233720368547758LL);
+    cpts.double_list.push_back(i / 3.0);
+    cpts.i32_byte_map[i * 70000] = static_cast<int8_t>(i);
+    cpts.i16_set.insert(static_cast<int16_t>(i * 7));
+    cpts.i64_set.insert(static_cast<int64_t>(i) << 40);
+  }
+  return cpts;
+}
+
+/**
+ * Encodes the value num times with TJSONProtocol, then decodes it num times
+ * and checks that it read back the same value. Reports the rate of both.
+ */
+template <typename T>
+static bool run(const char* label, const T& value, int num) {
+  std::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TJSONProtocol wprot(buf);
+
+  Timer timer;
+  for (int i = 0; i < num; ++i) {
+    buf->resetBuffer();
+    value.write(&wprot);
+  }
+  double encodeElapsed = timer.frame();
+
+  std::string json = buf->getBufferAsString();
+  uint8_t* data = reinterpret_cast<uint8_t*>(&json[0]);
+  auto datasize = static_cast<uint32_t>(json.size());
+  std::shared_ptr<TMemoryBuffer> rbuf(new TMemoryBuffer(data, datasize));
+  TJSONProtocol rprot(rbuf);
+  T result;
+
+  timer.start();
+  for (int i = 0; i < num; ++i) {
+    rbuf->resetBuffer(data, datasize);
+    result.read(&rprot);
+  }
+  double decodeElapsed = timer.frame();
+
+  if (!(result == value)) {
+    std::cout << label << ": decoded a different value\n";
+    return false;
+  }
+
+  double mb = static_cast<double>(datasize) * num / (1024 * 1024);
+  std::cout << label << " (" << datasize << " bytes):\n"
+            << "  encode: " << num / encodeElapsed << " msgs/sec, " << mb / encodeElapsed
+            << " MB/sec\n"
+            << "  decode: " << num / decodeElapsed << " msgs/sec, " << mb / decodeElapsed
+            << " MB/sec\n";
+  return true;
+}
+
+/*
+ * Measures TJSONProtocol on DebugProtoTest structs that are mostly numbers.
+ */
+int main() {
+  int num = 2000;
+  if (!run("ListDoublePerf", makeListDoublePerf(), num)
+      || !run("CompactProtoTestStruct", makeCompactProtoTestStruct(), num)) {
+    return 1;
+  }
+  return 0;
+}
@@ -20,6 +20,7 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <iomanip>
+#include <limits>
 #include <sstream>
 #include <thrift/protocol/TJSONProtocol.h>
 #include <memory>
@@ -61,7 +62,7 @@ BOOST_AUTO_TEST_CASE(test_json_proto_1) {
   const std::string expected_result(
   "{\"1\":{\"tf\":1},\"2\":{\"tf\":0},\"3\":{\"i8\":127},\"4\":{\"i16\":27000},"
   "\"5\":{\"i32\":16777216},\"6\":{\"i64\":6000000000},\"7\":{\"dbl\":3.1415926"
-  "535897931},\"8\":{\"str\":\"JSON THIS! \\\"\\u0001\"},\"9\":{\"str\":\"\xd7\\"
+  "53589793},\"8\":{\"str\":\"JSON THIS! \\\"\\u0001\"},\"9\":{\"str\":\"\xd7\\"
   "n\\u0007\\t\"},\"10\":{\"tf\":0},\"11\":{\"str\":\"AQIDrQ\"},\"12\":{\"lst\""
   ":[\"i8\",3,1,2,3]},\"13\":{\"lst\":[\"i16\",3,1,2,3]},\"14\":{\"lst\":[\"i64"
   "\",3,1,2,3]},\"15\":{\"uid\":\"00000000-0000-0000-0000-000000000000\"},\"16\""
@@ -106,7 +107,7 @@ BOOST_AUTO_TEST_CASE(test_json_proto_2) {
     "{\"1\":{\"rec\":{\"1\":{\"i32\":31337},\"2\":{\"str\":\"I am a bonk... xor"
     "!\"}}},\"2\":{\"rec\":{\"1\":{\"tf\":1},\"2\":{\"tf\":0},\"3\":{\"i8\":127"
     "},\"4\":{\"i16\":16},\"5\":{\"i32\":32},\"6\":{\"i64\":64},\"7\":{\"dbl\":"
-    "1.6180339887498949},\"8\":{\"str\":\":R (me going \\\"rrrr\\\")\"},\"9\":{"
+    "1.618033988749895},\"8\":{\"str\":\":R (me going \\\"rrrr\\\")\"},\"9\":{"
     "\"str\":\"ӀⅮΝ Нοⅿоɡгаρℎ Αttαⅽκǃ‼\"},\"10\":{\"tf\":0},\"11\":{\"str\":\""
     "AQIDrQ\"},\"12\":{\"lst\":[\"i8\",3,1,2,3]},\"13\":{\"lst\":[\"i16\",3,1,2"
     ",3]},\"14\":{\"lst\":[\"i64\",3,1,2,3]},\"15\":{\"uid\":\"5e2ab188-1726-"
@@ -172,13 +173,13 @@ BOOST_AUTO_TEST_CASE(test_json_proto_3) {
   const std::string expected_result(
   "{\"1\":{\"lst\":[\"rec\",2,{\"1\":{\"tf\":1},\"2\":{\"tf\":0},\"3\":{\"i8\":"
   "34},\"4\":{\"i16\":27000},\"5\":{\"i32\":16777216},\"6\":{\"i64\":6000000000"
-  "},\"7\":{\"dbl\":3.1415926535897931},\"8\":{\"str\":\"JSON THIS! \\\"\\u0001"
+  "},\"7\":{\"dbl\":3.141592653589793},\"8\":{\"str\":\"JSON THIS! \\\"\\u0001"
   "\"},\"9\":{\"str\":\"\xd7\\n\\u0007\\t\"},\"10\":{\"tf\":0},\"11\":{\"str\":"
   "\"AQIDrQ\"},\"12\":{\"lst\":[\"i8\",3,1,2,3]},\"13\":{\"lst\":[\"i16\",3,1,2"
   ",3]},\"14\":{\"lst\":[\"i64\",3,1,2,3]},\"15\":{\"uid\":\"00000000-0000-0000"
   "-0000-000000000000\"},\"16\":{\"lst\":[\"uid\",0]}},{\"1\":{\"tf\":1},\"2\":{\"tf\":0},"
   "\"3\":{\"i8\":51},\"4\":{\"i16\":16},\"5\":{\"i32\":32},\"6\":{\"i64\":64},"
-  "\"7\":{\"dbl\":1.6180339887498949},\"8\":{\"str\":\":R (me going \\\"rrrr\\\""
+  "\"7\":{\"dbl\":1.618033988749895},\"8\":{\"str\":\":R (me going \\\"rrrr\\\""
   ")\"},\"9\":{\"str\":\"ӀⅮΝ Нοⅿоɡгаρℎ Αttαⅽκǃ‼\"},\"10\":{\"tf\":0},\"11\":{"
   "\"str\":\"AQIDrQ\"},\"12\":{\"lst\":[\"i8\",3,1,2,3]},\"13\":{\"lst\":[\"i16"
   "\",3,1,2,3]},\"14\":{\"lst\":[\"i64\",3,1,2,3]},\"15\":{\"uid\":\"5e2ab188-"
@@ -245,8 +246,8 @@ BOOST_AUTO_TEST_CASE(test_json_proto_6) {
 
   const std::string expected_result(
   "{\"1\":{\"dbl\":\"NaN\"},\"2\":{\"dbl\":\"Infinity\"},\"3\":{\"dbl\":\"-Infi"
-  "nity\"},\"4\":{\"dbl\":3.3333333333333335},\"5\":{\"dbl\":9.9999999999999994e+"
-  "304},\"6\":{\"dbl\":1e-305},\"7\":{\"dbl\":0},\"8\":{\"dbl\":-0}}"
+  "nity\"},\"4\":{\"dbl\":3.3333333333333335},\"5\":{\"dbl\":1e+305},"
+  "\"6\":{\"dbl\":1e-305},\"7\":{\"dbl\":0},\"8\":{\"dbl\":-0}}"
   );
 
   std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
@@ -541,3 +542,237 @@ BOOST_AUTO_TEST_CASE(test_json_number_size_measured_against_configured_maximum)
   double out = 0;
   BOOST_CHECK_NO_THROW(proto->readDouble(out));
 }
+
+static std::shared_ptr<TJSONProtocol> protoReading(const std::string& json) {
+  auto buffer = std::make_shared<TMemoryBuffer>(
+      reinterpret_cast<uint8_t*>(const_cast<char*>(json.data())),
+      static_cast<uint32_t>(json.size()), TMemoryBuffer::COPY);
+  return std::make_shared<TJSONProtocol>(buffer);
+}
+
+// Doubles are written in the shortest form that reads back as the same value,
+// including subnormals and the extremes of the range.
+BOOST_AUTO_TEST_CASE(test_json_double_round_trip) {
+  const double values[] = {0.1,
+                           -0.0,
+                           1.0 / 3.0,
+                           123456789012345680.0,
+                           5e-324,
+                           std::numeric_limits<double>::min(),
+                           std::numeric_limits<double>::max(),
+                           std::numeric_limits<double>::lowest(),
+                           std::numeric_limits<double>::epsilon(),
+                           1.7976931348623157e308 / 3};
+  for (double value : values) {
+    auto buffer = std::make_shared<TMemoryBuffer>();
+    TJSONProtocol proto(buffer);
+    proto.writeListBegin(protocol::T_DOUBLE, 1);
+    proto.writeDouble(value);
+    proto.writeListEnd();
+    protocol::TType elemType;
+    uint32_t size;
+    double result = 0;
+    proto.readListBegin(elemType, size);
+    proto.readDouble(result);
+    proto.readListEnd();
+    BOOST_CHECK_EQUAL(result, value);
+    BOOST_CHECK_EQUAL(std::signbit(result), std::signbit(value));
+  }
+
+  auto buffer = std::make_shared<TMemoryBuffer>();
+  TJSONProtocol proto(buffer);
+  proto.writeDouble(0.1);
+  BOOST_CHECK_EQUAL(buffer->getBufferAsString(), "0.1");
+}
+
+BOOST_AUTO_TEST_CASE(test_json_integer_limits) {
+  auto buffer = std::make_shared<TMemoryBuffer>();
+  TJSONProtocol proto(buffer);
+  proto.writeListBegin(protocol::T_I64, 4);
+  proto.writeI64(std::numeric_limits<int64_t>::min());
+  proto.writeI64(std::numeric_limits<int64_t>::max());
+  proto.writeI16(std::numeric_limits<int16_t>::min());
+  proto.writeI32(std::numeric_limits<int32_t>::max());
+  proto.writeListEnd();
+  BOOST_CHECK_EQUAL(buffer->getBufferAsString(),
+                    "[\"i64\",4,-9223372036854775808,9223372036854775807,-32768,2147483647]");
+
+  protocol::TType elemType;
+  uint32_t size;
+  int64_t i64;
+  int16_t i16;
+  int32_t i32;
+  proto.readListBegin(elemType, size);
+  proto.readI64(i64);
+  BOOST_CHECK_EQUAL(i64, std::numeric_limits<int64_t>::min());
+  proto.readI64(i64);
+  BOOST_CHECK_EQUAL(i64, std::numeric_limits<int64_t>::max());
+  proto.readI16(i16);
+  BOOST_CHECK_EQUAL(i16, std::numeric_limits<int16_t>::min());
+  proto.readI32(i32);
+  BOOST_CHECK_EQUAL(i32, std::numeric_limits<int32_t>::max());
+  proto.readListEnd();
+}
+
+// Numbers that do not fit the type, or are not whole numbers of it, are
+// rejected rather than truncated.
+BOOST_AUTO_TEST_CASE(test_json_invalid_numbers) {
+  int16_t i16;
+  int32_t i32;
+  int64_t i64;
+  bool b;
+  double d;
+  BOOST_CHECK_THROW(protoReading("32768 ")->readI16(i16), protocol::TProtocolException);
+  BOOST_CHECK_THROW(protoReading("-2147483649 ")->readI32(i32), protocol::TProtocolException);
+  BOOST_CHECK_THROW(protoReading("9223372036854775808 ")->readI64(i64),
+                    protocol::TProtocolException);
+  BOOST_CHECK_THROW(protoReading("1.5 ")->readI32(i32), protocol::TProtocolException);
+  BOOST_CHECK_THROW(protoReading("1e3 ")->readI32(i32), protocol::TProtocolException);
+  BOOST_CHECK_THROW(protoReading("- ")->readI32(i32), protocol::TProtocolException);
+  BOOST_CHECK_THROW(protoReading("+-1 ")->readI32(i32), protocol::TProtocolException);
+  BOOST_CHECK_THROW(protoReading("2 ")->readBool(b), protocol::TProtocolException);
+  BOOST_CHECK_THROW(protoReading("1.2.3 ")->readDouble(d), protocol::TProtocolException);
+  BOOST_CHECK_THROW(protoReading("1e400 ")->readDouble(d), protocol::TProtocolException);
+  BOOST_CHECK_THROW(protoReading("\"1e400\"")->readDouble(d), protocol::TProtocolException);
+
+  protoReading("+42 ")->readI32(i32);
+  BOOST_CHECK_EQUAL(i32, 42);
+  protoReading("-0 ")->readI64(i64);
+  BOOST_CHECK_EQUAL(i64, 0);
+  protoReading("1E2 ")->readDouble(d);
+  BOOST_CHECK_EQUAL(d, 100.0);
+}
+
+// What writeString() should produce for str, one character at a time
+static std::string escapeJSON(const std::string& str) {
+  std::string json = "\"";
+  for (char c : str) {
+    auto ch = static_cast<uint8_t>(c);
+    if (ch == '"' || ch == '\\') {
+      json += '\\';
+      json += c;
+    } else if (ch == '\n') {
+      json += "\\n";
+    } else if (ch < 0x20) {
+      std::ostringstream escaped;
+      escaped << "\\u00" << std::hex << std::setw(2) << std::setfill('0') << int(ch);
+      json += escaped.str();
+    } else {
+      json += c;
+    }
+  }
+  return json + "\"";
+}
+
+// Strings are scanned many bytes at a time, so put the characters that need
+// escaping at every offset of strings longer than a vector
+BOOST_AUTO_TEST_CASE(test_json_string_escapes_at_every_offset) {
+  const char specials[] = {'"', '\\', '\n', '\x01', '\x1f', '\x7f', ' ', '\xc3'};
+  for (size_t size = 0; size < 70; ++size) {
+    for (size_t pos = 0; pos < size; ++pos) {
+      for (char special : specials) {
+        std::string str(size, 'a');
+        str[pos] = special;
+        str[size - 1 - pos] = special;
+
+        auto buffer = std::make_shared<TMemoryBuffer>();
+        TJSONProtocol proto(buffer);
+        uint32_t written = proto.writeString(str);
+        std::string json = buffer->getBufferAsString();
+        BOOST_REQUIRE_EQUAL(json, escapeJSON(str));
+        BOOST_CHECK_EQUAL(written, json.size());
+
+        std::string result;
+        BOOST_CHECK_EQUAL(proto.readString(result), json.size());
+        BOOST_REQUIRE_EQUAL(result, str);
+      }
+    }
+  }
+}
+
+// Unescaped runs are read straight from the transport's buffer, so read
+// through one that is smaller than the strings and holds part of them
+BOOST_AUTO_TEST_CASE(test_json_string_read_across_buffer_refills) {
+  OneOfEach ooe;
+  ooe.some_characters = std::string(100, 'x') + "\"\\\t" + std::string(50, 'y') + "\\u";
+  ooe.zomg_unicode = "\xe2\x82\xac in the middle of a long string \xf0\x9f\x98\x80";
+  const std::string json = apache::thrift::ThriftJSONString(ooe);
+  std::string unicodeJSON = json;
+  // The same characters escaped as UTF-16, with a surrogate pair
+  size_t pos = unicodeJSON.find("\xf0\x9f\x98\x80");
+  unicodeJSON.replace(pos, 4, "\\ud83d\\ude00");
+
+  for (const std::string& input : {json, unicodeJSON}) {
+    for (uint32_t bufferSize : {1u, 3u, 7u, 16u, 64u}) {
+      auto memory = std::make_shared<TMemoryBuffer>(
+          reinterpret_cast<uint8_t*>(const_cast<char*>(input.data())),
+          static_cast<uint32_t>(input.size()));
+      auto buffered = std::make_shared<apache::thrift::transport::TBufferedTransport>(memory,
+                                                                                    bufferSize);
+      TJSONProtocol proto(buffered);
+      OneOfEach result;
+      BOOST_CHECK_EQUAL(result.read(&proto), input.size());
+      BOOST_CHECK(result == ooe);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_json_string_low_surrogate_missing_before_run) {
+  std::string out;
+  BOOST_CHECK_THROW(protoReading("\"\\ud83dabcdefghijklmnopqrstuvwxyz\"")->readString(out),
+                    protocol::TProtocolException);
+}
+
+BOOST_AUTO_TEST_CASE(test_json_utf8_validation) {
+  const std::string valid[] = {"plain ascii",
+                               "\xc2\x80",
+                               "\xdf\xbf",
+                               "\xe0\xa0\x80",
+                               "\xed\x9f\xbf",
+                               "\xef\xbf\xbf",
+                               "\xf0\x90\x80\x80",
+                               "\xf4\x8f\xbf\xbf",
+                               std::string(40, 'a') + "\xe2\x82\xac" + std::string(40, 'b')};
+  const std::string invalid[] = {"\x80",
+                                 "\xc0\x80",
+                                 "\xc1\xbf",
+                                 "\xe0\x9f\xbf",
+                                 "\xed\xa0\x80",
+                                 "\xf0\x8f\xbf\xbf",
+                                 "\xf4\x90\x80\x80",
+                                 "\xf5\x80\x80\x80",
+                                 "\xe2\x82",
+                                 "\xe2\x28\xa1",
+                                 std::string(40, 'a') + "\xd7\n\a\t"};
+
+  for (const std::string& str : valid) {
+    auto buffer = std::make_shared<TMemoryBuffer>();
+    TJSONProtocol proto(buffer);
+    proto.setValidateUtf8(true);
+    BOOST_CHECK_NO_THROW(proto.writeString(str));
+    std::string result;
+    BOOST_CHECK_NO_THROW(proto.readString(result));
+    BOOST_CHECK_EQUAL(result, str);
+  }
+
+  for (const std::string& str : invalid) {
+    auto buffer = std::make_shared<TMemoryBuffer>();
+    TJSONProtocol proto(buffer);
+    proto.setValidateUtf8(true);
+    BOOST_CHECK_THROW(proto.writeString(str), protocol::TProtocolException);
+    BOOST_CHECK_EQUAL(buffer->available_read(), 0u);
+
+    // Written without validation, rejected when read with it
+    proto.setValidateUtf8(false);
+    proto.writeString(str);
+    proto.setValidateUtf8(true);
+    std::string result;
+    BOOST_CHECK_THROW(proto.readString(result), protocol::TProtocolException);
+  }
+
+  // The factory hands out protocols that validate
+  protocol::TJSONProtocolFactory factory(true);
+  std::shared_ptr<protocol::TProtocol> proto
+      = factory.getProtocol(std::make_shared<TMemoryBuffer>());
+  BOOST_CHECK_THROW(proto->writeString("\xc0\x80"), protocol::TProtocolException);
+}
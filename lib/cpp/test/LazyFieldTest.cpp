@@ -0,0 +1,318 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE LazyFieldTest
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <thrift/TLazy.h>
+#include <thrift/TToString.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/LazyFieldTest_types.h"
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TBinaryProtocolT;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TCompactProtocolT;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransport;
+using namespace thrift::test::lazy;
+
+template <typename Protocol, typename T>
+static std::string serialize(const T& value) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol protocol(buffer);
+  value.write(&protocol);
+  return buffer->getBufferAsString();
+}
+
+template <typename Protocol, typename T>
+static void deserialize(const std::string& data, T& value) {
+  std::shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(data.data())),
+                        static_cast<uint32_t>(data.size())));
+  Protocol protocol(buffer);
+  value.read(&protocol);
+}
+
+static Payload makePayload(const std::string& name, int32_t points) {
+  Payload payload;
+  payload.name = name;
+  for (int32_t i = 0; i < points; ++i) {
+    Point point;
+    point.x = i;
+    point.y = -i;
+    payload.points.push_back(point);
+  }
+  payload.counters["points"] = points;
+  payload.counters["version"] = 3;
+  return payload;
+}
+
+static EagerEnvelope makeEnvelope() {
+  EagerEnvelope envelope;
+  envelope.id = 42;
+  envelope.payload = makePayload("current", 10);
+  envelope.history.push_back(makePayload("first", 3));
+  envelope.history.push_back(makePayload("second", 5));
+  envelope.__set_extra(makePayload("extra", 1));
+  envelope.trailer = "end";
+  return envelope;
+}
+
+template <typename Protocol>
+static void checkRawCapture() {
+  EagerEnvelope eager = makeEnvelope();
+  std::string data = serialize<Protocol>(eager);
+
+  Envelope envelope;
+  deserialize<Protocol>(data, envelope);
+  BOOST_CHECK(envelope.payload.hasRaw());
+  BOOST_CHECK(envelope.history.hasRaw());
+  BOOST_CHECK(envelope.extra.hasRaw());
+  BOOST_CHECK(envelope.__isset.extra);
+
+  // The fields around the lazy ones are read as usual
+  BOOST_CHECK_EQUAL(envelope.id, 42);
+  BOOST_CHECK_EQUAL(envelope.trailer, "end");
+
+  BOOST_CHECK(envelope.payload.get() == eager.payload);
+  BOOST_CHECK(envelope.history.get() == eager.history);
+  BOOST_CHECK(envelope.extra.get() == eager.extra);
+
+  // Decoding keeps the bytes, so the value still is written verbatim
+  BOOST_CHECK(envelope.payload.hasRaw());
+  BOOST_CHECK_EQUAL(serialize<Protocol>(envelope), data);
+}
+
+BOOST_AUTO_TEST_CASE(test_raw_capture_binary) {
+  checkRawCapture<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_raw_capture_compact) {
+  checkRawCapture<TCompactProtocol>();
+}
+
+template <typename Protocol>
+static void checkVerbatimWrite() {
+  NewerEnvelope newer;
+  newer.id = 7;
+  newer.payload.name = "newer";
+  newer.payload.counters["a"] = 1;
+  newer.payload.note = "not known to Payload";
+  newer.trailer = "end";
+  std::string data = serialize<Protocol>(newer);
+
+  // Decoding drops the field Payload does not know about...
+  Envelope envelope;
+  deserialize<Protocol>(data, envelope);
+  BOOST_CHECK_EQUAL(envelope.payload.get().name, "newer");
+  EagerEnvelope eager;
+  deserialize<Protocol>(data, eager);
+  BOOST_CHECK(serialize<Protocol>(eager) != data);
+
+  // ...but an unchanged lazy field passes it through
+  NewerEnvelope copy;
+  deserialize<Protocol>(serialize<Protocol>(envelope), copy);
+  BOOST_CHECK(copy == newer);
+}
+
+BOOST_AUTO_TEST_CASE(test_verbatim_write_binary) {
+  checkVerbatimWrite<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_verbatim_write_compact) {
+  checkVerbatimWrite<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_changed_value_is_encoded) {
+  EagerEnvelope eager = makeEnvelope();
+  Envelope envelope;
+  deserialize<TBinaryProtocol>(serialize<TBinaryProtocol>(eager), envelope);
+
+  envelope.payload.mutable_get().name = "changed";
+  BOOST_CHECK(!envelope.payload.hasRaw());
+  envelope.history.mutable_get().pop_back();
+  BOOST_CHECK(!envelope.history.hasRaw());
+  envelope.__set_extra(makePayload("replaced", 2));
+  BOOST_CHECK(!envelope.extra.hasRaw());
+
+  EagerEnvelope result;
+  deserialize<TBinaryProtocol>(serialize<TBinaryProtocol>(envelope), result);
+  eager.payload.name = "changed";
+  eager.history.pop_back();
+  eager.extra = makePayload("replaced", 2);
+  BOOST_CHECK(result == eager);
+}
+
+BOOST_AUTO_TEST_CASE(test_other_format_is_encoded) {
+  EagerEnvelope eager = makeEnvelope();
+  Envelope envelope;
+  deserialize<TBinaryProtocol>(serialize<TBinaryProtocol>(eager), envelope);
+  BOOST_CHECK(envelope.payload.hasRaw());
+
+  // Binary bytes are no use to a compact protocol
+  BOOST_CHECK_EQUAL(serialize<TCompactProtocol>(envelope), serialize<TCompactProtocol>(eager));
+}
+
+BOOST_AUTO_TEST_CASE(test_json_reads_eagerly) {
+  EagerEnvelope eager = makeEnvelope();
+  Envelope envelope;
+  deserialize<TJSONProtocol>(serialize<TJSONProtocol>(eager), envelope);
+  BOOST_CHECK(!envelope.payload.hasRaw());
+  BOOST_CHECK(!envelope.history.hasRaw());
+  BOOST_CHECK(envelope.payload.get() == eager.payload);
+  BOOST_CHECK(envelope.history.get() == eager.history);
+  BOOST_CHECK_EQUAL(serialize<TJSONProtocol>(envelope), serialize<TJSONProtocol>(eager));
+}
+
+BOOST_AUTO_TEST_CASE(test_framed_transport) {
+  EagerEnvelope eager = makeEnvelope();
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  {
+    std::shared_ptr<TFramedTransport> framed(new TFramedTransport(buffer));
+    TCompactProtocol protocol(framed);
+    eager.write(&protocol);
+    framed->flush();
+  }
+
+  std::shared_ptr<TFramedTransport> framed(new TFramedTransport(buffer));
+  TCompactProtocol protocol(framed);
+  Envelope envelope;
+  envelope.read(&protocol);
+  BOOST_CHECK(envelope.payload.hasRaw());
+  BOOST_CHECK(envelope.history.hasRaw());
+  BOOST_CHECK(envelope.payload.get() == eager.payload);
+  BOOST_CHECK_EQUAL(envelope.trailer, "end");
+}
+
+BOOST_AUTO_TEST_CASE(test_buffered_transport_reads_eagerly) {
+  EagerEnvelope eager = makeEnvelope();
+  std::string data = serialize<TBinaryProtocol>(eager);
+
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  buffer->write(reinterpret_cast<const uint8_t*>(data.data()), static_cast<uint32_t>(data.size()));
+  std::shared_ptr<TTransport> buffered(new TBufferedTransport(buffer));
+  TBinaryProtocol protocol(buffered);
+  Envelope envelope;
+  envelope.read(&protocol);
+  BOOST_CHECK(!envelope.payload.hasRaw());
+  BOOST_CHECK(envelope.payload.get() == eager.payload);
+  BOOST_CHECK_EQUAL(serialize<TBinaryProtocol>(envelope), data);
+}
+
+BOOST_AUTO_TEST_CASE(test_copy_compare_swap) {
+  EagerEnvelope eager = makeEnvelope();
+  std::string data = serialize<TBinaryProtocol>(eager);
+  Envelope a;
+  deserialize<TBinaryProtocol>(data, a);
+
+  Envelope b(a);
+  BOOST_CHECK(b.payload.hasRaw());
+  BOOST_CHECK(a == b);
+
+  Envelope c;
+  c.id = eager.id;
+  c.payload = eager.payload;
+  c.history = eager.history;
+  c.__set_extra(eager.extra);
+  c.trailer = eager.trailer;
+  BOOST_CHECK(a == c);
+
+  c.payload.mutable_get().name = "other";
+  BOOST_CHECK(a != c);
+
+  swap(b, c);
+  BOOST_CHECK_EQUAL(b.payload.get().name, "other");
+  BOOST_CHECK(!b.payload.hasRaw());
+  BOOST_CHECK(c.payload.hasRaw());
+  BOOST_CHECK(a == c);
+
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(a.payload), apache::thrift::to_string(eager.payload));
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(a), apache::thrift::to_string(eager).replace(0, 5, ""));
+}
+
+BOOST_AUTO_TEST_CASE(test_defaults) {
+  WithDefaults defaults;
+  BOOST_CHECK_EQUAL(defaults.origin.get().x, 1);
+  BOOST_CHECK_EQUAL(defaults.origin.get().y, 2);
+  BOOST_CHECK((defaults.values.get() == std::vector<int32_t>{1, 2, 3}));
+
+  WithDefaults copy;
+  copy.values.mutable_get().clear();
+  deserialize<TCompactProtocol>(serialize<TCompactProtocol>(defaults), copy);
+  BOOST_CHECK(copy.values.hasRaw());
+  BOOST_CHECK(copy == defaults);
+}
+
+BOOST_AUTO_TEST_CASE(test_serialized_size) {
+  EagerEnvelope eager = makeEnvelope();
+  Envelope envelope;
+  deserialize<TCompactProtocol>(serialize<TCompactProtocol>(eager), envelope);
+  BOOST_CHECK_EQUAL(envelope.serializedSize<TCompactProtocol>(),
+                    serialize<TCompactProtocol>(eager).size());
+  BOOST_CHECK_EQUAL(envelope.serializedSize<TBinaryProtocol>(),
+                    serialize<TBinaryProtocol>(eager).size());
+}
+
+template <typename Protocol>
+static void checkSerializedSizeOfRaw() {
+  NewerEnvelope newer;
+  newer.id = 7;
+  newer.payload.name = "newer";
+  newer.payload.points.push_back(Point());
+  newer.payload.note = "not known to Payload";
+  newer.trailer = "end";
+  std::string data = serialize<Protocol>(newer);
+
+  // The bytes write() copies hold the field Payload does not know about
+  Envelope envelope;
+  deserialize<Protocol>(data, envelope);
+  BOOST_CHECK_EQUAL(envelope.serializedSize<Protocol>(), serialize<Protocol>(envelope).size());
+  BOOST_CHECK(envelope.payload.hasRaw());
+}
+
+BOOST_AUTO_TEST_CASE(test_serialized_size_of_raw_binary) {
+  checkSerializedSizeOfRaw<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_serialized_size_of_raw_compact) {
+  checkSerializedSizeOfRaw<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_serialized_size_of_raw_specialized) {
+  checkSerializedSizeOfRaw<TCompactProtocolT<TMemoryBuffer> >();
+  checkSerializedSizeOfRaw<TBinaryProtocolT<TMemoryBuffer> >();
+}
+
+BOOST_AUTO_TEST_CASE(test_serialized_size_of_other_format) {
+  EagerEnvelope eager = makeEnvelope();
+  Envelope envelope;
+  deserialize<TCompactProtocol>(serialize<TCompactProtocol>(eager), envelope);
+  BOOST_CHECK_EQUAL(envelope.serializedSize<TBinaryProtocol>(),
+                    serialize<TBinaryProtocol>(envelope).size());
+}
@@ -0,0 +1,75 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Generated with cpp:serialized_size by LazyFieldTest
+
+namespace cpp thrift.test.lazy
+
+struct Point {
+  1: i32 x
+  2: i32 y
+}
+
+struct Payload {
+  1: string name
+  2: list<Point> points
+  3: map<string, i64> counters
+}
+
+struct Envelope {
+  1: i32 id
+  2: Payload payload (cpp.lazy = "true")
+  3: list<Payload> history (cpp.lazy = "true")
+  4: optional Payload extra (cpp.lazy = "true")
+  5: string trailer
+}
+
+/**
+ * Envelope without lazy fields, which has the same encoding.
+ */
+struct EagerEnvelope {
+  1: i32 id
+  2: Payload payload
+  3: list<Payload> history
+  4: optional Payload extra
+  5: string trailer
+}
+
+/**
+ * Payload with a field that Payload does not know about, as a newer version
+ * of it would write.
+ */
+struct NewerPayload {
+  1: string name
+  2: list<Point> points
+  3: map<string, i64> counters
+  4: string note
+}
+
+struct NewerEnvelope {
+  1: i32 id
+  2: NewerPayload payload
+  5: string trailer
+}
+
+struct WithDefaults {
+  1: Point origin = { "x": 1, "y": 2 } (cpp.lazy = "true")
+  2: list<i32> values = [ 1, 2, 3 ] (cpp.lazy = "true")
+}
@@ -0,0 +1,215 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE PartialReadTest
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <string>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TFieldMask.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/PartialReadTest_types.h"
+
+using apache::thrift::TUuid;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TFieldMask;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::protocol::T_STRUCT;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransport;
+using namespace thrift::test::partial;
+
+static Record makeRecord() {
+  Record record;
+  record.id = 1234567890123LL;
+  record.name = "a record with a name longer than a small read buffer";
+  record.blob = std::string(1000, '\x7f');
+  for (int32_t i = 0; i < 100; ++i) {
+    record.samples.push_back(i * i);
+    record.weights.push_back(i / 8.0);
+    record.counters[i] = -i;
+  }
+  record.tags.insert("alpha");
+  record.tags.insert("beta");
+  record.location.lat = 52.5;
+  record.location.lon = 13.4;
+  record.path.push_back(record.location);
+  record.path.push_back(record.location);
+  record.active = true;
+  record.series["one"].push_back(1);
+  record.series["two"].push_back(2);
+  record.series["two"].push_back(-2);
+  record.key = TUuid("5e2ab188-1726-4e75-a04f-1ed9a6a89c4c");
+  record.flags.push_back(true);
+  record.flags.push_back(false);
+  record.source = "PartialReadTest";
+  return record;
+}
+
+template <typename Protocol, typename T>
+static std::string serialize(const T& value) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol protocol(buffer);
+  value.write(&protocol);
+  return buffer->getBufferAsString();
+}
+
+static std::shared_ptr<TMemoryBuffer> bufferOf(const std::string& data) {
+  return std::make_shared<TMemoryBuffer>(
+      reinterpret_cast<uint8_t*>(const_cast<char*>(data.data())),
+      static_cast<uint32_t>(data.size()));
+}
+
+template <typename Protocol>
+static void checkProjection(bool borrow) {
+  Record record = makeRecord();
+  std::string data = serialize<Protocol>(record);
+
+  // A small read buffer cannot lend out the larger strings and lists
+  std::shared_ptr<TMemoryBuffer> buffer = bufferOf(data);
+  std::shared_ptr<TTransport> trans = buffer;
+  if (!borrow) {
+    trans = std::make_shared<TBufferedTransport>(buffer, 16, 16);
+  }
+  Protocol protocol(trans);
+
+  Record partial;
+  uint32_t size = partial.readPartial(&protocol, TFieldMask{1, 8, 10, 14});
+  BOOST_CHECK_EQUAL(size, data.size());
+  BOOST_CHECK_EQUAL(buffer->available_read(), 0u);
+
+  BOOST_CHECK_EQUAL(partial.id, record.id);
+  BOOST_CHECK(partial.location == record.location);
+  BOOST_CHECK(partial.__isset.location);
+  BOOST_CHECK_EQUAL(partial.active, true);
+  BOOST_CHECK_EQUAL(partial.source, record.source);
+
+  // Everything else is skipped
+  BOOST_CHECK(partial.name.empty());
+  BOOST_CHECK(!partial.__isset.name);
+  BOOST_CHECK(partial.blob.empty());
+  BOOST_CHECK(partial.samples.empty());
+  BOOST_CHECK(partial.weights.empty());
+  BOOST_CHECK(partial.counters.empty());
+  BOOST_CHECK(partial.tags.empty());
+  BOOST_CHECK(partial.path.empty());
+  BOOST_CHECK(partial.series.empty());
+  BOOST_CHECK(partial.flags.empty());
+  BOOST_CHECK(!partial.__isset.key);
+
+  // With every field in the mask, it is read()
+  Record full;
+  std::shared_ptr<TMemoryBuffer> again = bufferOf(data);
+  Protocol fullProtocol(again);
+  TFieldMask all;
+  for (int16_t id = 1; id <= 14; ++id) {
+    all.add(id);
+  }
+  full.readPartial(&fullProtocol, all);
+  BOOST_CHECK(full == record);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_projection) {
+  checkProjection<TBinaryProtocol>(true);
+  checkProjection<TBinaryProtocol>(false);
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_projection) {
+  checkProjection<TCompactProtocol>(true);
+  checkProjection<TCompactProtocol>(false);
+}
+
+BOOST_AUTO_TEST_CASE(test_json_projection) {
+  Record record = makeRecord();
+  std::string data = serialize<TJSONProtocol>(record);
+  TJSONProtocol protocol(bufferOf(data));
+  Record partial;
+  partial.readPartial(&protocol, TFieldMask{1, 2, 14});
+  BOOST_CHECK_EQUAL(partial.id, record.id);
+  BOOST_CHECK_EQUAL(partial.name, record.name);
+  BOOST_CHECK_EQUAL(partial.source, record.source);
+  BOOST_CHECK(partial.samples.empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_required_fields) {
+  RecordId id;
+  id.id = 7;
+  std::string data = serialize<TBinaryProtocol>(id);
+
+  // Only the required fields in the mask have to be there
+  Record record;
+  TBinaryProtocol protocol(bufferOf(data));
+  record.readPartial(&protocol, TFieldMask{1});
+  BOOST_CHECK_EQUAL(record.id, 7);
+
+  TBinaryProtocol missing(bufferOf(data));
+  BOOST_CHECK_THROW(record.readPartial(&missing, TFieldMask{1, 14}), TProtocolException);
+}
+
+template <typename Protocol>
+static void checkSkip() {
+  std::string data = serialize<Protocol>(makeRecord());
+
+  Protocol fast(bufferOf(data));
+  BOOST_CHECK_EQUAL(fast.skip(T_STRUCT), data.size());
+
+  Protocol generic(bufferOf(data));
+  BOOST_CHECK_EQUAL(apache::thrift::protocol::skip(generic, T_STRUCT), data.size());
+}
+
+BOOST_AUTO_TEST_CASE(test_skip) {
+  checkSkip<TBinaryProtocol>();
+  checkSkip<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_skip_limits) {
+  Record record = makeRecord();
+
+  std::string binary = serialize<TBinaryProtocol>(record);
+  TBinaryProtocol strings(bufferOf(binary), 100, 0, false, false);
+  BOOST_CHECK_THROW(strings.skip(T_STRUCT), TProtocolException);
+  TBinaryProtocol containers(bufferOf(binary), 0, 50, false, false);
+  BOOST_CHECK_THROW(containers.skip(T_STRUCT), TProtocolException);
+
+  std::string compact = serialize<TCompactProtocol>(record);
+  TCompactProtocol compactStrings(bufferOf(compact), 100, 0);
+  BOOST_CHECK_THROW(compactStrings.skip(T_STRUCT), TProtocolException);
+  TCompactProtocol compactContainers(bufferOf(compact), 0, 50);
+  BOOST_CHECK_THROW(compactContainers.skip(T_STRUCT), TProtocolException);
+}
+
+BOOST_AUTO_TEST_CASE(test_field_mask) {
+  TFieldMask mask{3, 200, -1};
+  BOOST_CHECK(mask.contains(3));
+  BOOST_CHECK(mask.contains(200));
+  BOOST_CHECK(mask.contains(-1));
+  BOOST_CHECK(!mask.contains(0));
+  BOOST_CHECK(!mask.contains(4));
+  BOOST_CHECK(!mask.contains(32767));
+  BOOST_CHECK(!mask.contains(-2));
+  mask.remove(200).add(4);
+  BOOST_CHECK(!mask.contains(200));
+  BOOST_CHECK(mask.contains(4));
+}
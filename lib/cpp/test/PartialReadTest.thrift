@@ -0,0 +1,52 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Generated with cpp:read_partial by PartialReadTest
+
+namespace cpp thrift.test.partial
+
+struct Location {
+  1: double lat
+  2: double lon
+}
+
+struct Record {
+  1: required i64 id
+  2: string name
+  3: binary blob
+  4: list<i32> samples
+  5: list<double> weights
+  6: map<i32, i64> counters
+  7: set<string> tags
+  8: Location location
+  9: list<Location> path
+  10: bool active
+  11: map<string, list<i16>> series
+  12: uuid key
+  13: list<bool> flags
+  14: required string source
+}
+
+/**
+ * The first field of Record, as a record without the others is written.
+ */
+struct RecordId {
+  1: required i64 id
+}
@@ -0,0 +1,321 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE PipelinedClientTest
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <thrift/async/TPipelinedClientChannel.h>
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TServerSocket.h>
+#include <thrift/transport/TSocket.h>
+#include "gen-cpp/ParentService.h"
+
+using apache::thrift::async::TPipelinedClientChannel;
+using apache::thrift::concurrency::Monitor;
+using apache::thrift::concurrency::Synchronized;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TBinaryProtocolFactory;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::test::ParentServiceCobClient;
+using apache::thrift::test::ParentServiceNull;
+using apache::thrift::test::ParentServiceProcessor;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TServerSocket;
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+
+class DataHandler : public ParentServiceNull {
+public:
+  void getDataWait(std::string& _return, const int32_t length) override {
+    _return.assign(length, 'x');
+  }
+};
+
+/**
+ * Accepts one connection and serves ParentService on it from a thread.
+ * Unless inOrder, requests are taken batchSize at a time and each batch is
+ * answered in reverse order.  After maxRequests the connection is closed,
+ * without answering the last batch if answerLast is false.
+ */
+class TestServer {
+public:
+  TestServer(bool framed, bool inOrder, size_t batchSize, size_t maxRequests,
+             bool answerLast = true)
+    : server_(new TServerSocket("localhost", 0)),
+      framed_(framed),
+      inOrder_(inOrder),
+      batchSize_(batchSize),
+      maxRequests_(maxRequests),
+      answerLast_(answerLast) {
+    server_->listen();
+    thread_ = std::thread(std::bind(&TestServer::serve, this));
+  }
+
+  ~TestServer() {
+    thread_.join();
+    server_->close();
+  }
+
+  std::shared_ptr<TTransport> connect() {
+    return std::make_shared<TSocket>("localhost", server_->getPort());
+  }
+
+private:
+  void serve() {
+    std::shared_ptr<TTransport> client = server_->accept();
+    std::shared_ptr<TTransport> in;
+    std::shared_ptr<TTransport> out;
+    if (framed_) {
+      in = out = std::make_shared<TFramedTransport>(client);
+    } else {
+      in = std::make_shared<TBufferedTransport>(client);
+      out = client;
+    }
+    std::shared_ptr<TProtocol> iprot = std::make_shared<TBinaryProtocol>(in);
+    ParentServiceProcessor processor(std::make_shared<DataHandler>());
+
+    size_t served = 0;
+    try {
+      while (served < maxRequests_ && in->peek()) {
+        std::vector<std::shared_ptr<TMemoryBuffer> > replies;
+        while (replies.size() < batchSize_ && served < maxRequests_) {
+          std::shared_ptr<TMemoryBuffer> reply = std::make_shared<TMemoryBuffer>();
+          processor.process(iprot, std::make_shared<TBinaryProtocol>(reply), nullptr);
+          replies.push_back(reply);
+          ++served;
+        }
+        if (served == maxRequests_ && !answerLast_) {
+          break;
+        }
+        if (!inOrder_) {
+          std::reverse(replies.begin(), replies.end());
+        }
+        for (size_t i = 0; i < replies.size(); ++i) {
+          uint8_t* buf;
+          uint32_t len;
+          replies[i]->getBuffer(&buf, &len);
+          out->write(buf, len);
+          out->flush();
+        }
+      }
+    } catch (const TTransportException&) {
+      // the client went away
+    }
+    client->close();
+  }
+
+  std::shared_ptr<TServerSocket> server_;
+  const bool framed_;
+  const bool inOrder_;
+  const size_t batchSize_;
+  const size_t maxRequests_;
+  const bool answerLast_;
+  std::thread thread_;
+};
+
+/**
+ * Counts completed calls, keeping the size of each reply.
+ */
+class Results : public Monitor {
+public:
+  explicit Results(size_t count) : sizes(count, -1), failures(0), done_(0) {}
+
+  void complete(size_t index, ParentServiceCobClient* client) {
+    Synchronized s(*this);
+    try {
+      std::string data;
+      client->recv_getDataWait(data);
+      sizes[index] = static_cast<int>(data.size());
+    } catch (const apache::thrift::TException&) {
+      ++failures;
+    }
+    ++done_;
+    notifyAll();
+  }
+
+  void waitFor(size_t count) {
+    Synchronized s(*this);
+    while (done_ < count) {
+      BOOST_REQUIRE_NO_THROW(wait(10000));
+    }
+  }
+
+  std::vector<int> sizes;
+  size_t failures;
+
+private:
+  size_t done_;
+};
+
+static void testOutOfOrder(bool framed) {
+  const size_t count = 16;
+  TestServer server(framed, false, count, count + 1);
+  TBinaryProtocolFactory protocolFactory;
+  std::shared_ptr<TPipelinedClientChannel> channel = std::make_shared<TPipelinedClientChannel>(
+      server.connect(), std::make_shared<TBinaryProtocolFactory>(), framed);
+
+  Results results(count);
+  std::vector<std::shared_ptr<ParentServiceCobClient> > clients;
+  for (size_t i = 0; i < count; ++i) {
+    clients.push_back(std::make_shared<ParentServiceCobClient>(channel, &protocolFactory));
+    clients[i]->getDataWait(std::bind(&Results::complete, &results, i, std::placeholders::_1),
+                            static_cast<int32_t>(i + 1));
+  }
+  results.waitFor(count);
+
+  BOOST_CHECK_EQUAL(results.failures, 0u);
+  for (size_t i = 0; i < count; ++i) {
+    BOOST_CHECK_EQUAL(results.sizes[i], static_cast<int>(i + 1));
+  }
+  BOOST_CHECK_EQUAL(channel->pendingCount(), 0u);
+  BOOST_CHECK(channel->good());
+}
+
+BOOST_AUTO_TEST_CASE(test_out_of_order_framed) {
+  testOutOfOrder(true);
+}
+
+BOOST_AUTO_TEST_CASE(test_out_of_order_unframed) {
+  testOutOfOrder(false);
+}
+
+BOOST_AUTO_TEST_CASE(test_connection_failure) {
+  const size_t count = 2;
+  TestServer server(true, true, 1, count);
+  TBinaryProtocolFactory protocolFactory;
+  std::shared_ptr<TPipelinedClientChannel> channel = std::make_shared<TPipelinedClientChannel>(
+      server.connect(), std::make_shared<TBinaryProtocolFactory>());
+
+  // The server hangs up after answering two requests
+  Results results(count);
+  ParentServiceCobClient first(channel, &protocolFactory);
+  first.getDataWait(std::bind(&Results::complete, &results, 0, std::placeholders::_1), 10);
+  results.waitFor(1);
+  BOOST_CHECK_EQUAL(results.sizes[0], 10);
+
+  ParentServiceCobClient second(channel, &protocolFactory);
+  second.getDataWait(std::bind(&Results::complete, &results, 1, std::placeholders::_1), 20);
+  results.waitFor(2);
+  BOOST_CHECK_EQUAL(results.sizes[1], 20);
+
+  // Wait for the reader to see the connection close
+  for (int i = 0; i < 1000 && channel->good(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  BOOST_CHECK(channel->error());
+  BOOST_CHECK_THROW(first.getDataWait(std::bind(&Results::complete, &results, 0,
+                                                std::placeholders::_1),
+                                      30),
+                    TTransportException);
+}
+
+BOOST_AUTO_TEST_CASE(test_pending_replies_fail) {
+  // The server reads both requests but hangs up without answering
+  const size_t count = 2;
+  TestServer server(true, true, count, count, false);
+  TBinaryProtocolFactory protocolFactory;
+  std::shared_ptr<TPipelinedClientChannel> channel = std::make_shared<TPipelinedClientChannel>(
+      server.connect(), std::make_shared<TBinaryProtocolFactory>());
+
+  Results results(count);
+  std::vector<std::shared_ptr<ParentServiceCobClient> > clients;
+  for (size_t i = 0; i < count; ++i) {
+    clients.push_back(std::make_shared<ParentServiceCobClient>(channel, &protocolFactory));
+    clients[i]->getDataWait(std::bind(&Results::complete, &results, i, std::placeholders::_1), 5);
+  }
+  results.waitFor(count);
+
+  BOOST_CHECK_EQUAL(results.failures, count);
+  BOOST_CHECK_EQUAL(channel->pendingCount(), 0u);
+  BOOST_CHECK(channel->error());
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_senders) {
+  const size_t threadCount = 8;
+  const size_t perThread = 100;
+  const size_t count = threadCount * perThread;
+  TestServer server(true, true, 1, count + 1);
+  TBinaryProtocolFactory protocolFactory;
+
+  // Far fewer slots than requests, so senders have to wait for replies
+  std::shared_ptr<TPipelinedClientChannel> channel = std::make_shared<TPipelinedClientChannel>(
+      server.connect(), std::make_shared<TBinaryProtocolFactory>(), true, 4);
+
+  Results results(count);
+  std::vector<std::shared_ptr<ParentServiceCobClient> > clients(count);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < threadCount; ++t) {
+    threads.push_back(std::thread([&, t]() {
+      for (size_t i = t * perThread; i < (t + 1) * perThread; ++i) {
+        clients[i] = std::make_shared<ParentServiceCobClient>(channel, &protocolFactory);
+        clients[i]->getDataWait(std::bind(&Results::complete, &results, i, std::placeholders::_1),
+                                static_cast<int32_t>(i % 64));
+      }
+    }));
+  }
+  for (size_t t = 0; t < threadCount; ++t) {
+    threads[t].join();
+  }
+  results.waitFor(count);
+
+  BOOST_CHECK_EQUAL(results.failures, 0u);
+  for (size_t i = 0; i < count; ++i) {
+    BOOST_CHECK_EQUAL(results.sizes[i], static_cast<int>(i % 64));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_callback_destroys_channel) {
+  TestServer server(true, true, 1, 2);
+  TBinaryProtocolFactory protocolFactory;
+  std::shared_ptr<TPipelinedClientChannel> channel = std::make_shared<TPipelinedClientChannel>(
+      server.connect(), std::make_shared<TBinaryProtocolFactory>());
+  std::shared_ptr<ParentServiceCobClient> client
+      = std::make_shared<ParentServiceCobClient>(channel, &protocolFactory);
+
+  // Once the call is sent, the client holds the last reference to the
+  // channel, and the reply callback drops it on the reader thread
+  std::promise<void> sent;
+  std::shared_future<void> sentFuture = sent.get_future().share();
+  Results results(1);
+  client->getDataWait(
+      [&, sentFuture](ParentServiceCobClient* cobClient) {
+        sentFuture.wait();
+        std::shared_ptr<ParentServiceCobClient> last;
+        last.swap(client);
+        results.complete(0, cobClient);
+      },
+      10);
+  channel.reset();
+  sent.set_value();
+  results.waitFor(1);
+  BOOST_CHECK_EQUAL(results.sizes[0], 10);
+}
@@ -0,0 +1,172 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thrift/TArena.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "pmr/gen-cpp/DebugProtoTest_types.h"
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+// Every heap allocation in the process goes through these
+static uint64_t allocations = 0;
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size != 0 ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  ++allocations;
+  std::size_t align = static_cast<std::size_t>(alignment);
+  if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+class Timer {
+public:
+  timeval vStart;
+
+  Timer() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+  void start() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+
+  double frame() {
+    timeval vEnd;
+    THRIFT_GETTIMEOFDAY(&vEnd, nullptr);
+    double dstart = vStart.tv_sec + ((double)vStart.tv_usec / 1000000.0);
+    double dend = vEnd.tv_sec + ((double)vEnd.tv_usec / 1000000.0);
+    return dend - dstart;
+  }
+};
+
+/*
+ * Decodes a HolyMoley from DebugProtoTest.thrift, generated with cpp:pmr,
+ * once on the heap (std::pmr::new_delete_resource(), which allocates like
+ * the plain std containers do) and once in a TArena, and reports the heap
+ * allocations and time per decode of each.
+ */
+int main() {
+  using namespace thrift::test::debug;
+  using namespace apache::thrift::transport;
+  using namespace apache::thrift::protocol;
+  using apache::thrift::TArena;
+  using std::cout;
+
+  HolyMoley hm;
+  for (int i = 0; i < 16; ++i) {
+    OneOfEach ooe;
+    ooe.integer32 = i;
+    ooe.some_characters = "characters that do not fit in a short string";
+    ooe.zomg_unicode = "\xd3\x80\xe2\x85\xae\xce\x9d \xd0\x9d\xce\xbf\xe2\x85\xbf\xd0\xbe\xc9\xa1";
+    ooe.base64 = "binary data that does not fit either";
+    hm.big.push_back(ooe);
+  }
+  for (int i = 0; i < 8; ++i) {
+    std::pmr::vector<std::pmr::string> stage;
+    stage.push_back(("and a one, and a two, and a " + std::to_string(i)).c_str());
+    stage.push_back("then there was a long string");
+    hm.contain.insert(stage);
+  }
+  for (int i = 0; i < 8; ++i) {
+    std::pmr::vector<Bonk>& bonks = hm.bonks[("bonk key number " + std::to_string(i)).c_str()];
+    for (int j = 0; j < 4; ++j) {
+      Bonk bonk;
+      bonk.type = j;
+      bonk.message = ("this is the message of bonk " + std::to_string(j)).c_str();
+      bonks.push_back(bonk);
+    }
+  }
+
+  std::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocolT<TMemoryBuffer> prot(buf);
+  hm.write(&prot);
+  uint8_t* data = nullptr;
+  uint32_t datasize = 0;
+  buf->getBuffer(&data, &datasize);
+
+  int num = 20000;
+
+  {
+    std::shared_ptr<TMemoryBuffer> rbuf(new TMemoryBuffer(data, datasize));
+    TBinaryProtocolT<TMemoryBuffer> rprot(rbuf);
+    uint64_t before = allocations;
+    Timer timer;
+    for (int i = 0; i < num; ++i) {
+      rbuf->resetBuffer(data, datasize);
+      HolyMoley result;
+      result.read(&rprot);
+    }
+    double elapsed = timer.frame();
+    cout << "heap:  " << (allocations - before) / num << " allocations/decode, "
+         << num / elapsed << " decodes/sec\n";
+  }
+
+  {
+    std::shared_ptr<TMemoryBuffer> rbuf(new TMemoryBuffer(data, datasize));
+    TBinaryProtocolT<TMemoryBuffer> rprot(rbuf);
+    uint64_t before = allocations;
+    Timer timer;
+    for (int i = 0; i < num; ++i) {
+      rbuf->resetBuffer(data, datasize);
+      TArena arena;
+      TArena::Scope scope(arena);
+      HolyMoley result;
+      result.read(&rprot);
+      if (i == 0 && !(result == hm)) {
+        cout << "decoded HolyMoley differs from the original\n";
+        return 1;
+      }
+    }
+    double elapsed = timer.frame();
+    cout << "arena: " << (allocations - before) / num << " allocations/decode, "
+         << num / elapsed << " decodes/sec\n";
+  }
+
+  return 0;
+}
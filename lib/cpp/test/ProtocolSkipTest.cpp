@@ -0,0 +1,318 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE ProtocolSkipTest
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <thrift/TConfiguration.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+using apache::thrift::TConfiguration;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::protocol::TType;
+using apache::thrift::protocol::T_I32;
+using apache::thrift::protocol::T_I64;
+using apache::thrift::protocol::T_LIST;
+using apache::thrift::protocol::T_STRING;
+using apache::thrift::protocol::T_STRUCT;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+using namespace thrift::test::debug;
+
+// Counts the allocations made while counting_ is set
+static bool counting_ = false;
+static size_t allocations_ = 0;
+
+void* operator new(std::size_t size) {
+  if (counting_) {
+    ++allocations_;
+  }
+  void* p = std::malloc(size ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+/**
+ * Skips one value of the type and returns how many allocations that took.
+ */
+static size_t countSkipAllocations(TProtocol& protocol, TType type, uint32_t& size) {
+  allocations_ = 0;
+  counting_ = true;
+  try {
+    size = protocol.skip(type);
+  } catch (...) {
+    counting_ = false;
+    throw;
+  }
+  counting_ = false;
+  return allocations_;
+}
+
+static CompactProtoTestStruct makeCompactProtoTestStruct() {
+  CompactProtoTestStruct cpts;
+  cpts.a_byte = 127;
+  cpts.a_i16 = 32000;
+  cpts.a_i32 = 1000000000;
+  cpts.a_i64 = 0xffffffffffLL;
+  cpts.a_double = 5.6789;
+  cpts.a_string = "my string";
+  cpts.true_field = true;
+  cpts.false_field = false;
+  for (int16_t i = 0; i < 20; ++i) {
+    cpts.i16_list.push_back(static_cast<int16_t>(-i * 1000));
+    cpts.i32_list.push_back(i * 100000);
+    cpts.double_list.push_back(i / 3.0);
+    cpts.boolean_list.push_back(i % 3 == 0);
+    cpts.struct_list.push_back(Empty());
+    cpts.i32_byte_map[i * 70000] = static_cast<int8_t>(i);
+    cpts.byte_i64_map[static_cast<int8_t>(i)] = -i;
+    cpts.byte_string_map[static_cast<int8_t>(i)] = "value";
+  }
+  cpts.string_set.insert("first");
+  cpts.string_set.insert("second");
+  cpts.boolean_byte_map[true] = 1;
+  cpts.byte_list_map[1].push_back(2);
+  cpts.field500 = 500;
+  cpts.field5000 = 5000;
+  cpts.field20000 = 20000;
+  return cpts;
+}
+
+static HolyMoley makeHolyMoley() {
+  HolyMoley hm;
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.integer64 = 6000000000LL;
+  ooe.double_precision = 3.14;
+  ooe.some_characters = std::string(300, 'x');
+  ooe.base64 = std::string(700, '\x01');
+  for (int8_t i = 0; i < 100; ++i) {
+    ooe.byte_list.push_back(i);
+    ooe.i16_list.push_back(static_cast<int16_t>(i * 300));
+    ooe.i64_list.push_back(static_cast<int64_t>(i) << 40);
+  }
+  hm.big.push_back(ooe);
+  hm.big.push_back(ooe);
+
+  std::vector<std::string> stage1;
+  stage1.push_back("and a one");
+  stage1.push_back("and a two");
+  hm.contain.insert(stage1);
+
+  std::vector<Bonk> stage2(2);
+  stage2[0].type = 1;
+  stage2[0].message = "Wait.";
+  stage2[1].type = 2;
+  stage2[1].message = "What?";
+  hm.bonks["something"] = stage2;
+  return hm;
+}
+
+/**
+ * The serialized value followed by a single '!' byte.
+ */
+template <typename Protocol, typename T>
+static std::string serialize(const T& value) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol protocol(buffer);
+  value.write(&protocol);
+  protocol.writeByte('!');
+  return buffer->getBufferAsString();
+}
+
+template <typename Protocol>
+static void checkSkip(const std::string& data, std::shared_ptr<TTransport> trans, TType type) {
+  Protocol protocol(trans);
+  uint32_t size = 0;
+  BOOST_CHECK_EQUAL(countSkipAllocations(protocol, type, size), 0u);
+  BOOST_CHECK_EQUAL(size, data.size() - 1);
+  int8_t last = 0;
+  protocol.readByte(last);
+  BOOST_CHECK_EQUAL(last, '!');
+}
+
+template <typename Protocol>
+static void checkSkip(const std::string& data, TType type) {
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(const_cast<char*>(data.data()));
+  auto size = static_cast<uint32_t>(data.size());
+
+  // The transport lends the whole value
+  checkSkip<Protocol>(data, std::make_shared<TMemoryBuffer>(bytes, size), type);
+
+  // The transport lends a few bytes at a time, so values straddle its buffer
+  for (uint32_t bufferSize : {7u, 64u, 512u}) {
+    std::shared_ptr<TTransport> inner(new TMemoryBuffer(bytes, size));
+    checkSkip<Protocol>(data, std::make_shared<TBufferedTransport>(inner, bufferSize, bufferSize), type);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_skip_struct_allocates_nothing) {
+  CompactProtoTestStruct cpts = makeCompactProtoTestStruct();
+  checkSkip<TBinaryProtocol>(serialize<TBinaryProtocol>(cpts), T_STRUCT);
+  checkSkip<TCompactProtocol>(serialize<TCompactProtocol>(cpts), T_STRUCT);
+
+  HolyMoley hm = makeHolyMoley();
+  checkSkip<TBinaryProtocol>(serialize<TBinaryProtocol>(hm), T_STRUCT);
+  checkSkip<TCompactProtocol>(serialize<TCompactProtocol>(hm), T_STRUCT);
+}
+
+BOOST_AUTO_TEST_CASE(test_skip_leaves_field_ids_of_enclosing_struct) {
+  // The field after a skipped list of structs is encoded as a delta from its id
+  HolyMoley hm = makeHolyMoley();
+  std::string data = serialize<TCompactProtocol>(hm);
+  std::shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(data.data())),
+                        static_cast<uint32_t>(data.size())));
+  TCompactProtocol protocol(buffer);
+
+  std::string name;
+  TType ftype;
+  int16_t fid;
+  protocol.readStructBegin(name);
+  protocol.readFieldBegin(name, ftype, fid);
+  BOOST_CHECK_EQUAL(fid, 1);
+  protocol.skip(ftype);
+  protocol.readFieldEnd();
+  protocol.readFieldBegin(name, ftype, fid);
+  BOOST_CHECK_EQUAL(fid, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_skip_compact_varint_list) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TCompactProtocol writer(buffer);
+  writer.writeListBegin(T_I64, 1000);
+  for (int64_t i = 0; i < 1000; ++i) {
+    // One to ten bytes each
+    writer.writeI64(i % 2 ? -(i << (i % 57)) : i);
+  }
+  writer.writeListEnd();
+  writer.writeByte('!');
+
+  checkSkip<TCompactProtocol>(buffer->getBufferAsString(), T_LIST);
+}
+
+BOOST_AUTO_TEST_CASE(test_skip_compact_varint_over_ten_bytes) {
+  // A list of one i32 whose varint never ends
+  std::string data(1, static_cast<char>(0x10 | 5));
+  data.append(12, static_cast<char>(0xff));
+  std::shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(data.data())),
+                        static_cast<uint32_t>(data.size())));
+  TCompactProtocol protocol(buffer);
+  try {
+    protocol.skip(T_LIST);
+    BOOST_FAIL("expected an exception");
+  } catch (const TProtocolException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TProtocolException::INVALID_DATA);
+  }
+}
+
+template <typename Protocol>
+static void checkSkipDepthLimit() {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol writer(buffer);
+  for (int i = 0; i < 20; ++i) {
+    writer.writeListBegin(T_LIST, 1);
+  }
+  writer.writeListBegin(T_I32, 0);
+  std::string data = buffer->getBufferAsString();
+
+  std::shared_ptr<TConfiguration> config(new TConfiguration(TConfiguration::DEFAULT_MAX_MESSAGE_SIZE,
+                                                            TConfiguration::DEFAULT_MAX_FRAME_SIZE,
+                                                            8));
+  std::shared_ptr<TMemoryBuffer> input(
+      new TMemoryBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(data.data())),
+                        static_cast<uint32_t>(data.size()), TMemoryBuffer::OBSERVE, config));
+  Protocol protocol(input);
+  try {
+    protocol.skip(T_LIST);
+    BOOST_FAIL("expected an exception");
+  } catch (const TProtocolException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TProtocolException::DEPTH_LIMIT);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_skip_depth_limit) {
+  checkSkipDepthLimit<TBinaryProtocol>();
+  checkSkipDepthLimit<TCompactProtocol>();
+}
+
+template <typename Protocol>
+static void checkSkipMessageSizeLimit() {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol writer(buffer);
+  writer.writeString(std::string(1000, 'x'));
+  std::string data = buffer->getBufferAsString();
+
+  std::shared_ptr<TConfiguration> config(new TConfiguration(100));
+  std::shared_ptr<TTransport> inner(
+      new TMemoryBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(data.data())),
+                        static_cast<uint32_t>(data.size()), TMemoryBuffer::OBSERVE, config));
+  Protocol protocol(std::make_shared<TBufferedTransport>(inner, 16, 16, config));
+  try {
+    protocol.skip(T_STRING);
+    BOOST_FAIL("expected an exception");
+  } catch (const TTransportException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TTransportException::END_OF_FILE);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_skip_message_size_limit) {
+  checkSkipMessageSizeLimit<TBinaryProtocol>();
+  checkSkipMessageSizeLimit<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_skip_fixed_width_body_overflow) {
+  // A map claiming 2^31-1 entries of 16 + 8 bytes each
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol writer(buffer);
+  writer.writeMapBegin(apache::thrift::protocol::T_UUID, apache::thrift::protocol::T_DOUBLE,
+                       0x7fffffff);
+  std::string data = buffer->getBufferAsString();
+
+  std::shared_ptr<TConfiguration> config(new TConfiguration(0x7fffffff));
+  std::shared_ptr<TMemoryBuffer> input(
+      new TMemoryBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(data.data())),
+                        static_cast<uint32_t>(data.size()), TMemoryBuffer::OBSERVE, config));
+  TBinaryProtocol protocol(input);
+  BOOST_CHECK_THROW(protocol.skip(apache::thrift::protocol::T_MAP), apache::thrift::TException);
+}
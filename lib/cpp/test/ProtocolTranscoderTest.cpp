@@ -0,0 +1,353 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE ProtocolTranscoderTest
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <thrift/TApplicationException.h>
+#include <thrift/TConfiguration.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TProtocolTranscoder.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+using apache::thrift::TApplicationException;
+using apache::thrift::TConfiguration;
+using apache::thrift::TUuid;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace thrift::test::debug;
+
+typedef TBinaryProtocolT<TMemoryBuffer> BinaryProtocol;
+typedef TCompactProtocolT<TMemoryBuffer> CompactProtocol;
+
+// Counts the allocations made while counting_ is set
+static bool counting_ = false;
+static size_t allocations_ = 0;
+
+void* operator new(std::size_t size) {
+  if (counting_) {
+    ++allocations_;
+  }
+  void* p = std::malloc(size ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+static HolyMoley makeHolyMoley() {
+  HolyMoley hm;
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.a_bite = 0x22;
+  ooe.integer16 = 27000;
+  ooe.integer32 = 1 << 24;
+  ooe.integer64 = 6000000000LL;
+  ooe.double_precision = 3.1415926535897931;
+  ooe.some_characters = "a string longer than the small string buffer";
+  ooe.base64 = std::string(300, '\x01');
+  for (int i = 0; i < 100; ++i) {
+    ooe.byte_list.push_back(static_cast<int8_t>(i));
+    ooe.i16_list.push_back(static_cast<int16_t>(i * 300));
+    ooe.i64_list.push_back(static_cast<int64_t>(i) << 40);
+  }
+  hm.big.push_back(ooe);
+  hm.big.push_back(ooe);
+
+  std::vector<std::string> stage1;
+  stage1.push_back("and a one");
+  stage1.push_back("and a two");
+  hm.contain.insert(stage1);
+  hm.contain.insert(std::vector<std::string>());
+
+  std::vector<Bonk> stage2(2);
+  stage2[0].type = 1;
+  stage2[0].message = "Wait.";
+  stage2[1].type = 2;
+  stage2[1].message = "What?";
+  hm.bonks["something"] = stage2;
+  hm.bonks["nothing"] = std::vector<Bonk>();
+  return hm;
+}
+
+static CompactProtoTestStruct makeCompactProtoTestStruct() {
+  CompactProtoTestStruct cpts;
+  cpts.a_byte = 127;
+  cpts.a_i16 = 32000;
+  cpts.a_i32 = 1000000000;
+  cpts.a_i64 = 0xffffffffffLL;
+  cpts.a_double = 5.6789;
+  cpts.a_string = "my string";
+  cpts.true_field = true;
+  cpts.false_field = false;
+  for (int16_t i = 0; i < 150; ++i) {
+    cpts.i16_list.push_back(static_cast<int16_t>(-i * 100));
+    cpts.i32_list.push_back(i * 100000);
+    cpts.i64_list.push_back(-static_cast<int64_t>(i) << 40);
+    cpts.double_list.push_back(i / 3.0);
+    cpts.boolean_list.push_back(i % 3 == 0);
+    cpts.i16_set.insert(i);
+    cpts.double_set.insert(i / 7.0);
+    cpts.i32_byte_map[i * 70000] = static_cast<int8_t>(i);
+    cpts.byte_i64_map[static_cast<int8_t>(i)] = -i;
+  }
+  cpts.string_list.push_back("first");
+  cpts.struct_list.push_back(Empty());
+  cpts.boolean_byte_map[true] = 1;
+  cpts.boolean_byte_map[false] = 0;
+  cpts.byte_list_map[1].push_back(2);
+  cpts.byte_map_map[3][4] = 5;
+  cpts.field500 = 500;
+  cpts.field5000 = 5000;
+  cpts.field20000 = 20000;
+  return cpts;
+}
+
+template <typename Protocol, typename T>
+static std::string serialize(const T& value) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol protocol(buffer);
+  value.write(&protocol);
+  return buffer->getBufferAsString();
+}
+
+template <typename Protocol, typename T>
+static std::string serializeCall(const T& value) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol protocol(buffer);
+  protocol.writeMessageBegin("Service:method", T_CALL, 42);
+  value.write(&protocol);
+  protocol.writeMessageEnd();
+  return buffer->getBufferAsString();
+}
+
+static std::shared_ptr<TMemoryBuffer> bufferOf(const std::string& data) {
+  return std::make_shared<TMemoryBuffer>(reinterpret_cast<uint8_t*>(const_cast<char*>(data.data())),
+                                         static_cast<uint32_t>(data.size()));
+}
+
+/**
+ * Transcodes a struct in the In protocol's encoding to the Out protocol.
+ */
+template <typename In,
+          typename Out,
+          typename InProtocol_ = In,
+          typename OutProtocol_ = Out,
+          typename Transport_>
+static std::string transcode(std::shared_ptr<Transport_> input, uint32_t expectedSize) {
+  std::shared_ptr<TMemoryBuffer> output(new TMemoryBuffer());
+  TProtocolTranscoder<InProtocol_, OutProtocol_> transcoder(std::make_shared<In>(input),
+                                                            std::make_shared<Out>(output));
+  BOOST_CHECK_EQUAL(transcoder.transcode(T_STRUCT), expectedSize);
+  return output->getBufferAsString();
+}
+
+/**
+ * Decodes a struct from TBinaryProtocol.
+ */
+template <typename T>
+static T deserialize(const std::string& data) {
+  TBinaryProtocol protocol(bufferOf(data));
+  T value;
+  value.read(&protocol);
+  return value;
+}
+
+template <typename T>
+static void checkBothWays(const T& value) {
+  std::string binary = serialize<TBinaryProtocol>(value);
+  std::string compact = serialize<TCompactProtocol>(value);
+  auto binarySize = static_cast<uint32_t>(binary.size());
+  auto compactSize = static_cast<uint32_t>(compact.size());
+
+  BOOST_CHECK((transcode<BinaryProtocol, CompactProtocol>(bufferOf(binary), binarySize) == compact));
+  BOOST_CHECK((transcode<TBinaryProtocol, TCompactProtocol, TProtocol, TProtocol>(bufferOf(binary),
+                                                                                 binarySize)
+               == compact));
+  BOOST_CHECK((transcode<BinaryProtocol, BinaryProtocol>(bufferOf(binary), binarySize) == binary));
+
+  // Empty maps in the compact protocol have no key and value types, so the
+  // binary ones can differ from what the struct would write
+  BOOST_CHECK(
+      (deserialize<T>(transcode<CompactProtocol, BinaryProtocol>(bufferOf(compact), compactSize))
+       == value));
+
+  // A source whose transport does not keep the message around
+  std::shared_ptr<TTransport> buffered(new TBufferedTransport(bufferOf(compact), 16, 16));
+  BOOST_CHECK(
+      (deserialize<T>(transcode<TCompactProtocol, TBinaryProtocol>(buffered, compactSize)) == value));
+}
+
+BOOST_AUTO_TEST_CASE(test_transcode_struct) {
+  checkBothWays(makeHolyMoley());
+  checkBothWays(makeCompactProtoTestStruct());
+  checkBothWays(Empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_transcode_uuid) {
+  std::shared_ptr<TMemoryBuffer> input(new TMemoryBuffer());
+  TCompactProtocol writer(input);
+  TUuid uuid("5e2ab188-1726-4e75-a04f-1ed9a6a89c4c");
+  writer.writeUUID(uuid);
+
+  std::shared_ptr<TMemoryBuffer> output(new TMemoryBuffer());
+  TProtocolTranscoder<> transcoder(std::make_shared<TCompactProtocol>(input),
+                                   std::make_shared<TBinaryProtocol>(output));
+  BOOST_CHECK_EQUAL(transcoder.transcode(T_UUID), 16u);
+  TUuid result;
+  TBinaryProtocol reader(output);
+  reader.readUUID(result);
+  BOOST_CHECK(result == uuid);
+}
+
+BOOST_AUTO_TEST_CASE(test_transcode_message) {
+  HolyMoley hm = makeHolyMoley();
+  std::string binary = serializeCall<TBinaryProtocol>(hm);
+  std::shared_ptr<TMemoryBuffer> output(new TMemoryBuffer());
+  TProtocolTranscoder<BinaryProtocol, CompactProtocol> transcoder(
+      std::make_shared<BinaryProtocol>(bufferOf(binary)),
+      std::make_shared<CompactProtocol>(output));
+  BOOST_CHECK_EQUAL(transcoder.transcodeMessage(), binary.size());
+  BOOST_CHECK(output->getBufferAsString() == serializeCall<TCompactProtocol>(hm));
+
+  // An exception reply
+  std::shared_ptr<TMemoryBuffer> reply(new TMemoryBuffer());
+  TCompactProtocol replyWriter(reply);
+  replyWriter.writeMessageBegin("method", T_EXCEPTION, 7);
+  TApplicationException(TApplicationException::UNKNOWN_METHOD, "no such method").write(&replyWriter);
+  replyWriter.writeMessageEnd();
+
+  std::shared_ptr<TMemoryBuffer> binaryReply(new TMemoryBuffer());
+  TProtocolTranscoder<> replyTranscoder(std::make_shared<TCompactProtocol>(reply),
+                                        std::make_shared<TBinaryProtocol>(binaryReply));
+  replyTranscoder.transcodeMessage();
+
+  TBinaryProtocol reader(binaryReply);
+  std::string name;
+  TMessageType messageType;
+  int32_t seqid;
+  TApplicationException ex;
+  reader.readMessageBegin(name, messageType, seqid);
+  ex.read(&reader);
+  reader.readMessageEnd();
+  BOOST_CHECK_EQUAL(name, "method");
+  BOOST_CHECK_EQUAL(messageType, T_EXCEPTION);
+  BOOST_CHECK_EQUAL(seqid, 7);
+  BOOST_CHECK_EQUAL(ex.getType(), TApplicationException::UNKNOWN_METHOD);
+  BOOST_CHECK_EQUAL(std::string(ex.what()), "no such method");
+}
+
+template <typename In, typename Out, typename InProtocol_, typename OutProtocol_>
+static size_t countTranscodeAllocations(const std::string& input) {
+  uint8_t* data = reinterpret_cast<uint8_t*>(const_cast<char*>(input.data()));
+  auto size = static_cast<uint32_t>(input.size());
+  std::shared_ptr<TMemoryBuffer> rbuf(new TMemoryBuffer(data, size));
+  std::shared_ptr<TMemoryBuffer> wbuf(new TMemoryBuffer(size * 2));
+  TProtocolTranscoder<InProtocol_, OutProtocol_> transcoder(std::make_shared<In>(rbuf),
+                                                            std::make_shared<Out>(wbuf));
+
+  // The first message sizes the transcoder's name buffer
+  transcoder.transcodeMessage();
+
+  allocations_ = 0;
+  counting_ = true;
+  for (int i = 0; i < 10; ++i) {
+    rbuf->resetBuffer(data, size);
+    wbuf->resetBuffer();
+    transcoder.transcodeMessage();
+  }
+  counting_ = false;
+  return allocations_;
+}
+
+BOOST_AUTO_TEST_CASE(test_transcode_allocates_nothing) {
+  CompactProtoTestStruct cpts = makeCompactProtoTestStruct();
+  std::string binary = serializeCall<TBinaryProtocol>(cpts);
+  std::string compact = serializeCall<TCompactProtocol>(cpts);
+
+  BOOST_CHECK_EQUAL((countTranscodeAllocations<BinaryProtocol, CompactProtocol, BinaryProtocol,
+                                               CompactProtocol>(binary)),
+                    0u);
+  BOOST_CHECK_EQUAL((countTranscodeAllocations<CompactProtocol, BinaryProtocol, CompactProtocol,
+                                               BinaryProtocol>(compact)),
+                    0u);
+  BOOST_CHECK_EQUAL(
+      (countTranscodeAllocations<TBinaryProtocol, TCompactProtocol, TProtocol, TProtocol>(binary)),
+      0u);
+
+  HolyMoley hm = makeHolyMoley();
+  BOOST_CHECK_EQUAL((countTranscodeAllocations<CompactProtocol, BinaryProtocol, CompactProtocol,
+                                               BinaryProtocol>(serializeCall<TCompactProtocol>(hm))),
+                    0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_transcode_depth_limit) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol writer(buffer);
+  for (int i = 0; i < 20; ++i) {
+    writer.writeListBegin(T_LIST, 1);
+  }
+  writer.writeListBegin(T_I32, 0);
+  std::string data = buffer->getBufferAsString();
+
+  std::shared_ptr<TConfiguration> config(new TConfiguration(TConfiguration::DEFAULT_MAX_MESSAGE_SIZE,
+                                                            TConfiguration::DEFAULT_MAX_FRAME_SIZE,
+                                                            8));
+  std::shared_ptr<TMemoryBuffer> input(
+      new TMemoryBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(data.data())),
+                        static_cast<uint32_t>(data.size()), TMemoryBuffer::OBSERVE, config));
+  TProtocolTranscoder<> transcoder(std::make_shared<TBinaryProtocol>(input),
+                                   std::make_shared<TCompactProtocol>(std::make_shared<TMemoryBuffer>()));
+  try {
+    transcoder.transcode(T_LIST);
+    BOOST_FAIL("expected an exception");
+  } catch (const TProtocolException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TProtocolException::DEPTH_LIMIT);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_transcode_invalid_type) {
+  // A struct with field 1 of type 0x7f
+  std::string data("\x7f\x00\x01\x00", 4);
+  std::shared_ptr<TMemoryBuffer> output(new TMemoryBuffer());
+  TProtocolTranscoder<> transcoder(std::make_shared<TBinaryProtocol>(bufferOf(data)),
+                                   std::make_shared<TCompactProtocol>(output));
+  try {
+    transcoder.transcode(T_STRUCT);
+    BOOST_FAIL("expected an exception");
+  } catch (const TProtocolException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TProtocolException::INVALID_DATA);
+  }
+  BOOST_CHECK_EQUAL(output->available_read(), 0u);
+}
@@ -0,0 +1,196 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE SerializedSizeTest
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "sized/gen-cpp/DebugProtoTest_constants.h"
+#include "sized/gen-cpp/DebugProtoTest_types.h"
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TLEBinaryProtocol;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using namespace thrift::test::debug;
+
+// As in DebugProtoTest_extras.cpp, which is built against gen-cpp
+bool Empty::operator<(Empty const&) const {
+  return false;
+}
+
+/**
+ * Checks that serializedSize() is the number of bytes write() writes.
+ */
+template <typename Protocol, typename T>
+static void checkSize(const T& value) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol protocol(buffer);
+  uint32_t returned = value.write(&protocol);
+  uint32_t written = buffer->available_read();
+  BOOST_CHECK_EQUAL(value.template serializedSize<Protocol>(), written);
+  BOOST_CHECK_EQUAL(value.template serializedSize<Protocol>(), returned);
+}
+
+template <typename T>
+static void checkSizes(const T& value) {
+  checkSize<TBinaryProtocol>(value);
+  checkSize<TLEBinaryProtocol>(value);
+  checkSize<TCompactProtocol>(value);
+}
+
+static OneOfEach oneOfEach() {
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.im_false = false;
+  ooe.integer32 = -123456789;
+  ooe.integer64 = (std::numeric_limits<int64_t>::min)();
+  ooe.double_precision = M_PI;
+  ooe.some_characters = "Debug THIS!";
+  ooe.zomg_unicode = "\xd7\n\a\t";
+  ooe.base64 = std::string(300, 'b');
+  ooe.i16_list.push_back(-1);
+  ooe.i16_list.push_back(32767);
+  ooe.i64_list.push_back(1LL << 62);
+  ooe.rfc4122_uuid = apache::thrift::TUuid("5e2ab188-1726-4e75-a04f-1ed9a6a89c4c");
+  ooe.rfc4122_uuid_list.push_back(ooe.rfc4122_uuid);
+  return ooe;
+}
+
+BOOST_AUTO_TEST_CASE(test_primitives) {
+  checkSizes(Empty());
+  checkSizes(oneOfEach());
+  checkSizes(g_DebugProtoTest_constants.COMPACT_TEST);
+
+  Doubles doubles;
+  doubles.nan = std::numeric_limits<double>::quiet_NaN();
+  doubles.inf = std::numeric_limits<double>::infinity();
+  checkSizes(doubles);
+}
+
+BOOST_AUTO_TEST_CASE(test_containers_and_nesting) {
+  HolyMoley hm;
+  for (int i = 0; i < 20; ++i) {
+    hm.big.push_back(oneOfEach());
+    hm.big.back().integer32 = i * 1000;
+  }
+  std::vector<std::string> strings(3, "abc");
+  hm.contain.insert(strings);
+  hm.contain.insert(std::vector<std::string>());
+  Bonk bonk;
+  bonk.type = 31337;
+  bonk.message = std::string(200, 'm');
+  hm.bonks["nothing"];
+  hm.bonks["many"].assign(17, bonk);
+  checkSizes(hm);
+
+  RandomStuff stuff;
+  for (int i = 0; i < 300; ++i) {
+    stuff.myintlist.push_back(i * i * (i % 2 ? -1 : 1));
+    stuff.maps[i];
+  }
+  checkSizes(stuff);
+}
+
+BOOST_AUTO_TEST_CASE(test_field_ids) {
+  // Field ids that compact cannot encode as a delta from the last one
+  BigFieldIdStruct big;
+  big.field1 = "one";
+  big.field2 = "forty-five";
+  BreaksRubyCompactProtocol breaks;
+  breaks.field2 = big;
+  breaks.field3 = 3;
+  checkSizes(breaks);
+
+  Backwards backwards;
+  backwards.first_tag2 = 2;
+  backwards.second_tag1 = 1;
+  checkSizes(backwards);
+
+  TupleProtocolTestStruct tuple;
+  tuple.__set_field1(1);
+  tuple.__set_field12(-12);
+  checkSizes(tuple);
+}
+
+BOOST_AUTO_TEST_CASE(test_unions_and_exceptions) {
+  TestUnion test;
+  checkSizes(test);
+  test.__set_struct_field(oneOfEach());
+  checkSizes(test);
+  StructWithAUnion withUnion;
+  withUnion.test_union = test;
+  checkSizes(withUnion);
+
+  ExceptionWithAMap exception;
+  exception.blah = "blah";
+  exception.map_field["key"] = "value";
+  checkSizes(exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_memory_buffer_reserve) {
+  HolyMoley hm;
+  hm.big.assign(100, oneOfEach());
+  uint32_t size = hm.serializedSize<TBinaryProtocol>();
+
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(16));
+  buffer->write(reinterpret_cast<const uint8_t*>("0123"), 4);
+  buffer->reserve(size);
+  BOOST_CHECK_EQUAL(buffer->getBufferSize(), size + 4);
+  uint8_t* data = buffer->getWritePtr(0);
+
+  // Writing the struct fills the buffer without growing it again
+  TBinaryProtocol protocol(buffer);
+  hm.write(&protocol);
+  BOOST_CHECK_EQUAL(buffer->getBufferSize(), size + 4);
+  BOOST_CHECK_EQUAL(buffer->available_write(), 0u);
+  BOOST_CHECK(buffer->getWritePtr(0) == data + size);
+
+  // Reserving what is already there does not reallocate
+  buffer->resetBuffer();
+  buffer->reserve(size);
+  BOOST_CHECK_EQUAL(buffer->getBufferSize(), size + 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_framed_transport_reserve) {
+  HolyMoley hm;
+  hm.big.assign(100, oneOfEach());
+  uint32_t size = hm.serializedSize<TCompactProtocol>();
+
+  std::shared_ptr<TMemoryBuffer> sink(new TMemoryBuffer());
+  std::shared_ptr<TFramedTransport> framed(new TFramedTransport(sink));
+  framed->reserve(size);
+  TCompactProtocol protocol(framed);
+  hm.write(&protocol);
+  framed->flush();
+
+  BOOST_CHECK_EQUAL(sink->available_read(), size + 4);
+  uint8_t* frame;
+  uint32_t length;
+  sink->getBuffer(&frame, &length);
+  BOOST_CHECK_EQUAL((frame[0] << 24) | (frame[1] << 16) | (frame[2] << 8) | frame[3],
+                    static_cast<int>(size));
+}
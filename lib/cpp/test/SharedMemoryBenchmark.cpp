@@ -0,0 +1,180 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <thrift/transport/TServerSocket.h>
+#include <thrift/transport/TSharedMemoryServerTransport.h>
+#include <thrift/transport/TSharedMemoryTransport.h>
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+using namespace apache::thrift::transport;
+
+class Timer {
+public:
+  timeval vStart;
+
+  Timer() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+  void start() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+
+  double frame() {
+    timeval vEnd;
+    THRIFT_GETTIMEOFDAY(&vEnd, nullptr);
+    double dstart = vStart.tv_sec + ((double)vStart.tv_usec / 1000000.0);
+    double dend = vEnd.tv_sec + ((double)vEnd.tv_usec / 1000000.0);
+    return dend - dstart;
+  }
+};
+
+typedef std::function<std::shared_ptr<TTransport>()> ClientFactory;
+
+/**
+ * Sends num messages of size bytes to a thread that echoes each one back,
+ * waiting for each echo before sending the next: the round trip of a small
+ * request and response.
+ */
+static double pingPong(TServerTransport& server,
+                       const ClientFactory& connect,
+                       uint32_t size,
+                       int num) {
+  std::shared_ptr<TTransport> client = connect();
+  client->open();
+  std::shared_ptr<TTransport> accepted = server.accept();
+  std::thread echo([&] {
+    std::vector<uint8_t> buf(size);
+    for (int i = 0; i < num; ++i) {
+      accepted->readAll(buf.data(), size);
+      accepted->write(buf.data(), size);
+      accepted->flush();
+    }
+  });
+
+  std::vector<uint8_t> buf(size, 'x');
+  Timer timer;
+  for (int i = 0; i < num; ++i) {
+    client->write(buf.data(), size);
+    client->flush();
+    client->readAll(buf.data(), size);
+  }
+  double elapsed = timer.frame();
+  echo.join();
+  client->close();
+  accepted->close();
+  return elapsed;
+}
+
+/**
+ * Streams num messages of size bytes one way, then waits for a single byte
+ * back once the reader has them all.
+ */
+static double stream(TServerTransport& server,
+                     const ClientFactory& connect,
+                     uint32_t size,
+                     int num) {
+  std::shared_ptr<TTransport> client = connect();
+  client->open();
+  std::shared_ptr<TTransport> accepted = server.accept();
+  std::thread reader([&] {
+    std::vector<uint8_t> buf(size);
+    for (int i = 0; i < num; ++i) {
+      accepted->readAll(buf.data(), size);
+    }
+    accepted->write(buf.data(), 1);
+    accepted->flush();
+  });
+
+  std::vector<uint8_t> buf(size, 'x');
+  Timer timer;
+  for (int i = 0; i < num; ++i) {
+    client->write(buf.data(), size);
+  }
+  client->flush();
+  client->readAll(buf.data(), 1);
+  double elapsed = timer.frame();
+  reader.join();
+  client->close();
+  accepted->close();
+  return elapsed;
+}
+
+static void run(const char* label, TServerTransport& server, const ClientFactory& connect) {
+  server.listen();
+  std::cout << label << ":\n";
+  const uint32_t sizes[] = {64, 4096};
+  for (uint32_t size : sizes) {
+    int num = 20000;
+    double elapsed = pingPong(server, connect, size, num);
+    std::cout << "  " << size << " byte round trip: " << elapsed * 1000000 / num << " us, "
+              << num / elapsed << " round trips/sec\n";
+  }
+  int num = 4000;
+  uint32_t size = 64 * 1024;
+  double elapsed = stream(server, connect, size, num);
+  std::cout << "  " << size << " byte stream: "
+            << static_cast<double>(size) * num / (1024 * 1024) / elapsed << " MB/sec\n";
+  server.close();
+}
+
+/*
+ * Compares TSharedMemoryTransport with TSocket over loopback TCP and over a
+ * UNIX domain socket, between two threads of this process.
+ */
+int main() {
+  std::string path = std::string(1, '\0') + "thrift-shm-benchmark-" + std::to_string(getpid());
+
+  TServerSocket tcpServer("localhost", 0);
+  run("TSocket, loopback TCP", tcpServer, [&tcpServer] {
+    std::shared_ptr<TSocket> socket(new TSocket("localhost", tcpServer.getPort()));
+    socket->setNoDelay(true);
+    return socket;
+  });
+
+  TServerSocket unixServer(path + "-unix");
+  run("TSocket, UNIX domain socket", unixServer, [&path] {
+    return std::make_shared<TSocket>(path + "-unix");
+  });
+
+  TSharedMemoryServerTransport shmServer(path + "-shm");
+  run("TSharedMemoryTransport", shmServer, [&path] {
+    return std::make_shared<TSharedMemoryTransport>(path + "-shm");
+  });
+
+  // Only worth it with a CPU for each side
+  if (std::thread::hardware_concurrency() > 1) {
+    TSharedMemoryServerTransport spinServer(path + "-spin");
+    run("TSharedMemoryTransport, spinning", spinServer, [&path] {
+      std::shared_ptr<TSharedMemoryTransport> transport(
+          new TSharedMemoryTransport(path + "-spin"));
+      transport->setSpinCount(2000);
+      return transport;
+    });
+  }
+  return 0;
+}
@@ -0,0 +1,433 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE SharedMemoryTransportTest
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/server/TNonblockingServer.h>
+#include <thrift/server/TThreadedServer.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TNonblockingSharedMemoryServerTransport.h>
+#include <thrift/transport/TSharedMemoryServerTransport.h>
+#include <thrift/transport/TSharedMemoryTransport.h>
+
+#include "gen-cpp/ParentService.h"
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::server::TNonblockingServer;
+using apache::thrift::server::TServerEventHandler;
+using apache::thrift::server::TThreadedServer;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TNonblockingSharedMemoryServerTransport;
+using apache::thrift::transport::TSharedMemoryServerTransport;
+using apache::thrift::transport::TSharedMemoryTransport;
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+using std::shared_ptr;
+using std::vector;
+
+// A fresh name in the abstract namespace, so nothing is left on disk
+static std::string socketPath() {
+  static int count = 0;
+  return std::string(1, '\0') + "thrift-shm-test-" + std::to_string(getpid()) + "-"
+         + std::to_string(++count);
+}
+
+static vector<uint8_t> makePayload(uint32_t size) {
+  vector<uint8_t> payload(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    payload[i] = static_cast<uint8_t>(i * 31 + (i >> 9));
+  }
+  return payload;
+}
+
+// Sends descriptors the way a client sends its shared memory
+static void sendDescriptors(int socket, const int* fds, int count) {
+  char byte = 0;
+  struct iovec iov;
+  iov.iov_base = &byte;
+  iov.iov_len = 1;
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int) * 3)];
+  } control;
+  std::memset(&control, 0, sizeof(control));
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+  std::memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+  BOOST_REQUIRE_EQUAL(sendmsg(socket, &msg, MSG_NOSIGNAL), 1);
+}
+
+struct Handler : public apache::thrift::test::ParentServiceIf {
+  void addString(const std::string& s) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    strings_.push_back(s);
+  }
+  void getStrings(std::vector<std::string>& _return) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    _return = strings_;
+  }
+  std::mutex mutex_;
+  std::vector<std::string> strings_;
+
+  // dummy overrides not used in this test
+  int32_t incrementGeneration() override { return 0; }
+  int32_t getGeneration() override { return 0; }
+  void getDataWait(std::string&, const int32_t) override {}
+  void onewayWait() override {}
+  void exceptionWait(const std::string&) override {}
+  void unexpectedExceptionWait(const std::string&) override {}
+};
+
+struct ReadyHandler : public TServerEventHandler {
+  ReadyHandler() : ready_(false) {}
+
+  void preServe() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ready_ = true;
+    cond_.notify_all();
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return ready_; });
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool ready_;
+};
+
+// Calls the service through the transport, which is opened here
+static void checkService(const shared_ptr<TTransport>& transport) {
+  shared_ptr<TBinaryProtocol> protocol(new TBinaryProtocol(transport));
+  apache::thrift::test::ParentServiceClient client(protocol);
+  transport->open();
+  std::string large(1024 * 1024, 'x');
+  client.addString("first");
+  client.addString(large);
+  vector<std::string> strings;
+  client.getStrings(strings);
+  BOOST_REQUIRE_EQUAL(strings.size(), 2u);
+  BOOST_CHECK_EQUAL(strings[0], "first");
+  BOOST_CHECK(strings[1] == large);
+  transport->close();
+}
+
+BOOST_AUTO_TEST_CASE(test_round_trip) {
+  std::string path = socketPath();
+  TSharedMemoryServerTransport server(path);
+  server.listen();
+  shared_ptr<TSharedMemoryTransport> client(new TSharedMemoryTransport(path, 4096));
+  client->open();
+  shared_ptr<TTransport> accepted = server.accept();
+  BOOST_REQUIRE(accepted->isOpen());
+  BOOST_CHECK_EQUAL(std::static_pointer_cast<TSharedMemoryTransport>(accepted)->getRingSize(),
+                    4096u);
+
+  // Enough small messages to go round the ring many times
+  uint8_t buf[1000];
+  for (uint32_t i = 0; i < 100; ++i) {
+    vector<uint8_t> request = makePayload(100 + i * 9);
+    client->write(request.data(), static_cast<uint32_t>(request.size()));
+    BOOST_CHECK(accepted->peek());
+    accepted->readAll(buf, static_cast<uint32_t>(request.size()));
+    BOOST_REQUIRE(std::equal(request.begin(), request.end(), buf));
+    accepted->write(buf, static_cast<uint32_t>(request.size()) / 2);
+    BOOST_CHECK_EQUAL(client->read(buf, sizeof(buf)), request.size() / 2);
+  }
+  client->close();
+  server.close();
+}
+
+BOOST_AUTO_TEST_CASE(test_larger_than_ring) {
+  std::string path = socketPath();
+  TSharedMemoryServerTransport server(path);
+  server.listen();
+  shared_ptr<TSharedMemoryTransport> client(new TSharedMemoryTransport(path, 4096));
+  client->setSpinCount(100);
+  client->open();
+  shared_ptr<TTransport> accepted = server.accept();
+
+  // The writer waits for the reader to make room, then the other way round
+  vector<uint8_t> payload = makePayload(1024 * 1024 + 7);
+  auto size = static_cast<uint32_t>(payload.size());
+  vector<uint8_t> received(payload.size());
+  std::thread writer([&] { client->write(payload.data(), size); });
+  accepted->readAll(received.data(), size);
+  writer.join();
+  BOOST_CHECK(received == payload);
+
+  std::fill(received.begin(), received.end(), 0);
+  std::thread reader([&] { client->readAll(received.data(), size); });
+  accepted->write(payload.data(), size);
+  reader.join();
+  BOOST_CHECK(received == payload);
+  server.close();
+}
+
+BOOST_AUTO_TEST_CASE(test_peer_close) {
+  std::string path = socketPath();
+  TSharedMemoryServerTransport server(path);
+  server.listen();
+  shared_ptr<TSharedMemoryTransport> client(new TSharedMemoryTransport(path));
+  client->open();
+  shared_ptr<TTransport> accepted = server.accept();
+
+  // What was written before the close is still read
+  client->write(reinterpret_cast<const uint8_t*>("bye"), 3);
+  client->close();
+  uint8_t buf[8];
+  BOOST_CHECK_EQUAL(accepted->read(buf, sizeof(buf)), 3u);
+  BOOST_CHECK_EQUAL(accepted->read(buf, sizeof(buf)), 0u);
+  BOOST_CHECK(!accepted->peek());
+
+  // Writes fill the ring, then find the peer gone
+  vector<uint8_t> payload = makePayload(TSharedMemoryTransport::DEFAULT_RING_SIZE + 1);
+  BOOST_CHECK_THROW(accepted->write(payload.data(), static_cast<uint32_t>(payload.size())),
+                    TTransportException);
+  server.close();
+}
+
+BOOST_AUTO_TEST_CASE(test_read_timeout) {
+  std::string path = socketPath();
+  TSharedMemoryServerTransport server(path);
+  server.listen();
+  shared_ptr<TSharedMemoryTransport> client(new TSharedMemoryTransport(path));
+  client->setRecvTimeout(50);
+  client->open();
+  shared_ptr<TTransport> accepted = server.accept();
+
+  uint8_t buf[8];
+  try {
+    client->read(buf, sizeof(buf));
+    BOOST_ERROR("read did not time out");
+  } catch (TTransportException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TTransportException::TIMED_OUT);
+  }
+  server.close();
+}
+
+BOOST_AUTO_TEST_CASE(test_bad_clients) {
+  BOOST_CHECK_THROW(TSharedMemoryTransport("x", 5000), TTransportException);
+  BOOST_CHECK_THROW(TSharedMemoryTransport("x", 2048), TTransportException);
+
+  // A plain socket never sends the shared memory
+  std::string path = socketPath();
+  TSharedMemoryServerTransport server(path);
+  server.setHandshakeTimeout(50);
+  server.listen();
+  TSocket socket(path);
+  socket.open();
+  try {
+    server.accept();
+    BOOST_ERROR("accepted a client without shared memory");
+  } catch (TTransportException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TTransportException::TIMED_OUT);
+  }
+
+  TSocket other(path);
+  other.open();
+  other.write(reinterpret_cast<const uint8_t*>("x"), 1);
+  try {
+    server.accept();
+    BOOST_ERROR("accepted a client without shared memory");
+  } catch (TTransportException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TTransportException::CLIENT_DISCONNECT);
+  }
+
+  // Memory the client could still truncate under the server's mapping
+  TSocket unsealed(path);
+  unsealed.open();
+  int fds[3] = {memfd_create("thrift-shm-test", MFD_CLOEXEC),
+                eventfd(0, EFD_CLOEXEC),
+                eventfd(0, EFD_CLOEXEC)};
+  BOOST_REQUIRE_EQUAL(ftruncate(fds[0], 1024 * 1024), 0);
+  sendDescriptors(unsealed.getSocketFD(), fds, 3);
+  for (int fd : fds) {
+    ::close(fd);
+  }
+  try {
+    server.accept();
+    BOOST_ERROR("accepted shared memory that is not sealed");
+  } catch (TTransportException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TTransportException::CLIENT_DISCONNECT);
+  }
+
+  // A pipe nobody reads would hold up the server when it wakes the client
+  TSocket piped(path);
+  piped.open();
+  int pipeFds[2];
+  BOOST_REQUIRE_EQUAL(pipe(pipeFds), 0);
+  fds[0] = memfd_create("thrift-shm-test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  BOOST_REQUIRE_EQUAL(ftruncate(fds[0], 1024 * 1024), 0);
+  BOOST_REQUIRE_EQUAL(fcntl(fds[0], F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL), 0);
+  fds[1] = pipeFds[1];
+  fds[2] = eventfd(0, EFD_CLOEXEC);
+  sendDescriptors(piped.getSocketFD(), fds, 3);
+  for (int fd : fds) {
+    ::close(fd);
+  }
+  ::close(pipeFds[0]);
+  try {
+    server.accept();
+    BOOST_ERROR("accepted a pipe to wake the client");
+  } catch (TTransportException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TTransportException::CLIENT_DISCONNECT);
+    BOOST_CHECK(std::strstr(ex.what(), "eventfd") != nullptr);
+  }
+
+  TSharedMemoryTransport closed(path);
+  uint8_t buf[1];
+  BOOST_CHECK_THROW(closed.read(buf, 1), TTransportException);
+  BOOST_CHECK_THROW(closed.write(buf, 1), TTransportException);
+  server.close();
+}
+
+BOOST_AUTO_TEST_CASE(test_threaded_server) {
+  std::string path = socketPath();
+  shared_ptr<TSharedMemoryServerTransport> serverTransport(new TSharedMemoryServerTransport(path));
+  shared_ptr<ReadyHandler> ready(new ReadyHandler());
+  TThreadedServer server(std::make_shared<apache::thrift::test::ParentServiceProcessor>(
+                             std::make_shared<Handler>()),
+                         serverTransport,
+                         std::make_shared<apache::thrift::transport::TTransportFactory>(),
+                         std::make_shared<apache::thrift::protocol::TBinaryProtocolFactory>());
+  server.setServerEventHandler(ready);
+  std::thread serving([&] { server.serve(); });
+  ready->wait();
+
+  checkService(shared_ptr<TTransport>(new TSharedMemoryTransport(path)));
+
+  // A client that is still connected does not hold up stop()
+  shared_ptr<TSharedMemoryTransport> idle(new TSharedMemoryTransport(path));
+  idle->open();
+  server.stop();
+  serving.join();
+}
+
+BOOST_AUTO_TEST_CASE(test_nonblocking_server) {
+  std::string path = socketPath();
+  shared_ptr<TNonblockingSharedMemoryServerTransport> serverTransport(
+      new TNonblockingSharedMemoryServerTransport(path));
+  shared_ptr<ReadyHandler> ready(new ReadyHandler());
+  TNonblockingServer server(std::make_shared<apache::thrift::test::ParentServiceProcessor>(
+                                std::make_shared<Handler>()),
+                            serverTransport);
+  server.setServerEventHandler(ready);
+  std::thread serving([&] { server.serve(); });
+  ready->wait();
+
+  // A client that never sends its shared memory does not hold up the others
+  TSocket silent(path);
+  silent.open();
+  {
+    auto start = std::chrono::steady_clock::now();
+    shared_ptr<TBinaryProtocol> protocol(new TBinaryProtocol(
+        std::make_shared<TFramedTransport>(std::make_shared<TSharedMemoryTransport>(path))));
+    apache::thrift::test::ParentServiceClient client(protocol);
+    protocol->getTransport()->open();
+    vector<std::string> strings;
+    client.getStrings(strings);
+    protocol->getTransport()->close();
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+  }
+
+  // Several clients at once, each taking turns with the others
+  vector<std::thread> clients;
+  for (int i = 0; i < 4; ++i) {
+    clients.emplace_back([&path] {
+      shared_ptr<TBinaryProtocol> protocol(new TBinaryProtocol(
+          std::make_shared<TFramedTransport>(std::make_shared<TSharedMemoryTransport>(path))));
+      apache::thrift::test::ParentServiceClient client(protocol);
+      protocol->getTransport()->open();
+      for (int j = 0; j < 200; ++j) {
+        client.addString(std::string(j * 50, 'y'));
+      }
+      protocol->getTransport()->close();
+    });
+  }
+  for (std::thread& client : clients) {
+    client.join();
+  }
+
+  shared_ptr<TBinaryProtocol> protocol(new TBinaryProtocol(
+      std::make_shared<TFramedTransport>(std::make_shared<TSharedMemoryTransport>(path))));
+  apache::thrift::test::ParentServiceClient client(protocol);
+  protocol->getTransport()->open();
+  vector<std::string> strings;
+  client.getStrings(strings);
+  BOOST_CHECK_EQUAL(strings.size(), 800u);
+
+  // A client that does not read its responses does not hold up the others,
+  // and gets them all once it does, requests sent meanwhile included
+  std::string large(TSharedMemoryTransport::DEFAULT_RING_SIZE, 'z');
+  client.addString(large);
+  shared_ptr<TBinaryProtocol> slowProtocol(new TBinaryProtocol(
+      std::make_shared<TFramedTransport>(std::make_shared<TSharedMemoryTransport>(path))));
+  apache::thrift::test::ParentServiceClient slow(slowProtocol);
+  slowProtocol->getTransport()->open();
+  slow.send_getStrings();
+  slow.send_getStrings();
+  client.getStrings(strings);
+  BOOST_CHECK_EQUAL(strings.size(), 801u);
+  for (int i = 0; i < 2; ++i) {
+    vector<std::string> slowStrings;
+    slow.recv_getStrings(slowStrings);
+    BOOST_REQUIRE_EQUAL(slowStrings.size(), 801u);
+    BOOST_CHECK(slowStrings[800] == large);
+  }
+  slowProtocol->getTransport()->close();
+  protocol->getTransport()->close();
+
+  // A plain socket is dropped without stopping the server
+  TSocket socket(path);
+  socket.open();
+  socket.write(reinterpret_cast<const uint8_t*>("x"), 1);
+  uint8_t buf[1];
+  BOOST_CHECK_EQUAL(socket.read(buf, 1), 0u);
+
+  server.stop();
+  serving.join();
+}
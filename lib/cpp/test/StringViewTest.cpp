@@ -0,0 +1,178 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <memory>
+#include <string>
+#include <thrift/TStringView.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/StringViewTest_types.h"
+
+#define BOOST_TEST_MODULE StringViewTest
+#include <boost/test/unit_test.hpp>
+
+using apache::thrift::TStringView;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransport;
+using thrift::test::views::Blob;
+
+static Blob makeBlob() {
+  Blob blob;
+  blob.__set_name("blob name");
+  blob.__set_payload(std::string("\x00\x01\x02\xff payload", 13));
+  blob.tags.push_back("first");
+  blob.tags.push_back("");
+  blob.tags.push_back("third");
+  blob.attachments["a"] = "attachment a";
+  blob.attachments["b"] = std::string(1000, 'b');
+  blob.__set_comment("a comment");
+  blob.__set_plain("plain std::string");
+  return blob;
+}
+
+static void checkBlob(const Blob& blob) {
+  Blob expected = makeBlob();
+  BOOST_CHECK_EQUAL(blob.name, expected.name);
+  BOOST_CHECK(blob.payload == expected.payload);
+  BOOST_CHECK(blob.tags == expected.tags);
+  BOOST_CHECK(blob.attachments == expected.attachments);
+  BOOST_CHECK(blob.__isset.comment);
+  BOOST_CHECK_EQUAL(blob.comment, expected.comment);
+  BOOST_CHECK_EQUAL(blob.plain, expected.plain);
+  BOOST_CHECK(blob == expected);
+}
+
+template <typename Protocol_>
+static void roundTrip(bool expectBorrowed) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ oprot(buffer);
+  makeBlob().write(&oprot);
+
+  std::shared_ptr<TTransport> trans = buffer;
+  if (!expectBorrowed) {
+    // TBufferedTransport only lends what is in its own, smaller buffer
+    trans.reset(new TBufferedTransport(buffer, 16));
+  }
+  Protocol_ iprot(trans);
+  Blob blob;
+  blob.read(&iprot);
+  checkBlob(blob);
+
+  BOOST_CHECK_EQUAL(blob.name.owned(), !expectBorrowed);
+  BOOST_CHECK_EQUAL(blob.payload.owned(), !expectBorrowed);
+  BOOST_CHECK_EQUAL(blob.attachments["b"].owned(), !expectBorrowed);
+  if (expectBorrowed) {
+    // The value points into the buffer the message was read from
+    uint8_t* base;
+    uint32_t len;
+    buffer->getBuffer(&base, &len);
+    const char* begin = reinterpret_cast<const char*>(base) - buffer->readEnd();
+    BOOST_CHECK(blob.name.data() >= begin);
+    BOOST_CHECK(blob.name.data() < reinterpret_cast<const char*>(base) + len);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_borrows) {
+  roundTrip<TBinaryProtocol>(true);
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_borrows) {
+  roundTrip<TCompactProtocol>(true);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_copies_without_borrow) {
+  roundTrip<TBinaryProtocol>(false);
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_copies_without_borrow) {
+  roundTrip<TCompactProtocol>(false);
+}
+
+BOOST_AUTO_TEST_CASE(test_json_copies) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TJSONProtocol oprot(buffer);
+  makeBlob().write(&oprot);
+
+  TJSONProtocol iprot(buffer);
+  Blob blob;
+  blob.read(&iprot);
+  checkBlob(blob);
+  BOOST_CHECK(blob.name.owned());
+  BOOST_CHECK(blob.payload.owned());
+}
+
+BOOST_AUTO_TEST_CASE(test_borrowed_copy_to_string) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol oprot(buffer);
+  makeBlob().write(&oprot);
+
+  TBinaryProtocol iprot(buffer);
+  Blob blob;
+  blob.read(&iprot);
+  std::string name = blob.name.str();
+
+  // Reusing the read buffer invalidates borrowed values, but not copies
+  buffer->resetBuffer();
+  std::string overwrite(256, 'x');
+  buffer->write(reinterpret_cast<const uint8_t*>(overwrite.data()),
+                static_cast<uint32_t>(overwrite.size()));
+  BOOST_CHECK_EQUAL(name, "blob name");
+}
+
+BOOST_AUTO_TEST_CASE(test_string_view_basics) {
+  TStringView empty;
+  BOOST_CHECK(empty.empty());
+  BOOST_CHECK(empty.owned());
+  BOOST_CHECK_EQUAL(empty.str(), "");
+  BOOST_CHECK(empty == TStringView(""));
+
+  std::string source = "hello";
+  TStringView owned(source);
+  source[0] = 'j';
+  BOOST_CHECK(owned.owned());
+  BOOST_CHECK_EQUAL(owned.str(), "hello");
+
+  TStringView borrowed = TStringView::borrow(reinterpret_cast<const uint8_t*>(source.data()),
+                                             static_cast<uint32_t>(source.size()));
+  BOOST_CHECK(!borrowed.owned());
+  BOOST_CHECK_EQUAL(borrowed.str(), "jello");
+  BOOST_CHECK(borrowed.data() == source.data());
+
+  TStringView copy = owned;
+  BOOST_CHECK(copy.data() == owned.data());
+  BOOST_CHECK(copy == owned);
+  BOOST_CHECK(owned != borrowed);
+  BOOST_CHECK(owned < borrowed);
+  BOOST_CHECK(TStringView("hell") < owned);
+  BOOST_CHECK_EQUAL(owned.compare(TStringView("hello")), 0);
+
+  copy.swap(borrowed);
+  BOOST_CHECK_EQUAL(copy.str(), "jello");
+  BOOST_CHECK_EQUAL(borrowed.str(), "hello");
+  copy.clear();
+  BOOST_CHECK(copy.empty());
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(borrowed), "hello");
+}
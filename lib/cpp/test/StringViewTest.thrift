@@ -0,0 +1,38 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// Generated with cpp:string_views by StringViewTest
+
+namespace cpp thrift.test.views
+
+typedef string Name
+
+struct Blob {
+  1: string name
+  2: binary payload
+  3: list<string> tags
+  4: map<Name, binary> attachments
+  5: optional string comment = "none"
+  6: string (cpp.type = "std::string") plain
+}
+
+service BlobStore {
+  binary fetch(1: string key)
+  void store(1: string key, 2: Blob blob)
+}
@@ -0,0 +1,231 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE THeaderTransportTest
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <thrift/TApplicationException.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/THeaderTransport.h>
+
+using apache::thrift::TApplicationException;
+using apache::thrift::transport::THeaderTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransportException;
+using std::shared_ptr;
+using std::vector;
+
+// Offset of the transform count in a frame: the frame size, magic, flags,
+// sequence id and header size, then the protocol id as a one byte varint
+static const uint32_t TRANSFORM_COUNT_OFFSET = 15;
+
+static const uint16_t TRANSFORMS[] = {THeaderTransport::ZLIB_TRANSFORM,
+                                      THeaderTransport::ZSTD_TRANSFORM,
+                                      THeaderTransport::LZ4_TRANSFORM};
+
+// Something like a serialized message: repetitive, but not a single byte
+static vector<uint8_t> makePayload(uint32_t size, uint32_t seed) {
+  vector<uint8_t> payload(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    payload[i] = static_cast<uint8_t>((i % 64 < 48) ? "field value "[i % 12] : (i * seed) >> 3);
+  }
+  return payload;
+}
+
+static void writeMessage(THeaderTransport& writer, const vector<uint8_t>& payload) {
+  writer.write(payload.data(), static_cast<uint32_t>(payload.size()));
+  writer.flush();
+}
+
+static void checkMessage(THeaderTransport& reader, const vector<uint8_t>& payload) {
+  vector<uint8_t> out(payload.size());
+  reader.readAll(out.data(), static_cast<uint32_t>(out.size()));
+  reader.readEnd();
+  BOOST_CHECK(out == payload);
+}
+
+BOOST_AUTO_TEST_CASE(test_transforms_round_trip) {
+  for (uint16_t transId : TRANSFORMS) {
+    if (!THeaderTransport::isTransformSupported(transId)) {
+      BOOST_TEST_MESSAGE("transform " << transId << " is not built in");
+      continue;
+    }
+    shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    THeaderTransport writer(buffer);
+    THeaderTransport reader(buffer);
+    writer.setTransform(transId);
+
+    // The same writer and reader keep their contexts across messages
+    vector<vector<uint8_t> > payloads;
+    for (uint32_t i = 0; i < 8; ++i) {
+      payloads.push_back(makePayload(100 + i * 997, i + 1));
+    }
+    for (const vector<uint8_t>& payload : payloads) {
+      uint32_t before = buffer->available_read();
+      writeMessage(writer, payload);
+      BOOST_CHECK_LT(buffer->available_read() - before, payload.size());
+    }
+    for (const vector<uint8_t>& payload : payloads) {
+      checkMessage(reader, payload);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_compression_level) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  THeaderTransport writer(buffer);
+  THeaderTransport reader(buffer);
+  writer.setTransform(THeaderTransport::ZLIB_TRANSFORM, 0, 1);
+  writer.setTransform(THeaderTransport::ZLIB_TRANSFORM, 0, 9);
+  vector<uint8_t> payload = makePayload(20000, 3);
+
+  // Both transforms keep their own level from one message to the next
+  writeMessage(writer, payload);
+  writeMessage(writer, payload);
+  checkMessage(reader, payload);
+  checkMessage(reader, payload);
+}
+
+BOOST_AUTO_TEST_CASE(test_compression_level_per_transform) {
+  if (!THeaderTransport::isTransformSupported(THeaderTransport::ZSTD_TRANSFORM)) {
+    BOOST_TEST_MESSAGE("transform " << THeaderTransport::ZSTD_TRANSFORM << " is not built in");
+    return;
+  }
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  THeaderTransport writer(buffer);
+  THeaderTransport reader(buffer);
+  // A zstd level that zlib does not take
+  writer.setTransform(THeaderTransport::ZSTD_TRANSFORM, 0, 19);
+  writer.setTransform(THeaderTransport::ZLIB_TRANSFORM);
+  vector<uint8_t> payload = makePayload(20000, 3);
+
+  writeMessage(writer, payload);
+  checkMessage(reader, payload);
+}
+
+BOOST_AUTO_TEST_CASE(test_transform_min_size) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  THeaderTransport writer(buffer);
+  THeaderTransport reader(buffer);
+  writer.setTransform(THeaderTransport::ZLIB_TRANSFORM, 1024);
+
+  vector<uint8_t> small = makePayload(1023, 1);
+  writeMessage(writer, small);
+  BOOST_CHECK_EQUAL(buffer->getBufferAsString()[TRANSFORM_COUNT_OFFSET], 0);
+  checkMessage(reader, small);
+
+  vector<uint8_t> large = makePayload(1024, 2);
+  writeMessage(writer, large);
+  BOOST_CHECK_EQUAL(buffer->getBufferAsString()[TRANSFORM_COUNT_OFFSET], 1);
+  checkMessage(reader, large);
+}
+
+BOOST_AUTO_TEST_CASE(test_large_payload) {
+  // Expands to many times the size of the buffers the reader starts with
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  THeaderTransport writer(buffer);
+  THeaderTransport reader(buffer);
+  writer.setTransform(THeaderTransport::ZLIB_TRANSFORM);
+  vector<uint8_t> payload(4 * 1024 * 1024, 'x');
+
+  writeMessage(writer, payload);
+  BOOST_CHECK_LT(buffer->available_read(), 64 * 1024);
+  checkMessage(reader, payload);
+}
+
+BOOST_AUTO_TEST_CASE(test_incompressible_payload) {
+  // Comes out of the transform larger than the write buffer it went in from
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  THeaderTransport writer(buffer);
+  THeaderTransport reader(buffer);
+  writer.setTransform(THeaderTransport::ZLIB_TRANSFORM);
+  vector<uint8_t> payload(512 * 1024);
+  uint32_t state = 12345;
+  for (uint8_t& byte : payload) {
+    state = state * 1103515245 + 12345;
+    byte = static_cast<uint8_t>(state >> 24);
+  }
+
+  writeMessage(writer, payload);
+  checkMessage(reader, payload);
+}
+
+BOOST_AUTO_TEST_CASE(test_oversized_after_transform) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  THeaderTransport writer(buffer);
+  THeaderTransport reader(buffer);
+  writer.setTransform(THeaderTransport::ZLIB_TRANSFORM);
+  writeMessage(writer, vector<uint8_t>(1024 * 1024, 0));
+
+  reader.setMaxFrameSize(64 * 1024);
+  uint8_t out[1];
+  BOOST_CHECK_THROW(reader.read(out, sizeof(out)), TTransportException);
+}
+
+BOOST_AUTO_TEST_CASE(test_unknown_transform) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  THeaderTransport writer(buffer);
+  writer.setTransform(0x7f);
+  writer.write(reinterpret_cast<const uint8_t*>("abc"), 3);
+  BOOST_CHECK_THROW(writer.flush(), TTransportException);
+  BOOST_CHECK(!THeaderTransport::isTransformSupported(0x7f));
+
+  // A frame that names a transform the reader does not have
+  THeaderTransport zlibWriter(buffer);
+  zlibWriter.setTransform(THeaderTransport::ZLIB_TRANSFORM);
+  writeMessage(zlibWriter, makePayload(100, 1));
+  std::string frame = buffer->getBufferAsString();
+  frame[TRANSFORM_COUNT_OFFSET + 1] = 0x7f;
+  shared_ptr<TMemoryBuffer> corrupt(new TMemoryBuffer());
+  corrupt->write(reinterpret_cast<const uint8_t*>(frame.data()),
+                 static_cast<uint32_t>(frame.size()));
+  THeaderTransport reader(corrupt);
+  uint8_t out[1];
+  BOOST_CHECK_THROW(reader.read(out, sizeof(out)), TApplicationException);
+}
+
+BOOST_AUTO_TEST_CASE(test_corrupt_payload) {
+  for (uint16_t transId : TRANSFORMS) {
+    if (!THeaderTransport::isTransformSupported(transId)) {
+      continue;
+    }
+    shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    THeaderTransport writer(buffer);
+    writer.setTransform(transId);
+    writeMessage(writer, makePayload(4000, 5));
+
+    // Cut the compressed payload short
+    std::string frame = buffer->getBufferAsString();
+    frame.resize(frame.size() - 16);
+    uint32_t size = static_cast<uint32_t>(frame.size() - 4);
+    frame[0] = static_cast<char>(size >> 24);
+    frame[1] = static_cast<char>(size >> 16);
+    frame[2] = static_cast<char>(size >> 8);
+    frame[3] = static_cast<char>(size);
+    shared_ptr<TMemoryBuffer> corrupt(new TMemoryBuffer());
+    corrupt->write(reinterpret_cast<const uint8_t*>(frame.data()),
+                   static_cast<uint32_t>(frame.size()));
+    THeaderTransport reader(corrupt);
+    uint8_t out[1];
+    BOOST_CHECK_THROW(reader.read(out, sizeof(out)), TApplicationException);
+  }
+}
@@ -20,9 +20,12 @@
 #define BOOST_TEST_MODULE TNonblockingServerTest
 #include <boost/test/unit_test.hpp>
 #include <memory>
+#include <stdexcept>
+#include <thread>
 
 #include "thrift/concurrency/Monitor.h"
 #include "thrift/concurrency/Thread.h"
+#include "thrift/concurrency/ThreadManager.h"
 #include "thrift/server/TNonblockingServer.h"
 #include "thrift/transport/TNonblockingServerSocket.h"
 
@@ -37,6 +40,7 @@ using apache::thrift::concurrency::ThreadFactory;
 using apache::thrift::concurrency::Runnable;
 using apache::thrift::concurrency::Thread;
 using apache::thrift::concurrency::ThreadFactory;
+using apache::thrift::concurrency::ThreadManager;
 using apache::thrift::server::TServerEventHandler;
 using std::make_shared;
 using std::shared_ptr;
@@ -46,17 +50,51 @@ using namespace apache::thrift;
 struct Handler : public test::ParentServiceIf {
   void addString(const std::string& s) override { strings_.push_back(s); }
   void getStrings(std::vector<std::string>& _return) override { _return = strings_; }
+  void getDataWait(std::string&, const int32_t waitMs) override { THRIFT_SLEEP_USEC(waitMs * 1000); }
   std::vector<std::string> strings_;
 
   // dummy overrides not used in this test
   int32_t incrementGeneration() override { return 0; }
   int32_t getGeneration() override { return 0; }
-  void getDataWait(std::string&, const int32_t) override {}
   void onewayWait() override {}
   void exceptionWait(const std::string&) override {}
   void unexpectedExceptionWait(const std::string&) override {}
 };
 
+// Fails to listen on every SO_REUSEPORT listener after the first few
+class FlakyListenerSocket : public transport::TNonblockingServerSocket {
+public:
+  FlakyListenerSocket(int port, size_t goodListeners)
+    : TNonblockingServerSocket(port), goodListeners_(goodListeners) {}
+
+  std::vector<shared_ptr<transport::TNonblockingServerSocket> > listeners_;
+
+protected:
+  struct FailingListener : public transport::TNonblockingServerSocket {
+    FailingListener(const std::string& address, int port)
+      : TNonblockingServerSocket(address, port) {}
+    void listen() override {
+      throw transport::TTransportException(transport::TTransportException::NOT_OPEN,
+                                           "no more listeners");
+    }
+  };
+
+  shared_ptr<transport::TNonblockingServerSocket> newListener(const std::string& address,
+                                                             int port) override {
+    shared_ptr<transport::TNonblockingServerSocket> listener;
+    if (listeners_.size() < goodListeners_) {
+      listener = make_shared<transport::TNonblockingServerSocket>(address, port);
+    } else {
+      listener = make_shared<FailingListener>(address, port);
+    }
+    listeners_.push_back(listener);
+    return listener;
+  }
+
+private:
+  size_t goodListeners_;
+};
+
 class Fixture {
 private:
   struct ListenEventHandler : public TServerEventHandler {
@@ -75,6 +113,10 @@ private:
 
   struct Runner : public Runnable {
     int port;
+    size_t numIOThreads;
+    bool reusePort;
+    size_t bufferPoolLimit;
+    shared_ptr<ThreadManager> threadManager;
     shared_ptr<event_base> userEventBase;
     shared_ptr<TProcessor> processor;
     shared_ptr<server::TNonblockingServer> server;
@@ -84,6 +126,9 @@ private:
 
     Runner() {
       port = 0;
+      numIOThreads = 1;
+      reusePort = false;
+      bufferPoolLimit = 0;
       listenHandler.reset(new ListenEventHandler(&mutex_));
     }
 
@@ -103,9 +148,22 @@ private:
   private:
     void startServer(int retry_count) {
       try {
-        socket.reset(new transport::TNonblockingServerSocket(port));
+        if (!socket) {
+          socket.reset(new transport::TNonblockingServerSocket(port));
+        }
         server.reset(new server::TNonblockingServer(processor, socket));
         server->setServerEventHandler(listenHandler);
+        server->setNumIOThreads(numIOThreads);
+        server->setReusePortListeners(reusePort);
+        if (threadManager) {
+          server->setThreadManager(threadManager);
+        }
+        if (bufferPoolLimit) {
+          server->setBufferPoolLimit(bufferPoolLimit);
+        }
+        if (reusePort) {
+          server->setIOThreadCpus(std::vector<int>(1, 0));
+        }
         if (userEventBase) {
           server->registerEvents(userEventBase.get());
         }
@@ -126,7 +184,8 @@ private:
   };
 
 protected:
-  Fixture() : processor(new test::ParentServiceProcessor(make_shared<Handler>())) {}
+  Fixture()
+    : bufferPoolLimit_(0), processor(new test::ParentServiceProcessor(make_shared<Handler>())) {}
 
   ~Fixture() {
     if (server) {
@@ -141,9 +200,26 @@ protected:
     userEventBase_.reset(user_event_base, EventDeleter());
   }
 
-  int startServer(int port) {
+  void enableBufferPool(size_t limit) { bufferPoolLimit_ = limit; }
+
+  void useServerSocket(shared_ptr<transport::TNonblockingServerSocket> socket) {
+    serverSocket_ = socket;
+  }
+
+  void useThreadManager(size_t workers) {
+    threadManager_ = ThreadManager::newSimpleThreadManager(workers);
+    threadManager_->threadFactory(make_shared<ThreadFactory>());
+    threadManager_->start();
+  }
+
+  int startServer(int port, size_t numIOThreads = 1, bool reusePort = false) {
     shared_ptr<Runner> runner(new Runner);
     runner->port = port;
+    runner->socket = serverSocket_;
+    runner->numIOThreads = numIOThreads;
+    runner->reusePort = reusePort;
+    runner->bufferPoolLimit = bufferPoolLimit_;
+    runner->threadManager = threadManager_;
     runner->processor = processor;
     runner->userEventBase = userEventBase_;
 
@@ -169,6 +245,9 @@ protected:
   }
 
 private:
+  size_t bufferPoolLimit_;
+  shared_ptr<transport::TNonblockingServerSocket> serverSocket_;
+  shared_ptr<ThreadManager> threadManager_;
   shared_ptr<event_base> userEventBase_;
   shared_ptr<test::ParentServiceProcessor> processor;
 protected:
@@ -212,4 +291,221 @@ BOOST_FIXTURE_TEST_CASE(provide_event_base, Fixture) {
 #endif
 }
 
+BOOST_FIXTURE_TEST_CASE(reuse_port_listeners, Fixture) {
+  startServer(0, 4, true);
+  BOOST_REQUIRE(server->getReusePortListeners());
+  int port = server->getListenPort();
+
+  // keep all connections open so they land on different IO threads
+  std::vector<shared_ptr<test::ParentServiceClient> > clients;
+  for (int i = 0; i < 16; ++i) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+    socket->open();
+    clients.push_back(make_shared<test::ParentServiceClient>(
+        make_shared<protocol::TBinaryProtocol>(make_shared<transport::TFramedTransport>(socket))));
+  }
+  for (auto& client : clients) {
+    client->addString("foo");
+  }
+  std::vector<std::string> strings;
+  clients.front()->getStrings(strings);
+  BOOST_CHECK_EQUAL(strings.size(), 16u);
+}
+
+BOOST_FIXTURE_TEST_CASE(reuse_port_listener_failure, Fixture) {
+  shared_ptr<FlakyListenerSocket> socket = make_shared<FlakyListenerSocket>(0, 1);
+  useServerSocket(socket);
+  startServer(0, 4, true);
+  BOOST_CHECK(!server->getReusePortListeners());
+  int port = server->getListenPort();
+
+  // The listener IO thread #1 got is closed again, so #0 accepts everything
+  BOOST_REQUIRE_EQUAL(socket->listeners_.size(), 2u);
+  BOOST_CHECK_EQUAL(socket->listeners_[0]->getSocketFD(), THRIFT_INVALID_SOCKET);
+
+  std::vector<shared_ptr<test::ParentServiceClient> > clients;
+  for (int i = 0; i < 8; ++i) {
+    shared_ptr<transport::TSocket> client(new transport::TSocket("localhost", port));
+    client->open();
+    clients.push_back(make_shared<test::ParentServiceClient>(
+        make_shared<protocol::TBinaryProtocol>(make_shared<transport::TFramedTransport>(client))));
+  }
+  for (auto& client : clients) {
+    client->addString("foo");
+  }
+  std::vector<std::string> strings;
+  clients.front()->getStrings(strings);
+  BOOST_CHECK_EQUAL(strings.size(), 8u);
+}
+
+BOOST_AUTO_TEST_CASE(io_thread_cpus_out_of_range) {
+  server::TNonblockingServer server(make_shared<test::ParentServiceProcessor>(make_shared<Handler>()),
+                                    make_shared<transport::TNonblockingServerSocket>(0));
+  BOOST_CHECK_THROW(server.setIOThreadCpus(std::vector<int>(1, -1)), std::invalid_argument);
+#ifdef CPU_SETSIZE
+  BOOST_CHECK_THROW(server.setIOThreadCpus(std::vector<int>(1, CPU_SETSIZE)),
+                    std::invalid_argument);
+#endif
+  BOOST_CHECK(server.getIOThreadCpus().empty());
+
+  server.setIOThreadCpus(std::vector<int>{0, 1});
+  BOOST_CHECK_EQUAL(server.getIOThreadCpus().size(), 2u);
+}
+
+// Waits for the IO thread to give back the buffers of the last response
+static server::TBufferSlabPoolStats idleBufferPoolStats(const server::TNonblockingServer& server) {
+  server::TBufferSlabPoolStats stats = server.getBufferPoolStats();
+  for (int i = 0; i < 100 && stats.slabsInUse > 0; ++i) {
+    THRIFT_SLEEP_USEC(10000);
+    stats = server.getBufferPoolStats();
+  }
+  return stats;
+}
+
+BOOST_FIXTURE_TEST_CASE(pooled_buffers, Fixture) {
+  enableBufferPool(4 * 1024 * 1024);
+  startServer(0);
+  BOOST_REQUIRE_EQUAL(server->getBufferPoolLimit(), 4u * 1024 * 1024);
+  int port = server->getListenPort();
+
+  // Connections come and go, each borrowing the same few slabs
+  for (int i = 0; i < 20; ++i) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+    socket->open();
+    test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+    client.addString("foo");
+    client.addString("bar");
+  }
+
+  // A request and a response that outgrow the default slabs
+  std::string big(100 * 1000, 'x');
+  shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+  socket->open();
+  test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(socket)));
+  client.addString(big);
+  std::vector<std::string> strings;
+  client.getStrings(strings);
+  BOOST_REQUIRE_EQUAL(strings.size(), 41u);
+  BOOST_CHECK(strings.back() == big);
+
+  server::TBufferSlabPoolStats stats = idleBufferPoolStats(*server);
+  BOOST_CHECK_EQUAL(stats.slabsInUse, 0u);
+  BOOST_CHECK_GE(stats.slabsInUseHighWater, 2u);
+  BOOST_CHECK_LE(stats.allocations, 6u);
+  BOOST_CHECK_GE(stats.reuses, 80u);
+  BOOST_CHECK_GT(stats.freeSlabs, 0u);
+  BOOST_CHECK_LE(stats.freeBytes, server->getBufferPoolLimit());
+  BOOST_CHECK_GE(stats.freeBytesHighWater, stats.freeBytes);
+}
+
+BOOST_FIXTURE_TEST_CASE(unpooled_buffers, Fixture) {
+  startServer(0);
+  BOOST_CHECK_EQUAL(server->getBufferPoolLimit(), 0u);
+  BOOST_CHECK(canCommunicate(server->getListenPort()));
+
+  server::TBufferSlabPoolStats stats = server->getBufferPoolStats();
+  BOOST_CHECK_EQUAL(stats.allocations, 0u);
+  BOOST_CHECK_EQUAL(stats.slabsInUseHighWater, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(sojourn_histogram) {
+  server::TSojournMonitor monitor;
+  BOOST_CHECK_EQUAL(monitor.getTarget(), 0);
+  BOOST_CHECK_EQUAL(monitor.getInterval(), server::TSojournMonitor::DEFAULT_INTERVAL);
+  const int64_t waits[] = {0, 1, 3, 1000, 1023, 1024, int64_t(1) << 40};
+  for (int64_t us : waits) {
+    BOOST_CHECK(!monitor.record(us));
+  }
+  server::TSojournStats stats = monitor.getStats();
+  BOOST_CHECK_EQUAL(stats.tasks, 7u);
+  BOOST_CHECK_EQUAL(stats.buckets[0], 1u);
+  BOOST_CHECK_EQUAL(stats.buckets[1], 1u);
+  BOOST_CHECK_EQUAL(stats.buckets[2], 1u);
+  BOOST_CHECK_EQUAL(stats.buckets[10], 2u);
+  BOOST_CHECK_EQUAL(stats.buckets[11], 1u);
+  BOOST_CHECK_EQUAL(stats.buckets[server::TSojournStats::NUM_BUCKETS - 1], 1u);
+  BOOST_CHECK_EQUAL(stats.percentileUs(0.5), 1024);
+  BOOST_CHECK_EQUAL(stats.percentileUs(0.8), 2048);
+  BOOST_CHECK_EQUAL(server::TSojournStats().percentileUs(0.5), 0);
+
+  // Waits above a 1 ms target for a whole interval start the shedding of
+  // those over 2 ms, and one short wait in an interval ends it
+  monitor.setTarget(1);
+  monitor.setInterval(1);
+  BOOST_CHECK(!monitor.record(5000));
+  THRIFT_SLEEP_USEC(2000);
+  BOOST_CHECK(!monitor.record(1500));
+  BOOST_CHECK(monitor.getStats().overloaded);
+  BOOST_CHECK(monitor.record(2500));
+  BOOST_CHECK(!monitor.record(100));
+  THRIFT_SLEEP_USEC(2000);
+  BOOST_CHECK(!monitor.record(5000));
+  stats = monitor.getStats();
+  BOOST_CHECK(!stats.overloaded);
+  BOOST_CHECK_EQUAL(stats.shed, 1u);
+  BOOST_CHECK_EQUAL(stats.intervalMinUs, 100);
+}
+
+BOOST_FIXTURE_TEST_CASE(shed_on_queue_wait, Fixture) {
+  useThreadManager(1);
+  startServer(0);
+  server->setSojournTarget(5);
+  server->setSojournInterval(20);
+  int port = server->getListenPort();
+
+  // Eight clients keep a single worker busy with 20 ms requests, so the
+  // queue never drains
+  const int clients = 8;
+  const int calls = 10;
+  std::vector<int> shed(clients, 0);
+  std::vector<int> failed(clients, 0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < clients; ++i) {
+    threads.emplace_back([&, i] {
+      shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+      socket->open();
+      test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+          make_shared<transport::TFramedTransport>(socket)));
+      for (int j = 0; j < calls; ++j) {
+        try {
+          std::string data;
+          client.getDataWait(data, 20);
+        } catch (const TApplicationException& x) {
+          if (x.getType() == TApplicationException::INTERNAL_ERROR) {
+            ++shed[i];
+          } else {
+            ++failed[i];
+          }
+        } catch (...) {
+          ++failed[i];
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  int totalShed = 0;
+  for (int i = 0; i < clients; ++i) {
+    BOOST_CHECK_EQUAL(failed[i], 0);
+    totalShed += shed[i];
+  }
+  server::TSojournStats stats = server->getSojournStats();
+  BOOST_CHECK_GT(totalShed, 0);
+  BOOST_CHECK_EQUAL(stats.shed, static_cast<uint64_t>(totalShed));
+  BOOST_CHECK_EQUAL(stats.tasks, static_cast<uint64_t>(clients * calls));
+  uint64_t histogram = 0;
+  for (uint64_t bucket : stats.buckets) {
+    histogram += bucket;
+  }
+  BOOST_CHECK_EQUAL(histogram, stats.tasks);
+  BOOST_CHECK_GT(stats.percentileUs(0.99), 10 * 1000);
+
+  // A request that does not wait is never shed
+  BOOST_CHECK(canCommunicate(port));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -21,9 +21,12 @@
 #include <thrift/transport/TSocket.h>
 #include <thrift/transport/TServerSocket.h>
 #include <memory>
+#include <string>
+#include <thread>
 #include "TTransportCheckThrow.h"
 #include <iostream>
 
+using apache::thrift::transport::TIOVec;
 using apache::thrift::transport::TServerSocket;
 using apache::thrift::transport::TSocket;
 using apache::thrift::transport::TTransport;
@@ -70,4 +73,37 @@ BOOST_AUTO_TEST_CASE(test_get_port) {
   BOOST_CHECK_EQUAL(888, sock1.getPort());
 }
 
+BOOST_AUTO_TEST_CASE(test_write_iov) {
+  TServerSocket sock1("localhost", 0);
+  sock1.listen();
+  TSocket clientSock("localhost", sock1.getPort());
+  clientSock.open();
+  shared_ptr<TTransport> accepted = sock1.accept();
+
+  // Big enough that the kernel takes it in several partial sends
+  std::string head("head");
+  std::string body(8 * 1024 * 1024, 'x');
+  for (size_t i = 0; i < body.size(); i += 4093) {
+    body[i] = static_cast<char>(i);
+  }
+  std::string tail("tail");
+  TIOVec iov[4] = {{reinterpret_cast<const uint8_t*>(head.data()), 4},
+                   {nullptr, 0},
+                   {reinterpret_cast<const uint8_t*>(body.data()), static_cast<uint32_t>(body.size())},
+                   {reinterpret_cast<const uint8_t*>(tail.data()), 4}};
+
+  std::string received(head.size() + body.size() + tail.size(), '\0');
+  std::thread reader([&] {
+    accepted->readAll(reinterpret_cast<uint8_t*>(&received[0]),
+                      static_cast<uint32_t>(received.size()));
+  });
+  clientSock.write_iov(iov, 4);
+  reader.join();
+
+  BOOST_CHECK(received == head + body + tail);
+  accepted->close();
+  clientSock.close();
+  sock1.close();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
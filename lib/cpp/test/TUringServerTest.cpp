@@ -0,0 +1,288 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE TUringServerTest
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "thrift/concurrency/Monitor.h"
+#include "thrift/concurrency/Thread.h"
+#include "thrift/concurrency/ThreadManager.h"
+#include "thrift/server/TUringServer.h"
+#include "thrift/transport/TNonblockingServerSocket.h"
+
+#include "gen-cpp/ParentService.h"
+
+using apache::thrift::concurrency::Guard;
+using apache::thrift::concurrency::Monitor;
+using apache::thrift::concurrency::Mutex;
+using apache::thrift::concurrency::Runnable;
+using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::ThreadFactory;
+using apache::thrift::concurrency::ThreadManager;
+using apache::thrift::server::TServerEventHandler;
+using apache::thrift::server::TUringServer;
+using std::make_shared;
+using std::shared_ptr;
+
+using namespace apache::thrift;
+
+struct Handler : public test::ParentServiceIf {
+  Handler() : onewayMonitor_(&mutex_), onewayStarted_(false) {}
+
+  void addString(const std::string& s) override {
+    Guard g(mutex_);
+    strings_.push_back(s);
+  }
+  void getStrings(std::vector<std::string>& _return) override {
+    Guard g(mutex_);
+    _return = strings_;
+  }
+  void onewayWait() override {
+    {
+      Guard g(mutex_);
+      onewayStarted_ = true;
+      onewayMonitor_.notify();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  void waitForOneway() {
+    Guard g(mutex_);
+    while (!onewayStarted_) {
+      onewayMonitor_.wait();
+    }
+  }
+  Mutex mutex_;
+  std::vector<std::string> strings_;
+  Monitor onewayMonitor_;
+  bool onewayStarted_;
+
+  // dummy overrides not used in this test
+  int32_t incrementGeneration() override { return 0; }
+  int32_t getGeneration() override { return 0; }
+  void getDataWait(std::string& _return, const int32_t length) override {
+    _return.assign(static_cast<size_t>(length), 'x');
+  }
+  void exceptionWait(const std::string&) override {}
+  void unexpectedExceptionWait(const std::string&) override {}
+};
+
+class Fixture {
+private:
+  struct ListenEventHandler : public TServerEventHandler {
+    public:
+      ListenEventHandler(Mutex* mutex) : listenMonitor_(mutex), ready_(false) {}
+
+      void preServe() override /* override */ {
+        Guard g(listenMonitor_.mutex());
+        ready_ = true;
+        listenMonitor_.notify();
+      }
+
+      Monitor listenMonitor_;
+      bool ready_;
+  };
+
+  struct Runner : public Runnable {
+    shared_ptr<TProcessor> processor;
+    shared_ptr<ThreadManager> threadManager;
+    size_t numIOThreads;
+    shared_ptr<TUringServer> server;
+    shared_ptr<ListenEventHandler> listenHandler;
+    shared_ptr<transport::TNonblockingServerSocket> socket;
+    Mutex mutex_;
+
+    Runner() : numIOThreads(1) {
+      listenHandler.reset(new ListenEventHandler(&mutex_));
+    }
+
+    void run() override {
+      socket.reset(new transport::TNonblockingServerSocket(0));
+      server.reset(new TUringServer(processor,
+                                    make_shared<protocol::TBinaryProtocolFactory>(),
+                                    socket,
+                                    threadManager));
+      server->setNumIOThreads(numIOThreads);
+      server->setServerEventHandler(listenHandler);
+      server->serve();
+    }
+
+    void readyBarrier() {
+      // block until server is listening and ready to accept connections
+      Guard g(mutex_);
+      while (!listenHandler->ready_) {
+        listenHandler->listenMonitor_.wait();
+      }
+    }
+  };
+
+protected:
+  Fixture()
+    : handler(make_shared<Handler>()), processor(new test::ParentServiceProcessor(handler)) {}
+
+  ~Fixture() {
+    stopServer();
+    if (threadManager) {
+      threadManager->stop();
+    }
+  }
+
+  int startServer(size_t numIOThreads = 1, size_t numWorkers = 0) {
+    shared_ptr<Runner> runner(new Runner);
+    runner->processor = processor;
+    runner->numIOThreads = numIOThreads;
+    if (numWorkers) {
+      threadManager = ThreadManager::newSimpleThreadManager(numWorkers);
+      threadManager->threadFactory(make_shared<ThreadFactory>());
+      threadManager->start();
+      runner->threadManager = threadManager;
+    }
+
+    shared_ptr<ThreadFactory> threadFactory(
+        new ThreadFactory(false));
+    thread = threadFactory->newThread(runner);
+    thread->start();
+    runner->readyBarrier();
+
+    server = runner->server;
+    return server->getListenPort();
+  }
+
+  void stopServer() {
+    if (server) {
+      server->stop();
+    }
+    if (thread) {
+      thread->join();
+      thread.reset();
+    }
+  }
+
+  bool canCommunicate(int serverPort) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", serverPort));
+    socket->open();
+    test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+    client.addString("foo");
+    std::vector<std::string> strings;
+    client.getStrings(strings);
+    return !strings.empty() && !(strings.back().compare("foo"));
+  }
+
+  shared_ptr<test::ParentServiceClient> connect(int serverPort) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", serverPort));
+    socket->open();
+    return make_shared<test::ParentServiceClient>(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+  }
+
+protected:
+  shared_ptr<Handler> handler;
+private:
+  shared_ptr<test::ParentServiceProcessor> processor;
+  shared_ptr<ThreadManager> threadManager;
+protected:
+  shared_ptr<TUringServer> server;
+private:
+  shared_ptr<apache::thrift::concurrency::Thread> thread;
+
+};
+
+#define SKIP_IF_UNSUPPORTED()                                                                      \
+  if (!TUringServer::isSupported()) {                                                             \
+    BOOST_TEST_MESSAGE("io_uring is not available, skipping");                                     \
+    return;                                                                                        \
+  }
+
+BOOST_AUTO_TEST_SUITE(TUringServerTest)
+
+BOOST_FIXTURE_TEST_CASE(inline_processing, Fixture) {
+  SKIP_IF_UNSUPPORTED();
+  int port = startServer();
+  BOOST_REQUIRE_NE(port, 0);
+  BOOST_CHECK(canCommunicate(port));
+  // the completion of the last send may not have been reaped yet
+  BOOST_CHECK_GE(server->getNumResponses(), 1u);
+  BOOST_CHECK_GT(server->getNumEnterCalls(), 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(thread_pool_processing, Fixture) {
+  SKIP_IF_UNSUPPORTED();
+  int port = startServer(1, 4);
+  BOOST_CHECK(canCommunicate(port));
+  BOOST_CHECK(canCommunicate(port));
+}
+
+BOOST_FIXTURE_TEST_CASE(multiple_io_threads, Fixture) {
+  SKIP_IF_UNSUPPORTED();
+  int port = startServer(4, 2);
+  std::vector<shared_ptr<test::ParentServiceClient> > clients;
+  for (int i = 0; i < 16; ++i) {
+    clients.push_back(connect(port));
+  }
+  for (auto& client : clients) {
+    client->addString("bar");
+  }
+  std::vector<std::string> strings;
+  clients.front()->getStrings(strings);
+  BOOST_CHECK_EQUAL(strings.size(), 16u);
+}
+
+BOOST_FIXTURE_TEST_CASE(large_response, Fixture) {
+  SKIP_IF_UNSUPPORTED();
+  // spans many receive buffers and needs more than one send
+  int port = startServer();
+  shared_ptr<test::ParentServiceClient> client = connect(port);
+  client->addString(std::string(1024 * 1024, 'y'));
+  std::string data;
+  client->getDataWait(data, 4 * 1024 * 1024);
+  BOOST_CHECK_EQUAL(data.size(), 4u * 1024 * 1024);
+}
+
+BOOST_FIXTURE_TEST_CASE(pipelined_requests, Fixture) {
+  SKIP_IF_UNSUPPORTED();
+  // requests sent ahead wait while the connection is busy with a task
+  int port = startServer(1, 2);
+  shared_ptr<test::ParentServiceClient> client = connect(port);
+  for (int i = 0; i < 500; ++i) {
+    client->send_addString(std::string(100 + i, 'p'));
+  }
+  for (int i = 0; i < 500; ++i) {
+    client->recv_addString();
+  }
+  std::vector<std::string> strings;
+  client->getStrings(strings);
+  BOOST_REQUIRE_EQUAL(strings.size(), 500u);
+  BOOST_CHECK_EQUAL(strings.back().size(), 599u);
+}
+
+BOOST_FIXTURE_TEST_CASE(stop_while_task_runs, Fixture) {
+  SKIP_IF_UNSUPPORTED();
+  // stopping waits for the task, then frees its connection
+  int port = startServer(1, 1);
+  shared_ptr<test::ParentServiceClient> client = connect(port);
+  client->onewayWait();
+  handler->waitForOneway();
+  stopServer();
+  BOOST_CHECK_EQUAL(server->getNumConnections(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,249 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TProtocolTranscoder.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace thrift::test::debug;
+
+// Every heap allocation in the process goes through these
+static uint64_t allocations = 0;
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size != 0 ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+class Timer {
+public:
+  timeval vStart;
+
+  Timer() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+  void start() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+
+  double frame() {
+    timeval vEnd;
+    THRIFT_GETTIMEOFDAY(&vEnd, nullptr);
+    double dstart = vStart.tv_sec + ((double)vStart.tv_usec / 1000000.0);
+    double dend = vEnd.tv_sec + ((double)vEnd.tv_usec / 1000000.0);
+    return dend - dstart;
+  }
+};
+
+typedef TBinaryProtocolT<TMemoryBuffer> BinaryProtocol;
+typedef TCompactProtocolT<TMemoryBuffer> CompactProtocol;
+
+static OneOfEach makeOneOfEach() {
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.im_false = false;
+  ooe.a_bite = 0x7f;
+  ooe.integer16 = 27000;
+  ooe.integer32 = 1 << 24;
+  ooe.integer64 = 6000000000LL;
+  ooe.double_precision = 3.1415926535897931;
+  ooe.some_characters = "JSON THIS! \"\1";
+  ooe.zomg_unicode = "\xd7\n\a\t";
+  ooe.base64 = std::string(64, '\x01');
+  for (int i = 0; i < 32; ++i) {
+    ooe.byte_list.push_back(static_cast<int8_t>(i));
+    ooe.i16_list.push_back(static_cast<int16_t>(i * 1000));
+    ooe.i64_list.push_back(static_cast<int64_t>(i) << 33);
+  }
+  return ooe;
+}
+
+static HolyMoley makeHolyMoley() {
+  HolyMoley hm;
+  for (int i = 0; i < 8; ++i) {
+    hm.big.push_back(makeOneOfEach());
+  }
+  std::vector<std::string> stage1;
+  stage1.push_back("and a one");
+  stage1.push_back("and a two");
+  hm.contain.insert(stage1);
+  stage1.push_back("then a one, two");
+  hm.contain.insert(stage1);
+  for (int i = 0; i < 4; ++i) {
+    std::vector<Bonk> bonks(3);
+    for (int j = 0; j < 3; ++j) {
+      bonks[j].type = i * j;
+      bonks[j].message = "quoth the raven";
+    }
+    hm.bonks["bonk " + std::to_string(i)] = bonks;
+  }
+  return hm;
+}
+
+static CompactProtoTestStruct makeCompactProtoTestStruct() {
+  CompactProtoTestStruct cpts;
+  cpts.a_byte = 127;
+  cpts.a_i16 = 32000;
+  cpts.a_i32 = 1000000000;
+  cpts.a_i64 = 0xffffffffffLL;
+  cpts.a_double = 5.6789;
+  cpts.a_string = "my string";
+  cpts.true_field = true;
+  for (int16_t i = 0; i < 100; ++i) {
+    cpts.i16_list.push_back(static_cast<int16_t>(-i * 100));
+    cpts.i32_list.push_back(i * 100000);
+    cpts.i64_list.push_back(static_cast<int64_t>(i) << 40);
+    cpts.double_list.push_back(i / 3.0);
+    cpts.string_list.push_back("element");
+    cpts.boolean_list.push_back(i % 3 == 0);
+    cpts.i32_byte_map[i * 70000] = static_cast<int8_t>(i);
+    cpts.byte_string_map[static_cast<int8_t>(i)] = "value";
+  }
+  cpts.field500 = 500;
+  cpts.field5000 = 5000;
+  cpts.field20000 = 20000;
+  return cpts;
+}
+
+/**
+ * The value as the arguments of a call, in the protocol's encoding.
+ */
+template <typename Protocol, typename T>
+static std::string message(const T& value) {
+  std::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol prot(buf);
+  prot.writeMessageBegin("method", T_CALL, 42);
+  value.write(&prot);
+  prot.writeMessageEnd();
+  return buf->getBufferAsString();
+}
+
+/**
+ * Converts the message from In to Out num times, by decoding it into a T
+ * and encoding that again, and with TProtocolTranscoder on the concrete
+ * and on the virtual protocols. Reports the time and the heap allocations
+ * of a conversion for each.
+ */
+template <typename T, typename In, typename Out>
+static bool run(const char* label, const std::string& input, const T& expected, int num) {
+  uint8_t* data = reinterpret_cast<uint8_t*>(const_cast<char*>(input.data()));
+  auto datasize = static_cast<uint32_t>(input.size());
+  std::shared_ptr<TMemoryBuffer> rbuf(new TMemoryBuffer(data, datasize));
+  std::shared_ptr<TMemoryBuffer> wbuf(new TMemoryBuffer(datasize * 2));
+  std::shared_ptr<In> iprot(new In(rbuf));
+  std::shared_ptr<Out> oprot(new Out(wbuf));
+
+  double elapsed[3];
+  uint64_t allocated[3];
+  for (int method = 0; method < 3; ++method) {
+    TProtocolTranscoder<In, Out> transcoder(iprot, oprot);
+    TProtocolTranscoder<> virtualTranscoder(iprot, oprot);
+    std::string name;
+    TMessageType messageType;
+    int32_t seqid;
+    T value;
+
+    uint64_t allocationsBefore = allocations;
+    Timer timer;
+    for (int i = 0; i < num; ++i) {
+      rbuf->resetBuffer(data, datasize);
+      wbuf->resetBuffer();
+      if (method == 0) {
+        iprot->readMessageBegin(name, messageType, seqid);
+        value.read(iprot.get());
+        iprot->readMessageEnd();
+        oprot->writeMessageBegin(name, messageType, seqid);
+        value.write(oprot.get());
+        oprot->writeMessageEnd();
+      } else if (method == 1) {
+        transcoder.transcodeMessage();
+      } else {
+        virtualTranscoder.transcodeMessage();
+      }
+    }
+    elapsed[method] = timer.frame();
+    allocated[method] = (allocations - allocationsBefore) / num;
+
+    Out reader(wbuf);
+    T result;
+    reader.readMessageBegin(name, messageType, seqid);
+    result.read(&reader);
+    reader.readMessageEnd();
+    if (!(result == expected) || name != "method" || seqid != 42) {
+      std::cout << label << ": method " << method << " produced a different message\n";
+      return false;
+    }
+  }
+
+  std::cout << label << " (" << datasize << " bytes):\n"
+            << "  decode+encode: " << num / elapsed[0] << " msgs/sec, " << allocated[0]
+            << " allocations/msg\n"
+            << "  transcoder:    " << num / elapsed[1] << " msgs/sec, " << allocated[1]
+            << " allocations/msg\n"
+            << "  (virtual):     " << num / elapsed[2] << " msgs/sec, " << allocated[2]
+            << " allocations/msg\n";
+  return true;
+}
+
+template <typename T>
+static bool runBothWays(const char* label, const T& value, int num) {
+  std::string binary = message<BinaryProtocol>(value);
+  std::string compact = message<CompactProtocol>(value);
+  std::string binaryLabel = std::string(label) + " binary->compact";
+  std::string compactLabel = std::string(label) + " compact->binary";
+  return run<T, BinaryProtocol, CompactProtocol>(binaryLabel.c_str(), binary, value, num)
+         && run<T, CompactProtocol, BinaryProtocol>(compactLabel.c_str(), compact, value, num);
+}
+
+/*
+ * Compares converting DebugProtoTest messages between TBinaryProtocol and
+ * TCompactProtocol through generated types with TProtocolTranscoder.
+ */
+int main() {
+  int num = 20000;
+  if (!runBothWays("OneOfEach", makeOneOfEach(), num)
+      || !runBothWays("HolyMoley", makeHolyMoley(), num / 4)
+      || !runBothWays("CompactProtoTestStruct", makeCompactProtoTestStruct(), num / 4)) {
+    return 1;
+  }
+  return 0;
+}
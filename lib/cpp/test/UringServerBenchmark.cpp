@@ -0,0 +1,208 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <thrift/TProcessor.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/server/TNonblockingServer.h>
+#include <thrift/server/TUringServer.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TNonblockingServerSocket.h>
+#include <thrift/transport/TSocket.h>
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::server;
+using namespace apache::thrift::transport;
+
+/**
+ * Answers every call with an empty reply, so that the server's own work is
+ * what gets measured.
+ */
+class EchoProcessor : public TProcessor {
+public:
+  bool process(std::shared_ptr<TProtocol> in, std::shared_ptr<TProtocol> out, void*) override {
+    std::string name;
+    TMessageType type;
+    int32_t seqid;
+    in->readMessageBegin(name, type, seqid);
+    in->skip(T_STRUCT);
+    in->readMessageEnd();
+    in->getTransport()->readEnd();
+
+    out->writeMessageBegin(name, T_REPLY, seqid);
+    out->writeStructBegin("result");
+    out->writeFieldStop();
+    out->writeStructEnd();
+    out->writeMessageEnd();
+    out->getTransport()->writeEnd();
+    out->getTransport()->flush();
+    return true;
+  }
+};
+
+class ReadyHandler : public TServerEventHandler {
+public:
+  ReadyHandler() : ready_(false) {}
+
+  void preServe() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ready_ = true;
+    cond_.notify_all();
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return ready_; });
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool ready_;
+};
+
+/**
+ * Makes num calls on a connection of its own, one at a time, recording how
+ * long each took in microseconds.
+ */
+static void callServer(int port, int num, std::vector<double>& latencies) {
+  std::shared_ptr<TSocket> socket(new TSocket("localhost", port));
+  socket->setNoDelay(true);
+  TBinaryProtocol protocol(std::make_shared<TFramedTransport>(socket));
+  protocol.getTransport()->open();
+  latencies.reserve(num);
+  for (int i = 0; i < num; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    protocol.writeMessageBegin("ping", T_CALL, i);
+    protocol.writeStructBegin("args");
+    protocol.writeFieldStop();
+    protocol.writeStructEnd();
+    protocol.writeMessageEnd();
+    protocol.getTransport()->writeEnd();
+    protocol.getTransport()->flush();
+
+    std::string name;
+    TMessageType type;
+    int32_t seqid;
+    protocol.readMessageBegin(name, type, seqid);
+    protocol.skip(T_STRUCT);
+    protocol.readMessageEnd();
+    protocol.getTransport()->readEnd();
+    latencies.push_back(std::chrono::duration<double, std::micro>(
+                            std::chrono::steady_clock::now() - start).count());
+  }
+  protocol.getTransport()->close();
+}
+
+/**
+ * Runs clients threads of num calls each against server, which is served
+ * and stopped here, and prints their latencies along with the system time
+ * and voluntary context switches of the whole process for each call.
+ */
+template <typename Server>
+static void run(const char* label, Server& server, int clients, int num) {
+  std::shared_ptr<ReadyHandler> ready(new ReadyHandler());
+  server.setServerEventHandler(ready);
+  std::thread serving([&server] { server.serve(); });
+  ready->wait();
+
+  struct rusage before;
+  getrusage(RUSAGE_SELF, &before);
+  std::vector<std::vector<double> > latencies(clients);
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < clients; ++i) {
+    int port = server.getListenPort();
+    threads.emplace_back([port, num, &latencies, i] { callServer(port, num, latencies[i]); });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  double elapsed
+      = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  struct rusage after;
+  getrusage(RUSAGE_SELF, &after);
+
+  std::vector<double> all;
+  for (auto& client : latencies) {
+    all.insert(all.end(), client.begin(), client.end());
+  }
+  std::sort(all.begin(), all.end());
+  double calls = static_cast<double>(all.size());
+  double systemUs = (after.ru_stime.tv_sec - before.ru_stime.tv_sec) * 1000000.0
+                    + (after.ru_stime.tv_usec - before.ru_stime.tv_usec);
+  std::cout << label << ", " << clients << " clients:\n"
+            << "  " << calls / elapsed << " calls/sec\n"
+            << "  p50 " << all[all.size() / 2] << " us, p99 " << all[all.size() * 99 / 100]
+            << " us\n"
+            << "  " << systemUs / calls << " us system time, "
+            << (after.ru_nvcsw - before.ru_nvcsw) / calls << " voluntary context switches"
+            << " per call\n";
+
+  server.stop();
+  serving.join();
+}
+
+/*
+ * Compares TUringServer with TNonblockingServer, each with one IO thread
+ * processing calls inline, over loopback TCP. The clients are the same for
+ * both, so differences in the system time and context switches of the
+ * process come from the servers. For exact system call counts, run under
+ * perf stat -e raw_syscalls:sys_enter, once with each server.
+ */
+int main() {
+  if (!TUringServer::isSupported()) {
+    std::cout << "io_uring is not available, skipping\n";
+    return 0;
+  }
+
+  std::shared_ptr<TProcessor> processor(new EchoProcessor());
+  std::shared_ptr<TProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
+  const int clientCounts[] = {1, 16};
+  const int calls = 5000;
+
+  for (int clients : clientCounts) {
+    TNonblockingServer nonblocking(processor,
+                                   protocolFactory,
+                                   std::make_shared<TNonblockingServerSocket>(0));
+    run("TNonblockingServer", nonblocking, clients, calls);
+
+    TUringServer uring(processor, protocolFactory, std::make_shared<TNonblockingServerSocket>(0));
+    uint64_t enterCalls = uring.getNumEnterCalls();
+    run("TUringServer", uring, clients, calls);
+    std::cout << "  "
+              << static_cast<double>(uring.getNumEnterCalls() - enterCalls) / (clients * calls)
+              << " io_uring_enter calls per call\n";
+  }
+  return 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <variant>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/VariantUnionTest_constants.h"
+#include "gen-cpp/VariantUnionTest_types.h"
+
+#define BOOST_TEST_MODULE VariantUnionTest
+#include <boost/test/unit_test.hpp>
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using thrift::test::variant::Color;
+using thrift::test::variant::Holder;
+using thrift::test::variant::Point;
+using thrift::test::variant::Value;
+using thrift::test::variant::ValueFields;
+using thrift::test::variant::WithDefault;
+
+static Point makePoint(int32_t x, int32_t y) {
+  Point point;
+  point.__set_x(x);
+  point.__set_y(y);
+  return point;
+}
+
+template <typename Protocol, typename From, typename To>
+static void transfer(const From& from, To& to) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol protocol(buffer);
+  from.write(&protocol);
+  to.read(&protocol);
+  BOOST_CHECK_EQUAL(buffer->available_read(), 0u);
+}
+
+template <typename Protocol>
+static void checkRoundTrip(const Value& value) {
+  Value copy;
+  transfer<Protocol>(value, copy);
+  BOOST_CHECK(copy == value);
+  BOOST_CHECK(copy.getType() == value.getType());
+}
+
+template <typename Protocol>
+static void checkRoundTrips() {
+  Value value;
+  checkRoundTrip<Protocol>(value);
+  value.__set_text("some text");
+  checkRoundTrip<Protocol>(value);
+  value.__set_number(-1234567890123LL);
+  checkRoundTrip<Protocol>(value);
+  value.__set_real(2.5);
+  checkRoundTrip<Protocol>(value);
+  value.__set_point(makePoint(3, -4));
+  checkRoundTrip<Protocol>(value);
+  value.mutable_numbers().push_back(1);
+  value.mutable_numbers().push_back(2);
+  checkRoundTrip<Protocol>(value);
+  value.mutable_points()["a"] = makePoint(1, 2);
+  value.mutable_points()["b"] = makePoint(5, 6);
+  checkRoundTrip<Protocol>(value);
+  value.__set_color(Color::GREEN);
+  checkRoundTrip<Protocol>(value);
+
+  Value inner;
+  inner.__set_text("inner");
+  value.__set_nested(std::make_shared<Value>(inner));
+  Value copy;
+  transfer<Protocol>(value, copy);
+  BOOST_REQUIRE(copy.getType() == Value::Type::nested);
+  BOOST_CHECK(*copy.get_nested() == inner);
+}
+
+BOOST_AUTO_TEST_CASE(test_round_trip_binary) {
+  checkRoundTrips<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_round_trip_compact) {
+  checkRoundTrips<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_round_trip_json) {
+  checkRoundTrips<TJSONProtocol>();
+}
+
+template <typename Protocol, typename T>
+static void checkSerializedSize(const T& value) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol protocol(buffer);
+  value.write(&protocol);
+  BOOST_CHECK_EQUAL(value.template serializedSize<Protocol>(), buffer->available_read());
+}
+
+BOOST_AUTO_TEST_CASE(test_serialized_size) {
+  Holder holder;
+  Value value;
+  holder.values.push_back(value);
+  value.__set_text("some text");
+  holder.values.push_back(value);
+  value.__set_point(makePoint(3, -4));
+  holder.values.push_back(value);
+  value.mutable_points()["a"] = makePoint(1, 2);
+  holder.values.push_back(value);
+  value.__set_nested(std::make_shared<Value>(holder.values[1]));
+  holder.values.push_back(value);
+  value.__set_nested(nullptr);
+  holder.values.push_back(value);
+  holder.value = value;
+
+  for (size_t i = 0; i < holder.values.size(); ++i) {
+    checkSerializedSize<TBinaryProtocol>(holder.values[i]);
+    checkSerializedSize<TCompactProtocol>(holder.values[i]);
+  }
+  checkSerializedSize<TBinaryProtocol>(holder);
+  checkSerializedSize<TCompactProtocol>(holder);
+}
+
+BOOST_AUTO_TEST_CASE(test_accessors) {
+  Value value;
+  BOOST_CHECK(value.getType() == Value::Type::__EMPTY__);
+  BOOST_CHECK_THROW(value.get_text(), std::bad_variant_access);
+
+  value.__set_number(42);
+  BOOST_CHECK(value.getType() == Value::Type::number);
+  BOOST_CHECK_EQUAL(value.get_number(), 42);
+  BOOST_CHECK_THROW(value.get_text(), std::bad_variant_access);
+
+  // mutable_ switches to the field, but leaves it alone when it is set
+  value.mutable_text() = "text";
+  BOOST_CHECK(value.getType() == Value::Type::text);
+  value.mutable_text() += " more";
+  BOOST_CHECK_EQUAL(value.get_text(), "text more");
+
+  value.__clear();
+  BOOST_CHECK(value.getType() == Value::Type::__EMPTY__);
+
+  WithDefault withDefault;
+  BOOST_CHECK(withDefault.getType() == WithDefault::Type::name);
+  BOOST_CHECK_EQUAL(withDefault.get_name(), "unnamed");
+
+  BOOST_CHECK(thrift::test::variant::g_VariantUnionTest_constants.ORIGIN.getType()
+              == Value::Type::point);
+  BOOST_CHECK(thrift::test::variant::g_VariantUnionTest_constants.ORIGIN.get_point()
+              == makePoint(0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(test_smaller_than_fields) {
+  // The variant holds one field at a time, where the struct holds them all
+  BOOST_CHECK_LT(sizeof(Value), sizeof(ValueFields));
+}
+
+BOOST_AUTO_TEST_CASE(test_same_wire_format) {
+  Value value;
+  value.__set_point(makePoint(7, 8));
+  ValueFields fields;
+  transfer<TCompactProtocol>(value, fields);
+  BOOST_CHECK(fields.__isset.point);
+  BOOST_CHECK(!fields.__isset.text);
+  BOOST_CHECK(fields.point == makePoint(7, 8));
+
+  fields = ValueFields();
+  fields.__set_numbers(std::vector<int32_t>(3, 9));
+  Value copy;
+  copy.__set_text("replaced");
+  transfer<TCompactProtocol>(fields, copy);
+  BOOST_REQUIRE(copy.getType() == Value::Type::numbers);
+  BOOST_CHECK(copy.get_numbers() == std::vector<int32_t>(3, 9));
+}
+
+BOOST_AUTO_TEST_CASE(test_equality) {
+  Value a;
+  Value b;
+  BOOST_CHECK(a == b);
+  a.__set_number(1);
+  BOOST_CHECK(a != b);
+  b.__set_number(1);
+  BOOST_CHECK(a == b);
+  b.__set_real(1.0);
+  BOOST_CHECK(a != b);
+  b.__set_text("1");
+  BOOST_CHECK(a != b);
+
+  swap(a, b);
+  BOOST_CHECK_EQUAL(a.get_text(), "1");
+  BOOST_CHECK_EQUAL(b.get_number(), 1);
+}
+
+template <typename T>
+static std::string print(const T& value) {
+  std::ostringstream out;
+  out << value;
+  return out.str();
+}
+
+BOOST_AUTO_TEST_CASE(test_print) {
+  Value value;
+  BOOST_CHECK_EQUAL(print(value), "Value()");
+  value.__set_number(5);
+  BOOST_CHECK_EQUAL(print(value), "Value(number=5)");
+  value.__set_point(makePoint(1, 2));
+  BOOST_CHECK_EQUAL(print(value), "Value(point=Point(x=1, y=2))");
+
+  Holder holder;
+  holder.value.__set_text("held");
+  holder.values.resize(1);
+  BOOST_CHECK_EQUAL(print(holder), "Holder(value=Value(text=held), values=[Value()])");
+}
@@ -0,0 +1,70 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+// Generated with cpp:variant_unions,serialized_size by VariantUnionTest
+
+namespace cpp thrift.test.variant
+
+enum Color {
+  RED = 1,
+  GREEN = 2
+}
+
+struct Point {
+  1: i32 x
+  2: i32 y
+}
+
+union Value {
+  1: string text
+  2: i64 number
+  3: double real
+  4: Point point
+  5: list<i32> numbers
+  6: map<string, Point> points
+  7: Color color
+  8: Value & nested
+}
+
+/**
+ * The fields of Value as a struct, which is how a union is generated
+ * without cpp:variant_unions.
+ */
+struct ValueFields {
+  1: optional string text
+  2: optional i64 number
+  3: optional double real
+  4: optional Point point
+  5: optional list<i32> numbers
+  6: optional map<string, Point> points
+  7: optional Color color
+}
+
+union WithDefault {
+  1: i32 count
+  2: string name = "unnamed"
+}
+
+struct Holder {
+  1: Value value
+  2: list<Value> values
+}
+
+const Value ORIGIN = { "point": { "x": 0, "y": 0 } }
@@ -0,0 +1,240 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TVarintUtils.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/ThriftTest_types.h"
+
+#define BOOST_TEST_MODULE VarintTest
+#include <boost/test/unit_test.hpp>
+
+using namespace apache::thrift::protocol;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+
+/*
+ * Values of every encoded length, with long runs of single byte ones so
+ * that the bulk paths of the decoders and encoders are taken too.
+ */
+template <typename T>
+static std::vector<T> makeValues() {
+  std::vector<T> values;
+  uint64_t state = 12345;
+  for (int run = 0; run < 64; ++run) {
+    int length = run % 3 == 0 ? 40 : 7;
+    for (int i = 0; i < length; ++i) {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      int bits = run % 3 == 0 ? 6 : static_cast<int>(state >> 58) % (8 * sizeof(T));
+      T value = static_cast<T>((state >> 20) & ((static_cast<uint64_t>(1) << bits) - 1));
+      values.push_back(state & 1 ? value : static_cast<T>(-value - 1));
+    }
+  }
+  values.push_back(std::numeric_limits<T>::min());
+  values.push_back(std::numeric_limits<T>::max());
+  values.push_back(0);
+  values.push_back(-1);
+  values.push_back(63);
+  values.push_back(-64);
+  values.push_back(64);
+  return values;
+}
+
+// What TCompactProtocol writes for the values one at a time
+template <typename T>
+static std::string encodeOneByOne(const std::vector<T>& values) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TCompactProtocol prot(buffer);
+  for (size_t i = 0; i < values.size(); ++i) {
+    prot.writeI64(values[i]);
+  }
+  return buffer->getBufferAsString();
+}
+
+template <>
+std::string encodeOneByOne(const std::vector<int32_t>& values) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TCompactProtocol prot(buffer);
+  for (size_t i = 0; i < values.size(); ++i) {
+    prot.writeI32(values[i]);
+  }
+  return buffer->getBufferAsString();
+}
+
+static uint32_t encode(const int32_t* values, uint32_t count, uint8_t* buf) {
+  return varint_encode_zigzag32(values, count, buf);
+}
+
+static uint32_t encode(const int64_t* values, uint32_t count, uint8_t* buf) {
+  return varint_encode_zigzag64(values, count, buf);
+}
+
+static uint32_t decode(const uint8_t* buf,
+                       uint32_t len,
+                       int32_t* values,
+                       uint32_t count,
+                       uint32_t* decoded) {
+  return varint_decode_zigzag32(buf, len, values, count, decoded);
+}
+
+static uint32_t decode(const uint8_t* buf,
+                       uint32_t len,
+                       int64_t* values,
+                       uint32_t count,
+                       uint32_t* decoded) {
+  return varint_decode_zigzag64(buf, len, values, count, decoded);
+}
+
+template <typename T>
+static void checkCoding() {
+  std::vector<T> values = makeValues<T>();
+  std::string expected = encodeOneByOne(values);
+  uint32_t count = static_cast<uint32_t>(values.size());
+
+  std::vector<uint8_t> buf(values.size() * 10);
+  uint32_t len = encode(values.data(), count, buf.data());
+  BOOST_REQUIRE_EQUAL(len, expected.size());
+  BOOST_CHECK(std::string(reinterpret_cast<char*>(buf.data()), len) == expected);
+
+  std::vector<T> decoded(values.size());
+  uint32_t n = 0;
+  BOOST_CHECK_EQUAL(decode(buf.data(), len, decoded.data(), count, &n), len);
+  BOOST_CHECK_EQUAL(n, count);
+  BOOST_CHECK(decoded == values);
+
+  // Fewer values than are there
+  n = 0;
+  uint32_t used = decode(buf.data(), len, decoded.data(), 50, &n);
+  BOOST_CHECK_EQUAL(n, 50u);
+  BOOST_CHECK_EQUAL(used, encodeOneByOne(std::vector<T>(values.begin(), values.begin() + 50)).size());
+
+  // The last value (64) is two bytes, cutting it off leaves it out
+  n = 0;
+  BOOST_CHECK_EQUAL(decode(buf.data(), len - 1, decoded.data(), count, &n), len - 2);
+  BOOST_CHECK_EQUAL(n, count - 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_varint32_matches_compact_protocol) {
+  checkCoding<int32_t>();
+}
+
+BOOST_AUTO_TEST_CASE(test_varint64_matches_compact_protocol) {
+  checkCoding<int64_t>();
+}
+
+BOOST_AUTO_TEST_CASE(test_varint_decode_stops_at_overlong_value) {
+  std::vector<uint8_t> buf(64, 0x02);
+  buf[20] = buf[21] = buf[22] = buf[23] = buf[24] = 0xff;
+  buf[25] = 0x01;
+  int32_t values32[64];
+  uint32_t n = 0;
+  BOOST_CHECK_EQUAL(varint_decode_zigzag32(buf.data(), 64, values32, 64, &n), 20u);
+  BOOST_CHECK_EQUAL(n, 20u);
+  BOOST_CHECK_EQUAL(values32[19], 1);
+
+  // Six bytes is fine for an i64, eleven is not
+  int64_t values64[64];
+  BOOST_CHECK_EQUAL(varint_decode_zigzag64(buf.data(), 64, values64, 64, &n), 64u);
+  BOOST_CHECK_EQUAL(n, 64u - 5);
+  std::fill(buf.begin() + 20, buf.begin() + 31, 0xff);
+  BOOST_CHECK_EQUAL(varint_decode_zigzag64(buf.data(), 64, values64, 64, &n), 20u);
+  BOOST_CHECK_EQUAL(n, 20u);
+}
+
+template <typename T>
+static void protocolRoundTrip(bool smallBuffer) {
+  std::vector<T> values = makeValues<T>();
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TCompactProtocol oprot(buffer);
+  uint32_t wsize;
+  if (sizeof(T) == 4) {
+    wsize = oprot.writeI32Array(reinterpret_cast<const int32_t*>(values.data()),
+                                static_cast<uint32_t>(values.size()));
+  } else {
+    wsize = oprot.writeI64Array(reinterpret_cast<const int64_t*>(values.data()),
+                                static_cast<uint32_t>(values.size()));
+  }
+  BOOST_CHECK_EQUAL(wsize, buffer->available_read());
+  BOOST_CHECK(buffer->getBufferAsString() == encodeOneByOne(values));
+
+  std::shared_ptr<apache::thrift::transport::TTransport> trans = buffer;
+  if (smallBuffer) {
+    // Values straddle the end of the 16 byte buffer all the time
+    trans.reset(new TBufferedTransport(buffer, 16));
+  }
+  TCompactProtocol iprot(trans);
+  std::vector<T> decoded(values.size());
+  uint32_t rsize;
+  if (sizeof(T) == 4) {
+    rsize = iprot.readI32Array(reinterpret_cast<int32_t*>(decoded.data()),
+                               static_cast<uint32_t>(decoded.size()));
+  } else {
+    rsize = iprot.readI64Array(reinterpret_cast<int64_t*>(decoded.data()),
+                               static_cast<uint32_t>(decoded.size()));
+  }
+  BOOST_CHECK_EQUAL(rsize, wsize);
+  BOOST_CHECK(decoded == values);
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_arrays) {
+  protocolRoundTrip<int32_t>(false);
+  protocolRoundTrip<int64_t>(false);
+  protocolRoundTrip<int32_t>(true);
+  protocolRoundTrip<int64_t>(true);
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_array_overlong_values) {
+  // readI32() takes up to ten bytes for an i32, and so does readI32Array()
+  uint8_t bytes[] = {0x02, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01, 0x04,
+                     0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01};
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(bytes, sizeof(bytes)));
+  TCompactProtocol iprot(buffer);
+  int32_t values[4];
+  BOOST_CHECK_EQUAL(iprot.readI32Array(values, 3), 8u);
+  BOOST_CHECK_EQUAL(values[0], 1);
+  BOOST_CHECK_EQUAL(values[1], std::numeric_limits<int32_t>::min());
+  BOOST_CHECK_EQUAL(values[2], 2);
+  BOOST_CHECK_THROW(iprot.readI32Array(values + 3, 1), TProtocolException);
+}
+
+template <typename Protocol_>
+static void generatedRoundTrip() {
+  thrift::test::VersioningTestV2 in;
+  in.newlist = makeValues<int32_t>();
+  std::vector<int32_t> set = makeValues<int32_t>();
+  in.newset.insert(set.begin(), set.end());
+
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ prot(buffer);
+  in.write(&prot);
+  thrift::test::VersioningTestV2 out;
+  out.read(&prot);
+  BOOST_CHECK(out.newlist == in.newlist);
+  BOOST_CHECK(out.newset == in.newset);
+}
+
+BOOST_AUTO_TEST_CASE(test_generated_lists_and_sets) {
+  generatedRoundTrip<TCompactProtocol>();
+  generatedRoundTrip<TBinaryProtocol>();
+}
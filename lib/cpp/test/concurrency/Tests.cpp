@@ -152,16 +152,86 @@ int main(int argc, char** argv) {
     }
   }
 
+  if (runAll || args[0].compare("timing-wheel-timer-manager") == 0) {
+
+    std::cout << "TimingWheelTimerManager tests..." << '\n';
+
+    TimerManagerTests timerManagerTests;
+
+    std::cout << "\t\tTimingWheelTimerManager test00" << '\n';
+
+    if (!timerManagerTests.test00<TimingWheelTimerManager>()) {
+      std::cerr << "\t\tTimingWheelTimerManager tests FAILED" << '\n';
+      return 1;
+    }
+
+    std::cout << "\t\tTimingWheelTimerManager test01" << '\n';
+
+    if (!timerManagerTests.test01<TimingWheelTimerManager>()) {
+      std::cerr << "\t\tTimingWheelTimerManager tests FAILED" << '\n';
+      return 1;
+    }
+
+    std::cout << "\t\tTimingWheelTimerManager test02" << '\n';
+
+    if (!timerManagerTests.test02<TimingWheelTimerManager>()) {
+      std::cerr << "\t\tTimingWheelTimerManager tests FAILED" << '\n';
+      return 1;
+    }
+
+    std::cout << "\t\tTimingWheelTimerManager test03" << '\n';
+
+    if (!timerManagerTests.test03<TimingWheelTimerManager>()) {
+      std::cerr << "\t\tTimingWheelTimerManager tests FAILED" << '\n';
+      return 1;
+    }
+
+    std::cout << "\t\tTimingWheelTimerManager test04" << '\n';
+
+    if (!timerManagerTests.test04<TimingWheelTimerManager>()) {
+      std::cerr << "\t\tTimingWheelTimerManager tests FAILED" << '\n';
+      return 1;
+    }
+  }
+
+  if (runAll || args[0].compare("timer-manager-benchmark") == 0) {
+
+    std::cout << "TimerManager benchmark..." << '\n';
+
+    TimerManagerTests timerManagerTests;
+    size_t timerCount = 100000 * WEIGHT;
+
+    std::cout << "\t\tTimerManager" << '\n';
+
+    if (!timerManagerTests.benchmark<TimerManager>(timerCount)) {
+      std::cerr << "\t\tTimerManager benchmark FAILED" << '\n';
+      return 1;
+    }
+
+    std::cout << "\t\tTimingWheelTimerManager" << '\n';
+
+    if (!timerManagerTests.benchmark<TimingWheelTimerManager>(timerCount)) {
+      std::cerr << "\t\tTimingWheelTimerManager benchmark FAILED" << '\n';
+      return 1;
+    }
+  }
+
   if (runAll || args[0].compare("thread-manager") == 0) {
 
     std::cout << "ThreadManager tests..." << '\n';
 
-    {
+    ThreadManagerTests::Factory factories[] = {&ThreadManager::newSimpleThreadManager,
+                                               &ThreadManager::newWorkStealingThreadManager};
+    const char* names[] = {"Simple", "WorkStealing"};
+
+    for (size_t fx = 0; fx < 2; fx++) {
       size_t workerCount = 10 * WEIGHT;
       size_t taskCount = 500 * WEIGHT;
       int64_t delay = 10LL;
 
-      ThreadManagerTests threadManagerTests;
+      std::cout << "\t" << names[fx] << "ThreadManager" << '\n';
+
+      ThreadManagerTests threadManagerTests(factories[fx]);
 
       std::cout << "\t\tThreadManager api test:" << '\n';
 
@@ -220,6 +290,34 @@ int main(int argc, char** argv) {
     }
   }
 
+  if (runAll || args[0].compare("thread-manager-contention") == 0) {
+
+    std::cout << "ThreadManager contention benchmark..." << '\n';
+
+    size_t tasksPerThread = 1000 * WEIGHT;
+
+    for (size_t threadCount = 1; threadCount <= 64; threadCount *= 4) {
+
+      std::cout << "\t\tSimpleThreadManager" << '\n';
+
+      ThreadManagerTests simpleTests(&ThreadManager::newSimpleThreadManager);
+
+      if (!simpleTests.contentionTest(threadCount, tasksPerThread)) {
+        std::cerr << "\t\tThreadManager contentionTest FAILED" << '\n';
+        return 1;
+      }
+
+      std::cout << "\t\tWorkStealingThreadManager" << '\n';
+
+      ThreadManagerTests workStealingTests(&ThreadManager::newWorkStealingThreadManager);
+
+      if (!workStealingTests.contentionTest(threadCount, tasksPerThread)) {
+        std::cerr << "\t\tThreadManager contentionTest FAILED" << '\n';
+        return 1;
+      }
+    }
+  }
+
   std::cout << "ALL TESTS PASSED" << '\n';
   return 0;
 }
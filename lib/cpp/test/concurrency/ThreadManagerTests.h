@@ -23,12 +23,14 @@
 #include <thrift/concurrency/Monitor.h>
 
 #include <assert.h>
+#include <atomic>
 #include <deque>
 #include <set>
 #include <iostream>
 #include <stdint.h>
 #include <chrono>
 #include <thread>
+#include <vector>
 
 namespace apache {
 namespace thrift {
@@ -50,6 +52,14 @@ static void sleep_(int64_t millisec) {
 class ThreadManagerTests {
 
 public:
+  typedef shared_ptr<ThreadManager> (*Factory)(size_t count, size_t pendingTaskCountMax);
+
+  /**
+   * Runs the tests against the thread managers factory makes
+   */
+  ThreadManagerTests(Factory factory = &ThreadManager::newSimpleThreadManager)
+    : _factory(factory) {}
+
   class Task : public Runnable {
 
   public:
@@ -98,7 +108,7 @@ public:
 
     size_t activeCount = count;
 
-    shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(workerCount);
+    shared_ptr<ThreadManager> threadManager = _factory(workerCount, 0);
 
     shared_ptr<ThreadFactory> threadFactory
         = shared_ptr<ThreadFactory>(new ThreadFactory(false));
@@ -244,7 +254,7 @@ public:
       size_t activeCounts[] = {workerCount, pendingTaskMaxCount, 1};
 
       shared_ptr<ThreadManager> threadManager
-          = ThreadManager::newSimpleThreadManager(workerCount, pendingTaskMaxCount);
+          = _factory(workerCount, pendingTaskMaxCount);
 
       shared_ptr<ThreadFactory> threadFactory
           = shared_ptr<ThreadFactory>(new ThreadFactory());
@@ -393,7 +403,7 @@ public:
 
   bool apiTestWithThreadFactory(shared_ptr<ThreadFactory> threadFactory)
   {
-    shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(1);
+    shared_ptr<ThreadManager> threadManager = _factory(1, 0);
     threadManager->threadFactory(threadFactory);
 
     std::cout << "\t\t\t\tstarting.. " << '\n';
@@ -622,6 +632,79 @@ public:
     threadManager.reset();
     return true;
   }
+
+  class CountTask : public Runnable {
+
+  public:
+    CountTask(Monitor& monitor, std::atomic<size_t>& count) : _monitor(monitor), _count(count) {}
+
+    void run() override {
+      if (--_count == 0) {
+        Synchronized s(_monitor);
+        _monitor.notify();
+      }
+    }
+
+    Monitor& _monitor;
+    std::atomic<size_t>& _count;
+  };
+
+  /**
+   * Contention benchmark.  threadCount threads add taskCount tasks each that
+   * do next to nothing to a thread manager with threadCount workers, so the
+   * time taken is mostly spent queueing and dequeueing.
+   */
+  bool contentionTest(size_t threadCount, size_t taskCount) {
+
+    Monitor monitor;
+
+    std::atomic<size_t> activeCount(threadCount * taskCount);
+
+    shared_ptr<ThreadManager> threadManager = _factory(threadCount, 0);
+
+    threadManager->threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory(false)));
+
+    threadManager->start();
+
+    shared_ptr<Runnable> task(new ThreadManagerTests::CountTask(monitor, activeCount));
+
+    auto time00 = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> adders;
+    for (size_t ix = 0; ix < threadCount; ix++) {
+      adders.push_back(std::thread([&threadManager, &task, taskCount]() {
+        for (size_t jx = 0; jx < taskCount; jx++) {
+          threadManager->add(task);
+        }
+      }));
+    }
+
+    for (auto & adder : adders) {
+      adder.join();
+    }
+
+    {
+      Synchronized s(monitor);
+      while (activeCount > 0) {
+        monitor.wait();
+      }
+    }
+
+    auto time01 = std::chrono::steady_clock::now();
+
+    threadManager->stop();
+
+    int64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(time01 - time00).count();
+
+    std::cout << "\t\t\tthreads: " << threadCount << " tasks: " << threadCount * taskCount
+              << " elapsed: " << elapsed / 1000 << "ms tasks/ms: "
+              << (threadCount * taskCount * 1000) / (elapsed > 0 ? elapsed : 1) << '\n';
+
+    return threadManager->totalTaskCount() == 0;
+  }
+
+private:
+  Factory _factory;
 };
 
 }
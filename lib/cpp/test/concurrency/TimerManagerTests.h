@@ -18,13 +18,16 @@
  */
 
 #include <thrift/concurrency/TimerManager.h>
+#include <thrift/concurrency/TimingWheelTimerManager.h>
 #include <thrift/concurrency/ThreadFactory.h>
 #include <thrift/concurrency/Monitor.h>
 
 #include <assert.h>
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <iostream>
+#include <vector>
 
 namespace apache {
 namespace thrift {
@@ -74,16 +77,17 @@ public:
    * properly clean up itself and the remaining orphaned timeout task when the
    * manager goes out of scope and its destructor is called.
    */
+  template <typename Manager = TimerManager>
   bool test00(uint64_t timeout = 1000LL) {
 
     shared_ptr<TimerManagerTests::Task> orphanTask
         = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, 10 * timeout));
 
     {
-      TimerManager timerManager;
+      Manager timerManager;
       timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
       timerManager.start();
-      if (timerManager.state() != TimerManager::STARTED) {
+      if (timerManager.state() != Manager::STARTED) {
         std::cerr << "timerManager is not in the STARTED state, but should be" << '\n';
         return false;
       }
@@ -124,11 +128,12 @@ public:
    * verifies that the timer manager properly clean up itself and the remaining orphaned timeout
    * task when the manager goes out of scope and its destructor is called.
    */
+  template <typename Manager = TimerManager>
   bool test01(uint64_t timeout = 1000LL) {
-    TimerManager timerManager;
+    Manager timerManager;
     timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
     timerManager.start();
-    assert(timerManager.state() == TimerManager::STARTED);
+    assert(timerManager.state() == Manager::STARTED);
 
     Synchronized s(_monitor);
 
@@ -157,11 +162,12 @@ public:
    * clean up itself and the remaining orphaned timeout task when the manager goes out of scope
    * and its destructor is called.
    */
+  template <typename Manager = TimerManager>
   bool test02(uint64_t timeout = 1000LL) {
-    TimerManager timerManager;
+    Manager timerManager;
     timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
     timerManager.start();
-    assert(timerManager.state() == TimerManager::STARTED);
+    assert(timerManager.state() == Manager::STARTED);
 
     Synchronized s(_monitor);
 
@@ -190,18 +196,19 @@ public:
    * verifies that the timer manager properly clean up itself and the remaining orphaned timeout
    * task when the manager goes out of scope and its destructor is called.
    */
+  template <typename Manager = TimerManager>
   bool test03(uint64_t timeout = 1000LL) {
-    TimerManager timerManager;
+    Manager timerManager;
     timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
     timerManager.start();
-    assert(timerManager.state() == TimerManager::STARTED);
+    assert(timerManager.state() == Manager::STARTED);
 
     Synchronized s(_monitor);
 
     // Setup the two tasks
     shared_ptr<TimerManagerTests::Task> taskToRemove
         = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, timeout / 2));
-    TimerManager::Timer timer = timerManager.add(taskToRemove, taskToRemove->_timeout);
+    typename Manager::Timer timer = timerManager.add(taskToRemove, taskToRemove->_timeout);
 
     shared_ptr<TimerManagerTests::Task> task
       = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, timeout));
@@ -227,18 +234,19 @@ public:
   /**
    * This test creates one task, and tries to remove it after it has expired.
    */
+  template <typename Manager = TimerManager>
   bool test04(uint64_t timeout = 1000LL) {
-    TimerManager timerManager;
+    Manager timerManager;
     timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
     timerManager.start();
-    assert(timerManager.state() == TimerManager::STARTED);
+    assert(timerManager.state() == Manager::STARTED);
 
     Synchronized s(_monitor);
 
     // Setup the task
     shared_ptr<TimerManagerTests::Task> task
       = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, timeout / 10));
-    TimerManager::Timer timer = timerManager.add(task, task->_timeout);
+    typename Manager::Timer timer = timerManager.add(task, task->_timeout);
     task.reset();
 
     // Wait until the task has completed
@@ -262,6 +270,68 @@ public:
     return true;
   }
 
+  class CountTask : public Runnable {
+  public:
+    CountTask() : _count(0) {}
+
+    void run() override { ++_count; }
+
+    std::atomic<size_t> _count;
+  };
+
+  /**
+   * Throughput benchmark.  Adds count timers due in an hour and cancels them
+   * all by their handles, then adds count timers due within the next second
+   * and waits for them all to run.
+   */
+  template <typename Manager>
+  bool benchmark(size_t count) {
+    Manager timerManager;
+    timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
+    timerManager.start();
+    assert(timerManager.state() == Manager::STARTED);
+
+    shared_ptr<CountTask> task(new CountTask());
+    std::vector<typename Manager::Timer> timers;
+    timers.reserve(count);
+
+    auto time00 = std::chrono::steady_clock::now();
+
+    for (size_t ix = 0; ix < count; ix++) {
+      timers.push_back(timerManager.add(task, 3600000 + ix % 1000));
+    }
+
+    auto time01 = std::chrono::steady_clock::now();
+
+    for (size_t ix = 0; ix < count; ix++) {
+      timerManager.remove(timers[ix]);
+    }
+
+    auto time02 = std::chrono::steady_clock::now();
+
+    for (size_t ix = 0; ix < count; ix++) {
+      timerManager.add(task, 1 + ix % 1000);
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (task->_count < count && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto time03 = std::chrono::steady_clock::now();
+
+    int64_t addTime = std::chrono::duration_cast<std::chrono::microseconds>(time01 - time00).count();
+    int64_t removeTime = std::chrono::duration_cast<std::chrono::microseconds>(time02 - time01).count();
+    int64_t runTime = std::chrono::duration_cast<std::chrono::microseconds>(time03 - time02).count();
+    std::cout << "\t\t\ttimers: " << count << " add: " << addTime / 1000 << "ms remove: "
+              << removeTime / 1000 << "ms add and run: " << runTime / 1000 << "ms timers/ms: "
+              << (count * 1000) / (addTime > 0 ? addTime : 1) << " / "
+              << (count * 1000) / (removeTime > 0 ? removeTime : 1) << " / "
+              << (count * 1000) / (runTime > 0 ? runTime : 1) << '\n';
+
+    return task->_count == count && timerManager.taskCount() == 0;
+  }
+
   friend class TestTask;
 
   Monitor _monitor;